@@ -219,9 +219,8 @@ bool ModelBanner::on_update(Float32 _delta_time) {
   m_camera.projection = Math::perspective(45.0f, {0.01f, 1024.0f},
     dimensions.w / dimensions.h);
 
-  m_models.each_fwd([&](Render::Model& _model) {
-    _model.update(_delta_time);
-  });
+  Render::Model::update(engine()->thread_pool(),
+    {m_models.data(), m_models.size()}, _delta_time);
 
   if (m_animation) {
     m_animation->update(_delta_time);
@@ -16,6 +16,8 @@
 #include "rx/render/skybox.h"
 #include "rx/render/model.h"
 
+#include "rx/model/blend_tree.h"
+
 #include "rx/render/indirect_lighting_pass.h"
 #include "rx/render/lens_distortion_pass.h"
 #include "rx/render/copy_pass.h"
@@ -32,9 +34,12 @@
 
 #include "rx/math/camera.h"
 #include "rx/math/range.h"
+#include "rx/math/frustum.h"
+#include "rx/math/aabb_tree.h"
 
 #include "rx/core/filesystem/directory.h"
 #include "rx/core/filesystem/unbuffered_file.h"
+#include "rx/core/filesystem/watcher.h"
 
 #include "rx/core/concurrency/thread_pool.h"
 
@@ -48,6 +53,8 @@
 
 using namespace Rx;
 
+static constexpr const char* PARTICLE_PROGRAM = "base/particles/sphere.asm";
+
 static constexpr const char* LUTS[] = {
   "base/colorgrading/Arabica 12.CUBE",
   "base/colorgrading/Ava 614.CUBE",
@@ -127,6 +134,10 @@ struct TestGame
     , m_memory_stats{&m_immediate2D}
     , m_render_stats{&m_immediate2D}
     , m_models{m_frontend.allocator()}
+    , m_blend_root{0}
+    , m_blend_time{0.0f}
+    , m_model_tree{m_frontend.allocator()}
+    , m_model_proxies{m_frontend.allocator()}
     , m_color_grader{&m_frontend}
     , m_lut_index{0}
     , m_lut_count{0}
@@ -151,7 +162,7 @@ struct TestGame
     }
 
     Particle::Assembler assembler{m_frontend.allocator()};
-    m_particle_program = assembler.assemble("base/particles/sphere.asm");
+    m_particle_program = assembler.assemble(PARTICLE_PROGRAM);
     if (!m_particle_program) {
       return false;
     }
@@ -273,9 +284,56 @@ struct TestGame
     if (!add_model("base/models/ratcher_house/ratcher_house.json5")) return false;
     if (!add_model("base/models/spinal_roach/spinal_roach.json5")) return false;
 
+    // Cross-fade the roach between its first two clips with a blend tree.
+    auto& roach = m_models.last();
+    if (const auto& skeleton = roach.skeleton(); skeleton && roach.clips().size() >= 2) {
+      m_blend_tree = Rx::Model::BlendTree::create(m_frontend.allocator(), *skeleton);
+      if (!m_blend_tree) {
+        return false;
+      }
+
+      const auto from = m_blend_tree->add_clip(roach.clips()[0], true);
+      const auto to = m_blend_tree->add_clip(roach.clips()[1], true);
+      if (!from || !to) {
+        return false;
+      }
+
+      const auto blend = m_blend_tree->add_blend(*from, *to, 0.0f);
+      if (!blend) {
+        return false;
+      }
+
+      m_blend_root = *blend;
+      m_blend_tree->evaluate(m_blend_root);
+      roach.animate(&*m_blend_tree);
+    }
+
+    // Reload materials and the particle program as they're edited.
+    auto on_change = Filesystem::Watcher::instance().on_change(
+      [this](const StringView& _file_name) { on_file_change(_file_name); });
+    if (on_change) {
+      m_on_file_change = Utility::move(*on_change);
+    }
+
     return true;
   }
 
+  void on_file_change(const StringView& _file_name) {
+    m_models.each_fwd([&](Render::Model& model_) {
+      model_.reload(_file_name);
+    });
+
+    if (_file_name == PARTICLE_PROGRAM) {
+      Particle::Assembler assembler{m_frontend.allocator()};
+      if (auto program = assembler.assemble(_file_name)) {
+        (void)m_particle_system.replace_program(m_particle_program->hash, *program);
+        m_particle_program = Utility::move(program);
+      } else {
+        engine()->console().print("^rerror: ^w%s", assembler.error());
+      }
+    }
+  }
+
   virtual bool on_update(Float32 _delta_time) {
     auto& input = engine()->input();
     auto& console = engine()->console();
@@ -325,7 +383,20 @@ struct TestGame
       }
 
       if (input.root_layer().keyboard().is_released(Input::ScanCode::T)) {
-        m_models.pop_back();
+        if (!m_models.is_empty()) {
+          // The blend tree points into the skeleton and clips of the model
+          // it animates, drop it before that model goes away.
+          auto& model = m_models.last();
+          if (m_blend_tree && model.blend_tree() == &*m_blend_tree) {
+            model.animate(nullptr);
+            m_blend_tree = nullopt;
+          }
+          if (m_model_proxies.size() == m_models.size()) {
+            m_model_tree.remove(m_model_proxies.last());
+            m_model_proxies.pop_back();
+          }
+          m_models.pop_back();
+        }
       }
       if (input.root_layer().keyboard().is_released(Input::ScanCode::Y)) {
         static int group = 0;
@@ -391,14 +462,40 @@ struct TestGame
 
     m_console.update(console);
 
-    m_models.each_fwd([&](Render::Model& model_) {
-      model_.update(_delta_time);
-    });
+    // Swing from one clip to the other and back.
+    if (m_blend_tree) {
+      m_blend_time += _delta_time;
+      m_blend_tree->set_weight(m_blend_root, Math::sin(m_blend_time) * 0.5f + 0.5f);
+      m_blend_tree->update(_delta_time);
+      m_blend_tree->evaluate(m_blend_root);
+    }
+
+    Render::Model::update(engine()->thread_pool(),
+      {m_models.data(), m_models.size()}, _delta_time);
 
     m_mdl_rotations.each_fwd([&](Math::Vec3f& rotation_) {
       // rotation_.y += 25.0f * _delta_time;
     });
 
+    // Move the bounds of every model in the tree.
+    const auto n_models = m_models.size();
+    for (Size i = 0; i < n_models; i++) {
+      auto& transform = m_mdl_tranforms[i];
+      transform.rotation = Math::Mat3x3f::rotate(m_mdl_rotations[i]);
+
+      const auto bounds = m_models[i].bounds().transform(transform.as_mat4());
+      if (i < m_model_proxies.size()) {
+        m_model_tree.move(m_model_proxies[i], bounds);
+      } else if (auto proxy = m_model_tree.insert(bounds, Uint32(i))) {
+        if (!m_model_proxies.push_back(*proxy)) {
+          m_model_tree.remove(*proxy);
+          break;
+        }
+      } else {
+        break;
+      }
+    }
+
     m_particle_system.update(_delta_time);
 
     return true;
@@ -414,16 +511,20 @@ struct TestGame
 
     m_gbuffer.clear();
 
-    const auto n_models = m_models.size();
-    for (Size i = 0; i < n_models; i++) {
-      auto& model = m_models[i];
-      auto& transform = m_mdl_tranforms[i];
-      const auto& rotate = m_mdl_rotations[i];
-      transform.rotation = Math::Mat3x3f::rotate(rotate);
-      model.render(m_gbuffer.target(), transform.as_mat4(), m_camera.view(),
+    auto render_model = [&](Size _index) {
+      m_models[_index].render(m_gbuffer.target(),
+        m_mdl_tranforms[_index].as_mat4(), m_camera.view(),
         m_camera.projection,
         Render::Model::SKELETON | Render::Model::BOUNDS,
         &m_immediate3D);
+    };
+
+    // Only the models which may be visible are rendered, as well as those
+    // not in the tree.
+    const Math::Frustum frustum{m_camera.view() * m_camera.projection};
+    m_model_tree.query(frustum, render_model);
+    for (Size i = m_model_proxies.size(); i < m_models.size(); i++) {
+      render_model(i);
     }
 
     // Copy the depth for IndirectLightingPass because DS.
@@ -545,6 +646,16 @@ struct TestGame
   Vector<Render::Model> m_models;
   Math::Transform m_transform;
 
+  // Animates the last model, which refers to it.
+  Optional<Rx::Model::BlendTree> m_blend_tree;
+  Size m_blend_root;
+  Float32 m_blend_time;
+
+  // The world bounds of every model for culling, with the proxy of each
+  // model. Models after the last proxy are not in the tree yet.
+  Math::AABBTree m_model_tree;
+  Vector<Uint32> m_model_proxies;
+
   Render::ImageBasedLighting m_ibl;
 
   Render::IndirectLightingPass m_indirect_lighting_pass;
@@ -559,6 +670,8 @@ struct TestGame
   Particle::System m_particle_system;
   Optional<Particle::Program> m_particle_program;
 
+  Filesystem::Watcher::ChangeEvent::Handle m_on_file_change;
+
   Math::Camera m_camera;
   Math::Vec3f m_mouse;
 };
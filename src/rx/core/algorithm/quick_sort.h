@@ -63,6 +63,10 @@ void quick_sort(T* start_, T* end_, F&& _compare) {
       Utility::swap(*start_, *(end_ - 1));
     }
 
+    // The pivot always leaves a hole in the middle, move it to where the pivot
+    // goes once partitioned.
+    *middle = Utility::move(*(end_ - 2));
+
     do {
       while (_compare(*item1, pivot)) {
         if (++item1 >= item2) {
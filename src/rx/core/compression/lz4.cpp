@@ -0,0 +1,277 @@
+#include <string.h> // memcpy
+
+#include "rx/core/compression/lz4.h"
+#include "rx/core/utility/bit.h"
+#include "rx/core/hints/unlikely.h"
+
+namespace Rx::Compression {
+
+// The format requires the last five bytes to be literals and the last match to
+// begin at least twelve bytes before the end.
+static constexpr const Size MIN_MATCH = 4;
+static constexpr const Size LAST_LITERALS = 5;
+static constexpr const Size MF_LIMIT = 12;
+static constexpr const Size MAX_DISTANCE = 65535;
+
+static constexpr const Size HASH_BITS = 12;
+
+// After this many misses in a row (as a power of two) the search for a match
+// begins skipping ahead, incompressible data is passed over quickly.
+static constexpr const Size SKIP_TRIGGER = 6;
+
+template<typename T>
+static inline T read(const Byte* _data) {
+  T value;
+  memcpy(&value, _data, sizeof value);
+  return value;
+}
+
+static inline Uint32 hash4(Uint32 _sequence) {
+  return (_sequence * 2654435761_u32) >> (32 - HASH_BITS);
+}
+
+// Lengths of fifteen or more continue in a run of 255s and a remainder.
+static inline Byte* put_length(Byte* op_, Size _length) {
+  for (; _length >= 255; _length -= 255) {
+    *op_++ = 255;
+  }
+  *op_++ = static_cast<Byte>(_length);
+  return op_;
+}
+
+// Number of matching bytes at |_lhs| and |_rhs|, not going past |_limit|.
+static inline Size count_match(const Byte* _lhs, const Byte* _rhs, const Byte* _limit) {
+  const Byte* begin = _lhs;
+  while (_lhs + sizeof(Uint64) <= _limit) {
+    const auto diff = read<Uint64>(_lhs) ^ read<Uint64>(_rhs);
+    if (diff) {
+      return (_lhs - begin) + bit_search_lsb(diff) / 8;
+    }
+    _lhs += sizeof(Uint64);
+    _rhs += sizeof(Uint64);
+  }
+  while (_lhs < _limit && *_lhs == *_rhs) {
+    _lhs++;
+    _rhs++;
+  }
+  return _lhs - begin;
+}
+
+// Emits a sequence of |_literals| bytes at |_anchor| followed by an optional
+// match. Returns nullptr when it does not fit before |_end|.
+static inline Byte* put_sequence(Byte* op_, Byte* _end, const Byte* _anchor,
+  Size _literals, Size _offset, Size _match_length)
+{
+  const Size worst = 1 + (_literals + 240) / 255 + _literals
+    + (_offset ? 2 + (_match_length + 240) / 255 : 0);
+  if (RX_HINT_UNLIKELY(worst > Size(_end - op_))) {
+    return nullptr;
+  }
+
+  Byte* token = op_++;
+  if (_literals >= 15) {
+    *token = 15 << 4;
+    op_ = put_length(op_, _literals - 15);
+  } else {
+    *token = static_cast<Byte>(_literals << 4);
+  }
+
+  memcpy(op_, _anchor, _literals);
+  op_ += _literals;
+
+  // The last sequence is literals only.
+  if (!_offset) {
+    return op_;
+  }
+
+  *op_++ = static_cast<Byte>(_offset);
+  *op_++ = static_cast<Byte>(_offset >> 8);
+
+  if (_match_length >= 15) {
+    *token |= 15;
+    op_ = put_length(op_, _match_length - 15);
+  } else {
+    *token |= static_cast<Byte>(_match_length);
+  }
+
+  return op_;
+}
+
+Size lz4_bound(Size _size) {
+  return _size + _size / 255 + 16;
+}
+
+Size lz4_compress(const Byte* _src, Size _src_size, Byte* dst_,
+  Size _dst_capacity)
+{
+  const Byte* ip = _src;
+  const Byte* anchor = _src;
+  const Byte* const end = _src + _src_size;
+
+  Byte* op = dst_;
+  Byte* const op_end = dst_ + _dst_capacity;
+
+  if (_src_size > MF_LIMIT) {
+    const Byte* const match_limit = end - LAST_LITERALS;
+    const Byte* const mf_limit = end - MF_LIMIT;
+
+    // Positions of the last occurrence of each hashed four byte sequence.
+    Uint32 table[1 << HASH_BITS] = {};
+
+    ip++;
+    for (;;) {
+      // Find a match.
+      const Byte* match = nullptr;
+      for (Size attempts = 1 << SKIP_TRIGGER; ip <= mf_limit; ip += attempts++ >> SKIP_TRIGGER) {
+        const auto sequence = read<Uint32>(ip);
+        const auto hash = hash4(sequence);
+        const auto candidate = _src + table[hash];
+        table[hash] = static_cast<Uint32>(ip - _src);
+        if (Size(ip - candidate) <= MAX_DISTANCE && read<Uint32>(candidate) == sequence) {
+          match = candidate;
+          break;
+        }
+      }
+
+      if (!match) {
+        break;
+      }
+
+      // Extend it backwards into the pending literals.
+      while (ip > anchor && match > _src && ip[-1] == match[-1]) {
+        ip--;
+        match--;
+      }
+
+      // Then forwards.
+      const auto length = count_match(ip + MIN_MATCH, match + MIN_MATCH, match_limit);
+
+      op = put_sequence(op, op_end, anchor, ip - anchor, ip - match, length);
+      if (!op) {
+        return 0;
+      }
+
+      ip += MIN_MATCH + length;
+      anchor = ip;
+
+      if (ip > mf_limit) {
+        break;
+      }
+
+      // Index a position inside the match so that runs are found again.
+      table[hash4(read<Uint32>(ip - 2))] = static_cast<Uint32>(ip - 2 - _src);
+    }
+  }
+
+  op = put_sequence(op, op_end, anchor, end - anchor, 0, 0);
+  return op ? Size(op - dst_) : 0;
+}
+
+Size lz4_decompress(const Byte* _src, Size _src_size, Byte* dst_,
+  Size _dst_capacity)
+{
+  const Byte* ip = _src;
+  const Byte* const end = _src + _src_size;
+
+  Byte* op = dst_;
+  Byte* const op_end = dst_ + _dst_capacity;
+
+  // Reads a length continuation, false when it runs off the end.
+  auto get_length = [&](Size& length_) {
+    Byte byte;
+    do {
+      if (RX_HINT_UNLIKELY(ip == end)) {
+        return false;
+      }
+      byte = *ip++;
+      length_ += byte;
+    } while (byte == 255);
+    return true;
+  };
+
+  while (ip < end) {
+    const Byte token = *ip++;
+
+    Size literals = token >> 4;
+    if (literals < 15 && end - ip >= 16 && op_end - op >= 16) {
+      // Short literals far from either end are copied as a fixed sixteen bytes,
+      // the excess is overwritten by what follows. The last sequence is never
+      // this far from the end.
+      memcpy(op, ip, 16);
+      ip += literals;
+      op += literals;
+    } else {
+      if (literals == 15 && !get_length(literals)) {
+        return 0;
+      }
+
+      if (RX_HINT_UNLIKELY(literals > Size(end - ip) || literals > Size(op_end - op))) {
+        return 0;
+      }
+
+      memcpy(op, ip, literals);
+      ip += literals;
+      op += literals;
+
+      // The last sequence has no match.
+      if (ip == end) {
+        break;
+      }
+    }
+
+    if (RX_HINT_UNLIKELY(end - ip < 2)) {
+      return 0;
+    }
+
+    const Size offset = ip[0] | (Size(ip[1]) << 8);
+    ip += 2;
+
+    if (RX_HINT_UNLIKELY(offset == 0 || offset > Size(op - dst_))) {
+      return 0;
+    }
+
+    Size length = token & 15;
+
+    // Likewise for short matches that do not overlap within eight bytes.
+    if (length < 15 && offset >= 8 && op_end - op >= 18) {
+      const Byte* match = op - offset;
+      memcpy(op + 0, match + 0, 8);
+      memcpy(op + 8, match + 8, 8);
+      memcpy(op + 16, match + 16, 2);
+      op += length + MIN_MATCH;
+      continue;
+    }
+
+    if (length == 15 && !get_length(length)) {
+      return 0;
+    }
+    length += MIN_MATCH;
+
+    if (RX_HINT_UNLIKELY(length > Size(op_end - op))) {
+      return 0;
+    }
+
+    // Matches may overlap what they produce, repeating the last |offset| bytes.
+    const Byte* match = op - offset;
+    if (offset >= length) {
+      memcpy(op, match, length);
+      op += length;
+    } else if (offset >= sizeof(Uint64)) {
+      Byte* const match_end = op + length;
+      for (; op + sizeof(Uint64) <= match_end; op += sizeof(Uint64), match += sizeof(Uint64)) {
+        memcpy(op, match, sizeof(Uint64));
+      }
+      while (op < match_end) {
+        *op++ = *match++;
+      }
+    } else {
+      for (Size i = 0; i < length; i++) {
+        *op++ = *match++;
+      }
+    }
+  }
+
+  return op - dst_;
+}
+
+} // namespace Rx::Compression
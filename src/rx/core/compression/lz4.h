@@ -0,0 +1,45 @@
+#ifndef RX_CORE_COMPRESSION_LZ4_H
+#define RX_CORE_COMPRESSION_LZ4_H
+#include "rx/core/types.h"
+
+/// \file lz4.h
+///
+/// LZ4 block compression.
+///
+/// Produces and consumes the LZ4 block format, without the frame format around
+/// it. Compression is the single-pass greedy matcher LZ4 is known for, trading
+/// ratio for speed, decompression is little more than a series of copies.
+
+namespace Rx::Compression {
+
+/// Largest compressed size of \p _size bytes of input.
+RX_API Size lz4_bound(Size _size);
+
+/// \brief Compress a block.
+///
+/// \param _src The data to compress.
+/// \param _src_size Number of bytes in \p _src.
+/// \param dst_ Where to write the compressed block.
+/// \param _dst_capacity Number of bytes available in \p dst_.
+/// \returns The compressed size, or zero when it does not fit in
+/// \p _dst_capacity. Compression cannot fail with a capacity of lz4_bound().
+RX_API Size lz4_compress(const Byte* _src, Size _src_size, Byte* dst_,
+  Size _dst_capacity);
+
+/// \brief Decompress a block.
+///
+/// Every read and write is bounds checked so corrupt or hostile input cannot
+/// read or write out of bounds.
+///
+/// \param _src The compressed block.
+/// \param _src_size Number of bytes in \p _src.
+/// \param dst_ Where to write the decompressed data.
+/// \param _dst_capacity Number of bytes available in \p dst_.
+/// \returns The decompressed size, or zero when \p _src is malformed or does
+/// not fit in \p _dst_capacity.
+RX_API Size lz4_decompress(const Byte* _src, Size _src_size, Byte* dst_,
+  Size _dst_capacity);
+
+} // namespace Rx::Compression
+
+#endif // RX_CORE_COMPRESSION_LZ4_H
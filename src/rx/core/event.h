@@ -5,6 +5,7 @@
 #include "rx/core/markers.h"
 #include "rx/core/hints/thread.h"
 
+#include "rx/core/concurrency/atomic.h"
 #include "rx/core/concurrency/spin_lock.h"
 #include "rx/core/concurrency/scope_lock.h"
 
@@ -64,6 +65,9 @@ private:
   mutable Concurrency::SpinLock m_lock;
 
   Vector<Delegate> m_delegates RX_HINT_GUARDED_BY(m_lock);
+
+  // Number of connected delegates, so that checking for any doesn't lock.
+  Concurrency::Atomic<Size> m_size;
 };
 
 template<typename R, typename... Ts>
@@ -85,12 +89,14 @@ Event<R(Ts...)>::Handle::~Handle() {
   if (m_event) {
     Concurrency::ScopeLock lock{m_event->m_lock};
     m_event->m_delegates[m_index] = nullptr;
+    m_event->m_size--;
   }
 }
 
 template<typename R, typename... Ts>
 constexpr Event<R(Ts...)>::Event(Memory::Allocator& _allocator)
   : m_delegates{_allocator}
+  , m_size{0}
 {
 }
 
@@ -121,10 +127,12 @@ Optional<typename Event<R(Ts...)>::Handle> Event<R(Ts...)>::connect(Delegate&& d
     }
 
     m_delegates[i] = Utility::move(delegate_);
+    m_size++;
     return Handle{this, i};
   }
 
   if (m_delegates.emplace_back(Utility::move(delegate_))) {
+    m_size++;
     return Handle{this, delegates};
   }
 
@@ -138,15 +146,8 @@ bool Event<R(Ts...)>::is_empty() const {
 
 template<typename R, typename... Ts>
 Size Event<R(Ts...)>::size() const {
-  Concurrency::ScopeLock lock{m_lock};
-  // This is slightly annoying because |m_delegates| may have empty slots.
-  Size result = 0;
-  m_delegates.each_fwd([&](const Delegate& _delegate) {
-    if (_delegate) {
-      result++;
-    }
-  });
-  return result;
+  // Cannot count |m_delegates| since it may have empty slots.
+  return m_size.load(Concurrency::MemoryOrder::RELAXED);
 }
 
 template<typename R, typename... Ts>
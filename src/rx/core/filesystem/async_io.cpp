@@ -0,0 +1,593 @@
+#include <string.h> // memset
+
+#include "rx/core/filesystem/async_io.h"
+#include "rx/core/filesystem/unbuffered_file.h"
+
+#include "rx/core/concurrency/scheduler.h"
+#include "rx/core/concurrency/mutex.h"
+#include "rx/core/concurrency/condition_variable.h"
+#include "rx/core/concurrency/scope_lock.h"
+#include "rx/core/concurrency/thread.h"
+
+#include "rx/core/memory/slab.h"
+
+#include "rx/core/log.h"
+
+#if defined(RX_PLATFORM_LINUX) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h> // io_uring_params, io_uring_sqe, io_uring_cqe
+#include <sys/syscall.h> // __NR_io_uring_setup, __NR_io_uring_enter
+#include <sys/mman.h> // mmap, munmap
+#include <sys/uio.h> // struct iovec
+#include <unistd.h> // syscall, close
+#include <errno.h> // errno, EINTR, EAGAIN
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define RX_ASYNC_IO_URING
+#endif
+#endif
+
+namespace Rx::Filesystem {
+
+RX_LOG("filesystem/async_io", logger);
+
+struct Request {
+  RX_MARK_NO_COPY(Request);
+  RX_MARK_NO_MOVE(Request);
+
+  Request(Byte* _data, Uint64 _size, Uint64 _offset, AsyncIO::Completion&& completion_)
+    : completion{Utility::move(completion_)}
+    , data{_data}
+    , size{_size}
+    , offset{_offset}
+    , bytes{0}
+    , stream{nullptr}
+  {
+  }
+
+  AsyncIO::Completion completion;
+  Byte* data;
+  Uint64 size;
+  Uint64 offset;
+  Uint64 bytes;
+  Stream::Context* stream;
+#if defined(RX_ASYNC_IO_URING)
+  struct iovec iov;
+  int fd;
+#endif
+};
+
+#if defined(RX_ASYNC_IO_URING)
+// There is no libc wrapper for io_uring, the rings are set up by hand. The
+// kernel and this process share the ring memory, indices are published with
+// acquire and release ordering.
+static int io_uring_setup(unsigned _entries, io_uring_params* params_) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, _entries, params_));
+}
+
+static int io_uring_enter(int _fd, unsigned _to_submit, unsigned _min_complete, unsigned _flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, _fd, _to_submit,
+    _min_complete, _flags, nullptr, 0));
+}
+
+struct Ring {
+  bool init(unsigned _entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof params);
+
+    fd = io_uring_setup(_entries, &params);
+    if (fd < 0) {
+      return false;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    // Newer kernels place both rings in a single mapping.
+    const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+      sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+    }
+
+    sq_ring = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+      sq_ring = nullptr;
+      return false;
+    }
+
+    if (single) {
+      cq_ring = sq_ring;
+    } else {
+      cq_ring = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (cq_ring == MAP_FAILED) {
+        cq_ring = nullptr;
+        return false;
+      }
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    auto sqes_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_map == MAP_FAILED) {
+      return false;
+    }
+
+    auto sq = static_cast<Byte*>(sq_ring);
+    auto cq = static_cast<Byte*>(cq_ring);
+
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_entries = params.sq_entries;
+    sqes = static_cast<io_uring_sqe*>(sqes_map);
+
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    tail = *sq_tail;
+
+    return true;
+  }
+
+  void fini() {
+    if (sqes) {
+      munmap(sqes, sqes_size);
+    }
+    if (cq_ring && cq_ring != sq_ring) {
+      munmap(cq_ring, cq_size);
+    }
+    if (sq_ring) {
+      munmap(sq_ring, sq_size);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  // Get the next free submission entry, nullptr when the ring is full.
+  io_uring_sqe* next() {
+    const auto head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= sq_entries) {
+      return nullptr;
+    }
+    const auto index = tail & sq_mask;
+    auto sqe = &sqes[index];
+    memset(sqe, 0, sizeof *sqe);
+    sq_array[index] = index;
+    tail++;
+    pending++;
+    return sqe;
+  }
+
+  // Publish entries returned by next() and hand them to the kernel.
+  bool submit() {
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+    while (pending) {
+      const auto result = io_uring_enter(fd, pending, 0, 0);
+      if (result < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      pending -= static_cast<unsigned>(result);
+    }
+    return true;
+  }
+
+  int fd = -1;
+
+  void* sq_ring = nullptr;
+  void* cq_ring = nullptr;
+  Size sq_size = 0;
+  Size cq_size = 0;
+  Size sqes_size = 0;
+
+  unsigned* sq_head = nullptr;
+  unsigned* sq_tail = nullptr;
+  unsigned* sq_array = nullptr;
+  unsigned sq_mask = 0;
+  unsigned sq_entries = 0;
+  io_uring_sqe* sqes = nullptr;
+
+  unsigned* cq_head = nullptr;
+  unsigned* cq_tail = nullptr;
+  unsigned cq_mask = 0;
+  io_uring_cqe* cqes = nullptr;
+
+  // Local copy of the submission tail and the count not yet entered.
+  unsigned tail = 0;
+  unsigned pending = 0;
+};
+#endif
+
+struct AsyncIO::Impl {
+  RX_MARK_NO_COPY(Impl);
+  RX_MARK_NO_MOVE(Impl);
+
+  Memory::Allocator& allocator;
+  Concurrency::Scheduler& scheduler;
+  Concurrency::Mutex mutex;
+  Concurrency::ConditionVariable idle_cond;
+  Memory::Slab requests RX_HINT_GUARDED_BY(mutex);
+  Size in_flight        RX_HINT_GUARDED_BY(mutex);
+  Size tasks            RX_HINT_GUARDED_BY(mutex); // Scheduled, not finished.
+  Size queue_depth;
+#if defined(RX_ASYNC_IO_URING)
+  Ring ring;
+  Concurrency::Thread reaper;
+#endif
+
+  Impl(Memory::Allocator& _allocator, Concurrency::Scheduler& _scheduler)
+    : allocator{_allocator}
+    , scheduler{_scheduler}
+    , in_flight{0}
+    , tasks{0}
+    , queue_depth{0}
+  {
+  }
+
+  ~Impl() {
+    // Tasks on the scheduler reference this, every one of them must finish,
+    // not only the reads.
+    drain();
+
+#if defined(RX_ASYNC_IO_URING)
+    if (kernel_backed()) {
+      // A no-op with no request wakes the reaper up to exit.
+      {
+        Concurrency::ScopeLock lock{mutex};
+        auto sqe = ring.next();
+        RX_ASSERT(sqe, "ring full while idle");
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+        if (!ring.submit()) {
+          logger->error("failed to stop");
+        }
+      }
+      RX_ASSERT(reaper.join(), "failed to join thread");
+    }
+    ring.fini();
+#endif
+  }
+
+  bool init(Size _queue_depth) {
+    queue_depth = _queue_depth;
+
+#if defined(RX_ASYNC_IO_URING)
+    if (ring.init(static_cast<unsigned>(_queue_depth))) {
+      // The ring may be larger than asked for.
+      queue_depth = ring.sq_entries;
+    } else {
+      // Commonly disabled by sandboxes and older kernels, not an error.
+      logger->warning("io_uring unavailable, reads will be scheduled");
+      ring.fini();
+      ring = {};
+    }
+#endif
+
+    auto slab = Memory::Slab::create(allocator, sizeof(Request), queue_depth, 1, 1);
+    if (!slab) {
+      logger->error("out of memory");
+      return false;
+    }
+
+    requests = Utility::move(*slab);
+
+#if defined(RX_ASYNC_IO_URING)
+    if (kernel_backed()) {
+      auto thread = Concurrency::Thread::create(allocator, "async io",
+        [this](Sint32) { reap(); });
+      if (!thread) {
+        ring.fini();
+        ring = {};
+        return false;
+      }
+      reaper = Utility::move(*thread);
+      logger->info("using io_uring with %zu entries", queue_depth);
+    }
+#endif
+
+    return true;
+  }
+
+  bool kernel_backed() const {
+#if defined(RX_ASYNC_IO_URING)
+    return ring.fd >= 0;
+#else
+    return false;
+#endif
+  }
+
+  // Allocate a request, blocking while the queue is full. Any reads queued on
+  // the ring are submitted before blocking, otherwise none could complete.
+  Request* acquire(Concurrency::ScopeLock<Concurrency::Mutex>& _lock,
+    Byte* data_, Uint64 _size, Uint64 _offset, Completion&& completion_)
+  {
+#if defined(RX_ASYNC_IO_URING)
+    if (in_flight == queue_depth && ring.pending && !ring.submit()) {
+      return nullptr;
+    }
+#endif
+    idle_cond.wait(_lock, [this] { return in_flight < queue_depth; });
+    auto request = requests.create<Request>(data_, _size, _offset,
+      Utility::move(completion_));
+    if (request) {
+      in_flight++;
+    }
+    return request;
+  }
+
+  // The broadcast happens with |mutex| held, once it's released a waiter in
+  // the destructor may free this.
+  void release(Request* _request) {
+    Concurrency::ScopeLock lock{mutex};
+    requests.destroy(_request);
+    in_flight--;
+    idle_cond.broadcast();
+  }
+
+  void add_task() {
+    Concurrency::ScopeLock lock{mutex};
+    tasks++;
+  }
+
+  // Must be the last thing a task does, this may be freed right after.
+  void finish_task() {
+    Concurrency::ScopeLock lock{mutex};
+    tasks--;
+    idle_cond.broadcast();
+  }
+
+  // The request is released before the completion is invoked, so that the
+  // completion is free to queue another read.
+  void complete(Request* _request) {
+    const auto bytes = _request->bytes;
+    auto completion = Utility::move(_request->completion);
+    release(_request);
+    completion(bytes);
+  }
+
+  // Hand the completion to the scheduler, running it here when that fails so
+  // that it's never lost.
+  void schedule(Request* _request) {
+    auto task = [this, _request](Sint32) {
+      complete(_request);
+      finish_task();
+    };
+    add_task();
+    if (!scheduler.add(task)) {
+      logger->warning("failed to schedule completion");
+      task(-1);
+    }
+  }
+
+  bool read(Stream::Context& _stream, Byte* data_, Uint64 _size,
+    Uint64 _offset, Completion&& completion_)
+  {
+    Request* request = nullptr;
+    {
+      Concurrency::ScopeLock lock{mutex};
+      request = acquire(lock, data_, _size, _offset, Utility::move(completion_));
+    }
+
+    if (!request) {
+      return false;
+    }
+
+    request->stream = &_stream;
+
+    // The read runs on the scheduler, the completion follows it immediately.
+    auto task = [this, request](Sint32) {
+      while (request->bytes < request->size) {
+        const auto bytes = request->stream->on_read(
+          request->data + request->bytes,
+          request->size - request->bytes,
+          request->offset + request->bytes);
+        if (!bytes) {
+          break;
+        }
+        request->bytes += bytes;
+      }
+      complete(request);
+      finish_task();
+    };
+
+    add_task();
+    if (!scheduler.add(task)) {
+      release(request);
+      finish_task();
+      return false;
+    }
+
+    return true;
+  }
+
+#if defined(RX_ASYNC_IO_URING)
+  bool read(int _fd, Byte* data_, Uint64 _size, Uint64 _offset,
+    Completion&& completion_)
+  {
+    Concurrency::ScopeLock lock{mutex};
+    auto request = acquire(lock, data_, _size, _offset, Utility::move(completion_));
+    if (!request) {
+      return false;
+    }
+    request->fd = _fd;
+    queue(request);
+    return true;
+  }
+
+  // There is always a free entry for a request, the ring has at least as many
+  // entries as there can be requests. Must be called with |mutex| held.
+  void queue(Request* _request) {
+    auto sqe = ring.next();
+    RX_ASSERT(sqe, "ring full");
+
+    _request->iov.iov_base = _request->data + _request->bytes;
+    _request->iov.iov_len = _request->size - _request->bytes;
+
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = _request->fd;
+    sqe->addr = reinterpret_cast<UintPtr>(&_request->iov);
+    sqe->len = 1;
+    sqe->off = _request->offset + _request->bytes;
+    sqe->user_data = reinterpret_cast<UintPtr>(_request);
+  }
+
+  void reap() {
+    for (;;) {
+      const auto result = io_uring_enter(ring.fd, 0, 1, IORING_ENTER_GETEVENTS);
+      if (result < 0 && errno != EINTR) {
+        logger->error("failed to wait for completions");
+        return;
+      }
+
+      auto head = __atomic_load_n(ring.cq_head, __ATOMIC_RELAXED);
+      const auto tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+
+      bool stop = false;
+      for (; head != tail; head++) {
+        const auto& cqe = ring.cqes[head & ring.cq_mask];
+        auto request = reinterpret_cast<Request*>(cqe.user_data);
+        if (!request) {
+          stop = true;
+        } else if (!finish(request, cqe.res)) {
+          // Resubmit the remainder of a short read.
+          Concurrency::ScopeLock lock{mutex};
+          queue(request);
+          if (!ring.submit()) {
+            logger->error("failed to resubmit read");
+          }
+        }
+      }
+
+      __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+      if (stop) {
+        return;
+      }
+    }
+  }
+
+  // Returns false when the request needs to be resubmitted.
+  bool finish(Request* _request, Sint32 _result) {
+    if (_result == -EINTR || _result == -EAGAIN) {
+      return false;
+    }
+
+    if (_result > 0) {
+      _request->bytes += static_cast<Uint64>(_result);
+      if (_request->bytes < _request->size) {
+        return false;
+      }
+    } else if (_result < 0) {
+      logger->error("read failed (%d)", -_result);
+    }
+
+    schedule(_request);
+    return true;
+  }
+#endif
+
+  bool submit() {
+#if defined(RX_ASYNC_IO_URING)
+    if (kernel_backed()) {
+      Concurrency::ScopeLock lock{mutex};
+      return ring.submit();
+    }
+#endif
+    return true;
+  }
+
+  void wait() {
+    Concurrency::ScopeLock lock{mutex};
+#if defined(RX_ASYNC_IO_URING)
+    if (kernel_backed() && !ring.submit()) {
+      logger->error("failed to submit");
+    }
+#endif
+    idle_cond.wait(lock, [this] { return in_flight == 0; });
+  }
+
+  // Like wait() but also for every task on the scheduler to finish.
+  void drain() {
+    Concurrency::ScopeLock lock{mutex};
+#if defined(RX_ASYNC_IO_URING)
+    if (kernel_backed() && !ring.submit()) {
+      logger->error("failed to submit");
+    }
+#endif
+    idle_cond.wait(lock, [this] { return in_flight == 0 && tasks == 0; });
+  }
+};
+
+AsyncIO::~AsyncIO() {
+  m_allocator->destroy<Impl>(m_impl);
+}
+
+AsyncIO& AsyncIO::operator=(AsyncIO&& async_io_) {
+  if (this != &async_io_) {
+    m_allocator->destroy<Impl>(m_impl);
+    m_allocator = Utility::exchange(async_io_.m_allocator, &Memory::NullAllocator::instance());
+    m_impl = Utility::exchange(async_io_.m_impl, nullptr);
+  }
+  return *this;
+}
+
+Optional<AsyncIO> AsyncIO::create(Memory::Allocator& _allocator,
+  Concurrency::Scheduler& _scheduler, Size _queue_depth)
+{
+  RX_ASSERT(_queue_depth, "queue depth must be non-zero");
+
+  auto impl = _allocator.create<Impl>(_allocator, _scheduler);
+  if (!impl || !impl->init(_queue_depth)) {
+    _allocator.destroy<Impl>(impl);
+    return nullopt;
+  }
+
+  return AsyncIO { _allocator, impl };
+}
+
+bool AsyncIO::async_read(UnbufferedFile& _file, Byte* data_, Uint64 _size,
+  Uint64 _offset, Completion&& completion_)
+{
+  if (!m_impl) {
+    return false;
+  }
+
+#if defined(RX_ASYNC_IO_URING)
+  if (m_impl->kernel_backed()) {
+    const auto fd = static_cast<int>(reinterpret_cast<UintPtr>(_file.m_impl));
+    return m_impl->read(fd, data_, _size, _offset, Utility::move(completion_));
+  }
+#endif
+
+  return m_impl->read(_file, data_, _size, _offset, Utility::move(completion_));
+}
+
+bool AsyncIO::async_read(Stream::Context& _stream, Byte* data_, Uint64 _size,
+  Uint64 _offset, Completion&& completion_)
+{
+  return m_impl
+    ? m_impl->read(_stream, data_, _size, _offset, Utility::move(completion_))
+    : false;
+}
+
+bool AsyncIO::submit() {
+  return m_impl ? m_impl->submit() : false;
+}
+
+void AsyncIO::wait() {
+  if (m_impl) {
+    m_impl->wait();
+  }
+}
+
+bool AsyncIO::is_kernel_backed() const {
+  return m_impl ? m_impl->kernel_backed() : false;
+}
+
+} // namespace Rx::Filesystem
@@ -0,0 +1,151 @@
+#ifndef RX_CORE_FILESYSTEM_ASYNC_IO_H
+#define RX_CORE_FILESYSTEM_ASYNC_IO_H
+#include "rx/core/function.h"
+#include "rx/core/optional.h"
+
+/// \file async_io.h
+
+namespace Rx::Concurrency { struct Scheduler; }
+namespace Rx::Stream { struct Context; }
+
+namespace Rx::Filesystem {
+
+struct UnbufferedFile;
+
+/// \brief Asynchronous file reads.
+///
+/// Reads are queued with async_read() and handed to the operating system in
+/// batches by submit(). When a read finishes, the completion is added as a task
+/// to the Scheduler given to create(), so that decoding what was read happens
+/// on the scheduler while other reads are still in flight.
+///
+/// On Linux, reads of an UnbufferedFile are performed with io_uring where the
+/// kernel supports it, an entire batch costs a single system call and no thread
+/// blocks on the disk. Everywhere else, and for any other kind of stream, each
+/// read is performed as a task on the Scheduler itself.
+///
+/// \warning The buffer passed to async_read() and the stream being read must
+/// remain valid until the completion has been invoked.
+struct RX_API AsyncIO {
+  RX_MARK_NO_COPY(AsyncIO);
+
+  /// \brief Invoked on the scheduler with the number of bytes actually read.
+  using Completion = Function<void(Uint64)>;
+
+  constexpr AsyncIO();
+  AsyncIO(AsyncIO&& async_io_);
+  ~AsyncIO();
+
+  AsyncIO& operator=(AsyncIO&& async_io_);
+
+  /// \brief Create an asynchronous I/O service.
+  ///
+  /// \param _allocator Allocator to use for operations.
+  /// \param _scheduler The scheduler to complete reads into.
+  /// \param _queue_depth The maximum number of reads in flight at once.
+  ///
+  /// \return The service on success, nullopt otherwise.
+  static Optional<AsyncIO> create(Memory::Allocator& _allocator,
+    Concurrency::Scheduler& _scheduler, Size _queue_depth = 64);
+
+  /// @{
+  /// \brief Queue a read.
+  ///
+  /// \param _stream The stream to read from.
+  /// \param data_ Where to read into.
+  /// \param _size The number of bytes to read.
+  /// \param _offset The offset in the stream to read from.
+  /// \param completion_ Invoked when the read finishes.
+  ///
+  /// \returns When the read was queued, \c true. Otherwise, \c false, in which
+  /// case \p completion_ will never be invoked.
+  ///
+  /// \note When \p _queue_depth reads are already in flight this blocks until
+  /// one of them completes.
+  [[nodiscard]] bool async_read(UnbufferedFile& _file, Byte* data_,
+    Uint64 _size, Uint64 _offset, Completion&& completion_);
+  [[nodiscard]] bool async_read(Stream::Context& _stream, Byte* data_,
+    Uint64 _size, Uint64 _offset, Completion&& completion_);
+  /// @}
+
+  /// @{
+  /// Helper to queue a read with any invocable as the completion.
+  template<typename F>
+  [[nodiscard]] bool async_read(UnbufferedFile& _file, Byte* data_,
+    Uint64 _size, Uint64 _offset, F&& completion_);
+  template<typename F>
+  [[nodiscard]] bool async_read(Stream::Context& _stream, Byte* data_,
+    Uint64 _size, Uint64 _offset, F&& completion_);
+  /// @}
+
+  /// \brief Hand all queued reads to the operating system.
+  /// \returns When the reads were submitted, \c true. Otherwise, \c false.
+  bool submit();
+
+  /// \brief Submit and block until every queued read has completed.
+  ///
+  /// \note Completions may still be running when this returns.
+  /// \warning Do not call from a scheduler task when the scheduler has a single
+  /// thread, reads on the fallback path would never get to run.
+  void wait();
+
+  /// Check if reads are performed by the kernel rather than the scheduler.
+  bool is_kernel_backed() const;
+
+  /// \brief Allocator used to construct the service.
+  constexpr Memory::Allocator& allocator() const;
+
+private:
+  struct Impl;
+
+  constexpr AsyncIO(Memory::Allocator& _allocator, Impl* _impl);
+
+  Memory::Allocator* m_allocator;
+  Impl* m_impl;
+};
+
+inline constexpr AsyncIO::AsyncIO()
+  : m_allocator{&Memory::NullAllocator::instance()}
+  , m_impl{nullptr}
+{
+}
+
+inline constexpr AsyncIO::AsyncIO(Memory::Allocator& _allocator, Impl* _impl)
+  : m_allocator{&_allocator}
+  , m_impl{_impl}
+{
+}
+
+inline AsyncIO::AsyncIO(AsyncIO&& async_io_)
+  : m_allocator{Utility::exchange(async_io_.m_allocator, &Memory::NullAllocator::instance())}
+  , m_impl{Utility::exchange(async_io_.m_impl, nullptr)}
+{
+}
+
+template<typename F>
+bool AsyncIO::async_read(UnbufferedFile& _file, Byte* data_, Uint64 _size,
+  Uint64 _offset, F&& completion_)
+{
+  if (auto completion = Completion::create(Utility::forward<F>(completion_))) {
+    return async_read(_file, data_, _size, _offset, Utility::move(*completion));
+  }
+  return false;
+}
+
+template<typename F>
+bool AsyncIO::async_read(Stream::Context& _stream, Byte* data_, Uint64 _size,
+  Uint64 _offset, F&& completion_)
+{
+  if (auto completion = Completion::create(Utility::forward<F>(completion_))) {
+    return async_read(_stream, data_, _size, _offset, Utility::move(*completion));
+  }
+  return false;
+}
+
+RX_HINT_FORCE_INLINE constexpr Memory::Allocator& AsyncIO::allocator() const {
+  return *m_allocator;
+}
+
+} // namespace Rx::Filesystem
+
+#endif // RX_CORE_FILESYSTEM_ASYNC_IO_H
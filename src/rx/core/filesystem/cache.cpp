@@ -0,0 +1,469 @@
+#include <string.h> // memcpy, memcmp
+
+#include "rx/core/filesystem/cache.h"
+#include "rx/core/filesystem/directory.h"
+#include "rx/core/filesystem/unbuffered_file.h"
+
+#include "rx/core/concurrency/scope_lock.h"
+#include "rx/core/hash/djbx33a.h"
+#include "rx/core/log.h"
+
+namespace Rx::Filesystem {
+
+RX_LOG("filesystem/cache", logger);
+
+// Entries are "<digest>.rxc", a header followed by the data.
+static constexpr const Uint32 ENTRY_MAGIC = 0x45435852; // "RXCE"
+static constexpr const Uint64 ENTRY_HEADER_SIZE = 64;
+
+// The index is "index", a header followed by a record per entry.
+static constexpr const Uint32 INDEX_MAGIC = 0x49435852; // "RXCI"
+static constexpr const Uint64 INDEX_HEADER_SIZE = 24;
+static constexpr const Uint64 RECORD_SIZE = 32;
+
+static constexpr const Uint16 VERSION = 1;
+
+// Digest in hex and the extension.
+static constexpr const Size ENTRY_NAME_SIZE = 32 + 4;
+
+// The layout is little-endian, as is every host Rex targets.
+template<typename T>
+static inline T get(const Byte* _data) {
+  T value;
+  memcpy(&value, _data, sizeof value);
+  return value;
+}
+
+template<typename T>
+static inline void put(Byte* data_, T _value) {
+  memcpy(data_, &_value, sizeof _value);
+}
+
+static Optional<Cache::Key> parse_entry_name(const String& _name) {
+  if (_name.size() != ENTRY_NAME_SIZE || !_name.ends_with(".rxc")) {
+    return nullopt;
+  }
+
+  const auto nibble = [](char _ch) -> int {
+    if (_ch >= '0' && _ch <= '9') return _ch - '0';
+    if (_ch >= 'a' && _ch <= 'f') return _ch - 'a' + 10;
+    return -1;
+  };
+
+  Cache::Key key;
+  for (Size i = 0; i < 16; i++) {
+    const auto hi = nibble(_name[i * 2 + 0]);
+    const auto lo = nibble(_name[i * 2 + 1]);
+    if (hi < 0 || lo < 0) {
+      return nullopt;
+    }
+    key.digest[i] = Byte((hi << 4) | lo);
+  }
+
+  return key;
+}
+
+// Returns the data of an entry when the header is valid for |_key|.
+static Optional<Span<const Byte>> parse_entry(Span<const Byte> _file,
+  const Cache::Key& _key)
+{
+  if (_file.size() < ENTRY_HEADER_SIZE) {
+    return nullopt;
+  }
+
+  const auto header = _file.data();
+  if (get<Uint32>(header + 0) != ENTRY_MAGIC
+    || get<Uint16>(header + 4) != VERSION
+    || memcmp(header + 8, _key.digest.data(), 16) != 0
+    || get<Uint64>(header + 24) != _file.size() - ENTRY_HEADER_SIZE)
+  {
+    return nullopt;
+  }
+
+  return Span<const Byte>{header + ENTRY_HEADER_SIZE, _file.size() - ENTRY_HEADER_SIZE};
+}
+
+// Writes |_header| and then |_data| into a new file, removing it on failure.
+static bool write_file(Memory::Allocator& _allocator, const String& _file_name,
+  Span<const Byte> _header, Span<const Byte> _data)
+{
+  auto file = UnbufferedFile::open(_allocator, _file_name, "w");
+  if (!file) {
+    return false;
+  }
+
+  Stream::Context& stream = *file;
+  const bool written =
+    stream.on_write(_header.data(), _header.size(), 0) == _header.size() &&
+    stream.on_write(_data.data(), _data.size(), _header.size()) == _data.size();
+
+  if (!file->close() || !written) {
+    (void)remove_file(_file_name);
+    return false;
+  }
+
+  return true;
+}
+
+Global<Cache> Cache::s_instance{"system", "cache"};
+
+Cache::Cache(Memory::Allocator& _allocator)
+  : m_allocator{&_allocator}
+  , m_path{_allocator}
+  , m_records{_allocator}
+  , m_capacity{0}
+  , m_size{0}
+  , m_tick{0}
+  , m_enabled{false}
+  , m_writes{0}
+{
+}
+
+Cache::~Cache() {
+  disable();
+}
+
+Cache::Key Cache::key(Span<const Byte> _source, Span<const Byte> _parameters) {
+  // Hashing the digest of each keeps one from running into the other.
+  Byte digests[32];
+  const auto source = Hash::djbx33a(_source.data(), _source.size());
+  const auto parameters = Hash::djbx33a(_parameters.data(), _parameters.size());
+  memcpy(digests + 0, source.data(), 16);
+  memcpy(digests + 16, parameters.data(), 16);
+  return {Hash::djbx33a(digests, sizeof digests)};
+}
+
+bool Cache::enable(const StringView& _path, Uint64 _capacity) {
+  disable();
+
+  Concurrency::ScopeLock lock{m_lock};
+
+  // Fails when the directory exists, which is fine, scan() checks for it.
+  (void)create_directory(_path);
+
+  auto path = _path.to_string(*m_allocator);
+  if (!path) {
+    return false;
+  }
+
+  m_path = Utility::move(*path);
+  m_capacity = _capacity;
+  m_size = 0;
+  m_tick = 0;
+  m_records.clear();
+
+  // Without an index every entry is as old as every other, which only makes
+  // the first evictions arbitrary.
+  if (!load_index()) {
+    logger->warning("'%s' has no index", m_path);
+  }
+
+  if (!scan()) {
+    logger->error("failed to open '%s'", m_path);
+    return false;
+  }
+
+  evict();
+
+  logger->info("'%s' has %zu entries using %zu of %zu MiB", m_path,
+    m_records.size(), Size(m_size / 1_MiB), Size(m_capacity / 1_MiB));
+
+  m_enabled.store(true, Concurrency::MemoryOrder::RELEASE);
+
+  return true;
+}
+
+void Cache::disable() {
+  Concurrency::ScopeLock lock{m_lock};
+  if (!m_enabled.load(Concurrency::MemoryOrder::RELAXED)) {
+    return;
+  }
+
+  m_enabled.store(false, Concurrency::MemoryOrder::RELEASE);
+
+  if (!save_index()) {
+    logger->error("failed to write index of '%s'", m_path);
+  }
+
+  m_records.clear();
+  m_size = 0;
+}
+
+Optional<Cache::Entry> Cache::find(const Key& _key) {
+  if (!is_enabled()) {
+    return nullopt;
+  }
+
+  String file_name{*m_allocator};
+  {
+    Concurrency::ScopeLock lock{m_lock};
+    auto record = m_records.find(_key);
+    if (!record) {
+      return nullopt;
+    }
+    record->tick = ++m_tick;
+    file_name = entry_name(_key, ".rxc");
+  }
+
+  // The file is mapped without the lock held, an entry evicted meanwhile is
+  // either mapped before it's removed or not found.
+  if (auto file = MappedFile::open(*m_allocator, file_name)) {
+    if (auto data = parse_entry(file->data(), _key)) {
+      return Entry{Utility::move(*file), *data};
+    }
+    logger->warning("removing invalid entry '%s'", file_name);
+  }
+
+  Concurrency::ScopeLock lock{m_lock};
+  remove(_key);
+
+  return nullopt;
+}
+
+bool Cache::insert(const Key& _key, Span<const Byte> _data) {
+  if (!is_enabled()) {
+    return false;
+  }
+
+  const auto size = ENTRY_HEADER_SIZE + _data.size();
+
+  String file_name{*m_allocator};
+  String temp_name{*m_allocator};
+  {
+    Concurrency::ScopeLock lock{m_lock};
+    if (size > m_capacity || m_records.find(_key)) {
+      return false;
+    }
+    file_name = entry_name(_key, ".rxc");
+    temp_name = String::format(*m_allocator, "%s/%zu.tmp", m_path,
+      Size(m_writes.fetch_add(1, Concurrency::MemoryOrder::RELAXED)));
+  }
+
+  if (file_name.is_empty() || temp_name.is_empty()) {
+    return false;
+  }
+
+  Byte header[ENTRY_HEADER_SIZE] = {};
+  put<Uint32>(header + 0, ENTRY_MAGIC);
+  put<Uint16>(header + 4, VERSION);
+  memcpy(header + 8, _key.digest.data(), 16);
+  put<Uint64>(header + 24, _data.size());
+
+  // Written without the lock held into a file of its own and renamed into
+  // place, so a partial entry is never found, not even after a crash.
+  if (!write_file(*m_allocator, temp_name, header, _data)) {
+    return false;
+  }
+
+  Concurrency::ScopeLock lock{m_lock};
+
+  // Disabled or inserted by another thread while writing.
+  if (!m_enabled.load(Concurrency::MemoryOrder::RELAXED) || m_records.find(_key)) {
+    (void)remove_file(temp_name);
+    return false;
+  }
+
+  if (!rename_file(temp_name, file_name)) {
+    (void)remove_file(temp_name);
+    return false;
+  }
+
+  if (!m_records.insert(_key, {size, ++m_tick, true})) {
+    (void)remove_file(file_name);
+    return false;
+  }
+
+  m_size += size;
+
+  evict();
+
+  return true;
+}
+
+Uint64 Cache::size() const {
+  Concurrency::ScopeLock lock{m_lock};
+  return m_size;
+}
+
+bool Cache::load_index() {
+  auto file_name = String::format(*m_allocator, "%s/index", m_path);
+  auto file = MappedFile::open(*m_allocator, file_name);
+  if (!file) {
+    return false;
+  }
+
+  const auto data = file->data();
+  if (data.size() < INDEX_HEADER_SIZE) {
+    return false;
+  }
+
+  const auto header = data.data();
+  const auto count = get<Uint64>(header + 8);
+  if (get<Uint32>(header + 0) != INDEX_MAGIC
+    || get<Uint16>(header + 4) != VERSION
+    || count != (data.size() - INDEX_HEADER_SIZE) / RECORD_SIZE
+    || count * RECORD_SIZE != data.size() - INDEX_HEADER_SIZE)
+  {
+    return false;
+  }
+
+  m_tick = get<Uint64>(header + 16);
+
+  for (Uint64 i = 0; i < count; i++) {
+    const auto record = header + INDEX_HEADER_SIZE + RECORD_SIZE * i;
+    Key key;
+    memcpy(key.digest.data(), record, 16);
+    const auto size = get<Uint64>(record + 16);
+    const auto tick = get<Uint64>(record + 24);
+    if (!m_records.insert(key, {size, tick, false})) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Cache::scan() {
+  auto directory = Directory::open(*m_allocator, m_path);
+  if (!directory) {
+    return false;
+  }
+
+  // Files left over from writes that never finished and entries that are not
+  // in the index, because it was not written, are found here.
+  Vector<String> remove_names{*m_allocator};
+  const bool result = directory->each([&](Directory::Item&& item_) {
+    if (!item_.is_file()) {
+      return true;
+    }
+
+    const auto& name = item_.name();
+    if (name.ends_with(".tmp")) {
+      auto full_name = item_.full_name();
+      return full_name && remove_names.push_back(Utility::move(*full_name));
+    }
+
+    const auto key = parse_entry_name(name);
+    if (!key) {
+      return true;
+    }
+
+    if (auto record = m_records.find(*key)) {
+      record->seen = true;
+      return true;
+    }
+
+    auto full_name = item_.full_name();
+    if (!full_name) {
+      return false;
+    }
+
+    auto file = MappedFile::open(*m_allocator, *full_name);
+    if (file && parse_entry(file->data(), *key)) {
+      return m_records.insert(*key, {file->data().size(), 0, true}) != nullptr;
+    }
+
+    return remove_names.push_back(Utility::move(*full_name));
+  });
+
+  if (!result) {
+    return false;
+  }
+
+  remove_names.each_fwd([](const String& _name) {
+    (void)remove_file(_name);
+  });
+
+  // Records of entries which no longer exist.
+  Vector<Key> missing{*m_allocator};
+  const bool counted = m_records.each_pair([&](const Key& _key, Record& record_) {
+    if (!record_.seen) {
+      return missing.push_back(_key);
+    }
+    m_size += record_.size;
+    return true;
+  });
+
+  if (!counted) {
+    return false;
+  }
+
+  missing.each_fwd([&](const Key& _key) {
+    m_records.erase(_key);
+  });
+
+  return true;
+}
+
+bool Cache::save_index() {
+  Byte header[INDEX_HEADER_SIZE] = {};
+  put<Uint32>(header + 0, INDEX_MAGIC);
+  put<Uint16>(header + 4, VERSION);
+  put<Uint64>(header + 8, m_records.size());
+  put<Uint64>(header + 16, m_tick);
+
+  LinearBuffer records{*m_allocator};
+  if (!records.resize(RECORD_SIZE * m_records.size())) {
+    return false;
+  }
+
+  auto record = records.data();
+  m_records.each_pair([&](const Key& _key, const Record& _record) {
+    memcpy(record, _key.digest.data(), 16);
+    put<Uint64>(record + 16, _record.size);
+    put<Uint64>(record + 24, _record.tick);
+    record += RECORD_SIZE;
+  });
+
+  const auto file_name = String::format(*m_allocator, "%s/index", m_path);
+  const auto temp_name = String::format(*m_allocator, "%s/index.tmp", m_path);
+
+  if (!write_file(*m_allocator, temp_name, header, {records.data(), records.size()})) {
+    return false;
+  }
+
+  return rename_file(temp_name, file_name);
+}
+
+void Cache::evict() {
+  while (m_size > m_capacity) {
+    // Entries are few enough, hundreds, that finding the least recently used
+    // one is cheaper than keeping them ordered on every find().
+    Optional<Key> oldest;
+    Uint64 oldest_tick = -1_u64;
+    m_records.each_pair([&](const Key& _key, const Record& _record) {
+      if (_record.tick <= oldest_tick) {
+        oldest = _key;
+        oldest_tick = _record.tick;
+      }
+    });
+
+    if (!oldest) {
+      break;
+    }
+
+    remove(*oldest);
+  }
+}
+
+void Cache::remove(const Key& _key) {
+  if (auto record = m_records.find(_key)) {
+    m_size -= record->size;
+    m_records.erase(_key);
+  }
+
+  (void)remove_file(entry_name(_key, ".rxc"));
+}
+
+String Cache::entry_name(const Key& _key, const char* _suffix) const {
+  static constexpr const char* HEX = "0123456789abcdef";
+  char digest[33];
+  for (Size i = 0; i < 16; i++) {
+    digest[i * 2 + 0] = HEX[(_key.digest[i] >> 4) & 0x0f];
+    digest[i * 2 + 1] = HEX[_key.digest[i] & 0x0f];
+  }
+  digest[32] = '\0';
+  return String::format(*m_allocator, "%s/%s%s", m_path, digest, _suffix);
+}
+
+} // namespace Rx::Filesystem
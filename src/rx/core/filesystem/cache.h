@@ -0,0 +1,164 @@
+#ifndef RX_CORE_FILESYSTEM_CACHE_H
+#define RX_CORE_FILESYSTEM_CACHE_H
+#include "rx/core/filesystem/mapped_file.h"
+#include "rx/core/hints/thread.h"
+#include "rx/core/global.h"
+#include "rx/core/array.h"
+#include "rx/core/map.h"
+
+#include "rx/core/hash/mix_int.h"
+#include "rx/core/utility/wire.h"
+
+#include "rx/core/concurrency/atomic.h"
+#include "rx/core/concurrency/mutex.h"
+
+/// \file cache.h
+
+namespace Rx::Filesystem {
+
+/// \brief Content-addressed cache of derived data.
+///
+/// Expensive to produce data, like decoded textures with their mipmaps, is
+/// stored on disk under a key derived from the bytes it was produced from and
+/// the parameters it was produced with. Changing either changes the key, so
+/// entries never go stale and nothing has to be invalidated.
+///
+/// Each entry is a file in the cache directory which is mapped when found, so
+/// the data can be used in place. The cache is bounded in size, the least
+/// recently used entries are removed to make room for new ones. What was used
+/// when is kept in an index file written when the cache is disabled.
+///
+/// Every method is thread-safe.
+struct RX_API Cache {
+  RX_MARK_NO_COPY(Cache);
+  RX_MARK_NO_MOVE(Cache);
+
+  /// \brief Key of an entry.
+  struct Key {
+    Size hash() const;
+    bool operator==(const Key& _key) const;
+    Array<Byte[16]> digest;
+  };
+
+  /// \brief An entry found in the cache.
+  struct Entry {
+    /// The data of the entry, valid for the lifetime of the Entry.
+    Span<const Byte> data() const;
+
+  private:
+    friend struct Cache;
+    Entry(MappedFile&& file_, Span<const Byte> _data);
+    MappedFile m_file;
+    Span<const Byte> m_data;
+  };
+
+  Cache();
+  Cache(Memory::Allocator& _allocator);
+  ~Cache();
+
+  /// \brief Derive a key.
+  ///
+  /// \param _source The data the entry is produced from.
+  /// \param _parameters Everything else the entry depends on, including a
+  /// version of how it's produced.
+  static Key key(Span<const Byte> _source, Span<const Byte> _parameters);
+
+  /// \brief Enable the cache.
+  ///
+  /// \param _path The directory to keep the cache in, created if needed.
+  /// \param _capacity The most bytes of entries to keep.
+  /// \returns On success, \c true. Otherwise, \c false.
+  [[nodiscard]] bool enable(const StringView& _path, Uint64 _capacity);
+
+  /// \brief Disable the cache, writing the index.
+  void disable();
+
+  /// \brief Find an entry.
+  /// \param _key The key of the entry.
+  /// \returns The entry when it's in the cache, nullopt otherwise.
+  Optional<Entry> find(const Key& _key);
+
+  /// \brief Insert an entry.
+  ///
+  /// \param _key The key of the entry.
+  /// \param _data The data of the entry.
+  /// \returns When the entry was written, \c true. Otherwise, \c false.
+  bool insert(const Key& _key, Span<const Byte> _data);
+
+  /// Check if the cache is enabled.
+  bool is_enabled() const;
+
+  /// Bytes of entries in the cache.
+  Uint64 size() const;
+
+  /// The global instance.
+  static Cache& instance();
+
+private:
+  struct Record {
+    Uint64 size;
+    Uint64 tick;
+    bool seen;
+  };
+
+  bool load_index();
+  bool scan();
+  bool save_index();
+  void evict();
+  void remove(const Key& _key);
+
+  String entry_name(const Key& _key, const char* _suffix) const;
+
+  Memory::Allocator* m_allocator;
+
+  mutable Concurrency::Mutex m_lock;
+  String m_path RX_HINT_GUARDED_BY(m_lock);
+  Map<Key, Record> m_records RX_HINT_GUARDED_BY(m_lock);
+  Uint64 m_capacity RX_HINT_GUARDED_BY(m_lock);
+  Uint64 m_size RX_HINT_GUARDED_BY(m_lock);
+  Uint64 m_tick RX_HINT_GUARDED_BY(m_lock);
+
+  // So that a disabled cache is checked for without locking.
+  Concurrency::Atomic<bool> m_enabled;
+
+  // Makes the names of files being written unique.
+  Concurrency::Atomic<Uint64> m_writes;
+
+  static Global<Cache> s_instance;
+};
+
+inline Size Cache::Key::hash() const {
+  return Hash::mix_uint64(Uint64(Utility::read_u32(digest.data()))
+    | (Uint64(Utility::read_u32(digest.data() + 4)) << 32));
+}
+
+inline bool Cache::Key::operator==(const Key& _key) const {
+  return digest == _key.digest;
+}
+
+inline Span<const Byte> Cache::Entry::data() const {
+  return m_data;
+}
+
+inline Cache::Entry::Entry(MappedFile&& file_, Span<const Byte> _data)
+  : m_file{Utility::move(file_)}
+  , m_data{_data}
+{
+}
+
+inline Cache::Cache()
+  : Cache{Memory::SystemAllocator::instance()}
+{
+}
+
+inline bool Cache::is_enabled() const {
+  return m_enabled.load(Concurrency::MemoryOrder::ACQUIRE);
+}
+
+inline Cache& Cache::instance() {
+  return *s_instance;
+}
+
+} // namespace Rx::Filesystem
+
+#endif // RX_CORE_FILESYSTEM_CACHE_H
@@ -14,6 +14,7 @@
 #endif
 
 #include "rx/core/filesystem/directory.h"
+#include "rx/core/filesystem/vfs.h"
 
 namespace Rx::Filesystem {
 
@@ -68,9 +69,14 @@ Optional<Directory> Directory::open(Memory::Allocator& _allocator, const StringV
   if (!path) {
     return nullopt;
   }
+
+  if (VFS::instance().contains_directory(_path)) {
+    return Directory{_allocator, Utility::move(*path), nullptr, true};
+  }
+
 #if defined(RX_PLATFORM_POSIX)
   if (auto impl = opendir(_path.data())) {
-    return Directory{_allocator, Utility::move(*path), reinterpret_cast<void*>(impl)};
+    return Directory{_allocator, Utility::move(*path), reinterpret_cast<void*>(impl), false};
   }
 #elif defined(RX_PLATFORM_WINDOWS)
   // The only thing we can cache between reuses of a directory object is the
@@ -100,7 +106,7 @@ Optional<Directory> Directory::open(Memory::Allocator& _allocator, const StringV
     // conversion for |each|.
     context->handle = handle;
     context->path_data = Utility::move(path_data);
-    return Directory{_allocator, Utility::move(*path), reinterpret_cast<void*>(context)};
+    return Directory{_allocator, Utility::move(*path), reinterpret_cast<void*>(context), false};
   } else {
     _allocator.destroy<FindContext>(context);
   }
@@ -121,6 +127,17 @@ void Directory::release() {
 }
 
 bool Directory::enumerate(Function<bool(Item&&)>&& _function) {
+  if (m_packed) {
+    auto items = VFS::instance().list(allocator(), m_path);
+    if (!items) {
+      return false;
+    }
+    return items->each_fwd([&](VFS::Item& item_) {
+      const auto type = item_.is_directory ? Item::Type::DIRECTORY : Item::Type::FILE;
+      return _function({this, Utility::move(item_.name), type});
+    });
+  }
+
   if (!m_impl) {
     return false;
   }
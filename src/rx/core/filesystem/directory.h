@@ -40,6 +40,10 @@ struct RX_API Directory {
 
   /// \brief Open a directory.
   ///
+  /// A directory in a pack mounted in the VFS is opened instead of one by the
+  /// same name on the operating system. Then the items of it are those in every
+  /// mounted pack.
+  ///
   /// \param _allocator The allocator to use for directory operations.
   /// \param _path The path to the directory to open.
   /// \returns On success, the Directory. Otherwise, \c nullopt.
@@ -126,10 +130,11 @@ struct RX_API Directory {
   constexpr Memory::Allocator& allocator() const;
 
 private:
-  Directory(Memory::Allocator& _allocator, String&& path_, void* _impl)
+  Directory(Memory::Allocator& _allocator, String&& path_, void* _impl, bool _packed)
     : m_allocator{&_allocator}
     , m_path{Utility::move(path_)}
     , m_impl{_impl}
+    , m_packed{_packed}
   {
   }
 
@@ -144,11 +149,15 @@ private:
   Memory::Allocator* m_allocator;
   String m_path;
   void* m_impl;
+
+  // The directory is in a pack mounted in the VFS.
+  bool m_packed;
 };
 
 inline constexpr Directory::Directory()
   : m_allocator{nullptr}
   , m_impl{nullptr}
+  , m_packed{false}
 {
 }
 
@@ -156,6 +165,7 @@ inline Directory::Directory(Directory&& directory_)
   : m_allocator{Utility::exchange(directory_.m_allocator, &Memory::NullAllocator::instance())}
   , m_path{Utility::move(directory_.m_path)}
   , m_impl{Utility::exchange(directory_.m_impl, nullptr)}
+  , m_packed{Utility::exchange(directory_.m_packed, false)}
 {
 }
 
@@ -169,12 +179,13 @@ inline Directory& Directory::operator=(Directory&& directory_) {
     m_allocator = Utility::exchange(directory_.m_allocator, nullptr);
     m_path = Utility::move(directory_.m_path);
     m_impl = Utility::exchange(directory_.m_impl, nullptr);
+    m_packed = Utility::exchange(directory_.m_packed, false);
   }
   return *this;
 }
 
 RX_HINT_FORCE_INLINE bool Directory::is_valid() const {
-  return m_impl != nullptr;
+  return m_impl != nullptr || m_packed;
 }
 
 RX_HINT_FORCE_INLINE Directory::operator bool() const {
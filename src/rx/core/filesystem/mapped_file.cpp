@@ -0,0 +1,232 @@
+#include "rx/core/algorithm/min.h"
+#include "rx/core/filesystem/mapped_file.h"
+#include "rx/core/memory/copy.h"
+#include "rx/core/log.h"
+
+#if defined(RX_PLATFORM_POSIX)
+#include <sys/mman.h> // mmap, munmap, madvise
+#include <sys/stat.h> // fstat, struct stat
+#include <unistd.h> // close, sysconf
+#include <fcntl.h> // open
+#elif defined(RX_PLATFORM_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace Rx::Filesystem {
+
+RX_LOG("filesystem/mapped_file", logger);
+
+static constexpr const Uint32 FLAGS = Stream::READ | Stream::STAT | Stream::VIEW;
+
+#if defined(RX_PLATFORM_POSIX)
+static bool map_file(Memory::Allocator&, const StringView& _file_name,
+  MappedFile::Access _access, Byte*& data_, Uint64& size_)
+{
+  const int fd = open(_file_name.data(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat buf;
+  if (fstat(fd, &buf) == -1) {
+    close(fd);
+    return false;
+  }
+
+  size_ = buf.st_size;
+  data_ = nullptr;
+
+  // Cannot map an empty file, there's nothing to map anyways.
+  if (size_ == 0) {
+    close(fd);
+    return true;
+  }
+
+  void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  // The mapping holds it's own reference to the file.
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  // Read-ahead hints, failure is harmless.
+  if (_access == MappedFile::Access::SEQUENTIAL) {
+    madvise(data, size_, MADV_SEQUENTIAL);
+    madvise(data, size_, MADV_WILLNEED);
+  } else {
+    madvise(data, size_, MADV_RANDOM);
+  }
+
+  data_ = static_cast<Byte*>(data);
+  return true;
+}
+
+static bool unmap_file(Byte* _data, Uint64 _size) {
+  return munmap(_data, _size) == 0;
+}
+
+static void prefetch_file(const Byte* _data, Uint64 _offset, Uint64 _size) {
+  // The range passed to madvise must begin on a page boundary.
+  static const auto page_size = static_cast<Uint64>(sysconf(_SC_PAGESIZE));
+  const auto begin = _offset - _offset % page_size;
+  madvise(const_cast<Byte*>(_data) + begin, _size + (_offset - begin), MADV_WILLNEED);
+}
+#elif defined(RX_PLATFORM_WINDOWS)
+static bool map_file(Memory::Allocator& _allocator, const StringView& _file_name,
+  MappedFile::Access _access, Byte*& data_, Uint64& size_)
+{
+  WideString file_name = String::format(_allocator, "%s", _file_name).to_utf16();
+
+  const DWORD dwFlagsAndAttributes = _access == MappedFile::Access::SEQUENTIAL
+    ? FILE_FLAG_SEQUENTIAL_SCAN
+    : FILE_FLAG_RANDOM_ACCESS;
+
+  HANDLE file = CreateFileW(
+    reinterpret_cast<LPCWSTR>(file_name.data()),
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    nullptr,
+    OPEN_EXISTING,
+    dwFlagsAndAttributes,
+    nullptr);
+
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    return false;
+  }
+
+  size_ = static_cast<Uint64>(size.QuadPart);
+  data_ = nullptr;
+
+  // Cannot map an empty file, there's nothing to map anyways.
+  if (size_ == 0) {
+    CloseHandle(file);
+    return true;
+  }
+
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping) {
+    return false;
+  }
+
+  // The view holds it's own reference to the mapping.
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!data) {
+    return false;
+  }
+
+  data_ = static_cast<Byte*>(data);
+  return true;
+}
+
+static bool unmap_file(Byte* _data, Uint64) {
+  return UnmapViewOfFile(_data);
+}
+
+static void prefetch_file(const Byte*, Uint64, Uint64) {
+  // The file was opened with a read-ahead hint already.
+}
+#endif
+
+MappedFile::MappedFile(Byte* _data, Uint64 _size, String&& name_)
+  : Context{FLAGS}
+  , m_data{_data}
+  , m_size{_size}
+  , m_name{Utility::move(name_)}
+{
+}
+
+MappedFile::MappedFile(MappedFile&& other_)
+  : Context{Utility::move(other_)}
+  , m_data{Utility::exchange(other_.m_data, nullptr)}
+  , m_size{Utility::exchange(other_.m_size, 0)}
+  , m_name{Utility::move(other_.m_name)}
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& file_) {
+  if (this != &file_) {
+    (void)close();
+    Context::operator=(Utility::move(file_));
+    m_data = Utility::exchange(file_.m_data, nullptr);
+    m_size = Utility::exchange(file_.m_size, 0);
+    m_name = Utility::move(file_.m_name);
+  }
+  return *this;
+}
+
+Optional<MappedFile> MappedFile::open(Memory::Allocator& _allocator,
+  const StringView& _file_name, Access _access)
+{
+  auto name = _file_name.to_string(_allocator);
+  if (!name) {
+    return nullopt;
+  }
+
+  Byte* data = nullptr;
+  Uint64 size = 0;
+  if (!map_file(_allocator, _file_name, _access, data, size)) {
+    logger->error("failed to map file '%s'", _file_name);
+    return nullopt;
+  }
+
+  return MappedFile{data, size, Utility::move(*name)};
+}
+
+bool MappedFile::close() {
+  // Not opened or already closed.
+  if (!(m_flags & Stream::READ)) {
+    return false;
+  }
+
+  if (m_data && !unmap_file(m_data, m_size)) {
+    return false;
+  }
+
+  m_data = nullptr;
+  m_size = 0;
+  m_flags = 0;
+
+  return true;
+}
+
+void MappedFile::prefetch(Uint64 _offset, Uint64 _size) const {
+  if (_offset >= m_size) {
+    return;
+  }
+  prefetch_file(m_data, _offset, Algorithm::min(_size, m_size - _offset));
+}
+
+const String& MappedFile::name() const & {
+  return m_name;
+}
+
+Uint64 MappedFile::on_read(Byte* _data, Uint64 _size, Uint64 _offset) {
+  if (_offset >= m_size) {
+    return 0;
+  }
+  const auto bytes = Algorithm::min(_size, m_size - _offset);
+  Memory::copy(_data, m_data + _offset, bytes);
+  return bytes;
+}
+
+Optional<Stream::Stat> MappedFile::on_stat() const {
+  return Stream::Stat{m_size};
+}
+
+Optional<Span<const Byte>> MappedFile::on_view() {
+  return data();
+}
+
+} // namespace Rx::Filesystem
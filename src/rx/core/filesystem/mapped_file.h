@@ -0,0 +1,104 @@
+#ifndef RX_CORE_FILESYSTEM_MAPPED_FILE_H
+#define RX_CORE_FILESYSTEM_MAPPED_FILE_H
+#include "rx/core/stream/context.h"
+#include "rx/core/string.h"
+
+/// \file mapped_file.h
+
+namespace Rx::Filesystem {
+
+/// \brief Read-only memory-mapped file.
+///
+/// The entire file is mapped into the address space when opened. Reads are a
+/// copy out of the mapping and the contents can be accessed in place through
+/// data() or Stream::Context::view_binary() without any copy at all. Pages are
+/// brought in by the kernel on demand, the access pattern given to open() is
+/// passed along as a hint for how to read ahead.
+struct RX_API MappedFile
+  : Stream::Context
+{
+  RX_MARK_NO_COPY(MappedFile);
+
+  /// How the file is expected to be accessed.
+  enum class Access : Uint8 {
+    SEQUENTIAL, ///< Read front to back, aggressively read ahead.
+    RANDOM      ///< Read in no particular order, do not read ahead.
+  };
+
+  /// \brief Construct a MappedFile.
+  /// \param _allocator The allocator to associate with this mapped file.
+  constexpr MappedFile(Memory::Allocator& _allocator);
+
+  /// \brief Move constructor.
+  /// \param other_ The other mapped file to move from.
+  ///
+  /// Assigns the state of \p other_ to \c *this and sets \p other_ to a default
+  /// constructed state.
+  MappedFile(MappedFile&& other_);
+
+  /// \brief Destroy a mapped file.
+  /// \note Will call close().
+  ~MappedFile();
+
+  /// \brief Moves the mapped file.
+  /// \param file_ Another mapped file object to assign this mapped file.
+  /// \returns \c *this.
+  MappedFile& operator=(MappedFile&& file_);
+
+  /// \brief Opens and maps a file for reading.
+  ///
+  /// \param _allocator The allocator to use for stream state.
+  /// \param _file_name The name of the file to open.
+  /// \param _access The expected access pattern.
+  /// \returns The MappedFile on success, \c nullopt otherwise.
+  static Optional<MappedFile> open(Memory::Allocator& _allocator,
+    const StringView& _file_name, Access _access = Access::SEQUENTIAL);
+
+  /// \brief Unmap the file.
+  /// \return When unmapped successfully, \c true. Otherwise, \c false.
+  [[nodiscard]] bool close();
+
+  /// \brief The contents of the file.
+  /// \warning Only valid until the file is closed.
+  Span<const Byte> data() const;
+
+  /// \brief Hint that a range of the file will be needed soon.
+  /// \param _offset The offset of the range.
+  /// \param _size The size of the range.
+  void prefetch(Uint64 _offset, Uint64 _size) const;
+
+  /// Get the name of the file.
+  virtual const String& name() const &;
+
+protected:
+  virtual Uint64 on_read(Byte* _data, Uint64 _size, Uint64 _offset);
+  virtual Optional<Stream::Stat> on_stat() const;
+  virtual Optional<Span<const Byte>> on_view();
+
+private:
+  MappedFile(Byte* _data, Uint64 _size, String&& name_);
+
+  Byte* m_data;
+  Uint64 m_size;
+  String m_name;
+};
+
+inline constexpr MappedFile::MappedFile(Memory::Allocator& _allocator)
+  : Stream::Context{0}
+  , m_data{nullptr}
+  , m_size{0}
+  , m_name{_allocator}
+{
+}
+
+inline MappedFile::~MappedFile() {
+  (void)close();
+}
+
+inline Span<const Byte> MappedFile::data() const {
+  return {m_data, static_cast<Size>(m_size)};
+}
+
+} // namespace Rx::Filesystem
+
+#endif // RX_CORE_FILESYSTEM_MAPPED_FILE_H
@@ -0,0 +1,631 @@
+#include <string.h> // memcpy, memcmp
+
+#include "rx/core/filesystem/pack.h"
+
+#include "rx/core/stream/compressed_stream.h"
+#include "rx/core/stream/memory_stream.h"
+
+#include "rx/core/algorithm/quick_sort.h"
+#include "rx/core/algorithm/min.h"
+#include "rx/core/hash/fnv1a.h"
+#include "rx/core/memory/zero.h"
+#include "rx/core/log.h"
+
+namespace Rx::Filesystem {
+
+RX_LOG("filesystem/pack", logger);
+
+static constexpr const Uint32 MAGIC = 0x4b505852; // "RXPK"
+static constexpr const Uint16 VERSION = 1;
+static constexpr const Uint64 HEADER_SIZE = 48;
+static constexpr const Uint64 ENTRY_SIZE = 40;
+
+static constexpr const Uint16 COMPRESSED = 1 << 0;
+
+// Longest name that can be looked up, longer names are never found.
+static constexpr const Size NAME_MAX = 1024;
+
+// The layout is little-endian, as is every host Rex targets.
+template<typename T>
+static inline T get(const Byte* _data) {
+  T value;
+  memcpy(&value, _data, sizeof value);
+  return value;
+}
+
+template<typename T>
+static inline void put(Byte* data_, T _value) {
+  memcpy(data_, &_value, sizeof _value);
+}
+
+static inline Uint64 hash_name(const char* _name, Size _size) {
+  return Hash::fnv1a_64(reinterpret_cast<const Byte*>(_name), _size);
+}
+
+// Writes |_name| into |name_| without a leading "./", repeated or trailing
+// separators and with '\\' as '/'. Returns the length or -1 when it does not
+// fit.
+static Size normalize(const StringView& _name, char (&name_)[NAME_MAX]) {
+  const char* src = _name.data();
+  const char* end = src + _name.size();
+
+  while (end - src >= 2 && src[0] == '.' && (src[1] == '/' || src[1] == '\\')) {
+    src += 2;
+    while (src != end && (*src == '/' || *src == '\\')) {
+      src++;
+    }
+  }
+
+  Size size = 0;
+  for (; src != end; src++) {
+    const char ch = *src == '\\' ? '/' : *src;
+    if (ch == '/' && (size == 0 || name_[size - 1] == '/')) {
+      continue;
+    }
+    if (size == NAME_MAX - 1) {
+      return -1_z;
+    }
+    name_[size++] = ch;
+  }
+
+  if (size && name_[size - 1] == '/') {
+    size--;
+  }
+
+  name_[size] = '\0';
+  return size;
+}
+
+// Compares |_name| against the first |_size| bytes of |_other|, with |_other|
+// ordered after when it's longer.
+static inline int compare(const StringView& _name, const char* _other, Size _size) {
+  const auto size = Algorithm::min(_name.size(), _size);
+  if (const auto result = memcmp(_name.data(), _other, size)) {
+    return result;
+  }
+  return _name.size() < _size ? -1 : (_name.size() > _size ? 1 : 0);
+}
+
+// A file in a pack that was stored compressed, the CompressedStream reads from
+// the MemoryStream so neither can move.
+struct CompressedFile
+  : Stream::Context
+{
+  RX_MARK_NO_COPY(CompressedFile);
+  RX_MARK_NO_MOVE(CompressedFile);
+
+  CompressedFile(String&& name_, Span<const Byte> _data)
+    : Context{Stream::READ | Stream::STAT}
+    , m_source{Utility::move(name_), _data}
+  {
+  }
+
+  virtual Uint64 on_read(Byte* data_, Uint64 _size, Uint64 _offset) {
+    return m_stream->on_read(data_, _size, _offset);
+  }
+
+  virtual Optional<Stream::Stat> on_stat() const {
+    return m_stream->on_stat();
+  }
+
+  virtual const String& name() const & {
+    return m_source.name();
+  }
+
+  Stream::MemoryStream m_source;
+  Optional<Stream::CompressedStream> m_stream;
+};
+
+// [Pack]
+Pack::Pack(Memory::Allocator& _allocator, MappedFile&& file_)
+  : m_allocator{&_allocator}
+  , m_file{Utility::move(file_)}
+  , m_entries{nullptr}
+  , m_buckets{nullptr}
+  , m_names{nullptr}
+  , m_count{0}
+  , m_bucket_mask{0}
+{
+}
+
+Pack::Pack(Pack&& pack_)
+  : m_allocator{pack_.m_allocator}
+  , m_file{Utility::move(pack_.m_file)}
+  , m_entries{Utility::exchange(pack_.m_entries, nullptr)}
+  , m_buckets{Utility::exchange(pack_.m_buckets, nullptr)}
+  , m_names{Utility::exchange(pack_.m_names, nullptr)}
+  , m_count{Utility::exchange(pack_.m_count, 0)}
+  , m_bucket_mask{Utility::exchange(pack_.m_bucket_mask, 0)}
+{
+}
+
+Pack& Pack::operator=(Pack&& pack_) {
+  if (this != &pack_) {
+    m_allocator = pack_.m_allocator;
+    m_file = Utility::move(pack_.m_file);
+    m_entries = Utility::exchange(pack_.m_entries, nullptr);
+    m_buckets = Utility::exchange(pack_.m_buckets, nullptr);
+    m_names = Utility::exchange(pack_.m_names, nullptr);
+    m_count = Utility::exchange(pack_.m_count, 0);
+    m_bucket_mask = Utility::exchange(pack_.m_bucket_mask, 0);
+  }
+  return *this;
+}
+
+Optional<Pack> Pack::open(Memory::Allocator& _allocator,
+  const StringView& _file_name)
+{
+  // The directory is looked up at random, the files are read front to back.
+  auto file = MappedFile::open(_allocator, _file_name, MappedFile::Access::RANDOM);
+  if (!file) {
+    return nullopt;
+  }
+
+  Pack pack{_allocator, Utility::move(*file)};
+  if (!pack.parse()) {
+    logger->error("'%s' is not a valid pack", _file_name);
+    return nullopt;
+  }
+
+  return pack;
+}
+
+bool Pack::parse() {
+  const auto data = m_file.data();
+  if (data.size() < HEADER_SIZE) {
+    return false;
+  }
+
+  const auto header = data.data();
+  if (get<Uint32>(header + 0) != MAGIC || get<Uint16>(header + 4) > VERSION) {
+    return false;
+  }
+
+  const auto count = get<Uint32>(header + 8);
+  const auto buckets = get<Uint32>(header + 12);
+  const auto entries_offset = get<Uint64>(header + 16);
+  const auto buckets_offset = get<Uint64>(header + 24);
+  const auto names_offset = get<Uint64>(header + 32);
+  const auto names_size = get<Uint64>(header + 40);
+
+  // Buckets are a power of two with at least one left empty to end probing.
+  if (buckets == 0 || (buckets & (buckets - 1)) || buckets <= count) {
+    return false;
+  }
+
+  // The directory is in order at the end of the pack. Buckets are aligned.
+  const auto size = data.size();
+  if (entries_offset < HEADER_SIZE
+    || buckets_offset != entries_offset + Uint64(count) * ENTRY_SIZE
+    || names_offset != buckets_offset + Uint64(buckets) * sizeof(Uint32)
+    || names_offset > size
+    || names_size != size - names_offset
+    || (names_size && header[size - 1] != '\0')
+    || buckets_offset % alignof(Uint32))
+  {
+    return false;
+  }
+
+  m_entries = header + entries_offset;
+  m_buckets = reinterpret_cast<const Uint32*>(header + buckets_offset);
+  m_names = reinterpret_cast<const char*>(header + names_offset);
+  m_count = count;
+  m_bucket_mask = buckets - 1;
+
+  for (Uint32 i = 0; i < count; i++) {
+    const auto entry = m_entries + i * ENTRY_SIZE;
+    const auto offset = get<Uint64>(entry + 8);
+    const auto stored = get<Uint64>(entry + 24);
+    const auto name = get<Uint32>(entry + 32);
+    const auto name_size = get<Uint16>(entry + 36);
+
+    // Files are between the header and the directory.
+    if (offset < HEADER_SIZE || offset > entries_offset || stored > entries_offset - offset) {
+      return false;
+    }
+
+    // Names are terminated where the entry says they end.
+    if (Uint64(name) + name_size >= names_size || m_names[name + name_size] != '\0') {
+      return false;
+    }
+  }
+
+  // Every entry is in one bucket, so as many buckets are used as there are
+  // entries and, with more buckets than entries, probing always ends.
+  Uint32 used = 0;
+  for (Uint32 i = 0; i <= m_bucket_mask; i++) {
+    if (m_buckets[i] > count) {
+      return false;
+    }
+    used += m_buckets[i] != 0;
+  }
+
+  return used == count;
+}
+
+StringView Pack::entry_name(Uint32 _index) const {
+  return m_names + get<Uint32>(m_entries + _index * ENTRY_SIZE + 32);
+}
+
+Optional<Uint32> Pack::find(const StringView& _file_name) const {
+  char name[NAME_MAX];
+  const auto size = normalize(_file_name, name);
+  if (size == -1_z || m_count == 0) {
+    return nullopt;
+  }
+
+  const auto hash = hash_name(name, size);
+
+  // Buckets hold the entry index plus one, zero is empty. Probing is bounded
+  // by the bucket count as well.
+  auto bucket = hash & m_bucket_mask;
+  for (Uint32 probe = 0; probe <= m_bucket_mask && m_buckets[bucket]; probe++, bucket = (bucket + 1) & m_bucket_mask) {
+    const auto index = m_buckets[bucket] - 1;
+    const auto entry = m_entries + index * ENTRY_SIZE;
+    if (get<Uint64>(entry) != hash || get<Uint16>(entry + 36) != size) {
+      continue;
+    }
+    if (!memcmp(m_names + get<Uint32>(entry + 32), name, size)) {
+      return index;
+    }
+  }
+
+  return nullopt;
+}
+
+// The first entry with a name not ordered before |_name|.
+Uint32 Pack::lower_bound(const StringView& _name) const {
+  Uint32 first = 0;
+  Uint32 count = m_count;
+  while (count) {
+    const auto step = count / 2;
+    const auto entry = m_entries + (first + step) * ENTRY_SIZE;
+    const auto name = m_names + get<Uint32>(entry + 32);
+    if (compare(_name, name, get<Uint16>(entry + 36)) > 0) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+Ptr<Stream::Context> Pack::open_file(Memory::Allocator& _allocator,
+  const StringView& _file_name) const
+{
+  const auto index = find(_file_name);
+  if (!index) {
+    return {_allocator};
+  }
+
+  const auto entry = m_entries + *index * ENTRY_SIZE;
+  const auto offset = get<Uint64>(entry + 8);
+  const auto stored = get<Uint64>(entry + 24);
+  const auto flags = get<Uint16>(entry + 38);
+
+  auto file_name = String::create(_allocator, _file_name.data());
+  if (!file_name) {
+    return {_allocator};
+  }
+
+  // The pack is mapped for random access, the file is about to be read through.
+  m_file.prefetch(offset, stored);
+
+  const Span<const Byte> data{m_file.data().data() + offset, static_cast<Size>(stored)};
+
+  if (!(flags & COMPRESSED)) {
+    return make_ptr<Stream::MemoryStream>(_allocator, Utility::move(*file_name), data);
+  }
+
+  Ptr<CompressedFile> file = make_ptr<CompressedFile>(_allocator, Utility::move(*file_name), data);
+  if (!file) {
+    return {_allocator};
+  }
+
+  auto stream = Stream::CompressedStream::open(_allocator, file->m_source);
+  if (!stream) {
+    logger->error("'%s' in '%s' is corrupt", _file_name, name());
+    return {_allocator};
+  }
+
+  file->m_stream = Utility::move(*stream);
+  return file;
+}
+
+bool Pack::contains_file(const StringView& _file_name) const {
+  return find(_file_name).has_value();
+}
+
+bool Pack::contains_directory(const StringView& _path) const {
+  char path[NAME_MAX];
+  auto size = normalize(_path, path);
+  if (size == -1_z || size == NAME_MAX - 1) {
+    return false;
+  }
+
+  // The root contains everything.
+  if (size == 0) {
+    return m_count != 0;
+  }
+
+  path[size++] = '/';
+  path[size] = '\0';
+
+  const auto index = lower_bound(path);
+  return index != m_count && entry_name(index).begins_with(path);
+}
+
+bool Pack::enumerate(const StringView& _path, Enumerator&& _function) const {
+  char path[NAME_MAX];
+  auto size = normalize(_path, path);
+  if (size == -1_z || size == NAME_MAX - 1) {
+    return false;
+  }
+
+  if (size) {
+    path[size++] = '/';
+    path[size] = '\0';
+  }
+
+  // Files under |path| are adjacent. The files of a subdirectory are adjacent
+  // too, so it's reported once and then skipped past.
+  char item[NAME_MAX];
+  for (auto index = lower_bound(path); index < m_count; ) {
+    const auto name = entry_name(index);
+    if (!name.begins_with(path)) {
+      break;
+    }
+
+    const char* stem = name.data() + size;
+    const char* slash = strchr(stem, '/');
+    const auto length = slash ? Size(slash - stem) : strlen(stem);
+
+    memcpy(item, stem, length);
+    item[length] = '\0';
+
+    if (!_function(item, slash != nullptr)) {
+      return false;
+    }
+
+    if (!slash) {
+      index++;
+      continue;
+    }
+
+    // Skip the rest of the subdirectory, "|path||item|/" is always shorter
+    // than a name in it so there's room for the terminator.
+    memcpy(path + size, item, length);
+    path[size + length] = '/';
+    path[size + length + 1] = '\0';
+    index++;
+    while (index < m_count && entry_name(index).begins_with(path)) {
+      index++;
+    }
+    path[size] = '\0';
+  }
+
+  return true;
+}
+
+// [PackWriter]
+PackWriter::PackWriter(Memory::Allocator& _allocator, Stream::Context& _stream,
+  Concurrency::Scheduler* _scheduler, Uint32 _alignment)
+  : m_allocator{&_allocator}
+  , m_stream{&_stream}
+  , m_scheduler{_scheduler}
+  , m_entries{_allocator}
+  , m_compressed{_allocator}
+  , m_offset{HEADER_SIZE}
+  , m_alignment{_alignment}
+{
+}
+
+PackWriter::PackWriter(PackWriter&& pack_writer_)
+  : m_allocator{pack_writer_.m_allocator}
+  , m_stream{Utility::exchange(pack_writer_.m_stream, nullptr)}
+  , m_scheduler{Utility::exchange(pack_writer_.m_scheduler, nullptr)}
+  , m_entries{Utility::move(pack_writer_.m_entries)}
+  , m_compressed{Utility::move(pack_writer_.m_compressed)}
+  , m_offset{Utility::exchange(pack_writer_.m_offset, 0)}
+  , m_alignment{Utility::exchange(pack_writer_.m_alignment, 0)}
+{
+}
+
+Optional<PackWriter> PackWriter::create(Memory::Allocator& _allocator,
+  Stream::Context& _stream, Concurrency::Scheduler* _scheduler,
+  Uint32 _alignment)
+{
+  if (!(_stream.flags() & Stream::WRITE)) {
+    return nullopt;
+  }
+
+  if (_alignment == 0 || (_alignment & (_alignment - 1))) {
+    return nullopt;
+  }
+
+  // Reserve the header, a zero magic marks the pack unfinished.
+  const Byte header[HEADER_SIZE] = {};
+  if (_stream.on_write(header, HEADER_SIZE, 0) != HEADER_SIZE) {
+    return nullopt;
+  }
+
+  return PackWriter{_allocator, _stream, _scheduler, _alignment};
+}
+
+bool PackWriter::write(const Byte* _data, Uint64 _size) {
+  if (m_stream->on_write(_data, _size, m_offset) != _size) {
+    return false;
+  }
+  m_offset += _size;
+  return true;
+}
+
+bool PackWriter::pad(Uint32 _alignment) {
+  static constexpr const Byte ZERO[256] = {};
+  while (m_offset & (_alignment - 1)) {
+    const auto bytes = _alignment - (m_offset & (_alignment - 1));
+    if (!write(ZERO, Algorithm::min(bytes, Uint64(sizeof ZERO)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PackWriter::add(const StringView& _file_name, Span<const Byte> _data,
+  bool _compress)
+{
+  char name[NAME_MAX];
+  const auto size = normalize(_file_name, name);
+  if (size == -1_z || size == 0 || size > 0xffff) {
+    logger->error("cannot add '%s', bad name", _file_name);
+    return false;
+  }
+
+  auto name_string = String::create(*m_allocator, name, size);
+  if (!name_string) {
+    return false;
+  }
+
+  if (!pad(m_alignment)) {
+    return false;
+  }
+
+  Entry entry{Utility::move(*name_string), hash_name(name, size), m_offset,
+    _data.size(), _data.size(), 0};
+
+  if (_compress && _data.size() >= Stream::CompressedStream::BLOCK_SIZE / 16) {
+    // Stored blocks are as large as they are, each with an entry in the index.
+    const Uint64 block = Stream::CompressedStream::BLOCK_SIZE;
+    const Uint64 blocks = (_data.size() + block - 1) / block;
+    if (!m_compressed.resize(32 + blocks * (block + 16))) {
+      return false;
+    }
+
+    Stream::MemoryStream output{{*m_allocator}, Span<Byte>{m_compressed.data(), m_compressed.size()}};
+    auto stream = Stream::CompressedStream::create(*m_allocator, output, m_scheduler);
+    if (!stream
+      || stream->on_write(_data.data(), _data.size(), 0) != _data.size()
+      || !stream->on_flush())
+    {
+      return false;
+    }
+
+    const auto compressed = output.on_stat()->size;
+    if (compressed <= _data.size() - _data.size() / 8) {
+      if (!write(m_compressed.data(), compressed)) {
+        return false;
+      }
+      entry.stored = compressed;
+      entry.flags = COMPRESSED;
+      return m_entries.push_back(Utility::move(entry));
+    }
+  }
+
+  if (!write(_data.data(), _data.size())) {
+    return false;
+  }
+
+  return m_entries.push_back(Utility::move(entry));
+}
+
+bool PackWriter::finish() {
+  const auto count = m_entries.size();
+  if (count >= 0x7fffffff) {
+    return false;
+  }
+
+  // Sort by name so the files of a directory are adjacent.
+  Vector<Uint32> order{*m_allocator};
+  if (!order.resize(count)) {
+    return false;
+  }
+  for (Size i = 0; i < count; i++) {
+    order[i] = static_cast<Uint32>(i);
+  }
+  Algorithm::quick_sort(order.data(), order.data() + count,
+    [this](Uint32 _lhs, Uint32 _rhs) {
+      const auto& lhs = m_entries[_lhs].name;
+      const auto& rhs = m_entries[_rhs].name;
+      return compare(lhs, rhs.data(), rhs.size()) < 0;
+    });
+
+  for (Size i = 1; i < count; i++) {
+    const auto& name = m_entries[order[i]].name;
+    if (name == m_entries[order[i - 1]].name) {
+      logger->error("'%s' was added more than once", name);
+      return false;
+    }
+  }
+
+  // At most half of the buckets are used.
+  Uint32 buckets = 2;
+  while (buckets < count * 2) {
+    buckets *= 2;
+  }
+
+  if (!pad(alignof(Uint64))) {
+    return false;
+  }
+
+  const auto entries_offset = m_offset;
+  const auto buckets_offset = entries_offset + count * ENTRY_SIZE;
+  const auto names_offset = buckets_offset + buckets * sizeof(Uint32);
+
+  LinearBuffer directory{*m_allocator};
+  if (!directory.resize(names_offset - entries_offset)) {
+    return false;
+  }
+  Memory::zero(directory.data(), directory.size());
+
+  auto bucket_data = directory.data() + count * ENTRY_SIZE;
+  Uint64 names_size = 0;
+  for (Size i = 0; i < count; i++) {
+    const auto& entry = m_entries[order[i]];
+    const auto data = directory.data() + i * ENTRY_SIZE;
+    put<Uint64>(data + 0, entry.hash);
+    put<Uint64>(data + 8, entry.offset);
+    put<Uint64>(data + 16, entry.size);
+    put<Uint64>(data + 24, entry.stored);
+    put<Uint32>(data + 32, static_cast<Uint32>(names_size));
+    put<Uint16>(data + 36, static_cast<Uint16>(entry.name.size()));
+    put<Uint16>(data + 38, entry.flags);
+    names_size += entry.name.size() + 1;
+
+    auto bucket = entry.hash & (buckets - 1);
+    while (get<Uint32>(bucket_data + bucket * sizeof(Uint32))) {
+      bucket = (bucket + 1) & (buckets - 1);
+    }
+    put<Uint32>(bucket_data + bucket * sizeof(Uint32), static_cast<Uint32>(i + 1));
+  }
+
+  if (names_size > 0xffffffff || !write(directory.data(), directory.size())) {
+    return false;
+  }
+
+  for (Size i = 0; i < count; i++) {
+    const auto& name = m_entries[order[i]].name;
+    if (!write(reinterpret_cast<const Byte*>(name.data()), name.size() + 1)) {
+      return false;
+    }
+  }
+
+  Byte header[HEADER_SIZE];
+  put<Uint32>(header + 0, MAGIC);
+  put<Uint16>(header + 4, VERSION);
+  put<Uint16>(header + 6, 0);
+  put<Uint32>(header + 8, static_cast<Uint32>(count));
+  put<Uint32>(header + 12, buckets);
+  put<Uint64>(header + 16, entries_offset);
+  put<Uint64>(header + 24, buckets_offset);
+  put<Uint64>(header + 32, names_offset);
+  put<Uint64>(header + 40, names_size);
+
+  if (m_stream->on_write(header, HEADER_SIZE, 0) != HEADER_SIZE) {
+    return false;
+  }
+
+  return !(m_stream->flags() & Stream::FLUSH) || m_stream->on_flush();
+}
+
+} // namespace Rx::Filesystem
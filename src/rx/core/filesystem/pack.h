@@ -0,0 +1,217 @@
+#ifndef RX_CORE_FILESYSTEM_PACK_H
+#define RX_CORE_FILESYSTEM_PACK_H
+#include "rx/core/filesystem/mapped_file.h"
+#include "rx/core/function.h"
+#include "rx/core/vector.h"
+#include "rx/core/ptr.h"
+
+/// \file pack.h
+
+namespace Rx::Concurrency { struct Scheduler; }
+
+namespace Rx::Filesystem {
+
+/// \brief Read-only archive of files.
+///
+/// A pack stores many files in one, so that loading them costs a single open
+/// and map rather than an open and stat per file. The layout is:
+///
+/// \code
+///   Header    (48 bytes)
+///   File      (each aligned)
+///   ...
+///   Entries   (40 bytes per file, sorted by name)
+///   Buckets   (4 bytes each, a power of two)
+///   Names     (null-terminated)
+/// \endcode
+///
+/// Files are found by hashing their name into the buckets. Since entries are
+/// sorted by name, the files of a directory are adjacent and directories are
+/// found with a binary search.
+///
+/// Each file is stored either as it is, in which case it's read in place out
+/// of the mapping, or as a Stream::CompressedStream when compressing it saves
+/// enough to be worth decompressing.
+///
+/// Names are relative paths with '/' as the separator, e.g. "base/fonts/a.ttf".
+/// Leading "./" and repeated separators are ignored when looking up names.
+struct RX_API Pack {
+  RX_MARK_NO_COPY(Pack);
+
+  /// \brief Move construct a pack.
+  /// \param pack_ The pack to move from.
+  Pack(Pack&& pack_);
+
+  /// \brief Moves the pack.
+  /// \param pack_ The pack to move from.
+  /// \returns \c *this.
+  Pack& operator=(Pack&& pack_);
+
+  /// \brief Open a pack.
+  /// \param _allocator The allocator to use for files opened in the pack.
+  /// \param _file_name The name of the pack file.
+  /// \returns The Pack on success, nullopt when the file cannot be opened or is
+  /// not a valid pack.
+  static Optional<Pack> open(Memory::Allocator& _allocator,
+    const StringView& _file_name);
+
+  /// \brief Open a file in the pack for reading.
+  ///
+  /// \param _allocator The allocator to create the stream with.
+  /// \param _file_name The name of the file.
+  /// \returns The stream, or \c nullptr when the file is not in the pack.
+  ///
+  /// \note Files stored as they are support Stream::VIEW.
+  /// \warning The stream refers to the pack, which must outlive it.
+  Ptr<Stream::Context> open_file(Memory::Allocator& _allocator,
+    const StringView& _file_name) const;
+
+  /// Check if a file is in the pack.
+  bool contains_file(const StringView& _file_name) const;
+
+  /// Check if the pack contains any file under a directory.
+  bool contains_directory(const StringView& _path) const;
+
+  /// \brief Enumerate the files and directories directly in a directory.
+  ///
+  /// The invocable should have the following signature:
+  /// \code{.cpp}
+  /// bool each(const StringView& _name, bool _is_directory);
+  /// \endcode
+  ///
+  /// Where the result should be \c true for continued enumeration or \c false
+  /// to stop enumeration.
+  ///
+  /// \param _path The directory.
+  /// \param function_ The invocable.
+  /// \returns When every item was enumerated, \c true. Otherwise, \c false.
+  template<typename F>
+  bool each(const StringView& _path, F&& function_) const;
+
+  /// Number of files in the pack.
+  Uint32 count() const;
+
+  /// The name of the pack file.
+  const String& name() const &;
+
+  /// Allocator passed to open().
+  constexpr Memory::Allocator& allocator() const;
+
+private:
+  Pack(Memory::Allocator& _allocator, MappedFile&& file_);
+
+  using Enumerator = Function<bool(const StringView&, bool)>;
+
+  bool parse();
+  bool enumerate(const StringView& _path, Enumerator&& _function) const;
+
+  Optional<Uint32> find(const StringView& _file_name) const;
+  Uint32 lower_bound(const StringView& _name) const;
+  StringView entry_name(Uint32 _index) const;
+
+  Memory::Allocator* m_allocator;
+  MappedFile m_file;
+
+  // These all point into |m_file|, which moving does not change.
+  const Byte* m_entries;
+  const Uint32* m_buckets;
+  const char* m_names;
+  Uint32 m_count;
+  Uint32 m_bucket_mask;
+};
+
+/// \brief Writes a Pack.
+///
+/// Files are added one at a time and written straight out. The directory is
+/// written by finish(), only then is the pack valid.
+struct RX_API PackWriter {
+  RX_MARK_NO_COPY(PackWriter);
+
+  /// Default alignment of files in a pack.
+  static constexpr const Uint32 ALIGNMENT = 4_KiB;
+
+  /// \brief Move construct a pack writer.
+  PackWriter(PackWriter&& pack_writer_);
+
+  /// \brief Create a pack writer.
+  ///
+  /// \param _allocator The allocator to use for the directory and compression.
+  /// \param _stream The stream to write the pack into, from the beginning. Must
+  /// outlive the writer.
+  /// \param _scheduler Where to compress files, may be \c nullptr.
+  /// \param _alignment The alignment of each file, a power of two.
+  /// \returns The PackWriter on success, nullopt otherwise.
+  static Optional<PackWriter> create(Memory::Allocator& _allocator,
+    Stream::Context& _stream, Concurrency::Scheduler* _scheduler = nullptr,
+    Uint32 _alignment = ALIGNMENT);
+
+  /// \brief Add a file.
+  ///
+  /// \param _file_name The name to give the file in the pack.
+  /// \param _data The contents of the file.
+  /// \param _compress Try compressing the file. It's only stored compressed
+  /// when that saves at least an eighth of the size.
+  /// \returns When the file was written, \c true. Otherwise, \c false.
+  [[nodiscard]] bool add(const StringView& _file_name, Span<const Byte> _data,
+    bool _compress = true);
+
+  /// \brief Write the directory and header.
+  /// \returns On success, \c true. Otherwise, \c false, which includes the same
+  /// name having been added more than once.
+  [[nodiscard]] bool finish();
+
+  /// Number of bytes written to the stream.
+  Uint64 size() const;
+
+private:
+  struct Entry {
+    String name;
+    Uint64 hash;
+    Uint64 offset;
+    Uint64 size;
+    Uint64 stored;
+    Uint16 flags;
+  };
+
+  PackWriter(Memory::Allocator& _allocator, Stream::Context& _stream,
+    Concurrency::Scheduler* _scheduler, Uint32 _alignment);
+
+  bool write(const Byte* _data, Uint64 _size);
+  bool pad(Uint32 _alignment);
+
+  Memory::Allocator* m_allocator;
+  Stream::Context* m_stream;
+  Concurrency::Scheduler* m_scheduler;
+  Vector<Entry> m_entries;
+  LinearBuffer m_compressed;
+  Uint64 m_offset;
+  Uint32 m_alignment;
+};
+
+template<typename F>
+bool Pack::each(const StringView& _path, F&& function_) const {
+  if (auto fun = Enumerator::create(Utility::move(function_))) {
+    return enumerate(_path, Utility::move(*fun));
+  }
+  return false;
+}
+
+inline Uint32 Pack::count() const {
+  return m_count;
+}
+
+inline const String& Pack::name() const & {
+  return m_file.name();
+}
+
+RX_HINT_FORCE_INLINE constexpr Memory::Allocator& Pack::allocator() const {
+  return *m_allocator;
+}
+
+inline Uint64 PackWriter::size() const {
+  return m_offset;
+}
+
+} // namespace Rx::Filesystem
+
+#endif // RX_CORE_FILESYSTEM_PACK_H
@@ -2,11 +2,13 @@
 
 #include "rx/core/algorithm/min.h"
 #include "rx/core/filesystem/unbuffered_file.h"
+#include "rx/core/filesystem/vfs.h"
 #include "rx/core/log.h"
 
 #if defined(RX_PLATFORM_POSIX)
 #include <sys/stat.h> // fstat, struct stat
-#include <unistd.h> // open, close, pread, pwrite
+#include <unistd.h> // open, close, pread, pwrite, unlink
+#include <stdio.h> // rename
 #include <fcntl.h>
 #elif defined(RX_PLATFORM_WINDOWS)
 #define WIN32_LEAN_AND_MEAN
@@ -355,7 +357,7 @@ const String& UnbufferedFile::name() const & {
 Optional<LinearBuffer> read_binary_file(Memory::Allocator& _allocator,
   const StringView& _file_name)
 {
-  if (auto file = UnbufferedFile::open(_allocator, _file_name, "r")) {
+  if (auto file = open_file(_allocator, _file_name)) {
     return file->read_binary(_allocator);
   }
   logger->error("failed to open file '%s' [%s]", _file_name);
@@ -365,11 +367,33 @@ Optional<LinearBuffer> read_binary_file(Memory::Allocator& _allocator,
 Optional<LinearBuffer> read_text_file(Memory::Allocator& _allocator,
   const StringView& _file_name)
 {
-  if (auto file = UnbufferedFile::open(_allocator, _file_name, "r")) {
+  if (auto file = open_file(_allocator, _file_name)) {
     return file->read_text(_allocator);
   }
   logger->error("failed to open file '%s'", _file_name);
   return nullopt;
 }
 
+bool remove_file(const StringView& _file_name) {
+#if defined(RX_PLATFORM_POSIX)
+  return unlink(_file_name.data()) == 0;
+#elif defined(RX_PLATFORM_WINDOWS)
+  auto& allocator = Memory::SystemAllocator::instance();
+  const auto file_name = String::format(allocator, "%s", _file_name).to_utf16();
+  return DeleteFileW(reinterpret_cast<LPCWSTR>(file_name.data()));
+#endif
+}
+
+bool rename_file(const StringView& _old_name, const StringView& _new_name) {
+#if defined(RX_PLATFORM_POSIX)
+  return rename(_old_name.data(), _new_name.data()) == 0;
+#elif defined(RX_PLATFORM_WINDOWS)
+  auto& allocator = Memory::SystemAllocator::instance();
+  const auto old_name = String::format(allocator, "%s", _old_name).to_utf16();
+  const auto new_name = String::format(allocator, "%s", _new_name).to_utf16();
+  return MoveFileExW(reinterpret_cast<LPCWSTR>(old_name.data()),
+    reinterpret_cast<LPCWSTR>(new_name.data()), MOVEFILE_REPLACE_EXISTING);
+#endif
+}
+
 } // namespace Rx::Filesystem
\ No newline at end of file
@@ -8,6 +8,8 @@
 /// File system access.
 namespace Rx::Filesystem {
 
+struct AsyncIO;
+
 /// \brief Unbuffered file.
 struct RX_API UnbufferedFile
   : Stream::Context
@@ -82,6 +84,9 @@ protected:
   virtual Uint64 on_copy(Uint64 _dst_offset, Uint64 _src_offset, Uint64 _size);
 
 private:
+  // Submits reads on the underlying file handle directly.
+  friend struct AsyncIO;
+
   UnbufferedFile(Uint32 _flags, void* _impl, String&& name_, const char* _mode);
 
   void* m_impl;
@@ -102,6 +107,7 @@ inline UnbufferedFile::~UnbufferedFile() {
 }
 
 /// \brief Read a binary file into memory.
+/// \note The file is searched for in the mounted packs of the VFS first.
 /// \param _allocator The allocator to use to allocate the LinearBuffer.
 /// \param _file_name The file to read.
 /// \return On success the contents of the binary file. On failure, nullopt.
@@ -111,7 +117,8 @@ RX_API Optional<LinearBuffer> read_binary_file(Memory::Allocator& _allocator,
 /// \brief Read a text file into memory.
 ///
 /// Reads any text file into memory, normalizing line endings, handling Unicode
-/// BOM, and converting all flavors of Unicode into UTF-8.
+/// BOM, and converting all flavors of Unicode into UTF-8. The file is searched
+/// for in the mounted packs of the VFS first.
 ///
 /// \param _allocator The allocator to use to allocate the LinearBuffer.
 /// \param _file_name The file to read.
@@ -119,6 +126,21 @@ RX_API Optional<LinearBuffer> read_binary_file(Memory::Allocator& _allocator,
 RX_API Optional<LinearBuffer> read_text_file(Memory::Allocator& _allocator,
   const StringView& _file_name);
 
+/// \brief Remove a file.
+/// \param _file_name The file to remove.
+/// \return `true` on success.
+RX_API bool remove_file(const StringView& _file_name);
+
+/// \brief Rename a file, replacing any file with the new name.
+///
+/// The replacement is atomic where the operating system allows it, so the new
+/// name refers to either the old file or the renamed one, never neither.
+///
+/// \param _old_name The file to rename.
+/// \param _new_name The new name of the file.
+/// \return `true` on success.
+RX_API bool rename_file(const StringView& _old_name, const StringView& _new_name);
+
 } // namespace Rx::Filesystem
 
 #endif // RX_CORE_FILESYSTEM_UNBUFFERED_FILE_H
\ No newline at end of file
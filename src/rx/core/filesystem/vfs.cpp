@@ -0,0 +1,133 @@
+#include "rx/core/filesystem/vfs.h"
+#include "rx/core/filesystem/buffered_file.h"
+
+#include "rx/core/concurrency/scope_lock.h"
+#include "rx/core/log.h"
+
+namespace Rx::Filesystem {
+
+RX_LOG("filesystem/vfs", logger);
+
+Global<VFS> VFS::s_instance{"system", "vfs"};
+
+bool VFS::mount(Pack&& pack_) {
+  Concurrency::ScopeLock lock{m_lock};
+  logger->info("mounted '%s' with %zu files", pack_.name(), Size(pack_.count()));
+  if (!m_packs.push_back(Utility::move(pack_))) {
+    return false;
+  }
+  m_count.store(m_packs.size(), Concurrency::MemoryOrder::RELEASE);
+  return true;
+}
+
+bool VFS::unmount(const StringView& _file_name) {
+  Concurrency::ScopeLock lock{m_lock};
+  const auto n_packs = m_packs.size();
+  for (Size i = 0; i < n_packs; i++) {
+    if (StringView{m_packs[i].name()} == _file_name) {
+      m_packs.erase(i, i + 1);
+      m_count.store(m_packs.size(), Concurrency::MemoryOrder::RELEASE);
+      return true;
+    }
+  }
+  return false;
+}
+
+Ptr<Stream::Context> VFS::open(Memory::Allocator& _allocator,
+  const StringView& _file_name) const
+{
+  if (is_empty()) {
+    return {_allocator};
+  }
+
+  Concurrency::ScopeLock lock{m_lock};
+  for (Size i = m_packs.size(); i--; ) {
+    if (auto file = m_packs[i].open_file(_allocator, _file_name)) {
+      return file;
+    }
+  }
+
+  return {_allocator};
+}
+
+bool VFS::contains_directory(const StringView& _path) const {
+  if (is_empty()) {
+    return false;
+  }
+
+  Concurrency::ScopeLock lock{m_lock};
+  for (Size i = m_packs.size(); i--; ) {
+    if (m_packs[i].contains_directory(_path)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+Optional<Vector<VFS::Item>> VFS::list(Memory::Allocator& _allocator,
+  const StringView& _path) const
+{
+  Vector<Item> items{_allocator};
+
+  // The list is made while locked so that it can be enumerated without, as
+  // enumerating a directory often opens the files in it.
+  Concurrency::ScopeLock lock{m_lock};
+  for (Size i = m_packs.size(); i--; ) {
+    bool listed = true;
+    auto add = [&](const StringView& _name, bool _is_directory) {
+      // Directories can be in more than one pack, and a file in a pack mounted
+      // later overrides one mounted earlier.
+      const auto n_items = items.size();
+      for (Size j = 0; j < n_items; j++) {
+        if (StringView{items[j].name} == _name) {
+          return true;
+        }
+      }
+
+      auto name = _name.to_string(_allocator);
+      listed = name && items.emplace_back(Utility::move(*name), _is_directory);
+      return listed;
+    };
+
+    if (!m_packs[i].each(_path, add) && !listed) {
+      return nullopt;
+    }
+  }
+
+  return items;
+}
+
+Ptr<Stream::Context> open_file(Memory::Allocator& _allocator,
+  const StringView& _file_name, FileKind _kind)
+{
+  if (auto file = VFS::instance().open(_allocator, _file_name)) {
+    return file;
+  }
+
+  switch (_kind) {
+  case FileKind::UNBUFFERED:
+    if (auto file = UnbufferedFile::open(_allocator, _file_name, "r")) {
+      return make_ptr<UnbufferedFile>(_allocator, Utility::move(*file));
+    }
+    break;
+  case FileKind::BUFFERED:
+    if (auto file = BufferedFile::open(_allocator, _file_name, "r")) {
+      auto result = make_ptr<BufferedFile>(_allocator, Utility::move(*file));
+      if (result) {
+        result->set_async_io(VFS::instance().async_io());
+      }
+      return result;
+    }
+    break;
+  case FileKind::MAPPED:
+    if (auto file = MappedFile::open(_allocator, _file_name)) {
+      return make_ptr<MappedFile>(_allocator, Utility::move(*file));
+    }
+    break;
+  }
+
+  return {_allocator};
+}
+
+} // namespace Rx::Filesystem
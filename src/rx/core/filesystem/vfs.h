@@ -0,0 +1,147 @@
+#ifndef RX_CORE_FILESYSTEM_VFS_H
+#define RX_CORE_FILESYSTEM_VFS_H
+#include "rx/core/filesystem/pack.h"
+#include "rx/core/hints/thread.h"
+#include "rx/core/global.h"
+
+#include "rx/core/concurrency/atomic.h"
+#include "rx/core/concurrency/mutex.h"
+
+/// \file vfs.h
+
+namespace Rx::Filesystem {
+
+struct AsyncIO;
+
+/// \brief Virtual file system.
+///
+/// Packs mounted in the VFS are searched for files and directories before the
+/// operating system is. The most recently mounted pack is searched first, so
+/// a pack can override files in those mounted before it.
+///
+/// Directory::open() and open_file() resolve against the global instance.
+///
+/// \warning Streams opened from a pack refer to it, a pack must not be
+/// unmounted while any of them are still open.
+struct RX_API VFS {
+  RX_MARK_NO_COPY(VFS);
+  RX_MARK_NO_MOVE(VFS);
+
+  /// \brief An item in a directory.
+  struct Item {
+    String name;
+    bool is_directory;
+  };
+
+  VFS();
+  VFS(Memory::Allocator& _allocator);
+
+  /// \brief Mount a pack.
+  /// \param pack_ The pack to mount.
+  /// \returns On success, \c true. Otherwise, \c false.
+  [[nodiscard]] bool mount(Pack&& pack_);
+
+  /// \brief Unmount a pack.
+  /// \param _file_name The name the pack was opened with.
+  /// \returns When the pack was mounted, \c true. Otherwise, \c false.
+  bool unmount(const StringView& _file_name);
+
+  /// \brief Open a file in a mounted pack for reading.
+  /// \param _allocator The allocator to create the stream with.
+  /// \param _file_name The name of the file.
+  /// \returns The stream, or \c nullptr when no mounted pack has the file.
+  Ptr<Stream::Context> open(Memory::Allocator& _allocator,
+    const StringView& _file_name) const;
+
+  /// Check if any mounted pack contains a directory.
+  bool contains_directory(const StringView& _path) const;
+
+  /// \brief List the items in a directory in every mounted pack.
+  ///
+  /// \param _allocator The allocator for the list.
+  /// \param _path The directory.
+  /// \returns The items, each only once, or nullopt when out of memory.
+  Optional<Vector<Item>> list(Memory::Allocator& _allocator,
+    const StringView& _path) const;
+
+  /// Check if any pack is mounted.
+  bool is_empty() const;
+
+  /// \brief Read ahead buffered files in the background.
+  ///
+  /// Files opened by open_file() with FileKind::BUFFERED read ahead with
+  /// \p _async_io. Pass \c nullptr to stop, files already open keep using it.
+  ///
+  /// \warning \p _async_io must outlive every file opened while it's set.
+  void set_async_io(AsyncIO* _async_io);
+
+  /// The asynchronous I/O service buffered files read ahead with, if any.
+  AsyncIO* async_io() const;
+
+  /// The global instance.
+  static VFS& instance();
+
+private:
+  mutable Concurrency::Mutex m_lock;
+  Vector<Pack> m_packs RX_HINT_GUARDED_BY(m_lock);
+
+  // Number of mounted packs, so that checking for any doesn't lock.
+  Concurrency::Atomic<Size> m_count;
+
+  Concurrency::Atomic<AsyncIO*> m_async_io;
+
+  static Global<VFS> s_instance;
+};
+
+inline VFS::VFS()
+  : VFS{Memory::SystemAllocator::instance()}
+{
+}
+
+inline VFS::VFS(Memory::Allocator& _allocator)
+  : m_packs{_allocator}
+  , m_count{0}
+  , m_async_io{nullptr}
+{
+}
+
+inline bool VFS::is_empty() const {
+  return m_count.load(Concurrency::MemoryOrder::ACQUIRE) == 0;
+}
+
+inline void VFS::set_async_io(AsyncIO* _async_io) {
+  m_async_io.store(_async_io, Concurrency::MemoryOrder::RELEASE);
+}
+
+inline AsyncIO* VFS::async_io() const {
+  return m_async_io.load(Concurrency::MemoryOrder::ACQUIRE);
+}
+
+inline VFS& VFS::instance() {
+  return *s_instance;
+}
+
+/// How open_file() opens a file not found in a mounted pack.
+enum class FileKind : Uint8 {
+  UNBUFFERED, ///< As an UnbufferedFile.
+  BUFFERED,   ///< As a BufferedFile.
+  MAPPED      ///< As a MappedFile.
+};
+
+/// \brief Open a file for reading.
+///
+/// The mounted packs of the global VFS are searched first, then the operating
+/// system.
+///
+/// \param _allocator The allocator to create the stream with.
+/// \param _file_name The name of the file.
+/// \param _kind How to open the file when it's not in a pack.
+///
+/// \note Buffered files read ahead with VFS::async_io() when it's set.
+/// \returns The stream, or \c nullptr when the file could not be opened.
+RX_API Ptr<Stream::Context> open_file(Memory::Allocator& _allocator,
+  const StringView& _file_name, FileKind _kind = FileKind::UNBUFFERED);
+
+} // namespace Rx::Filesystem
+
+#endif // RX_CORE_FILESYSTEM_VFS_H
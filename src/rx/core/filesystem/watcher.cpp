@@ -0,0 +1,220 @@
+#include "rx/core/filesystem/watcher.h"
+#include "rx/core/filesystem/directory.h"
+
+#include "rx/core/time/qpc.h"
+#include "rx/core/log.h"
+
+#if defined(RX_PLATFORM_LINUX)
+#include <sys/inotify.h> // inotify_init1, inotify_add_watch, inotify_rm_watch
+#include <unistd.h> // read, close
+#include <errno.h> // errno, EAGAIN, EINTR
+#endif
+
+namespace Rx::Filesystem {
+
+RX_LOG("filesystem/watcher", logger);
+
+Global<Watcher> Watcher::s_instance{"system", "watcher"};
+
+// How long a file must not change before it's reported, in milliseconds.
+static constexpr const Uint64 SETTLE_TIME = 100;
+
+Watcher::Watcher(Memory::Allocator& _allocator)
+  : m_allocator{&_allocator}
+  , m_fd{-1}
+  , m_directories{_allocator}
+  , m_changes{_allocator}
+  , m_on_change{_allocator}
+{
+}
+
+Watcher::~Watcher() {
+  unwatch();
+}
+
+#if defined(RX_PLATFORM_LINUX)
+// The changes to files and directories watched for. Writes are watched for
+// with IN_MODIFY rather than IN_CLOSE_WRITE so that files written through a
+// mapping, or by a program keeping them open, are reported too.
+static constexpr const Uint32 WATCH_MASK =
+  IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+  IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR;
+
+bool Watcher::watch(const StringView& _path) {
+  if (m_fd == -1) {
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd == -1) {
+      logger->error("could not watch '%s': inotify_init1 failed (%d)",
+        _path, errno);
+      return false;
+    }
+  }
+
+  if (!add(_path)) {
+    logger->error("could not watch '%s'", _path);
+    if (m_directories.is_empty()) {
+      unwatch();
+    }
+    return false;
+  }
+
+  logger->info("watching '%s'", _path);
+  return true;
+}
+
+bool Watcher::add(const StringView& _path) {
+  auto path = _path.to_string(*m_allocator);
+  if (!path) {
+    return false;
+  }
+
+  const int wd = inotify_add_watch(m_fd, path->data(), WATCH_MASK);
+  if (wd == -1) {
+    return false;
+  }
+
+  // Watching the same directory twice gives the same descriptor.
+  if (auto find = m_directories.find(wd)) {
+    *find = Utility::move(*path);
+  } else if (!m_directories.insert(wd, Utility::move(*path))) {
+    inotify_rm_watch(m_fd, wd);
+    return false;
+  }
+
+  // inotify isn't recursive, every directory in this one is watched as well.
+  auto directory = Directory::open(*m_allocator, _path);
+  if (!directory) {
+    return false;
+  }
+
+  return directory->each([this](Directory::Item&& item_) {
+    if (!item_.is_directory()) {
+      return true;
+    }
+    auto name = item_.full_name();
+    return name && add(*name);
+  });
+}
+
+void Watcher::unwatch() {
+  if (m_fd != -1) {
+    // Closing removes every watch.
+    close(m_fd);
+    m_fd = -1;
+  }
+  m_directories.clear();
+  m_changes.clear();
+}
+
+void Watcher::read() {
+  // Aligned for the events read into it.
+  alignas(struct inotify_event) char buffer[4096];
+
+  const Uint64 now = Time::qpc_ticks();
+
+  for (;;) {
+    const auto length = ::read(m_fd, buffer, sizeof buffer);
+    if (length == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // EAGAIN when every event is read.
+      break;
+    }
+
+    for (Size offset = 0; offset < Size(length); ) {
+      const auto event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+      offset += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        logger->warning("too many changes, some were not seen");
+        continue;
+      }
+
+      // The watch is removed when the directory is.
+      if (event->mask & IN_IGNORED) {
+        m_directories.erase(event->wd);
+        continue;
+      }
+
+      // Changes to the directory itself aren't reported, there's no name.
+      if (event->len == 0) {
+        continue;
+      }
+
+      const auto directory = m_directories.find(event->wd);
+      if (!directory) {
+        continue;
+      }
+
+      const char* file_name = event->name;
+      auto name = String::format(*m_allocator, "%s/%s", *directory, file_name);
+
+      // Directories are not reported but new ones are watched too.
+      if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO) && !add(name)) {
+          logger->warning("could not watch '%s'", name);
+        }
+        continue;
+      }
+
+      // Coalesce with earlier changes to the file not yet reported.
+      if (auto find = m_changes.find(name)) {
+        *find = now;
+      } else if (!m_changes.insert(Utility::move(name), now)) {
+        logger->warning("out of memory, changes may not be reported");
+      }
+    }
+  }
+}
+#else
+bool Watcher::watch(const StringView& _path) {
+  logger->error("could not watch '%s': not supported", _path);
+  return false;
+}
+
+bool Watcher::add(const StringView&) {
+  return false;
+}
+
+void Watcher::unwatch() {
+  m_directories.clear();
+  m_changes.clear();
+}
+
+void Watcher::read() {
+}
+#endif
+
+void Watcher::poll() {
+  if (m_fd == -1) {
+    return;
+  }
+
+  read();
+
+  if (m_changes.is_empty()) {
+    return;
+  }
+
+  const Uint64 now = Time::qpc_ticks();
+  const Uint64 settle = SETTLE_TIME * Time::qpc_frequency() / 1000;
+
+  // Collected first since the changes cannot be erased while enumerated.
+  Vector<String> settled{*m_allocator};
+  m_changes.each_pair([&](const String& _name, Uint64 _tick) {
+    if (now - _tick < settle) {
+      return true;
+    }
+    auto name = Utility::copy(_name);
+    return name && settled.push_back(Utility::move(*name));
+  });
+
+  settled.each_fwd([this](const String& _name) {
+    m_changes.erase(_name);
+    logger->verbose("'%s' changed", _name);
+    m_on_change.signal(_name);
+  });
+}
+
+} // namespace Rx::Filesystem
@@ -0,0 +1,106 @@
+#ifndef RX_CORE_FILESYSTEM_WATCHER_H
+#define RX_CORE_FILESYSTEM_WATCHER_H
+#include "rx/core/event.h"
+#include "rx/core/global.h"
+#include "rx/core/string.h"
+#include "rx/core/map.h"
+
+/// \file watcher.h
+
+namespace Rx::Filesystem {
+
+/// \brief Watches directories for changes to the files in them.
+///
+/// Changes are collected from the operating system when polled. They're
+/// coalesced per file: editors tend to save a file with several writes, or by
+/// writing another file and renaming it over the original, so a file is only
+/// reported once it stopped changing for a short while, and only once.
+///
+/// Files created, written, renamed into place or removed are reported with
+/// the name of the watched directory they're under as a prefix, e.g. watching
+/// \c "base" reports \c "base/renderer/modules/fog.json5".
+///
+/// \note Only implemented on Linux with inotify. Elsewhere nothing can be
+/// watched.
+///
+/// \warning Watching and polling must happen on the same thread, which is the
+/// thread the changes are reported on. Connecting to on_change() is
+/// thread-safe.
+struct RX_API Watcher {
+  RX_MARK_NO_COPY(Watcher);
+  RX_MARK_NO_MOVE(Watcher);
+
+  using ChangeEvent = Event<void(const StringView& _file_name)>;
+
+  Watcher();
+  Watcher(Memory::Allocator& _allocator);
+  ~Watcher();
+
+  /// \brief Watch a directory and every directory in it.
+  /// \param _path The path of the directory.
+  /// \returns On success, \c true. Otherwise, \c false.
+  [[nodiscard]] bool watch(const StringView& _path);
+
+  /// \brief Stop watching every directory, dropping changes not yet reported.
+  void unwatch();
+
+  /// \brief Report the files which stopped changing.
+  void poll();
+
+  /// \brief Connect a function to call for each changed file.
+  ///
+  /// The function should have the signature:
+  /// \code{.cpp}
+  /// void on_change(const StringView& _file_name);
+  /// \endcode
+  template<typename F>
+  Optional<ChangeEvent::Handle> on_change(F&& on_change_);
+
+  /// Check if anything is being watched.
+  bool is_watching() const;
+
+  /// The global instance.
+  static Watcher& instance();
+
+private:
+  bool add(const StringView& _path);
+  void read();
+
+  Memory::Allocator* m_allocator;
+  int m_fd;
+
+  // The directory of each watch descriptor.
+  Map<int, String> m_directories;
+
+  // The files changed but not yet reported, and when they last changed.
+  Map<String, Uint64> m_changes;
+
+  ChangeEvent m_on_change;
+
+  static Global<Watcher> s_instance;
+};
+
+inline Watcher::Watcher()
+  : Watcher{Memory::SystemAllocator::instance()}
+{
+}
+
+template<typename F>
+Optional<Watcher::ChangeEvent::Handle> Watcher::on_change(F&& on_change_) {
+  if (auto fun = ChangeEvent::Delegate::create(Utility::move(on_change_))) {
+    return m_on_change.connect(Utility::move(*fun));
+  }
+  return nullopt;
+}
+
+inline bool Watcher::is_watching() const {
+  return m_fd != -1;
+}
+
+inline Watcher& Watcher::instance() {
+  return *s_instance;
+}
+
+} // namespace Rx::Filesystem
+
+#endif // RX_CORE_FILESYSTEM_WATCHER_H
@@ -60,15 +60,15 @@ inline constexpr Size mix_sint8(Sint8 _value) {
 }
 
 inline constexpr Size mix_sint16(Sint16 _value) {
-  return mix_uint8(static_cast<Uint16>(_value));
+  return mix_uint16(static_cast<Uint16>(_value));
 }
 
 inline constexpr Size mix_sint32(Sint32 _value) {
-  return mix_uint8(static_cast<Uint32>(_value));
+  return mix_uint32(static_cast<Uint32>(_value));
 }
 
 inline constexpr Size mix_sint64(Sint64 _value) {
-  return mix_uint8(static_cast<Uint64>(_value));
+  return mix_uint64(static_cast<Uint64>(_value));
 }
 
 template<Concepts::Integral T>
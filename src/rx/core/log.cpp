@@ -2,26 +2,77 @@
 #include <string.h> // strlen
 
 #include "rx/core/log.h"
-#include "rx/core/ptr.h"
-#include "rx/core/intrusive_list.h"
 #include "rx/core/stream/buffered_stream.h"
 
 #include "rx/core/algorithm/max.h"
 
+#include "rx/core/concurrency/atomic.h"
 #include "rx/core/concurrency/mutex.h"
 #include "rx/core/concurrency/condition_variable.h"
 #include "rx/core/concurrency/thread.h"
 
+#include "rx/core/time/delay.h"
+#include "rx/core/time/qpc.h"
+
 #include "rx/core/memory/search.h"
 
 #if defined(RX_PLATFORM_EMSCRIPTEN)
 #include <emscripten.h>
 #endif
 
+#if defined(RX_PLATFORM_POSIX)
+#include <pthread.h> // pthread_key_t, pthread_key_create, pthread_setspecific
+#elif defined(RX_PLATFORM_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h> // FlsAlloc, FlsSetValue, FlsFree
+#endif
+
 namespace Rx {
 
 namespace {
 
+// Header of a message recorded by Log::write, the recorded arguments follow.
+struct Record {
+  Uint32 size;
+  Log::Level level;
+  Log* owner;
+  const char* format;
+  Log::Replay replay;
+  Uint64 ticks;
+};
+
+// Each thread that logs has a ring of records it produces into and the logging
+// thread consumes from. The head and tail count bytes ever written and read,
+// they're kept on separate cache lines.
+struct Ring {
+  static inline constexpr const Size CAPACITY = 64_KiB;
+
+  // A record size with this bit set is padding up to the end of the ring.
+  static inline constexpr const Uint32 PADDING = 1_u32 << 31;
+
+  Ring(Byte* _data)
+    : data{_data}
+    , head{0}
+    , reserved{0}
+    , cached_tail{0}
+    , tail{0}
+  {
+  }
+
+  Byte* data;
+
+  Concurrency::Atomic<Uint64> head;
+  Uint64 reserved;    // Only touched by the producer.
+  Uint64 cached_tail; // Only touched by the producer.
+  Byte padding[64];
+  Concurrency::Atomic<Uint64> tail;
+};
+
+static constexpr Size align_record(Size _size) {
+  return (_size + alignof(Record) - 1) & ~(alignof(Record) - 1);
+}
+
 struct Logger {
   Logger();
   ~Logger();
@@ -30,53 +81,104 @@ struct Logger {
 
   bool subscribe(Stream::Context& _stream);
   bool unsubscribe(Stream::Context& _stream);
-  bool enqueue(Log* _log, Log::Level _level, String&& _message);
+  Byte* reserve(Log* _owner, Log::Level _level, const char* _format,
+    Log::Replay _replay, Size _size);
+  void commit();
   void flush();
 
+  void set_overflow(Log::Overflow _overflow);
+  Uint64 dropped() const;
+
+  // Called on a thread that logged as it ends, the ring is given to the next
+  // thread that logs.
+  void release_ring(Ring* _ring);
+
 private:
   enum : Uint8 {
     RUNNING = 1 << 0,
     READY   = 1 << 1
   };
 
-  struct Queue {
-    Log* owner;
-    IntrusiveList messages;
-  };
-
-  struct Message {
-    Queue* owner;
-    Log::Level level;
-    time_t time;
-    String contents;
-    IntrusiveList::Node link;
+  // Where the next record comes from when draining.
+  struct Source {
+    Ring* ring;
+    Uint64 tail;
+    Uint64 head;
   };
 
   void process(int _thread_id);
 
-  void flush_unlocked();
-  void write(Ptr<Message>& message_);
+  Ring* thread_ring();
+
+  bool flush_unlocked();
+  const Record* next_record(Source& source_);
+  void write(const Record* _record);
+  void write(Log* _owner, Log::Level _level, time_t _time, String&& contents_);
 
   Concurrency::Mutex m_mutex;
   Concurrency::ConditionVariable m_ready_cond;
-  Concurrency::ConditionVariable m_wakeup_cond;
 
   Vector<Stream::BufferedStream> m_streams RX_HINT_GUARDED_BY(m_mutex);
-  Vector<Queue> m_queues                   RX_HINT_GUARDED_BY(m_mutex);
-  Vector<Ptr<Message>> m_messages          RX_HINT_GUARDED_BY(m_mutex);
+  Vector<Ring*> m_rings                    RX_HINT_GUARDED_BY(m_mutex);
+  Vector<Ring*> m_free_rings               RX_HINT_GUARDED_BY(m_mutex);
+  Vector<Byte*> m_large                    RX_HINT_GUARDED_BY(m_mutex);
+  Vector<Source> m_sources                 RX_HINT_GUARDED_BY(m_mutex);
+  Vector<Log*> m_written                   RX_HINT_GUARDED_BY(m_mutex);
+  Uint64 m_dropped_reported                RX_HINT_GUARDED_BY(m_mutex);
+  time_t m_last_time                       RX_HINT_GUARDED_BY(m_mutex);
+  Optional<String> m_last_timestamp        RX_HINT_GUARDED_BY(m_mutex);
   int m_status                             RX_HINT_GUARDED_BY(m_mutex);
   int m_padding                            RX_HINT_GUARDED_BY(m_mutex);
 
+  Concurrency::Atomic<Uint64> m_dropped;
+  Concurrency::Atomic<Uint8> m_overflow;
+  Concurrency::Atomic<bool> m_running;
+
+  // The wall clock time of a record is derived from it's ticks.
+  time_t m_time_base;
+  Uint64 m_ticks_base;
+  Uint64 m_frequency;
+
+  // Rings are cached per thread, the generation invalidates that cache when
+  // the logger is reinitialized.
+  Uint64 m_generation;
+
+  // Has the ring of every thread that logged, to release it as the thread ends.
+#if defined(RX_PLATFORM_POSIX)
+  pthread_key_t m_ring_key;
+#elif defined(RX_PLATFORM_WINDOWS)
+  DWORD m_ring_key;
+#endif
+
   // NOTE(dweiler): This should come last.
   Concurrency::Thread m_thread;
 
   static Global<Logger> s_instance;
+  static inline Concurrency::Atomic<Uint64> s_generations{0};
 };
 
 static GlobalGroup g_group_loggers{"loggers"};
 
 Global<Logger> Logger::s_instance{"system", "logger"};
 
+RX_LOG("log", logger);
+
+// The ring of the calling thread, these must all be trivially destructible.
+static thread_local Ring* t_ring;
+static thread_local Uint64 t_generation;
+static thread_local Byte* t_large;
+static thread_local bool t_logger_thread;
+
+#if defined(RX_PLATFORM_WINDOWS)
+static void WINAPI release_thread_ring(void* _ring) {
+#else
+static void release_thread_ring(void* _ring) {
+#endif
+  if (_ring) {
+    Logger::instance().release_ring(static_cast<Ring*>(_ring));
+  }
+}
+
 static inline const char* string_for_level(Log::Level _level) {
   switch (_level) {
   case Log::Level::WARNING:
@@ -115,12 +217,32 @@ static inline Optional<String> string_for_time(time_t _time) {
 
 Logger::Logger()
   : m_streams{Memory::SystemAllocator::instance()}
-  , m_queues{Memory::SystemAllocator::instance()}
-  , m_messages{Memory::SystemAllocator::instance()}
+  , m_rings{Memory::SystemAllocator::instance()}
+  , m_free_rings{Memory::SystemAllocator::instance()}
+  , m_large{Memory::SystemAllocator::instance()}
+  , m_sources{Memory::SystemAllocator::instance()}
+  , m_written{Memory::SystemAllocator::instance()}
+  , m_dropped_reported{0}
+  , m_last_time{0}
   , m_status{RUNNING}
   , m_padding{0}
+  , m_dropped{0}
+  , m_overflow{static_cast<Uint8>(Log::Overflow::BLOCK)}
+  , m_running{true}
+  , m_time_base{time(nullptr)}
+  , m_ticks_base{Time::qpc_ticks()}
+  , m_frequency{Time::qpc_frequency()}
+  , m_generation{++s_generations}
   , m_thread{}
 {
+#if defined(RX_PLATFORM_POSIX)
+  RX_ASSERT(pthread_key_create(&m_ring_key, release_thread_ring) == 0,
+    "failed to create key");
+#elif defined(RX_PLATFORM_WINDOWS)
+  m_ring_key = FlsAlloc(release_thread_ring);
+  RX_ASSERT(m_ring_key != FLS_OUT_OF_INDEXES, "failed to create key");
+#endif
+
   auto thread = Concurrency::Thread::create(
     Memory::SystemAllocator::instance(),
     "loggger", [this](int _tid) { process(_tid); });
@@ -141,12 +263,8 @@ Logger::Logger()
     // Initialize the logger.
     _node->init();
 
-    // Associate a message queue with the logger.
-    auto this_log = _node->cast<Log>();
-    m_queues.emplace_back(this_log, IntrusiveList{});
-
     // Keep track of the largest logger name.
-    const auto length = strlen(this_log->name());
+    const auto length = strlen(_node->cast<Log>()->name());
     max_name = Algorithm::max(max_name, static_cast<int>(length));
   });
 
@@ -166,11 +284,28 @@ Logger::~Logger() {
   {
     Concurrency::ScopeLock lock{m_mutex};
     m_status &= ~RUNNING;
-    m_wakeup_cond.signal();
   }
 
-  // Join the |process| thread.
+  // Join the |process| thread, it writes everything still queued on the way
+  // out. Anything logged after this point is dropped.
   RX_ASSERT(m_thread.join(), "failed to join thread");
+  m_running = false;
+
+  // Threads that end from now on have nothing to release.
+#if defined(RX_PLATFORM_POSIX)
+  pthread_key_delete(m_ring_key);
+#elif defined(RX_PLATFORM_WINDOWS)
+  FlsFree(m_ring_key);
+#endif
+
+  auto& allocator = Memory::SystemAllocator::instance();
+  m_rings.each_fwd([&](Ring* _ring) {
+    allocator.deallocate(_ring->data);
+    allocator.destroy<Ring>(_ring);
+  });
+  m_large.each_fwd([&](Byte* _data) {
+    allocator.deallocate(_data);
+  });
 
   // Finalize all loggers.
   g_group_loggers.fini();
@@ -223,43 +358,143 @@ bool Logger::unsubscribe(Stream::Context& _stream) {
   return false;
 }
 
-bool Logger::enqueue(Log* _owner, Log::Level _level, String&& message_) {
-  Concurrency::ScopeLock lock{m_mutex};
-
-  const auto index = m_queues.find_if([_owner](const Queue& _queue) {
-    return _queue.owner == _owner;
-  });
+Ring* Logger::thread_ring() {
+  if (RX_HINT_LIKELY(t_generation == m_generation)) {
+    return t_ring;
+  }
 
-  if (!index) {
-    return false;
+  // Reuse the ring of a thread that ended. Any records still in it are drained
+  // as usual, only the thread producing into it changes.
+  Ring* ring = nullptr;
+  {
+    Concurrency::ScopeLock lock{m_mutex};
+    if (!m_free_rings.is_empty()) {
+      ring = m_free_rings.last();
+      m_free_rings.pop_back();
+    }
   }
 
-  auto& this_queue = m_queues[*index];
+  if (!ring) {
+    auto& allocator = Memory::SystemAllocator::instance();
 
-  // Record the message.
-  auto this_message = make_ptr<Message>(Memory::SystemAllocator::instance(),
-                                        &this_queue, _level, time(nullptr), Utility::move(message_),
-                                        IntrusiveList::Node{});
+    auto data = allocator.allocate(Ring::CAPACITY);
+    if (!data) {
+      return nullptr;
+    }
 
-  if (!this_message || !m_messages.emplace_back(Utility::move(this_message))) {
-    return false;
-  }
+    ring = allocator.create<Ring>(data);
+    if (!ring) {
+      allocator.deallocate(data);
+      return nullptr;
+    }
 
-  // Record the link.
-  this_queue.messages.push_back(&m_messages.last()->link);
+    // Rings live as long as the logger does, threads only borrow them.
+    Concurrency::ScopeLock lock{m_mutex};
+    if (!m_rings.push_back(ring)) {
+      allocator.destroy<Ring>(ring);
+      allocator.deallocate(data);
+      return nullptr;
+    }
+  }
 
-  // Wakeup logging thread when we have a few messages.
-#if defined(RX_DEBUG)
-  static constexpr const auto FLUSH_THRESHOLD = 1_z;
-#else
-  static constexpr const auto FLUSH_THRESHOLD = 1000_z;
+#if defined(RX_PLATFORM_POSIX)
+  pthread_setspecific(m_ring_key, ring);
+#elif defined(RX_PLATFORM_WINDOWS)
+  FlsSetValue(m_ring_key, ring);
 #endif
 
-  if (m_streams.size() && m_messages.size() >= FLUSH_THRESHOLD) {
-    m_wakeup_cond.signal();
+  t_ring = ring;
+  t_generation = m_generation;
+
+  return ring;
+}
+
+void Logger::release_ring(Ring* _ring) {
+  // Anything logged later on this thread takes another ring.
+  t_ring = nullptr;
+  t_generation = 0;
+
+  Concurrency::ScopeLock lock{m_mutex};
+  // When out of memory the ring is kept by the logger, just not reused.
+  (void)m_free_rings.push_back(_ring);
+}
+
+Byte* Logger::reserve(Log* _owner, Log::Level _level, const char* _format,
+  Log::Replay _replay, Size _size)
+{
+  const auto ticks = Time::qpc_ticks();
+  const auto size = align_record(sizeof(Record) + _size);
+
+  Byte* data = nullptr;
+
+  auto ring = thread_ring();
+  if (RX_HINT_LIKELY(ring && size <= Ring::CAPACITY / 4)) {
+    auto head = ring->head.load(Concurrency::MemoryOrder::RELAXED);
+
+    // Records are contiguous, pad to the end of the ring when it doesn't fit.
+    const auto offset = head & (Ring::CAPACITY - 1);
+    const auto contiguous = Ring::CAPACITY - offset;
+    const auto need = contiguous < size ? contiguous + size : size;
+
+    while (head + need - ring->cached_tail > Ring::CAPACITY) {
+      ring->cached_tail = ring->tail.load(Concurrency::MemoryOrder::ACQUIRE);
+      if (head + need - ring->cached_tail <= Ring::CAPACITY) {
+        break;
+      }
+
+      // The logging thread cannot wait on itself.
+      if (m_overflow.load(Concurrency::MemoryOrder::RELAXED) == static_cast<Uint8>(Log::Overflow::DROP)
+        || t_logger_thread
+        || !m_running.load(Concurrency::MemoryOrder::RELAXED))
+      {
+        m_dropped.fetch_add(1, Concurrency::MemoryOrder::RELAXED);
+        return nullptr;
+      }
+
+      // Rather than wait for the logging thread, write out everything queued
+      // on this thread. Blocked threads take turns doing so.
+      flush();
+    }
+
+    if (contiguous < size) {
+      const auto padding = static_cast<Uint32>(contiguous) | Ring::PADDING;
+      memcpy(ring->data + offset, &padding, sizeof padding);
+      head += contiguous;
+    }
+
+    data = ring->data + (head & (Ring::CAPACITY - 1));
+    ring->reserved = head + size;
+  } else {
+    // Too large for the ring, allocate it on it's own.
+    data = Memory::SystemAllocator::instance().allocate(size);
+    if (!data) {
+      return nullptr;
+    }
+    t_large = data;
   }
 
-  return true;
+  auto record = reinterpret_cast<Record*>(data);
+  record->size = static_cast<Uint32>(size);
+  record->level = _level;
+  record->owner = _owner;
+  record->format = _format;
+  record->replay = _replay;
+  record->ticks = ticks;
+
+  return data + sizeof(Record);
+}
+
+void Logger::commit() {
+  if (RX_HINT_UNLIKELY(t_large)) {
+    auto data = Utility::exchange(t_large, nullptr);
+    Concurrency::ScopeLock lock{m_mutex};
+    if (!m_large.push_back(data)) {
+      Memory::SystemAllocator::instance().deallocate(data);
+      m_dropped.fetch_add(1, Concurrency::MemoryOrder::RELAXED);
+    }
+    return;
+  }
+  t_ring->head.store(t_ring->reserved, Concurrency::MemoryOrder::RELEASE);
 }
 
 void Logger::flush() {
@@ -267,48 +502,167 @@ void Logger::flush() {
   flush_unlocked();
 }
 
+void Logger::set_overflow(Log::Overflow _overflow) {
+  m_overflow.store(static_cast<Uint8>(_overflow), Concurrency::MemoryOrder::RELAXED);
+}
+
+Uint64 Logger::dropped() const {
+  return m_dropped.load(Concurrency::MemoryOrder::RELAXED);
+}
+
 void Logger::process([[maybe_unused]] int _thread_id) {
-  Concurrency::ScopeLock locked{m_mutex};
+  t_logger_thread = true;
 
-  // Block the logging thread until |this| is ready.
-  m_ready_cond.wait(locked, [this] { return m_status & READY; });
+  {
+    Concurrency::ScopeLock locked{m_mutex};
 
-  while (m_status & RUNNING) {
-    // Block until another we're woken up again to flush something.
-    m_wakeup_cond.wait(locked);
+    // Block the logging thread until |this| is ready.
+    m_ready_cond.wait(locked, [this] { return m_status & READY; });
+  }
 
-    // Flush the queued contents. Use the unlocked variant since |m_mutex| is
-    // held by |m_wakeup_cond|.
-    flush_unlocked();
+  // Producers never signal the logging thread, it polls instead. Poll more
+  // often while messages are coming in.
+  static constexpr const Uint64 BUSY_INTERVAL = 1;
+  static constexpr const Uint64 IDLE_INTERVAL = 10;
+
+  for (;;) {
+    bool busy = false;
+    {
+      Concurrency::ScopeLock locked{m_mutex};
+      busy = flush_unlocked();
+      if (!(m_status & RUNNING)) {
+        break;
+      }
+    }
+    Time::delay(busy ? BUSY_INTERVAL : IDLE_INTERVAL);
   }
 }
 
-void Logger::flush_unlocked() {
-  // Flush all message entries.
-  m_messages.each_fwd([this](Ptr<Message>& message_) { write(message_); });
-  m_messages.clear();
+// Skips padding. Returns nullptr when the source is exhausted.
+const Record* Logger::next_record(Source& source_) {
+  while (source_.tail != source_.head) {
+    const auto data = source_.ring->data + (source_.tail & (Ring::CAPACITY - 1));
+    Uint32 size;
+    memcpy(&size, data, sizeof size);
+    if (!(size & Ring::PADDING)) {
+      return reinterpret_cast<const Record*>(data);
+    }
+    source_.tail += size & ~Ring::PADDING;
+  }
+  return nullptr;
+}
+
+bool Logger::flush_unlocked() {
+  m_sources.clear();
+  m_rings.each_fwd([this](Ring* _ring) {
+    const auto tail = _ring->tail.load(Concurrency::MemoryOrder::RELAXED);
+    const auto head = _ring->head.load(Concurrency::MemoryOrder::ACQUIRE);
+    if (head != tail) {
+      (void)m_sources.push_back(Source{_ring, tail, head});
+    }
+  });
+
+  const bool busy = !m_sources.is_empty() || !m_large.is_empty();
+
+  // Merge the records of every thread by the time they were recorded. Threads
+  // may be preempted between taking the time and publishing the record, so the
+  // order is approximate.
+  Size large = 0;
+  for (;;) {
+    Source* source = nullptr;
+    const Record* record = nullptr;
+    m_sources.each_fwd([&](Source& source_) {
+      const auto next = next_record(source_);
+      if (next && (!record || next->ticks < record->ticks)) {
+        record = next;
+        source = &source_;
+      }
+    });
+
+    if (large < m_large.size()) {
+      const auto next = reinterpret_cast<const Record*>(m_large[large]);
+      if (!record || next->ticks < record->ticks) {
+        record = next;
+        source = nullptr;
+      }
+    }
+
+    if (!record) {
+      break;
+    }
+
+    write(record);
+
+    // Release the memory of the record back to the producer.
+    if (source) {
+      source->tail += record->size;
+      source->ring->tail.store(source->tail, Concurrency::MemoryOrder::RELEASE);
+    } else {
+      Memory::SystemAllocator::instance().deallocate(m_large[large++]);
+    }
+  }
+
+  m_large.clear();
+
+  // Report any messages dropped since the last report.
+  const auto dropped = m_dropped.load(Concurrency::MemoryOrder::RELAXED);
+  if (dropped != m_dropped_reported) {
+    auto contents = String::format(Memory::SystemAllocator::instance(),
+      "dropped %zu messages", static_cast<Size>(dropped - m_dropped_reported));
+    m_dropped_reported = dropped;
+    write(logger.data(), Log::Level::WARNING, time(nullptr), Utility::move(contents));
+  }
 
   // Flush all the streams.
   m_streams.each_fwd([](Stream::BufferedStream& _stream) {
     _stream.on_flush();
   });
+
+  // Signal the flush operation on every log written to, to indicate any
+  // messages queued up on it are now all written out.
+  m_written.each_fwd([](Log* _log) { _log->signal_flush(); });
+  m_written.clear();
+
+  return busy;
 }
 
-void Logger::write(Ptr<Message>& message_) {
+void Logger::write(const Record* _record) {
+  const auto arguments = reinterpret_cast<const Byte*>(_record + 1);
+
+  String contents{Memory::SystemAllocator::instance()};
+  const auto length = _record->replay({nullptr, 0}, _record->format, arguments);
+  if (contents.resize(length)) {
+    _record->replay(contents.span(), _record->format, arguments);
+  }
+
+  const auto elapsed = (_record->ticks - m_ticks_base) / m_frequency;
+  const auto time = m_time_base + static_cast<time_t>(elapsed);
+
+  write(_record->owner, _record->level, time, Utility::move(contents));
+
+  if (!m_written.find(_record->owner)) {
+    (void)m_written.push_back(_record->owner);
+  }
+}
+
+void Logger::write(Log* _owner, Log::Level _level, time_t _time, String&& contents_) {
 #if defined(RX_PLATFORM_WINDOWS)
   static constexpr const Byte CR[] = { '\r', '\n' };
 #else
   static constexpr const Byte CR[] = { '\n' };
 #endif
 
-  auto this_queue = message_->owner;
-
-  const auto name = this_queue->owner->name();
-  const auto level = string_for_level(message_->level);
+  const auto name = _owner->name();
+  const auto level = string_for_level(_level);
   const auto padding = strlen(name) + strlen(level) + 1; // +1 for '/'
 
-  const auto timestamp = string_for_time(message_->time);
-  const auto time = timestamp ? timestamp->data() : "out of memory";
+  // Many messages are written in the same second.
+  if (_time != m_last_time || !m_last_timestamp) {
+    m_last_timestamp = string_for_time(_time);
+    m_last_time = _time;
+  }
+
+  const auto time = m_last_timestamp ? m_last_timestamp->data() : "out of memory";
 
   // The streams written to are all binary streams. Handle platform differences
   // for handling for newline.
@@ -322,7 +676,7 @@ void Logger::write(Ptr<Message>& message_) {
     "");
 
   const auto label_span = label.span().cast<const Byte>();
-  const auto content_span = message_->contents.span().cast<const Byte>();
+  const auto content_span = contents_.span().cast<const Byte>();
 
   auto beg = content_span.data();
   auto end = content_span.data() + content_span.size() - 1;
@@ -348,7 +702,7 @@ void Logger::write(Ptr<Message>& message_) {
   // here.
 #if defined(RX_PLATFORM_EMSCRIPTEN)
   const auto contents = content_span.data();
-  switch (message_->level) {
+  switch (_level) {
   case Log::Level::ERROR:
     emscripten_log(EM_LOG_ERROR, "%s", contents);
     break;
@@ -364,18 +718,7 @@ void Logger::write(Ptr<Message>& message_) {
 #endif
 
   // Signal the write event for the log associated with this message.
-  this_queue->owner->signal_write(message_->level,
-                                  Utility::move(message_->contents));
-
-  // Remove the message from the log's queue associated with this message.
-  this_queue->messages.erase(&message_->link);
-
-  // The queue for the log associated with this message is now empty.
-  if (this_queue->messages.is_empty()) {
-    // Signal the flush operation on that log, to indicate any messages
-    // queued up on it are now all written out.
-    this_queue->owner->signal_flush();
-  }
+  _owner->signal_write(_level, Utility::move(contents_));
 }
 
 } // anon-namespace
@@ -400,13 +743,31 @@ void Log::signal_flush() {
 }
 
 bool Log::enqueue(Log* _owner, Level _level, String&& contents_) {
-  return Logger::instance().enqueue(_owner, _level, Utility::move(contents_));
+  return _owner->record(_level, "%s", contents_.data());
 }
 
 void Log::flush() {
   Logger::instance().flush();
 }
 
+void Log::set_overflow(Overflow _overflow) {
+  Logger::instance().set_overflow(_overflow);
+}
+
+Uint64 Log::dropped() {
+  return Logger::instance().dropped();
+}
+
+Byte* Log::reserve(Log* _owner, Level _level, const char* _format,
+  Replay _replay, Size _size)
+{
+  return Logger::instance().reserve(_owner, _level, _format, _replay, _size);
+}
+
+void Log::commit() {
+  Logger::instance().commit();
+}
+
 bool Log::subscribe(Stream::Context& _stream) {
   return Logger::instance().subscribe(_stream);
 }
@@ -1,9 +1,14 @@
 #ifndef RX_CORE_LOG_H
 #define RX_CORE_LOG_H
+#include <string.h> // memcpy, strlen
+
 #include "rx/core/event.h"
 #include "rx/core/string.h"
 #include "rx/core/source_location.h"
 
+#include "rx/core/hints/likely.h"
+#include "rx/core/traits/is_same.h"
+
 namespace Rx {
 
 namespace Stream { struct Context; }
@@ -19,6 +24,12 @@ struct RX_API Log {
     ERROR
   };
 
+  /// \brief What to do when a thread logs faster than messages are written.
+  enum class Overflow : Uint8 {
+    BLOCK, ///< Wait for the logging thread to make room.
+    DROP   ///< Discard the message. See dropped().
+  };
+
   using QueueEvent = Event<void(Level, String)>;
   using WriteEvent = Event<void(Level, String)>;
   using FlushEvent = Event<void()>;
@@ -31,13 +42,26 @@ struct RX_API Log {
 
   static void flush();
 
+  /// \brief Select the overflow policy for all logs. The default is BLOCK.
+  static void set_overflow(Overflow _overflow);
+
+  /// \brief The total number of messages discarded by Overflow::DROP.
+  static Uint64 dropped();
+
   /// \brief
   /// Write a formatted message given by \p _format and \p _arguments of
   /// associated severity level \p _level. This will queue the given message
   /// on the logger thread.
   ///
+  /// The arguments are copied into a ring buffer owned by the calling thread
+  /// and only formatted later by the logging thread, strings are copied in
+  /// their entirety. Queuing takes no locks unless the ring is full and the
+  /// overflow policy is Overflow::BLOCK.
+  ///
   /// All delegates assigned by on_queue will be called immediately by this
-  /// function (and thus on the same thread).
+  /// function (and thus on the same thread). This requires formatting the
+  /// message immediately, so logs with such delegates lose the benefit of
+  /// deferred formatting.
   ///
   /// This function is thread-safe.
   ///
@@ -119,7 +143,39 @@ struct RX_API Log {
   void signal_write(Level _level, String&& contents_);
   void signal_flush();
 
+  /// Formats the arguments recorded by write() into \p buffer_.
+  using Replay = Size (*)(Span<char> buffer_, const char* _format, const Byte* _arguments);
+
 private:
+  // Arguments are recorded in 8-byte slots. Strings are recorded as their
+  // length followed by their contents, padded to a multiple of 8 bytes.
+  static constexpr const Size SLOT = 8;
+  static constexpr const Uint64 NULL_STRING = ~0_u64;
+
+  template<typename T>
+  static constexpr bool is_string();
+
+  template<typename T>
+  static Size record_size(T _value);
+
+  template<typename T>
+  static Byte* record_argument(Byte* data_, T _value);
+
+  template<typename T>
+  static T replay_argument(const Byte*& data_);
+
+  template<typename... Ts>
+  struct Replayer;
+
+  template<typename... Ts>
+  bool record(Level _level, const char* _format, Ts... _arguments);
+
+  // Reserve space for a record in the ring buffer of the calling thread.
+  // Returns nullptr when the message was dropped.
+  static Byte* reserve(Log* _owner, Level _level, const char* _format,
+    Replay _replay, Size _size);
+  static void commit();
+
   const char* m_name;
   SourceLocation m_source_location;
 
@@ -128,8 +184,96 @@ private:
   FlushEvent m_flush_event;
 };
 
+template<typename T>
+inline constexpr bool Log::is_string() {
+  return Traits::IS_SAME<T, const char*> || Traits::IS_SAME<T, char*>;
+}
+
+template<typename T>
+inline Size Log::record_size(T _value) {
+  if constexpr (is_string<T>()) {
+    const auto length = _value ? strlen(_value) + 1 : 0;
+    return SLOT + (length + SLOT - 1) / SLOT * SLOT;
+  } else {
+    static_assert(sizeof(T) <= SLOT, "argument too large to record");
+    return SLOT;
+  }
+}
+
+template<typename T>
+inline Byte* Log::record_argument(Byte* data_, T _value) {
+  if constexpr (is_string<T>()) {
+    const Uint64 length = _value ? strlen(_value) + 1 : NULL_STRING;
+    memcpy(data_, &length, sizeof length);
+    if (!_value) {
+      return data_ + SLOT;
+    }
+    memcpy(data_ + SLOT, _value, length);
+    return data_ + SLOT + (length + SLOT - 1) / SLOT * SLOT;
+  } else {
+    memcpy(data_, &_value, sizeof _value);
+    return data_ + SLOT;
+  }
+}
+
+template<typename T>
+inline T Log::replay_argument(const Byte*& data_) {
+  if constexpr (is_string<T>()) {
+    Uint64 length;
+    memcpy(&length, data_, sizeof length);
+    if (length == NULL_STRING) {
+      data_ += SLOT;
+      return nullptr;
+    }
+    const auto string = reinterpret_cast<const char*>(data_ + SLOT);
+    data_ += SLOT + (length + SLOT - 1) / SLOT * SLOT;
+    return const_cast<T>(string);
+  } else {
+    T value;
+    memcpy(&value, data_, sizeof value);
+    data_ += SLOT;
+    return value;
+  }
+}
+
+// Arguments are replayed one at a time into a growing parameter pack as the
+// order of evaluation of function arguments is unspecified.
+template<>
+struct Log::Replayer<> {
+  template<typename... Us>
+  static Size replay(Span<char> buffer_, const char* _format, const Byte*, Us... _values) {
+    return format_buffer_va_args(buffer_, _format, _values...);
+  }
+};
+
+template<typename T, typename... Ts>
+struct Log::Replayer<T, Ts...> {
+  template<typename... Us>
+  static Size replay(Span<char> buffer_, const char* _format, const Byte* _data, Us... _values) {
+    const auto value = replay_argument<T>(_data);
+    return Replayer<Ts...>::replay(buffer_, _format, _data, _values..., value);
+  }
+};
+
+template<typename... Ts>
+bool Log::record(Level _level, const char* _format, Ts... _arguments) {
+  const Size size = (record_size(_arguments) + ... + 0);
+  auto data = reserve(this, _level, _format, &Replayer<Ts...>::template replay<>, size);
+  if (!data) {
+    return false;
+  }
+  ((data = record_argument(data, _arguments)), ...);
+  commit();
+  return true;
+}
+
 template<typename... Ts>
 bool Log::write(Level _level, const char* _format, Ts&&... _arguments) {
+  if (RX_HINT_LIKELY(m_queue_event.is_empty())) {
+    return record(_level, _format,
+      FormatNormalize<Traits::RemoveCVRef<Ts>>{}(Utility::forward<Ts>(_arguments))...);
+  }
+
   auto& allocator = Memory::SystemAllocator::instance();
   Optional<String> contents;
   if constexpr (sizeof...(Ts) != 0) {
@@ -139,14 +283,14 @@ bool Log::write(Level _level, const char* _format, Ts&&... _arguments) {
   }
   if (contents) {
     m_queue_event.signal(_level, *contents);
-    return enqueue(this, _level, Utility::move(*contents));
+    return record(_level, "%s", contents->data());
   }
   return false;
 }
 
 inline bool Log::write(Level _level, String&& message_) {
   m_queue_event.signal(_level, message_);
-  return enqueue(this, _level, Utility::move(message_));
+  return record(_level, "%s", message_.data());
 }
 
 template<typename... Ts>
@@ -79,6 +79,8 @@ void MersenneTwister::seed(Uint64 _seed) {
   for (Size i = 1; i < SIZE; i++) {
     m_state[i] = 0x6c078965 * (m_state[i - 1] ^ m_state[i - 1] >> 30) + i;
   }
+  m_index = SIZE;
+  m_seeded = true;
 }
 
 Uint32 MersenneTwister::u32_unlocked() {
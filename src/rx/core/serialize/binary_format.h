@@ -0,0 +1,61 @@
+#ifndef RX_CORE_SERIALIZE_BINARY_FORMAT_H
+#define RX_CORE_SERIALIZE_BINARY_FORMAT_H
+#include "rx/core/types.h"
+
+/// \file binary_format.h
+///
+/// On-disk layout shared by BinaryWriter and BinaryReader.
+///
+/// A binary container is a fixed-size header followed by a sequence of
+/// sections and terminated by a section table. All integers are little-endian.
+///
+/// \code
+///   Header   (32 bytes)
+///   padding  (to ALIGNMENT)
+///   Section  (aligned to ALIGNMENT)
+///   ...
+///   Table    (aligned to ALIGNMENT, 32 bytes per section)
+/// \endcode
+///
+/// Every section begins on an ALIGNMENT boundary so a container that is
+/// mapped or loaded into suitably aligned memory can have its arrays used in
+/// place without copying.
+
+namespace Rx::Serialize::Binary {
+
+/// Construct a four character code tag from a string literal.
+constexpr Uint32 tag(const char (&_tag)[5]) {
+  return static_cast<Uint32>(static_cast<Byte>(_tag[0]))
+      | (static_cast<Uint32>(static_cast<Byte>(_tag[1])) << 8)
+      | (static_cast<Uint32>(static_cast<Byte>(_tag[2])) << 16)
+      | (static_cast<Uint32>(static_cast<Byte>(_tag[3])) << 24);
+}
+
+/// Magic number identifying a binary container.
+inline constexpr const Uint32 MAGIC = tag("REXB");
+
+/// Version of the container layout, not of the contents.
+inline constexpr const Uint16 VERSION = 1;
+
+/// Alignment of every section in bytes.
+inline constexpr const Uint64 ALIGNMENT = 64;
+
+/// Size of the header in bytes.
+inline constexpr const Uint64 HEADER_SIZE = 32;
+
+/// Size of a section table entry in bytes.
+inline constexpr const Uint64 ENTRY_SIZE = 32;
+
+/// Reserved tag of the string pool section.
+inline constexpr const Uint32 STRINGS_TAG = tag("STRS");
+
+/// The type of a section.
+enum class Type : Uint8 {
+  BLOB,   ///< Opaque bytes.
+  ARRAY,  ///< Array of fixed-size elements.
+  STRINGS ///< Pool of null-terminated strings.
+};
+
+} // namespace Rx::Serialize::Binary
+
+#endif // RX_CORE_SERIALIZE_BINARY_FORMAT_H
@@ -0,0 +1,149 @@
+#include <string.h> // memcpy
+
+#include "rx/core/serialize/binary_reader.h"
+
+namespace Rx::Serialize {
+
+// Containers are little-endian, as is every host Rex targets. The header and
+// table are read with memcpy since the container need not be aligned.
+template<typename T>
+static T read(const Byte* _data) {
+  T value;
+  memcpy(&value, _data, sizeof value);
+  return value;
+}
+
+BinaryReader::BinaryReader(Memory::Allocator& _allocator, Span<const Byte> _data)
+  : m_data{_data}
+  , m_strings{nullptr, 0}
+  , m_sections{_allocator}
+  , m_kind{0}
+  , m_version{0}
+{
+}
+
+BinaryReader::BinaryReader(BinaryReader&& binary_reader_)
+  : m_data{binary_reader_.m_data}
+  , m_strings{binary_reader_.m_strings}
+  , m_sections{Utility::move(binary_reader_.m_sections)}
+  , m_kind{Utility::exchange(binary_reader_.m_kind, 0)}
+  , m_version{Utility::exchange(binary_reader_.m_version, 0)}
+{
+}
+
+Optional<BinaryReader> BinaryReader::create(Memory::Allocator& _allocator,
+  Span<const Byte> _data)
+{
+  const auto data = _data.data();
+  const auto size = _data.size();
+
+  if (size < Binary::HEADER_SIZE) {
+    return nullopt;
+  }
+
+  // An unfinished container has a zero magic.
+  if (read<Uint32>(data + 0) != Binary::MAGIC) {
+    return nullopt;
+  }
+
+  // Newer layouts cannot be read.
+  if (read<Uint16>(data + 4) > Binary::VERSION) {
+    return nullopt;
+  }
+
+  const auto count = read<Uint16>(data + 6);
+  const auto table_offset = read<Uint64>(data + 16);
+  const auto total_size = read<Uint64>(data + 24);
+
+  // Truncated container or table out of bounds.
+  if (total_size > size || table_offset > total_size
+    || (total_size - table_offset) / Binary::ENTRY_SIZE < count)
+  {
+    return nullopt;
+  }
+
+  BinaryReader reader{_allocator, _data};
+  reader.m_kind = read<Uint32>(data + 8);
+  reader.m_version = read<Uint32>(data + 12);
+
+  if (!reader.m_sections.reserve(count)) {
+    return nullopt;
+  }
+
+  for (Size i = 0; i < count; i++) {
+    const auto entry = data + table_offset + i * Binary::ENTRY_SIZE;
+
+    Section section;
+    section.tag = read<Uint32>(entry + 0);
+    section.type = static_cast<Binary::Type>(read<Uint8>(entry + 4));
+    section.element_size = read<Uint32>(entry + 8);
+    section.offset = read<Uint64>(entry + 16);
+    section.size = read<Uint64>(entry + 24);
+
+    if (section.offset % Binary::ALIGNMENT != 0
+      || section.offset > table_offset
+      || section.size > table_offset - section.offset)
+    {
+      return nullopt;
+    }
+
+    switch (section.type) {
+    case Binary::Type::BLOB:
+      break;
+    case Binary::Type::ARRAY:
+      if (section.element_size == 0 || section.size % section.element_size) {
+        return nullopt;
+      }
+      break;
+    case Binary::Type::STRINGS:
+      // Must end with a null-terminator so no lookup can run off the end.
+      if (section.size == 0 || data[section.offset + section.size - 1] != 0) {
+        return nullopt;
+      }
+      reader.m_strings = {
+        reinterpret_cast<const char*>(data + section.offset),
+        static_cast<Size>(section.size)
+      };
+      break;
+    default:
+      return nullopt;
+    }
+
+    if (!reader.m_sections.push_back(section)) {
+      return nullopt;
+    }
+  }
+
+  return reader;
+}
+
+bool BinaryReader::has(Uint32 _tag) const {
+  return !m_sections.each_fwd([&](const Section& _section) {
+    return _section.tag != _tag;
+  });
+}
+
+Optional<Span<const Byte>> BinaryReader::blob(Uint32 _tag) const {
+  if (const auto section = find(_tag, Binary::Type::BLOB)) {
+    return Span<const Byte>{m_data.data() + section->offset, static_cast<Size>(section->size)};
+  }
+  return nullopt;
+}
+
+const char* BinaryReader::string(Uint32 _offset) const {
+  return _offset < m_strings.size() ? m_strings.data() + _offset : nullptr;
+}
+
+const BinaryReader::Section* BinaryReader::find(Uint32 _tag, Binary::Type _type) const {
+  // Containers hold a handful of sections, a linear search is fine.
+  const Size n_sections = m_sections.size();
+  for (Size i = 0; i < n_sections; i++) {
+    const auto& section = m_sections[i];
+    if (section.tag == _tag) {
+      return section.type == _type ? &section : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace Rx::Serialize
@@ -0,0 +1,100 @@
+#ifndef RX_CORE_SERIALIZE_BINARY_READER_H
+#define RX_CORE_SERIALIZE_BINARY_READER_H
+#include "rx/core/serialize/binary_format.h"
+
+#include "rx/core/span.h"
+#include "rx/core/vector.h"
+
+/// \file binary_reader.h
+
+namespace Rx::Serialize {
+
+/// \brief Reads a binary container in place.
+///
+/// A BinaryReader validates the header and section table of a container held
+/// in memory and then hands out spans that point directly into that memory.
+/// Nothing is copied, the memory must outlive the reader and every span
+/// returned by it.
+struct RX_API BinaryReader {
+  RX_MARK_NO_COPY(BinaryReader);
+
+  BinaryReader(BinaryReader&& binary_reader_);
+
+  /// \brief Create a reader over the contents of a container.
+  /// \param _allocator The allocator for the section table.
+  /// \param _data The container contents.
+  /// \returns The reader when \p _data is a complete, well-formed container of
+  /// a supported version, \c nullopt otherwise.
+  static Optional<BinaryReader> create(Memory::Allocator& _allocator,
+    Span<const Byte> _data);
+
+  /// Tag identifying what the container holds.
+  Uint32 kind() const;
+
+  /// Version of the contents as given to the BinaryWriter.
+  Uint32 version() const;
+
+  /// Check if a section with the given tag exists.
+  bool has(Uint32 _tag) const;
+
+  /// \brief Access a section of opaque bytes.
+  /// \returns The bytes of the section, \c nullopt if there is no such blob.
+  Optional<Span<const Byte>> blob(Uint32 _tag) const;
+
+  /// \brief Access a section holding an array of \p T in place.
+  /// \returns The array, \c nullopt when there is no such array, the element
+  /// size does not match \c sizeof(T) or the memory is not aligned for \p T.
+  template<typename T>
+  Optional<Span<const T>> array(Uint32 _tag) const;
+
+  /// \brief Look up a string in the string pool.
+  /// \param _offset The offset returned by BinaryWriter::add_string.
+  /// \returns The string or \c nullptr when \p _offset is out of bounds.
+  const char* string(Uint32 _offset) const;
+
+private:
+  struct Section {
+    Uint32 tag;
+    Binary::Type type;
+    Uint32 element_size;
+    Uint64 offset;
+    Uint64 size;
+  };
+
+  BinaryReader(Memory::Allocator& _allocator, Span<const Byte> _data);
+
+  const Section* find(Uint32 _tag, Binary::Type _type) const;
+
+  Span<const Byte> m_data;
+  Span<const char> m_strings;
+  Vector<Section> m_sections;
+  Uint32 m_kind;
+  Uint32 m_version;
+};
+
+inline Uint32 BinaryReader::kind() const {
+  return m_kind;
+}
+
+inline Uint32 BinaryReader::version() const {
+  return m_version;
+}
+
+template<typename T>
+Optional<Span<const T>> BinaryReader::array(Uint32 _tag) const {
+  const auto section = find(_tag, Binary::Type::ARRAY);
+  if (!section || section->element_size != sizeof(T)) {
+    return nullopt;
+  }
+
+  const auto data = m_data.data() + section->offset;
+  if (reinterpret_cast<UintPtr>(data) % alignof(T)) {
+    return nullopt;
+  }
+
+  return Span<const T>{reinterpret_cast<const T*>(data), section->size / sizeof(T)};
+}
+
+} // namespace Rx::Serialize
+
+#endif // RX_CORE_SERIALIZE_BINARY_READER_H
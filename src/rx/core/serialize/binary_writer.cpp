@@ -0,0 +1,151 @@
+#include "rx/core/serialize/binary_writer.h"
+
+namespace Rx::Serialize {
+
+BinaryWriter::BinaryWriter(Memory::Allocator& _allocator, Encoder&& encoder_,
+  Uint32 _kind, Uint32 _version)
+  : m_allocator{&_allocator}
+  , m_encoder{Utility::move(encoder_)}
+  , m_strings{_allocator}
+  , m_sections{_allocator}
+  , m_kind{_kind}
+  , m_version{_version}
+  , m_finished{false}
+{
+}
+
+BinaryWriter::BinaryWriter(BinaryWriter&& binary_writer_)
+  : m_allocator{binary_writer_.m_allocator}
+  , m_encoder{Utility::move(binary_writer_.m_encoder)}
+  , m_strings{Utility::move(binary_writer_.m_strings)}
+  , m_sections{Utility::move(binary_writer_.m_sections)}
+  , m_kind{binary_writer_.m_kind}
+  , m_version{binary_writer_.m_version}
+  , m_finished{Utility::exchange(binary_writer_.m_finished, true)}
+{
+}
+
+Optional<BinaryWriter> BinaryWriter::create(Memory::Allocator& _allocator,
+  Stream::Context& _stream, Uint32 _kind, Uint32 _version)
+{
+  auto encoder = Encoder::create(_allocator, _stream);
+  if (!encoder) {
+    return nullopt;
+  }
+
+  BinaryWriter writer{_allocator, Utility::move(*encoder), _kind, _version};
+
+  // Reserve the header, it's written by finish() once the table offset is
+  // known. A zero magic keeps an unfinished container from being read.
+  if (!writer.write_header(0, 0) || !writer.pad()) {
+    return nullopt;
+  }
+
+  return writer;
+}
+
+Optional<Uint32> BinaryWriter::add_string(const StringView& _string) {
+  RX_ASSERT(!m_finished, "already finished");
+  if (auto offset = m_strings.add(_string)) {
+    return static_cast<Uint32>(*offset);
+  }
+  return nullopt;
+}
+
+bool BinaryWriter::write_blob(Uint32 _tag, Span<const Byte> _data) {
+  return write_section(_tag, Binary::Type::BLOB, 1, _data.data(), _data.size());
+}
+
+bool BinaryWriter::finish() {
+  RX_ASSERT(!m_finished, "already finished");
+
+  const auto& strings = m_strings.data();
+  if (!strings.is_empty()) {
+    if (!write_section(Binary::STRINGS_TAG, Binary::Type::STRINGS, 1,
+      strings.data(), strings.size()))
+    {
+      return false;
+    }
+  }
+
+  auto& stream = m_encoder.stream();
+
+  const auto table_offset = stream.tell();
+  const bool wrote = m_sections.each_fwd([&](const Section& _section) {
+    return m_encoder.put_u32le(_section.tag)
+      && m_encoder.put_u8(static_cast<Uint8>(_section.type))
+      && m_encoder.put_u8(0)
+      && m_encoder.put_u16le(0)
+      && m_encoder.put_u32le(_section.element_size)
+      && m_encoder.put_u32le(0)
+      && m_encoder.put_u64le(_section.offset)
+      && m_encoder.put_u64le(_section.size);
+  });
+
+  if (!wrote) {
+    return false;
+  }
+
+  const auto size = stream.tell();
+  if (!stream.seek(0, Stream::Whence::SET) || !write_header(table_offset, size)) {
+    return false;
+  }
+
+  if (!stream.seek(size, Stream::Whence::SET) || !stream.flush()) {
+    return false;
+  }
+
+  m_finished = true;
+  return true;
+}
+
+bool BinaryWriter::write_section(Uint32 _tag, Binary::Type _type,
+  Uint32 _element_size, const Byte* _data, Uint64 _size)
+{
+  RX_ASSERT(!m_finished, "already finished");
+
+  // The table is stored as 16-bit count.
+  if (m_sections.size() == 0xffff) {
+    return false;
+  }
+
+  // Tags must be unique.
+  const bool unique = m_sections.each_fwd([&](const Section& _section) {
+    return _section.tag != _tag;
+  });
+
+  if (!unique) {
+    return false;
+  }
+
+  auto& stream = m_encoder.stream();
+  const auto offset = stream.tell();
+  if (stream.write(_data, _size) != _size || !pad()) {
+    return false;
+  }
+
+  return m_sections.emplace_back(_tag, _type, _element_size, offset, _size);
+}
+
+bool BinaryWriter::write_header(Uint64 _table_offset, Uint64 _size) {
+  const bool complete = _size != 0;
+  return m_encoder.put_u32le(complete ? Binary::MAGIC : 0)
+    && m_encoder.put_u16le(Binary::VERSION)
+    && m_encoder.put_u16le(static_cast<Uint16>(m_sections.size()))
+    && m_encoder.put_u32le(m_kind)
+    && m_encoder.put_u32le(m_version)
+    && m_encoder.put_u64le(_table_offset)
+    && m_encoder.put_u64le(_size);
+}
+
+// Pad with zeros to the next section boundary.
+bool BinaryWriter::pad() {
+  static constexpr const Byte ZERO[Binary::ALIGNMENT]{};
+
+  auto& stream = m_encoder.stream();
+  const auto offset = stream.tell();
+  const auto padding = (Binary::ALIGNMENT - offset % Binary::ALIGNMENT) % Binary::ALIGNMENT;
+  return stream.write(ZERO, padding) == padding;
+}
+
+} // namespace Rx::Serialize
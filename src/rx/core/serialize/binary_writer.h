@@ -0,0 +1,95 @@
+#ifndef RX_CORE_SERIALIZE_BINARY_WRITER_H
+#define RX_CORE_SERIALIZE_BINARY_WRITER_H
+#include "rx/core/serialize/binary_format.h"
+#include "rx/core/serialize/encoder.h"
+
+#include "rx/core/string_table.h"
+#include "rx/core/span.h"
+
+/// \file binary_writer.h
+
+namespace Rx::Serialize {
+
+/// \brief Writes a binary container.
+///
+/// Sections are streamed through an Encoder as they are written. Strings added
+/// with add_string() are pooled in a StringTable and written as a single
+/// section by finish(), which also writes the section table and fills in the
+/// header. A container is incomplete and will be rejected by BinaryReader
+/// until finish() succeeds.
+///
+/// \code{.cpp}
+///   auto writer = BinaryWriter::create(allocator, file, Binary::tag("MODL"), 1);
+///   auto name = writer->add_string("body");
+///   writer->write_array(Binary::tag("VERT"), vertices.span());
+///   writer->write_array(Binary::tag("ELEM"), elements.span());
+///   writer->finish();
+/// \endcode
+struct RX_API BinaryWriter {
+  RX_MARK_NO_COPY(BinaryWriter);
+
+  BinaryWriter(BinaryWriter&& binary_writer_);
+
+  /// \brief Create a writer.
+  /// \param _allocator The allocator for buffering, strings and the table.
+  /// \param _stream The stream to write the container to, must support WRITE.
+  /// \param _kind Tag identifying what the container holds.
+  /// \param _version Version of the contents, checked by readers to detect
+  /// stale containers.
+  /// \returns The writer on success, \c nullopt otherwise.
+  static Optional<BinaryWriter> create(Memory::Allocator& _allocator,
+    Stream::Context& _stream, Uint32 _kind, Uint32 _version);
+
+  /// \brief Add a string to the string pool.
+  /// \returns The offset of the string in the pool, \c nullopt on failure.
+  Optional<Uint32> add_string(const StringView& _string);
+
+  /// \brief Write a section of opaque bytes.
+  /// \returns \c false if the tag is already used or the write failed.
+  bool write_blob(Uint32 _tag, Span<const Byte> _data);
+
+  /// \brief Write a section holding an array of \p T.
+  /// \note \p T must be trivially copyable and have the same layout on the
+  /// reading side.
+  template<typename T>
+  bool write_array(Uint32 _tag, Span<const T> _data);
+
+  /// \brief Write the string pool and section table and complete the header.
+  /// \returns \c true on success.
+  bool finish();
+
+private:
+  BinaryWriter(Memory::Allocator& _allocator, Encoder&& encoder_, Uint32 _kind,
+    Uint32 _version);
+
+  struct Section {
+    Uint32 tag;
+    Binary::Type type;
+    Uint32 element_size;
+    Uint64 offset;
+    Uint64 size;
+  };
+
+  bool write_section(Uint32 _tag, Binary::Type _type, Uint32 _element_size,
+    const Byte* _data, Uint64 _size);
+  bool write_header(Uint64 _table_offset, Uint64 _size);
+  bool pad();
+
+  Memory::Allocator* m_allocator;
+  Encoder m_encoder;
+  StringTable m_strings;
+  Vector<Section> m_sections;
+  Uint32 m_kind;
+  Uint32 m_version;
+  bool m_finished;
+};
+
+template<typename T>
+bool BinaryWriter::write_array(Uint32 _tag, Span<const T> _data) {
+  return write_section(_tag, Binary::Type::ARRAY, sizeof(T),
+    reinterpret_cast<const Byte*>(_data.data()), _data.size() * sizeof(T));
+}
+
+} // namespace Rx::Serialize
+
+#endif // RX_CORE_SERIALIZE_BINARY_WRITER_H
@@ -2,12 +2,19 @@
 #include <string.h> // strcmp
 
 #include "rx/core/serialize/json.h"
+#include "rx/core/serialize/json_structural.h"
 #include "rx/core/concurrency/atomic.h"
+#include "rx/core/concurrency/spin_lock.h"
+#include "rx/core/concurrency/scope_lock.h"
+
+#include "rx/core/hash/fnv1a.h"
 
 #include "rx/core/math/floor.h"
 
 #include "rx/core/hints/unreachable.h"
 
+#include "rx/core/map.h"
+
 #include "lib/json.h"
 
 namespace Rx::Serialize {
@@ -46,6 +53,14 @@ static void* json_allocator(void* _user, Size _size) {
   return allocator->allocate(_size);
 }
 
+// Objects with fewer members than this are searched linearly, larger objects
+// have their members hashed into an open-addressed table on first lookup.
+static constexpr const Size HASH_THRESHOLD = 8;
+
+static inline Size hash_name(const char* _name, Size _length) {
+  return Hash::fnv1a_32(reinterpret_cast<const Byte*>(_name), _length);
+}
+
 struct JSON::Shared {
   Shared(Memory::Allocator& _allocator, const StringView& _contents);
   ~Shared();
@@ -53,17 +68,40 @@ struct JSON::Shared {
   // Shared* acquire();
   // void release();
 
+  // Open-addressed member table for a single object. The slots are never
+  // modified after the table is built so they can be probed without a lock.
+  struct Index {
+    const json_object_element_s* const* slots;
+    Size mask;
+  };
+
+  Optional<Index> index(const json_object_s* _object);
+
   Memory::Allocator& allocator;
   json_value_s* root;
   json_parse_result_s error;
   Concurrency::Atomic<Size> count;
+
+  Concurrency::SpinLock lock;
+  Map<const json_object_s*, Vector<const json_object_element_s*>> indices
+    RX_HINT_GUARDED_BY(lock);
 };
 
 JSON::Shared::Shared(Memory::Allocator& _allocator, const StringView& _contents)
   : allocator{_allocator}
   , root{nullptr}
   , count{0}
+  , indices{_allocator}
 {
+  // The structural parser handles the common case of comment free, well-formed
+  // input. Anything else goes through json.c for the extensions and errors.
+  root = json_structural_parse(allocator, _contents.data(), _contents.size());
+  if (root) {
+    error = {};
+    error.error = json_parse_error_none;
+    return;
+  }
+
   root = json_parse_ex(_contents.data(), _contents.size(),
     (json_parse_flags_allow_c_style_comments |
      json_parse_flags_allow_location_information |
@@ -78,6 +116,50 @@ JSON::Shared::~Shared() {
   allocator.deallocate(root);
 }
 
+// Finds or builds the member table for |_object|.
+Optional<JSON::Shared::Index> JSON::Shared::index(const json_object_s* _object) {
+  Concurrency::ScopeLock locked{lock};
+
+  if (auto slots = indices.find(_object)) {
+    return Index{slots->data(), slots->size() - 1};
+  }
+
+  // Keep the load factor at or below 50%.
+  Size capacity = 1;
+  while (capacity < _object->length * 2) {
+    capacity <<= 1;
+  }
+
+  Vector<const json_object_element_s*> slots{allocator};
+  if (!slots.resize(capacity, nullptr)) {
+    return nullopt;
+  }
+
+  const Size mask = capacity - 1;
+  for (auto element = _object->start; element; element = element->next) {
+    const auto name = element->name;
+    Size slot = hash_name(name->string, name->string_size) & mask;
+    while (slots[slot]) {
+      // Duplicate keys resolve to the first occurrence, same as a linear scan.
+      if (!strcmp(slots[slot]->name->string, name->string)) {
+        break;
+      }
+      slot = (slot + 1) & mask;
+    }
+    if (!slots[slot]) {
+      slots[slot] = element;
+    }
+  }
+
+  // The Vector storage does not move when |indices| is resized.
+  const auto data = slots.data();
+  if (!indices.insert(_object, Utility::move(slots))) {
+    return nullopt;
+  }
+
+  return Index{data, mask};
+}
+
 Optional<JSON> JSON::parse(Memory::Allocator& _allocator, const StringView& _contents) {
   auto shared = _allocator.create<Shared>(_allocator, _contents);
   if (!shared) {
@@ -178,6 +260,21 @@ JSON JSON::operator[](const char* _name) const {
   RX_ASSERT(is_object(), "not a object");
   const auto value = static_cast<const json_value_s*>(m_value);
   auto object = static_cast<const json_object_s*>(value->payload);
+
+  if (object->length >= HASH_THRESHOLD) {
+    if (const auto index = m_shared->index(object)) {
+      Size slot = hash_name(_name, strlen(_name)) & index->mask;
+      while (const auto element = index->slots[slot]) {
+        if (!strcmp(element->name->string, _name)) {
+          return {m_shared, element->value};
+        }
+        slot = (slot + 1) & index->mask;
+      }
+      return {};
+    }
+    // Could not build the table, fall back to the linear search.
+  }
+
   for (auto element = object->start; element; element = element->next) {
     if (!strcmp(element->name->string, _name)) {
       return {m_shared, element->value};
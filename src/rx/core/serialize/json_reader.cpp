@@ -0,0 +1,639 @@
+#include <stdlib.h> // strtod
+
+#include "rx/core/serialize/json_reader.h"
+
+#include "rx/core/algorithm/min.h"
+
+#include "rx/core/hints/likely.h"
+#include "rx/core/hints/unlikely.h"
+
+namespace Rx::Serialize {
+
+static inline bool is_whitespace(int _ch) {
+  return _ch == ' ' || _ch == '\t' || _ch == '\r' || _ch == '\n';
+}
+
+static inline bool is_digit(int _ch) {
+  return _ch >= '0' && _ch <= '9';
+}
+
+static inline bool is_unquoted_key_char(int _ch) {
+  return is_digit(_ch) || (_ch >= 'a' && _ch <= 'z')
+    || (_ch >= 'A' && _ch <= 'Z') || _ch == '_';
+}
+
+static inline int hex_value(int _ch) {
+  if (_ch >= '0' && _ch <= '9') return _ch - '0';
+  if (_ch >= 'a' && _ch <= 'f') return _ch - 'a' + 10;
+  if (_ch >= 'A' && _ch <= 'F') return _ch - 'A' + 10;
+  return -1;
+}
+
+JSONReader::JSONReader(Memory::Allocator& _allocator, Stream::Context& _stream)
+  : m_allocator{&_allocator}
+  , m_stream{&_stream}
+  , m_window{_allocator}
+  , m_stream_offset{0}
+  , m_cursor{0}
+  , m_length{0}
+  , m_scratch{_allocator}
+  , m_stack{_allocator}
+  , m_error_offset{0}
+  , m_error{nullptr}
+  , m_number{0.0}
+  , m_boolean{false}
+  , m_eos{false}
+  , m_expect{Expect::VALUE}
+  , m_token{Token::NIL}
+{
+}
+
+JSONReader::JSONReader(JSONReader&& reader_)
+  : m_allocator{reader_.m_allocator}
+  , m_stream{Utility::exchange(reader_.m_stream, nullptr)}
+  , m_window{Utility::move(reader_.m_window)}
+  , m_stream_offset{Utility::exchange(reader_.m_stream_offset, 0)}
+  , m_cursor{Utility::exchange(reader_.m_cursor, 0)}
+  , m_length{Utility::exchange(reader_.m_length, 0)}
+  , m_scratch{Utility::move(reader_.m_scratch)}
+  , m_stack{Utility::move(reader_.m_stack)}
+  , m_error_offset{Utility::exchange(reader_.m_error_offset, 0)}
+  , m_error{Utility::exchange(reader_.m_error, nullptr)}
+  , m_number{Utility::exchange(reader_.m_number, 0.0)}
+  , m_boolean{Utility::exchange(reader_.m_boolean, false)}
+  , m_eos{Utility::exchange(reader_.m_eos, true)}
+  , m_expect{Utility::exchange(reader_.m_expect, Expect::DONE)}
+  , m_token{Utility::exchange(reader_.m_token, Token::END)}
+{
+}
+
+JSONReader& JSONReader::operator=(JSONReader&& reader_) {
+  if (this != &reader_) {
+    m_allocator = reader_.m_allocator;
+    m_stream = Utility::exchange(reader_.m_stream, nullptr);
+    m_window = Utility::move(reader_.m_window);
+    m_stream_offset = Utility::exchange(reader_.m_stream_offset, 0);
+    m_cursor = Utility::exchange(reader_.m_cursor, 0);
+    m_length = Utility::exchange(reader_.m_length, 0);
+    m_scratch = Utility::move(reader_.m_scratch);
+    m_stack = Utility::move(reader_.m_stack);
+    m_error_offset = Utility::exchange(reader_.m_error_offset, 0);
+    m_error = Utility::exchange(reader_.m_error, nullptr);
+    m_number = Utility::exchange(reader_.m_number, 0.0);
+    m_boolean = Utility::exchange(reader_.m_boolean, false);
+    m_eos = Utility::exchange(reader_.m_eos, true);
+    m_expect = Utility::exchange(reader_.m_expect, Expect::DONE);
+    m_token = Utility::exchange(reader_.m_token, Token::END);
+  }
+  return *this;
+}
+
+Optional<JSONReader> JSONReader::create(Memory::Allocator& _allocator,
+  Stream::Context& _stream)
+{
+  if (!(_stream.flags() & Stream::READ)) {
+    // Stream does not support reading from.
+    return nullopt;
+  }
+
+  JSONReader result{_allocator, _stream};
+  if (!result.m_window.resize(WINDOW_SIZE)) {
+    return nullopt;
+  }
+
+  // Skip the UTF-8 BOM if present.
+  if (result.refill() && result.m_length >= 3) {
+    const auto data = result.m_window.data();
+    if (data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+      result.m_cursor = 3;
+    }
+  }
+
+  return result;
+}
+
+// Slides the window forward to the next unread region of the stream. Returns
+// false when the end of the stream is reached.
+bool JSONReader::refill() {
+  if (m_eos) {
+    return false;
+  }
+
+  m_stream_offset += m_length;
+  m_cursor = 0;
+  m_length = m_stream->on_read(m_window.data(), WINDOW_SIZE, m_stream_offset);
+
+  if (m_length == 0) {
+    m_eos = true;
+    return false;
+  }
+
+  return true;
+}
+
+RX_HINT_FORCE_INLINE int JSONReader::peek() {
+  if (RX_HINT_UNLIKELY(m_cursor == m_length) && !refill()) {
+    return -1;
+  }
+  return m_window[m_cursor];
+}
+
+RX_HINT_FORCE_INLINE void JSONReader::advance() {
+  m_cursor++;
+}
+
+bool JSONReader::push_scratch(char _ch) {
+  return m_scratch.push_back(static_cast<Byte>(_ch));
+}
+
+bool JSONReader::terminate_scratch() {
+  return m_scratch.push_back(0);
+}
+
+JSONReader::Token JSONReader::fail(const char* _message) {
+  m_error = _message;
+  m_error_offset = m_stream_offset + m_cursor;
+  m_expect = Expect::DONE;
+  return m_token = Token::ERROR;
+}
+
+JSONReader::Token JSONReader::after_value(Token _token) {
+  m_expect = m_stack.is_empty() ? Expect::DONE : Expect::COMMA_OR_END;
+  return m_token = _token;
+}
+
+JSONReader::Token JSONReader::close(Byte _container, Token _token) {
+  if (m_stack.is_empty() || m_stack.last() != _container) {
+    return fail("expected a comma, closing '}', or ']'");
+  }
+  advance();
+  m_stack.pop_back();
+  return after_value(_token);
+}
+
+bool JSONReader::skip_comment() {
+  // Skip the leading '/'.
+  advance();
+
+  const int ch = peek();
+  if (ch == '/') {
+    // Comment of the form "//", ends at newline or end of stream.
+    advance();
+    for (int ch = peek(); ch != -1; ch = peek()) {
+      advance();
+      if (ch == '\n') {
+        break;
+      }
+    }
+    return true;
+  } else if (ch == '*') {
+    // Comment of the form "/* */".
+    advance();
+    bool star = false;
+    for (int ch = peek(); ch != -1; ch = peek()) {
+      advance();
+      if (star && ch == '/') {
+        return true;
+      }
+      star = ch == '*';
+    }
+    m_error = "premature end of buffer";
+    return false;
+  }
+
+  m_error = "invalid value";
+  return false;
+}
+
+bool JSONReader::skip_skippables() {
+  for (int ch = peek(); ch != -1; ch = peek()) {
+    if (is_whitespace(ch)) {
+      // Consume the whitespace run in the window without going through peek.
+      const Byte* data = m_window.data();
+      while (++m_cursor < m_length && is_whitespace(data[m_cursor]));
+    } else if (ch == '/') {
+      if (!skip_comment()) {
+        return false;
+      }
+    } else {
+      break;
+    }
+  }
+  return true;
+}
+
+JSONReader::Token JSONReader::read_string(Token _token, char _quote) {
+  // Skip the opening quote.
+  advance();
+
+  m_scratch.clear();
+
+  for (;;) {
+    if (RX_HINT_UNLIKELY(peek() == -1)) {
+      return fail("premature end of buffer");
+    }
+
+    // Copy the run of unescaped characters in the window in one go. Raw
+    // newlines are permitted since multi-line strings are allowed.
+    const Byte* data = m_window.data();
+    Size end = m_cursor;
+    while (end < m_length && data[end] != _quote && data[end] != '\\') {
+      end++;
+    }
+
+    if (!m_scratch.append(data + m_cursor, end - m_cursor)) {
+      return fail("out of memory");
+    }
+
+    m_cursor = end;
+    if (end == m_length) {
+      // Run continues into the next window.
+      continue;
+    }
+
+    advance();
+
+    if (data[end] == _quote) {
+      break;
+    }
+
+    int ch = peek();
+    if (ch == -1) {
+      return fail("premature end of buffer");
+    }
+
+    advance();
+
+    char escaped = 0;
+    switch (ch) {
+    case '"':
+      [[fallthrough]];
+    case '\\':
+      [[fallthrough]];
+    case '/':
+      escaped = static_cast<char>(ch);
+      break;
+    case 'b':
+      escaped = '\b';
+      break;
+    case 'f':
+      escaped = '\f';
+      break;
+    case 'n':
+      escaped = '\n';
+      break;
+    case 'r':
+      escaped = '\r';
+      break;
+    case 't':
+      escaped = '\t';
+      break;
+    case 'u':
+      break;
+    default:
+      return fail("invalid string escape sequence");
+    }
+
+    if (escaped) {
+      if (!push_scratch(escaped)) {
+        return fail("out of memory");
+      }
+      continue;
+    }
+
+    auto read_hex4 = [this]() -> Sint32 {
+      Sint32 value = 0;
+      for (Size i = 0; i < 4; i++) {
+        const int digit = hex_value(peek());
+        if (digit < 0) {
+          return -1;
+        }
+        advance();
+        value = (value << 4) | digit;
+      }
+      return value;
+    };
+
+    Sint32 codepoint = read_hex4();
+    if (codepoint < 0) {
+      return fail("invalid string escape sequence");
+    }
+
+    if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+      // High surrogate must be followed by an escaped low surrogate.
+      if (peek() != '\\') {
+        return fail("invalid string escape sequence");
+      }
+      advance();
+      if (peek() != 'u') {
+        return fail("invalid string escape sequence");
+      }
+      advance();
+      const Sint32 low = read_hex4();
+      if (low < 0xDC00 || low > 0xDFFF) {
+        return fail("invalid string escape sequence");
+      }
+      codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+    } else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+      return fail("invalid string escape sequence");
+    }
+
+    // Encode |codepoint| as UTF-8.
+    bool result = true;
+    if (codepoint < 0x80) {
+      result &= push_scratch(static_cast<char>(codepoint));
+    } else if (codepoint < 0x800) {
+      result &= push_scratch(static_cast<char>(0xC0 | (codepoint >> 6)));
+      result &= push_scratch(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else if (codepoint < 0x10000) {
+      result &= push_scratch(static_cast<char>(0xE0 | (codepoint >> 12)));
+      result &= push_scratch(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+      result &= push_scratch(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else {
+      result &= push_scratch(static_cast<char>(0xF0 | (codepoint >> 18)));
+      result &= push_scratch(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+      result &= push_scratch(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+      result &= push_scratch(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    }
+
+    if (!result) {
+      return fail("out of memory");
+    }
+  }
+
+  if (!terminate_scratch()) {
+    return fail("out of memory");
+  }
+
+  if (_token == Token::KEY) {
+    m_expect = Expect::COLON;
+    return m_token = Token::KEY;
+  }
+
+  return after_value(_token);
+}
+
+JSONReader::Token JSONReader::read_unquoted_key() {
+  m_scratch.clear();
+  for (int ch = peek(); is_unquoted_key_char(ch); ch = peek()) {
+    if (!push_scratch(static_cast<char>(ch))) {
+      return fail("out of memory");
+    }
+    advance();
+  }
+
+  if (!terminate_scratch()) {
+    return fail("out of memory");
+  }
+
+  m_expect = Expect::COLON;
+  return m_token = Token::KEY;
+}
+
+JSONReader::Token JSONReader::read_number() {
+  m_scratch.clear();
+
+  // Collect the characters which can make up a number, then validate.
+  for (int ch = peek(); ch != -1; ch = peek()) {
+    if (!is_digit(ch) && ch != '-' && ch != '+' && ch != '.'
+      && ch != 'e' && ch != 'E')
+    {
+      break;
+    }
+    if (!push_scratch(static_cast<char>(ch))) {
+      return fail("out of memory");
+    }
+    advance();
+  }
+
+  if (!terminate_scratch()) {
+    return fail("out of memory");
+  }
+
+  // Validate: -?[0-9]+(\.[0-9]+)?([eE][+-]?[0-9]+)?
+  const char* s = reinterpret_cast<const char*>(m_scratch.data());
+  if (*s == '-') {
+    s++;
+  }
+  if (!is_digit(*s)) {
+    return fail("invalid number formatting");
+  }
+  while (is_digit(*s)) {
+    s++;
+  }
+  if (*s == '.') {
+    s++;
+    if (!is_digit(*s)) {
+      return fail("invalid number formatting");
+    }
+    while (is_digit(*s)) {
+      s++;
+    }
+  }
+  if (*s == 'e' || *s == 'E') {
+    s++;
+    if (*s == '+' || *s == '-') {
+      s++;
+    }
+    if (!is_digit(*s)) {
+      return fail("invalid number formatting");
+    }
+    while (is_digit(*s)) {
+      s++;
+    }
+  }
+  if (*s != '\0') {
+    return fail("invalid number formatting");
+  }
+
+  m_number = strtod(reinterpret_cast<const char*>(m_scratch.data()), nullptr);
+
+  return after_value(Token::NUMBER);
+}
+
+JSONReader::Token JSONReader::read_literal(const char* _literal, Token _token,
+  bool _value)
+{
+  for (const char* ch = _literal; *ch; ch++) {
+    if (peek() != *ch) {
+      return fail("invalid value");
+    }
+    advance();
+  }
+  m_boolean = _value;
+  return after_value(_token);
+}
+
+JSONReader::Token JSONReader::next() {
+  if (m_token == Token::END || m_token == Token::ERROR) {
+    return m_token;
+  }
+
+  for (;;) {
+    if (!skip_skippables()) {
+      return fail(m_error);
+    }
+
+    const int ch = peek();
+
+    if (m_expect == Expect::DONE) {
+      return ch == -1
+        ? m_token = Token::END
+        : fail("unexpected trailing characters");
+    }
+
+    if (ch == -1) {
+      return fail("premature end of buffer");
+    }
+
+    switch (m_expect) {
+    case Expect::COLON:
+      if (ch != ':') {
+        return fail("expected a colon");
+      }
+      advance();
+      m_expect = Expect::VALUE;
+      continue;
+    case Expect::COMMA_OR_END:
+      if (ch == ',') {
+        advance();
+        m_expect = m_stack.last() == '{' ? Expect::KEY : Expect::VALUE;
+        continue;
+      } else if (ch == '}') {
+        return close('{', Token::END_OBJECT);
+      } else if (ch == ']') {
+        return close('[', Token::END_ARRAY);
+      }
+      return fail("expected a comma, closing '}', or ']'");
+    case Expect::KEY_OR_END:
+      if (ch == '}') {
+        return close('{', Token::END_OBJECT);
+      }
+      [[fallthrough]];
+    case Expect::KEY:
+      if (ch == '"') {
+        return read_string(Token::KEY, '"');
+      } else if (is_unquoted_key_char(ch)) {
+        return read_unquoted_key();
+      }
+      return fail("expected opening quote '\"'");
+    case Expect::VALUE_OR_END:
+      if (ch == ']') {
+        return close('[', Token::END_ARRAY);
+      }
+      [[fallthrough]];
+    case Expect::VALUE:
+      switch (ch) {
+      case '{':
+        advance();
+        if (!m_stack.push_back('{')) {
+          return fail("out of memory");
+        }
+        m_expect = Expect::KEY_OR_END;
+        return m_token = Token::BEGIN_OBJECT;
+      case '[':
+        advance();
+        if (!m_stack.push_back('[')) {
+          return fail("out of memory");
+        }
+        m_expect = Expect::VALUE_OR_END;
+        return m_token = Token::BEGIN_ARRAY;
+      case '"':
+        return read_string(Token::STRING, '"');
+      case 't':
+        return read_literal("true", Token::BOOLEAN, true);
+      case 'f':
+        return read_literal("false", Token::BOOLEAN, false);
+      case 'n':
+        return read_literal("null", Token::NIL, false);
+      default:
+        if (ch == '-' || is_digit(ch)) {
+          return read_number();
+        }
+        return fail("invalid value");
+      }
+    case Expect::DONE:
+      break;
+    }
+
+    return fail("unknown error");
+  }
+}
+
+bool JSONReader::skip() {
+  switch (m_token) {
+  case Token::BEGIN_OBJECT:
+    [[fallthrough]];
+  case Token::BEGIN_ARRAY:
+    {
+      // Consume tokens until the container opened by the last token closes.
+      const Size depth = m_stack.size();
+      while (m_stack.size() >= depth) {
+        const auto token = next();
+        if (token == Token::ERROR || token == Token::END) {
+          return false;
+        }
+      }
+    }
+    return true;
+  case Token::KEY:
+    switch (next()) {
+    case Token::ERROR:
+      return false;
+    case Token::BEGIN_OBJECT:
+      [[fallthrough]];
+    case Token::BEGIN_ARRAY:
+      return skip();
+    default:
+      return true;
+    }
+  case Token::ERROR:
+    return false;
+  default:
+    return true;
+  }
+}
+
+StringView JSONReader::as_string() const {
+  RX_ASSERT(m_token == Token::KEY || m_token == Token::STRING,
+    "not a key or string");
+  return reinterpret_cast<const char*>(m_scratch.data());
+}
+
+Float64 JSONReader::as_number() const {
+  RX_ASSERT(m_token == Token::NUMBER, "not a number");
+  return m_number;
+}
+
+Optional<String> JSONReader::error() const {
+  if (m_token != Token::ERROR) {
+    return nullopt;
+  }
+
+  // Line and column information is not tracked while reading since it's only
+  // needed here. Recover it by scanning the stream up to the error instead.
+  Size line = 1;
+  Size column = 1;
+  Byte buffer[WINDOW_SIZE];
+  for (Uint64 offset = 0; offset < m_error_offset; ) {
+    const auto size = Algorithm::min(m_error_offset - offset, Uint64(sizeof buffer));
+    const auto read = m_stream->on_read(buffer, size, offset);
+    if (read == 0) {
+      break;
+    }
+    for (Uint64 i = 0; i < read; i++) {
+      if (buffer[i] == '\n') {
+        line++;
+        column = 1;
+      } else {
+        column++;
+      }
+    }
+    offset += read;
+  }
+
+  return String::format(*m_allocator, "%zu:%zu %s", line, column,
+    m_error ? m_error : "unknown error");
+}
+
+} // namespace Rx::Serialize
@@ -0,0 +1,163 @@
+#ifndef RX_CORE_SERIALIZE_JSON_READER_H
+#define RX_CORE_SERIALIZE_JSON_READER_H
+#include "rx/core/stream/context.h"
+#include "rx/core/string.h"
+#include "rx/core/vector.h"
+
+/// \file json_reader.h
+
+namespace Rx::Serialize {
+
+/// \brief Streaming, pull-style JSON reader.
+///
+/// A JSONReader tokenizes JSON directly from a Stream::Context through a small
+/// fixed-size window without materializing a document. Each call to next()
+/// produces the next token in document order. The only memory used is the
+/// window, a scratch buffer the size of the largest string or number token
+/// and a nesting stack.
+///
+/// The same JSON5 extensions accepted by JSON::parse are accepted here:
+///  * C-style comments.
+///  * Unquoted object keys.
+///  * Multi-line strings.
+struct RX_API JSONReader {
+  RX_MARK_NO_COPY(JSONReader);
+
+  /// Size of the stream window in bytes.
+  static inline constexpr const Size WINDOW_SIZE = 4096;
+
+  enum class Token : Uint8 {
+    BEGIN_OBJECT, ///< Start of an object '{'.
+    END_OBJECT,   ///< End of an object '}'.
+    BEGIN_ARRAY,  ///< Start of an array '['.
+    END_ARRAY,    ///< End of an array ']'.
+    KEY,          ///< Object member name, available through as_string().
+    STRING,       ///< String value, available through as_string().
+    NUMBER,       ///< Number value, available through as_number().
+    BOOLEAN,      ///< Boolean value, available through as_boolean().
+    NIL,          ///< Null value.
+    END,          ///< End of the document.
+    ERROR         ///< Malformed document, see error().
+  };
+
+  JSONReader(JSONReader&& reader_);
+  JSONReader& operator=(JSONReader&& reader_);
+
+  /// \brief Create a reader over a stream.
+  /// \param _allocator The allocator to use for the window and scratch space.
+  /// \param _stream The stream to read from, must support READ.
+  /// \returns The reader on success, \c nullopt otherwise.
+  static Optional<JSONReader> create(Memory::Allocator& _allocator,
+    Stream::Context& _stream);
+
+  /// \brief Advance to the next token.
+  /// \note Once END or ERROR is returned, every subsequent call returns the
+  /// same token.
+  Token next();
+
+  /// \brief Skip the value that begins with the last token.
+  ///
+  /// When the last token was BEGIN_OBJECT or BEGIN_ARRAY this consumes tokens
+  /// up to and including the matching END_OBJECT or END_ARRAY. When the last
+  /// token was KEY, the member value is skipped. Otherwise does nothing.
+  ///
+  /// \returns \c false if an error was encountered while skipping.
+  bool skip();
+
+  /// The contents of the last KEY or STRING token.
+  /// \warning Only valid until the next call to next().
+  StringView as_string() const;
+  /// The value of the last NUMBER token.
+  Float64 as_number() const;
+  /// The value of the last NUMBER token as a float.
+  Float32 as_float() const;
+  /// The value of the last BOOLEAN token.
+  bool as_boolean() const;
+
+  /// Current nesting depth of objects and arrays.
+  Size depth() const;
+
+  /// The last token returned by next().
+  Token token() const;
+
+  /// Human readable error when next() returned ERROR.
+  Optional<String> error() const;
+
+private:
+  JSONReader(Memory::Allocator& _allocator, Stream::Context& _stream);
+
+  // What the grammar expects at the current position.
+  enum class Expect : Uint8 {
+    VALUE,            // Any value.
+    VALUE_OR_END,     // Any value or ']', after '['.
+    KEY,              // Object key, after ',' in object.
+    KEY_OR_END,       // Object key or '}', after '{'.
+    COLON,            // ':' after key.
+    COMMA_OR_END,     // ',' or closing bracket of container.
+    DONE              // Top-level value consumed.
+  };
+
+  bool refill();
+  int peek();
+  void advance();
+
+  bool skip_skippables();
+  bool skip_comment();
+
+  Token read_string(Token _token, char _quote);
+  Token read_unquoted_key();
+  Token read_number();
+  Token read_literal(const char* _literal, Token _token, bool _value);
+
+  Token fail(const char* _message);
+  Token close(Byte _container, Token _token);
+  Token after_value(Token _token);
+
+  bool push_scratch(char _ch);
+  bool terminate_scratch();
+
+  Memory::Allocator* m_allocator;
+  Stream::Context* m_stream;
+
+  // Sliding window into |m_stream|.
+  LinearBuffer m_window;
+  Uint64 m_stream_offset;
+  Size m_cursor;
+  Size m_length;
+
+  // Token contents for strings, keys and numbers.
+  LinearBuffer m_scratch;
+
+  // Stack of open containers, either '{' or '['.
+  Vector<Byte> m_stack;
+
+  // Stream offset of the error, line and column are computed from it lazily.
+  Uint64 m_error_offset;
+  const char* m_error;
+  Float64 m_number;
+  bool m_boolean;
+  bool m_eos;
+  Expect m_expect;
+  Token m_token;
+};
+
+inline Float32 JSONReader::as_float() const {
+  return static_cast<Float32>(as_number());
+}
+
+inline bool JSONReader::as_boolean() const {
+  RX_ASSERT(m_token == Token::BOOLEAN, "not a boolean");
+  return m_boolean;
+}
+
+inline Size JSONReader::depth() const {
+  return m_stack.size();
+}
+
+inline JSONReader::Token JSONReader::token() const {
+  return m_token;
+}
+
+} // namespace Rx::Serialize
+
+#endif // RX_CORE_SERIALIZE_JSON_READER_H
@@ -0,0 +1,790 @@
+#include <string.h> // memcpy, memcmp, memset
+
+#include "rx/core/serialize/json_structural.h"
+#include "rx/core/memory/allocator.h"
+
+#include "rx/core/utility/bit.h"
+
+#include "rx/core/vector.h"
+
+#include "lib/json.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__PCLMUL__) && defined(RX_ARCHITECTURE_AMD64)
+#include <wmmintrin.h>
+#endif
+
+namespace Rx::Serialize {
+
+static constexpr const Uint64 EVEN_BITS = 0x5555555555555555_u64;
+static constexpr const Uint64 ODD_BITS = ~EVEN_BITS;
+
+// One bit per byte of a 64-byte block for each character class of interest.
+struct Block {
+  Uint64 quote;
+  Uint64 backslash;
+  Uint64 op;
+  Uint64 whitespace;
+  Uint64 slash;
+};
+
+#if defined(__SSE2__)
+static inline Uint64 match(__m128i _bytes, char _ch, Size _shift) {
+  const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_bytes, _mm_set1_epi8(_ch)));
+  return static_cast<Uint64>(static_cast<Uint16>(mask)) << _shift;
+}
+#endif
+
+static void classify(const Byte* _data, Block& block_) {
+  block_ = {};
+#if defined(__SSE2__)
+  // '[' and ']' only differ from '{' and '}' in bit 5, setting it lets one
+  // compare match both brackets.
+  const __m128i fold = _mm_set1_epi8(0x20);
+  for (Size i = 0; i < 64; i += 16) {
+    const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_data + i));
+    const auto folded = _mm_or_si128(bytes, fold);
+    block_.quote |= match(bytes, '"', i);
+    block_.backslash |= match(bytes, '\\', i);
+    block_.op |= match(folded, '{', i) | match(folded, '}', i)
+      | match(bytes, ':', i) | match(bytes, ',', i);
+    block_.whitespace |= match(bytes, ' ', i) | match(bytes, '\t', i)
+      | match(bytes, '\n', i) | match(bytes, '\r', i);
+    block_.slash |= match(bytes, '/', i);
+  }
+#else
+  for (Size i = 0; i < 64; i++) {
+    const Uint64 bit = 1_u64 << i;
+    switch (_data[i]) {
+    case '"':
+      block_.quote |= bit;
+      break;
+    case '\\':
+      block_.backslash |= bit;
+      break;
+    case '{':
+      [[fallthrough]];
+    case '}':
+      [[fallthrough]];
+    case '[':
+      [[fallthrough]];
+    case ']':
+      [[fallthrough]];
+    case ':':
+      [[fallthrough]];
+    case ',':
+      block_.op |= bit;
+      break;
+    case ' ':
+      [[fallthrough]];
+    case '\t':
+      [[fallthrough]];
+    case '\n':
+      [[fallthrough]];
+    case '\r':
+      block_.whitespace |= bit;
+      break;
+    case '/':
+      block_.slash |= bit;
+      break;
+    }
+  }
+#endif
+}
+
+static inline bool add_overflow(Uint64 _lhs, Uint64 _rhs, Uint64& result_) {
+#if defined(RX_COMPILER_GCC) || defined(RX_COMPILER_CLANG)
+  unsigned long long result;
+  const bool overflow = __builtin_uaddll_overflow(_lhs, _rhs, &result);
+  result_ = result;
+  return overflow;
+#else
+  result_ = _lhs + _rhs;
+  return result_ < _lhs;
+#endif
+}
+
+// Bit i of the result is the xor of bits [0, i] of |_bits|. Applied to the
+// quote mask this gives a mask of the bytes inside strings, including the
+// opening quote and excluding the closing quote.
+static inline Uint64 prefix_xor(Uint64 _bits) {
+#if defined(__PCLMUL__) && defined(RX_ARCHITECTURE_AMD64)
+  const __m128i bits = _mm_set_epi64x(0, static_cast<Sint64>(_bits));
+  const __m128i ones = _mm_set1_epi8(static_cast<char>(0xFF));
+  return static_cast<Uint64>(_mm_cvtsi128_si64(_mm_clmulepi64_si128(bits, ones, 0)));
+#else
+  _bits ^= _bits << 1;
+  _bits ^= _bits << 2;
+  _bits ^= _bits << 4;
+  _bits ^= _bits << 8;
+  _bits ^= _bits << 16;
+  _bits ^= _bits << 32;
+  return _bits;
+#endif
+}
+
+// Find the bytes escaped by a backslash. Only the end of an odd length run of
+// backslashes escapes the byte that follows it. Runs are found by adding the
+// run starts to the backslash mask and letting the carry ripple through, the
+// parity of the start and end positions tells if the run was odd. |carry_|
+// holds whether the previous block ended in an odd run.
+static inline Uint64 find_escaped(Uint64 _backslash, Uint64& carry_) {
+  const Uint64 starts = _backslash & ~(_backslash << 1);
+  const Uint64 even_start_mask = EVEN_BITS ^ carry_;
+  const Uint64 even_starts = starts & even_start_mask;
+  const Uint64 odd_starts = starts & ~even_start_mask;
+
+  const Uint64 even_carries = _backslash + even_starts;
+
+  Uint64 odd_carries;
+  const bool overflow = add_overflow(_backslash, odd_starts, odd_carries);
+  odd_carries |= carry_;
+  carry_ = overflow ? 1 : 0;
+
+  const Uint64 even_carry_ends = even_carries & ~_backslash;
+  const Uint64 odd_carry_ends = odd_carries & ~_backslash;
+
+  return (even_carry_ends & ODD_BITS) | (odd_carry_ends & EVEN_BITS);
+}
+
+// Stage one, produces the offsets of all structural characters.
+static bool index_structurals(const char* _data, Size _size,
+  Vector<Uint32>& indices_)
+{
+  alignas(16) Byte tail[64];
+
+  Uint64 escape_carry = 0;
+  Uint64 in_string_carry = 0;
+  Uint64 scalar_carry = 0;
+
+  Size count = 0;
+  for (Size offset = 0; offset < _size; offset += 64) {
+    auto data = reinterpret_cast<const Byte*>(_data) + offset;
+
+    // Pad the final partial block with whitespace.
+    if (_size - offset < 64) {
+      memset(tail, ' ', sizeof tail);
+      memcpy(tail, data, _size - offset);
+      data = tail;
+    }
+
+    Block block;
+    classify(data, block);
+
+    const Uint64 escaped = find_escaped(block.backslash, escape_carry);
+    const Uint64 quote = block.quote & ~escaped;
+    const Uint64 in_string = prefix_xor(quote) ^ in_string_carry;
+    in_string_carry = static_cast<Uint64>(static_cast<Sint64>(in_string) >> 63);
+
+    // Comments are left to the reference parser.
+    if (RX_HINT_UNLIKELY(block.slash & ~in_string)) {
+      return false;
+    }
+
+    // Every run of bytes which are not whitespace, operators or quotes is a
+    // bare scalar, only the first byte of the run is structural.
+    const Uint64 scalar = ~(block.op | block.whitespace | block.quote);
+    const Uint64 follows_scalar = (scalar << 1) | scalar_carry;
+    scalar_carry = scalar >> 63;
+
+    Uint64 structurals = ((block.op | (scalar & ~follows_scalar)) & ~in_string)
+      | (quote & in_string);
+
+    // Each block contributes at most 64 indices.
+    if (count + 64 > indices_.size() && !indices_.resize(indices_.size() * 2 + 64)) {
+      return false;
+    }
+
+    auto output = indices_.data() + count;
+    while (structurals) {
+      *output++ = static_cast<Uint32>(offset + bit_search_lsb(structurals));
+      structurals &= structurals - 1;
+    }
+    count = output - indices_.data();
+  }
+
+  // Unterminated string.
+  if (in_string_carry) {
+    return false;
+  }
+
+  return indices_.resize(count);
+}
+
+static inline bool is_digit(char _ch) {
+  return _ch >= '0' && _ch <= '9';
+}
+
+static inline bool is_key(char _ch) {
+  return is_digit(_ch) || (_ch >= 'a' && _ch <= 'z')
+    || (_ch >= 'A' && _ch <= 'Z') || _ch == '_';
+}
+
+static inline bool is_scalar(char _ch) {
+  switch (_ch) {
+  case ' ':
+    [[fallthrough]];
+  case '\t':
+    [[fallthrough]];
+  case '\n':
+    [[fallthrough]];
+  case '\r':
+    [[fallthrough]];
+  case '{':
+    [[fallthrough]];
+  case '}':
+    [[fallthrough]];
+  case '[':
+    [[fallthrough]];
+  case ']':
+    [[fallthrough]];
+  case ':':
+    [[fallthrough]];
+  case ',':
+    [[fallthrough]];
+  case '"':
+    return false;
+  }
+  return true;
+}
+
+static bool hex4(const char* _data, Uint32& value_) {
+  Uint32 value = 0;
+  for (Size i = 0; i < 4; i++) {
+    const char ch = _data[i];
+    value <<= 4;
+    if (ch >= '0' && ch <= '9') {
+      value |= ch - '0';
+    } else if (ch >= 'a' && ch <= 'f') {
+      value |= ch - 'a' + 10;
+    } else if (ch >= 'A' && ch <= 'F') {
+      value |= ch - 'A' + 10;
+    } else {
+      return false;
+    }
+  }
+  value_ = value;
+  return true;
+}
+
+// Count the bytes before the next quote or backslash.
+static inline Size scan_string(const char* _data, const char* _end) {
+  const char* data = _data;
+#if defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  for (; _end - data >= 16; data += 16) {
+    const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    const int mask = _mm_movemask_epi8(_mm_or_si128(
+      _mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)));
+    if (mask) {
+      return (data - _data) + bit_search_lsb(static_cast<Uint32>(mask));
+    }
+  }
+#endif
+  for (; data != _end && *data != '"' && *data != '\\'; data++);
+  return data - _data;
+}
+
+// Stage two, builds the DOM from the structural indices.
+struct Builder {
+  template<typename T>
+  T* make();
+
+  char peek() const;
+
+  bool parse_value(json_value_s* value_);
+  bool parse_object(json_value_s* value_);
+  bool parse_array(json_value_s* value_);
+  bool parse_string(json_string_s* string_);
+  bool parse_key(json_string_s* string_);
+  bool parse_number(json_number_s* number_);
+  bool parse_literal(const char* _literal, Size _length);
+
+  const char* data;
+  Size size;
+  const Uint32* indices;
+  Size count;
+  Size cursor;
+
+  Byte* dom;
+  Byte* dom_end;
+  char* text;
+};
+
+template<typename T>
+T* Builder::make() {
+  if (RX_HINT_UNLIKELY(dom_end - dom < static_cast<PtrDiff>(sizeof(T)))) {
+    return nullptr;
+  }
+  auto result = reinterpret_cast<T*>(dom);
+  dom += sizeof(T);
+  return result;
+}
+
+char Builder::peek() const {
+  return cursor < count ? data[indices[cursor]] : '\0';
+}
+
+bool Builder::parse_value(json_value_s* value_) {
+  if (cursor >= count) {
+    return false;
+  }
+
+  switch (data[indices[cursor]]) {
+  case '{':
+    return parse_object(value_);
+  case '[':
+    return parse_array(value_);
+  case '"':
+    if (auto string = make<json_string_s>()) {
+      value_->type = json_type_string;
+      value_->payload = string;
+      return parse_string(string);
+    }
+    return false;
+  case '-':
+    [[fallthrough]];
+  case '0':
+    [[fallthrough]];
+  case '1':
+    [[fallthrough]];
+  case '2':
+    [[fallthrough]];
+  case '3':
+    [[fallthrough]];
+  case '4':
+    [[fallthrough]];
+  case '5':
+    [[fallthrough]];
+  case '6':
+    [[fallthrough]];
+  case '7':
+    [[fallthrough]];
+  case '8':
+    [[fallthrough]];
+  case '9':
+    if (auto number = make<json_number_s>()) {
+      value_->type = json_type_number;
+      value_->payload = number;
+      return parse_number(number);
+    }
+    return false;
+  case 't':
+    value_->type = json_type_true;
+    value_->payload = nullptr;
+    return parse_literal("true", 4);
+  case 'f':
+    value_->type = json_type_false;
+    value_->payload = nullptr;
+    return parse_literal("false", 5);
+  case 'n':
+    value_->type = json_type_null;
+    value_->payload = nullptr;
+    return parse_literal("null", 4);
+  }
+
+  return false;
+}
+
+bool Builder::parse_object(json_value_s* value_) {
+  auto object = make<json_object_s>();
+  if (!object) {
+    return false;
+  }
+
+  object->start = nullptr;
+  object->length = 0;
+
+  value_->type = json_type_object;
+  value_->payload = object;
+
+  // Skip '{'.
+  cursor++;
+
+  if (peek() == '}') {
+    cursor++;
+    return true;
+  }
+
+  json_object_element_s* last = nullptr;
+  for (;;) {
+    // Every key must be followed by a colon.
+    if (cursor + 1 >= count || data[indices[cursor + 1]] != ':') {
+      return false;
+    }
+
+    auto element = make<json_object_element_s>();
+    auto name = make<json_string_s>();
+    if (!element || !name) {
+      return false;
+    }
+
+    const bool quoted = peek() == '"';
+    if (!(quoted ? parse_string(name) : parse_key(name))) {
+      return false;
+    }
+
+    // Skip ':'.
+    cursor++;
+
+    auto value = make<json_value_s>();
+    if (!value || !parse_value(value)) {
+      return false;
+    }
+
+    element->name = name;
+    element->value = value;
+    element->next = nullptr;
+
+    if (last) {
+      last->next = element;
+    } else {
+      object->start = element;
+    }
+    last = element;
+    object->length++;
+
+    const char separator = peek();
+    cursor++;
+    if (separator == '}') {
+      return true;
+    } else if (separator != ',') {
+      return false;
+    }
+  }
+}
+
+bool Builder::parse_array(json_value_s* value_) {
+  auto array = make<json_array_s>();
+  if (!array) {
+    return false;
+  }
+
+  array->start = nullptr;
+  array->length = 0;
+
+  value_->type = json_type_array;
+  value_->payload = array;
+
+  // Skip '['.
+  cursor++;
+
+  if (peek() == ']') {
+    cursor++;
+    return true;
+  }
+
+  json_array_element_s* last = nullptr;
+  for (;;) {
+    auto element = make<json_array_element_s>();
+    auto value = make<json_value_s>();
+    if (!element || !value || !parse_value(value)) {
+      return false;
+    }
+
+    element->value = value;
+    element->next = nullptr;
+
+    if (last) {
+      last->next = element;
+    } else {
+      array->start = element;
+    }
+    last = element;
+    array->length++;
+
+    const char separator = peek();
+    cursor++;
+    if (separator == ']') {
+      return true;
+    } else if (separator != ',') {
+      return false;
+    }
+  }
+}
+
+bool Builder::parse_string(json_string_s* string_) {
+  const char* end = data + size;
+  const char* src = data + indices[cursor] + 1;
+  char* dst = text;
+
+  for (;;) {
+    const Size run = scan_string(src, end);
+    memcpy(dst, src, run);
+    src += run;
+    dst += run;
+
+    if (src == end) {
+      return false;
+    }
+
+    if (*src++ == '"') {
+      break;
+    }
+
+    if (src == end) {
+      return false;
+    }
+
+    switch (*src++) {
+    case '"':
+      *dst++ = '"';
+      break;
+    case '\\':
+      *dst++ = '\\';
+      break;
+    case '/':
+      *dst++ = '/';
+      break;
+    case 'b':
+      *dst++ = '\b';
+      break;
+    case 'f':
+      *dst++ = '\f';
+      break;
+    case 'n':
+      *dst++ = '\n';
+      break;
+    case 'r':
+      *dst++ = '\r';
+      break;
+    case 't':
+      *dst++ = '\t';
+      break;
+    case 'u':
+      {
+        Uint32 codepoint;
+        if (end - src < 4 || !hex4(src, codepoint)) {
+          return false;
+        }
+        src += 4;
+
+        if (codepoint >= 0xd800 && codepoint <= 0xdbff) {
+          // High surrogate must be immediately followed by a low surrogate.
+          Uint32 low;
+          if (end - src < 6 || src[0] != '\\' || src[1] != 'u'
+            || !hex4(src + 2, low) || low < 0xdc00 || low > 0xdfff)
+          {
+            return false;
+          }
+          src += 6;
+          codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+        } else if (codepoint >= 0xdc00 && codepoint <= 0xdfff) {
+          return false;
+        }
+
+        if (codepoint <= 0x7f) {
+          *dst++ = static_cast<char>(codepoint);
+        } else if (codepoint <= 0x7ff) {
+          *dst++ = static_cast<char>(0xc0 | (codepoint >> 6));
+          *dst++ = static_cast<char>(0x80 | (codepoint & 0x3f));
+        } else if (codepoint <= 0xffff) {
+          *dst++ = static_cast<char>(0xe0 | (codepoint >> 12));
+          *dst++ = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+          *dst++ = static_cast<char>(0x80 | (codepoint & 0x3f));
+        } else {
+          *dst++ = static_cast<char>(0xf0 | (codepoint >> 18));
+          *dst++ = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f));
+          *dst++ = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+          *dst++ = static_cast<char>(0x80 | (codepoint & 0x3f));
+        }
+      }
+      break;
+    default:
+      return false;
+    }
+  }
+
+  string_->string = text;
+  string_->string_size = dst - text;
+  *dst++ = '\0';
+  text = dst;
+
+  cursor++;
+  return true;
+}
+
+bool Builder::parse_key(json_string_s* string_) {
+  const Size offset = indices[cursor];
+
+  Size length = 0;
+  while (offset + length < size && is_key(data[offset + length])) {
+    length++;
+  }
+
+  // The key must be the whole scalar.
+  if (!length || (offset + length < size && is_scalar(data[offset + length]))) {
+    return false;
+  }
+
+  memcpy(text, data + offset, length);
+  string_->string = text;
+  string_->string_size = length;
+  text[length] = '\0';
+  text += length + 1;
+
+  cursor++;
+  return true;
+}
+
+bool Builder::parse_number(json_number_s* number_) {
+  const char* begin = data + indices[cursor];
+  const char* end = data + size;
+  const char* src = begin;
+
+  if (*src == '-') {
+    src++;
+  }
+
+  if (src == end || !is_digit(*src)) {
+    return false;
+  }
+
+  // No leading zeros.
+  if (*src == '0') {
+    src++;
+    if (src != end && is_digit(*src)) {
+      return false;
+    }
+  }
+
+  for (; src != end && is_digit(*src); src++);
+
+  if (src != end && *src == '.') {
+    src++;
+    if (src == end || !is_digit(*src)) {
+      return false;
+    }
+    for (; src != end && is_digit(*src); src++);
+  }
+
+  if (src != end && (*src == 'e' || *src == 'E')) {
+    src++;
+    if (src != end && (*src == '+' || *src == '-')) {
+      src++;
+    }
+    for (; src != end && is_digit(*src); src++);
+  }
+
+  if (src != end) {
+    switch (*src) {
+    case ' ':
+      [[fallthrough]];
+    case '\t':
+      [[fallthrough]];
+    case '\r':
+      [[fallthrough]];
+    case '\n':
+      [[fallthrough]];
+    case '}':
+      [[fallthrough]];
+    case ']':
+      [[fallthrough]];
+    case ',':
+      break;
+    default:
+      return false;
+    }
+  }
+
+  const Size length = src - begin;
+  memcpy(text, begin, length);
+  number_->number = text;
+  number_->number_size = length;
+  text[length] = '\0';
+  text += length + 1;
+
+  cursor++;
+  return true;
+}
+
+bool Builder::parse_literal(const char* _literal, Size _length) {
+  const Size offset = indices[cursor];
+  if (size - offset < _length || memcmp(data + offset, _literal, _length)) {
+    return false;
+  }
+
+  // The literal must be the whole scalar.
+  if (offset + _length < size && is_scalar(data[offset + _length])) {
+    return false;
+  }
+
+  cursor++;
+  return true;
+}
+
+json_value_s* json_structural_parse(Memory::Allocator& _allocator,
+  const char* _data, Size _size)
+{
+  // Offsets are stored as 32-bit integers.
+  if (_size == 0 || _size > 0xffffffff_z) {
+    return nullptr;
+  }
+
+  Vector<Uint32> indices{_allocator};
+  if (!index_structurals(_data, _size, indices) || indices.is_empty()) {
+    return nullptr;
+  }
+
+  // Every structural that is not an operator or an object key starts a value.
+  // Each value needs at most a value, a payload and an array element. Each
+  // object key needs an object element and a string.
+  Size members = 0;
+  Size operators = 0;
+  indices.each_fwd([&](Uint32 _index) {
+    switch (_data[_index]) {
+    case ':':
+      members++;
+      [[fallthrough]];
+    case ',':
+      [[fallthrough]];
+    case '}':
+      [[fallthrough]];
+    case ']':
+      operators++;
+    }
+  });
+
+  if (operators + members > indices.size()) {
+    return nullptr;
+  }
+
+  const Size values = indices.size() - operators - members;
+  const Size dom_size =
+    values * (sizeof(json_value_s) + sizeof(json_array_element_s) + sizeof(json_object_s))
+      + members * (sizeof(json_object_element_s) + sizeof(json_string_s));
+
+  // Decoded strings and numbers never exceed their source bytes plus the null
+  // terminator, which takes the place of the closing quote or separator.
+  const Size text_size = _size + 1;
+
+  auto allocation = _allocator.allocate(dom_size + text_size);
+  if (!allocation) {
+    return nullptr;
+  }
+
+  Builder builder;
+  builder.data = _data;
+  builder.size = _size;
+  builder.indices = indices.data();
+  builder.count = indices.size();
+  builder.cursor = 0;
+  builder.dom = allocation;
+  builder.dom_end = allocation + dom_size;
+  builder.text = reinterpret_cast<char*>(builder.dom_end);
+
+  // The root must be at the start of the allocation.
+  auto root = builder.make<json_value_s>();
+  if (!root || !builder.parse_value(root) || builder.cursor != builder.count) {
+    _allocator.deallocate(allocation);
+    return nullptr;
+  }
+
+  return root;
+}
+
+} // namespace Rx::Serialize
@@ -0,0 +1,38 @@
+#ifndef RX_CORE_SERIALIZE_JSON_STRUCTURAL_H
+#define RX_CORE_SERIALIZE_JSON_STRUCTURAL_H
+#include "rx/core/types.h"
+
+/// \file json_structural.h
+
+struct json_value_s;
+
+namespace Rx::Memory { struct Allocator; }
+
+namespace Rx::Serialize {
+
+/// \brief Two-stage structural-index JSON parser.
+///
+/// The first stage classifies the input 64 bytes at a time into bitmasks and
+/// extracts the offsets of every structural character (brackets, colons,
+/// commas, opening quotes and the first byte of every bare scalar) that lies
+/// outside a string. The second stage walks those offsets to build a DOM.
+///
+/// The DOM produced is laid out exactly like the one produced by
+/// json_parse_ex() in a single allocation with the root value at the start,
+/// so it can be used and released the same way.
+///
+/// Only a strict subset of what JSON::parse accepts is handled here. Inputs
+/// containing comments, as well as malformed inputs, return \c nullptr so the
+/// caller can defer to json_parse_ex() which either handles the extension or
+/// produces the canonical error.
+///
+/// \param _allocator The allocator to allocate the DOM with.
+/// \param _data The JSON contents.
+/// \param _size The size of |_data| in bytes.
+/// \returns The root value on success, \c nullptr otherwise.
+json_value_s* json_structural_parse(Memory::Allocator& _allocator,
+  const char* _data, Size _size);
+
+} // namespace Rx::Serialize
+
+#endif // RX_CORE_SERIALIZE_JSON_STRUCTURAL_H
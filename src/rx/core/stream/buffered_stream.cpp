@@ -6,26 +6,75 @@
 #include "rx/core/memory/zero.h"
 #include "rx/core/memory/copy.h"
 
+#include "rx/core/filesystem/async_io.h"
+#include "rx/core/filesystem/unbuffered_file.h"
+
+#include "rx/core/concurrency/yield.h"
+
 namespace Rx::Stream {
 
+// Sentinel for |m_ahead_result| while a read-ahead window is in flight.
+static constexpr const auto PENDING = -1_u64;
+
+// Sentinel for an empty slot in |m_index|.
+static constexpr const auto EMPTY = 0xffff_u16;
+
+// Sentinel for no page.
+static constexpr const auto NO_PAGE = -1_u32;
+
+// Read-ahead windows begin this many pages large.
+static constexpr const Uint8 WINDOW_MIN = 2;
+
+static inline Size hash_page(Uint32 _page_no, Size _mask) {
+  const Uint32 hash = _page_no * 0x9e3779b1_u32;
+  return (hash ^ (hash >> 16)) & _mask;
+}
+
 // [BufferedStream]
 BufferedStream::BufferedStream(BufferedStream&& buffered_stream_)
   : Context{Utility::move(buffered_stream_)}
   , m_stream{Utility::exchange(buffered_stream_.m_stream, nullptr)}
+  , m_file{Utility::exchange(buffered_stream_.m_file, nullptr)}
   , m_buffer{Utility::move(buffered_stream_.m_buffer)}
   , m_pages{Utility::move(buffered_stream_.m_pages)}
+  , m_index{Utility::move(buffered_stream_.m_index)}
+  , m_ahead{Utility::move(buffered_stream_.m_ahead)}
+  , m_async_io{Utility::exchange(buffered_stream_.m_async_io, nullptr)}
+  , m_ahead_result{0}
+  , m_stats{Utility::exchange(buffered_stream_.m_stats, {0, 0, 0, 0, 0})}
+  , m_last_page{Utility::exchange(buffered_stream_.m_last_page, NO_PAGE)}
+  , m_ahead_page{0}
+  , m_ahead_next{Utility::exchange(buffered_stream_.m_ahead_next, 0)}
+  , m_trigger_page{NO_PAGE}
+  , m_ahead_count{0}
+  , m_window{Utility::exchange(buffered_stream_.m_window, 0)}
+  , m_hand{Utility::exchange(buffered_stream_.m_hand, 0)}
   , m_page_size{Utility::exchange(buffered_stream_.m_page_size, 0)}
   , m_page_count{Utility::exchange(buffered_stream_.m_page_count, 0)}
 {
+  // A window in flight still completes into |buffered_stream_|, its contents
+  // are thrown away.
+  buffered_stream_.cancel_read_ahead();
 }
 
 BufferedStream& BufferedStream::operator=(BufferedStream&& buffered_stream_) {
   if (this != &buffered_stream_) {
     on_flush();
+    // The window in flight is read into |m_ahead|, which is about to move.
+    buffered_stream_.cancel_read_ahead();
     Context::operator=(Utility::move(buffered_stream_));
     m_stream = Utility::exchange(buffered_stream_.m_stream, nullptr);
+    m_file = Utility::exchange(buffered_stream_.m_file, nullptr);
     m_buffer = Utility::move(buffered_stream_.m_buffer);
     m_pages = Utility::move(buffered_stream_.m_pages);
+    m_index = Utility::move(buffered_stream_.m_index);
+    m_ahead = Utility::move(buffered_stream_.m_ahead);
+    m_async_io = Utility::exchange(buffered_stream_.m_async_io, nullptr);
+    m_stats = Utility::exchange(buffered_stream_.m_stats, {0, 0, 0, 0, 0});
+    m_last_page = Utility::exchange(buffered_stream_.m_last_page, NO_PAGE);
+    m_ahead_next = Utility::exchange(buffered_stream_.m_ahead_next, 0);
+    m_window = Utility::exchange(buffered_stream_.m_window, 0);
+    m_hand = Utility::exchange(buffered_stream_.m_hand, 0);
     m_page_size = Utility::exchange(buffered_stream_.m_page_size, 0);
     m_page_count = Utility::exchange(buffered_stream_.m_page_count, 0);
   }
@@ -46,12 +95,16 @@ Optional<BufferedStream> BufferedStream::create(Memory::Allocator& _allocator,
   return nullopt;
 }
 
+void BufferedStream::set_async_io(Filesystem::AsyncIO* _async_io) {
+  cancel_read_ahead();
+  m_async_io = _async_io;
+}
+
 // Flushes the page cache entry out to the underlying stream.
 bool BufferedStream::flush_page(Page& page_) {
   // Only flush when the page is dirty.
   if (page_.dirty) {
     page_.dirty = 0;
-    page_.hits = 0;
     const auto bytes =
       m_stream->on_write(page_data(page_), page_.size, page_offset(page_));
     return bytes == page_.size;
@@ -62,10 +115,78 @@ bool BufferedStream::flush_page(Page& page_) {
 // Finds a page in the page cache that matches the given page number,
 // returning a pointer to that page, or nullptr if not found.
 BufferedStream::Page* BufferedStream::find_page(Uint32 _page_no) {
-  const auto index = m_pages.find_if([&](const Page& _page) {
-    return _page.page_no == _page_no;
-  });
-  return index ? &m_pages[*index] : nullptr;
+  const auto mask = m_index.size() - 1;
+  for (auto slot = hash_page(_page_no, mask); ; slot = (slot + 1) & mask) {
+    const auto index = m_index[slot];
+    if (index == EMPTY) {
+      return nullptr;
+    }
+    if (m_pages[index].page_no == _page_no) {
+      return &m_pages[index];
+    }
+  }
+}
+
+// Adds |_page| to the index. It must not already be in it.
+void BufferedStream::index_page(const Page& _page) {
+  const auto mask = m_index.size() - 1;
+  auto slot = hash_page(_page.page_no, mask);
+  while (m_index[slot] != EMPTY) {
+    slot = (slot + 1) & mask;
+  }
+  m_index[slot] = _page.buffer_index;
+}
+
+// Removes page |_page_no| from the index. It must be in it.
+void BufferedStream::unindex_page(Uint32 _page_no) {
+  const auto mask = m_index.size() - 1;
+  auto slot = hash_page(_page_no, mask);
+  while (m_pages[m_index[slot]].page_no != _page_no) {
+    slot = (slot + 1) & mask;
+  }
+
+  // Rather than leave a tombstone, shift back the entries after the hole which
+  // would otherwise no longer be found by probing from their home slot.
+  for (auto next = (slot + 1) & mask; m_index[next] != EMPTY; next = (next + 1) & mask) {
+    const auto home = hash_page(m_pages[m_index[next]].page_no, mask);
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      m_index[slot] = m_index[next];
+      slot = next;
+    }
+  }
+
+  m_index[slot] = EMPTY;
+}
+
+// Finds a page in the cache to hold another page, flushing and removing it from
+// the index. Returns nullptr when the flush fails.
+BufferedStream::Page* BufferedStream::evict_page() {
+  const auto n_pages = m_pages.size();
+  if (RX_HINT_UNLIKELY(n_pages < m_page_count)) {
+    // Cannot fail as |m_pages| is reserved for |m_page_count|.
+    (void)m_pages.emplace_back(0_u32, 0_u16, Uint8(n_pages), 0_u8, 0_u8, 0_u8);
+    return &m_pages.last();
+  }
+
+  // Sweep the clock hand around taking away the second chance of referenced
+  // pages until one without is found. This visits every page at most twice.
+  for (;;) {
+    Page& page = m_pages[m_hand];
+    m_hand = (m_hand + 1) % n_pages;
+    if (page.referenced) {
+      page.referenced = 0;
+      continue;
+    }
+
+    if (!flush_page(page)) {
+      return nullptr;
+    }
+
+    unindex_page(page.page_no);
+    m_stats.evictions++;
+
+    return &page;
+  }
 }
 
 // Performs a page lookup on |_page_no|. If the page is in cache, it returns
@@ -77,9 +198,37 @@ BufferedStream::Page* BufferedStream::find_page(Uint32 _page_no) {
 // the stream. When this is not zero, the |_allocate| bytes are allocated
 // in the page cache and zeroed out, marking the page dirty immediately.
 BufferedStream::Page* BufferedStream::lookup_page(Uint32 _page_no, Uint16 _allocate) {
+  // A finished window is brought into the cache as early as possible.
+  if (m_ahead_count && m_ahead_result.load(Concurrency::MemoryOrder::ACQUIRE) != PENDING) {
+    if (!complete_read_ahead()) {
+      return nullptr;
+    }
+  }
+
+  const auto last_page = Utility::exchange(m_last_page, _page_no);
+  const auto sequential = _page_no == last_page + 1;
+
+  // Random access ends read-ahead.
+  if (!sequential && _page_no != last_page) {
+    m_window = 0;
+    m_trigger_page = NO_PAGE;
+  }
+
   if (auto page = find_page(_page_no)) {
-    // Since it was found in cache, hit the page.
-    page->hit();
+    m_stats.hits++;
+
+    if (page->ahead) {
+      page->ahead = 0;
+      m_stats.read_ahead_hits++;
+    } else if (_page_no != last_page) {
+      page->referenced = 1;
+    }
+
+    // Reaching the first page of the last window read sends the next one.
+    if (_page_no == m_trigger_page) {
+      m_trigger_page = NO_PAGE;
+      issue_read_ahead();
+    }
 
     // Possibly expand the page.
     if (_allocate > page->size) {
@@ -90,63 +239,177 @@ BufferedStream::Page* BufferedStream::lookup_page(Uint32 _page_no, Uint16 _alloc
 
     return page;
   }
+
+  m_stats.misses++;
+
+  if (!_allocate && sequential) {
+    if (auto page = read_ahead(_page_no)) {
+      return page;
+    }
+  }
+
   return fill_page(_page_no, _allocate);
 }
 
 // Reads in page |_page_no| and stores it in page cache by replacing the least
 // recently used page in the cache. This returns a pointer to the Page itself.
 BufferedStream::Page* BufferedStream::fill_page(Uint32 _page_no, Uint16 _allocate) {
-  // There's three cases to consider when filling a page.
-  // * The cache is empty.
-  // * The cache is not full.
-  // * The cache is full.
-  //
-  // All of these cases are handled here.
-  Uint8 best_index = 0;
-  Uint8 page_count = Uint8(m_pages.size());
-  if (RX_HINT_UNLIKELY(page_count < m_page_count)) {
-    best_index = page_count;
-    // Cannot fail as |m_pages| is reserved for |m_page_count|.
-    (void)m_pages.emplace_back(0_u32, 0_u16, page_count, 0_u8, 0_u8);
-  } else {
-    // Search for page with fewest cache hits.
-    Uint8 best_hits = 127;
-    for (Uint8 i = 0; i < page_count; i++) {
-      const auto& page = m_pages[i];
-      if (page.hits < best_hits) {
-        best_hits = page.hits;
-        best_index = i;
-      }
-    }
-  }
-
-  Page& page = m_pages[best_index];
-
-  // Flush the contents of this page out to replace it with a new page.
-  if (!flush_page(page)) {
+  Page* page = evict_page();
+  if (!page) {
     return nullptr;
   }
 
   // Now the entry refers to this page.
-  page.page_no = _page_no;
+  page->page_no = _page_no;
+  page->referenced = 0;
+  page->ahead = 0;
+  index_page(*page);
 
   // Fill in the page cache now with new page data.
   const auto read = (m_stream->flags() & READ)
-    ? m_stream->on_read(page_data(page), m_page_size, page_offset(page))
+    ? m_stream->on_read(page_data(*page), m_page_size, page_offset(*page))
     : 0;
 
   if (read < _allocate) {
     // Zero the area to allocate and expand allocation.
-    Memory::zero(page_data(page) + read, _allocate - read);
-    page.size = _allocate;
-    page.dirty = 1;
+    Memory::zero(page_data(*page) + read, _allocate - read);
+    page->size = _allocate;
+    page->dirty = 1;
   } else {
     // Store the actual amount of bytes this page truely represents so that
     // future flushing of the contents do not over-flush the page.
-    page.size = read;
+    page->size = read;
+  }
+
+  return page;
+}
+
+// Called on a sequential read of |_page_no| that missed the cache. Reads the
+// window beginning at |_page_no| into the cache and returns the page. Returns
+// nullptr when there is no window to read and the page should be filled alone.
+BufferedStream::Page* BufferedStream::read_ahead(Uint32 _page_no) {
+  // Caught up with the window in flight, wait for it.
+  if (m_ahead_count && _page_no >= m_ahead_page && _page_no - m_ahead_page < m_ahead_count) {
+    if (!complete_read_ahead()) {
+      return nullptr;
+    }
+    // There's no time to wait for the trigger page.
+    if (Utility::exchange(m_trigger_page, NO_PAGE) != NO_PAGE) {
+      issue_read_ahead();
+    }
+    return find_page(_page_no);
+  }
+
+  cancel_read_ahead();
+
+  const Uint8 window_max = m_page_count / 4;
+  if (window_max < WINDOW_MIN || !(m_stream->flags() & READ)) {
+    return nullptr;
+  }
+
+  m_window = m_window ? Algorithm::min(Uint8(m_window * 2), window_max) : WINDOW_MIN;
+
+  const auto size = Uint64(m_window) * m_page_size;
+  const auto read = m_stream->on_read(m_ahead.data(), size, Uint64(_page_no) * m_page_size);
+  if (!read || !install_pages(_page_no, read, _page_no)) {
+    return nullptr;
+  }
+
+  m_ahead_next = _page_no + m_window;
+
+  // Get the next window in flight now unless the end has been reached.
+  if (read == size) {
+    issue_read_ahead();
+  }
+
+  return find_page(_page_no);
+}
+
+// Copies |_size| bytes of pages in |m_ahead| beginning with page |_page_no|
+// into the cache. Pages already in cache are left alone as they may be dirty.
+// Every page except |_demand| is marked as read ahead.
+bool BufferedStream::install_pages(Uint32 _page_no, Uint64 _size, Uint32 _demand) {
+  for (Uint64 offset = 0; offset < _size; offset += m_page_size, _page_no++) {
+    if (find_page(_page_no)) {
+      continue;
+    }
+
+    Page* page = evict_page();
+    if (!page) {
+      return false;
+    }
+
+    page->page_no = _page_no;
+    page->size = Uint16(Algorithm::min(_size - offset, Uint64(m_page_size)));
+    page->referenced = 0;
+    page->ahead = _page_no != _demand;
+    Memory::copy(page_data(*page), m_ahead.data() + offset, page->size);
+    index_page(*page);
+
+    if (page->ahead) {
+      m_stats.read_ahead++;
+    }
+  }
+
+  return true;
+}
+
+// Sends the next window in flight when there's an asynchronous I/O service.
+void BufferedStream::issue_read_ahead() {
+  if (!m_async_io || m_ahead_count || !m_window) {
+    return;
+  }
+
+  m_window = Algorithm::min(Uint8(m_window * 2), Uint8(m_page_count / 4));
+
+  const auto size = Uint64(m_window) * m_page_size;
+  const auto offset = Uint64(m_ahead_next) * m_page_size;
+
+  m_ahead_result.store(PENDING, Concurrency::MemoryOrder::RELAXED);
+
+  auto completion = [this](Uint64 _bytes) {
+    m_ahead_result.store(_bytes, Concurrency::MemoryOrder::RELEASE);
+  };
+
+  // Files are read with the operating system's asynchronous I/O when possible.
+  const auto issued = m_file
+    ? m_async_io->async_read(*m_file, m_ahead.data(), size, offset, completion)
+    : m_async_io->async_read(*m_stream, m_ahead.data(), size, offset, completion);
+
+  if (issued) {
+    m_ahead_page = m_ahead_next;
+    m_ahead_count = m_window;
+    m_ahead_next += m_window;
+    (void)m_async_io->submit();
+  }
+}
+
+// Waits for the window in flight and copies it into the cache.
+bool BufferedStream::complete_read_ahead() {
+  const auto read = wait_read_ahead();
+  const auto size = Uint64(Utility::exchange(m_ahead_count, 0)) * m_page_size;
+  // Nothing more to read ahead once the end has been reached.
+  m_trigger_page = read == size ? m_ahead_page : NO_PAGE;
+  return install_pages(m_ahead_page, read, NO_PAGE);
+}
+
+// Blocks until the window in flight has been read and returns how many bytes
+// were read.
+Uint64 BufferedStream::wait_read_ahead() {
+  Uint64 bytes;
+  while ((bytes = m_ahead_result.load(Concurrency::MemoryOrder::ACQUIRE)) == PENDING) {
+    Concurrency::yield();
   }
+  return bytes;
+}
 
-  return &page;
+// Throws away the window in flight, once it's no longer in flight.
+void BufferedStream::cancel_read_ahead() {
+  if (m_ahead_count) {
+    (void)wait_read_ahead();
+    m_ahead_count = 0;
+  }
+  m_trigger_page = NO_PAGE;
 }
 
 // Reads |_size| bytes from offset |_offset| in page |_page_no| into |data_|.
@@ -197,12 +460,27 @@ bool BufferedStream::resize(Uint16 _page_size, Uint8 _page_count) {
     return false;
   }
 
+  // Keep the index at most half full so probes stay short.
+  Size index_size = 1;
+  while (index_size < Size(_page_count) * 2) {
+    index_size *= 2;
+  }
+
+  if (!m_index.resize(index_size, EMPTY)) {
+    return false;
+  }
+
+  if (!m_ahead.resize(Size(_page_count / 4) * _page_size)) {
+    return false;
+  }
+
   if (m_buffer.resize(_page_size * _page_count)) {
     // Zero the contents of the buffer.
     Memory::zero(m_buffer.data(), m_buffer.size());
 
     m_page_size = _page_size;
     m_page_count = _page_count;
+    m_window = 0;
     return true;
   }
 
@@ -222,6 +500,7 @@ bool BufferedStream::attach(Context& _stream) {
 
   // Change the stream.
   m_stream = &_stream;
+  m_file = nullptr;
 
   // Adopt the flags of the stream.
   m_flags = m_stream->flags() | FLUSH;
@@ -236,7 +515,16 @@ bool BufferedStream::attach(Context& _stream) {
   }
 
   m_stream = nullptr;
+  m_file = nullptr;
+
+  return true;
+}
 
+bool BufferedStream::attach(Filesystem::UnbufferedFile& _file) {
+  if (!attach(static_cast<Context&>(_file))) {
+    return false;
+  }
+  m_file = &_file;
   return true;
 }
 
@@ -261,6 +549,9 @@ Uint64 BufferedStream::on_read(Byte* data_, Uint64 _size, Uint64 _offset) {
 }
 
 Uint64 BufferedStream::on_write(const Byte* _data, Uint64 _size, Uint64 _offset) {
+  // The window in flight may have read what is about to be written.
+  cancel_read_ahead();
+
   // Writes larger than a page size, skip the buffering.
   if (_size > m_page_size && on_flush()) {
     return m_stream->on_write(_data, _size, _offset);
@@ -300,6 +591,9 @@ Optional<Stat> BufferedStream::on_stat() const {
 
 // Flushes all pages in the cache that are dirty.
 bool BufferedStream::on_flush() {
+  // Pages are not read ahead into an empty cache.
+  cancel_read_ahead();
+
   // Nothing to flush if no stream.
   if (!m_stream) {
     return true;
@@ -310,13 +604,21 @@ bool BufferedStream::on_flush() {
     return true;
   }
 
-  if (m_pages.each_fwd([this](Page& page_) { return flush_page(page_); })) {
-    m_pages.clear();
-    // Remember to flush the underlying stream if supported too.
-    return (m_stream->flags() & FLUSH) ? m_stream->on_flush() : true;
+  // Oldest pages first, beginning at the clock hand, so the pages of a
+  // sequential writer reach the stream in order.
+  const auto n_pages = m_pages.size();
+  for (Size i = 0; i < n_pages; i++) {
+    if (!flush_page(m_pages[(m_hand + i) % n_pages])) {
+      return false;
+    }
   }
 
-  return false;
+  m_pages.clear();
+  m_index.each_fwd([](Uint16& index_) { index_ = EMPTY; });
+  m_hand = 0;
+
+  // Remember to flush the underlying stream if supported too.
+  return (m_stream->flags() & FLUSH) ? m_stream->on_flush() : true;
 }
 
 bool BufferedStream::on_truncate(Uint64 _size) {
@@ -329,10 +631,12 @@ Uint64 BufferedStream::on_copy(Uint64 _dst_offset, Uint64 _src_offset, Uint64 _s
   return on_flush() ? m_stream->on_copy(_dst_offset, _src_offset, _size) : 0;
 }
 
-// [BufferedStream::Page]
-BufferedStream::Page* BufferedStream::Page::hit() {
-  hits = (hits + 1) & 127;
-  return this;
+Optional<Span<const Byte>> BufferedStream::on_view() {
+  // Just flush all pages and view the underlying stream.
+  if (on_flush()) {
+    return m_stream->on_view();
+  }
+  return nullopt;
 }
 
-} // namespace Rx
\ No newline at end of file
+} // namespace Rx
@@ -1,10 +1,13 @@
 #ifndef RX_CORE_STREAM_BUFFERED_STREAM_H
 #define RX_CORE_STREAM_BUFFERED_STREAM_H
 #include "rx/core/stream/context.h"
+#include "rx/core/concurrency/atomic.h"
 #include "rx/core/vector.h"
 
 /// \file buffered_stream.h
 
+namespace Rx::Filesystem { struct AsyncIO; struct UnbufferedFile; }
+
 namespace Rx::Stream {
 
 /// \brief Buffered stream.
@@ -14,11 +17,21 @@ namespace Rx::Stream {
 ///
 /// All stream operations have their offsets rounded to a page size granularity
 /// and count of pages. Such operations then go directly to the page cache.
-/// The page cache is not contiguous. Each time an operation hits the page cache
-/// directly, the page's hit count is incremented. The page with the fewest hits
-/// is reused when none of the pages in cache can service an operation. With
-/// exception to the first and last page of a stream, all underlying stream
-/// reads and writes will be of the size of a page.
+/// The page cache is not contiguous, pages are found by hashing the page number.
+/// When none of the pages in cache can service an operation, one is reused
+/// according to the CLOCK policy: a page that is used again after it was first
+/// brought in is given a second chance before it's reused. Repeated use within
+/// the same page does not count, so a single front to back pass over a stream
+/// does not push out pages that are actually used repeatedly.
+///
+/// Reads that walk the stream page after page are detected and the pages after
+/// them are read ahead in windows that double in size, up to a quarter of the
+/// cache, for as long as the reads remain sequential. A window is read with a
+/// single underlying read. When an asynchronous I/O service is given with
+/// set_async_io(), the next window is read in the background while the current
+/// one is consumed. With exception to the first and last page of a stream and
+/// read-ahead windows, all underlying stream reads and writes will be of the
+/// size of a page.
 ///
 /// A BufferedStream models the sort of page caching that an operating system
 /// implements for files, except implemented in user-space. Rex's
@@ -35,6 +48,15 @@ struct RX_API BufferedStream
   /// Default page count for the page cache.
   static constexpr const auto BUFFER_PAGE_COUNT = 64_u8;
 
+  /// Statistics about the page cache.
+  struct Stats {
+    Uint64 hits;            ///< Page lookups served from the cache.
+    Uint64 misses;          ///< Page lookups that had to go to the stream.
+    Uint64 evictions;       ///< Pages reused to hold another page.
+    Uint64 read_ahead;      ///< Pages brought in before they were asked for.
+    Uint64 read_ahead_hits; ///< Pages read ahead that were later used.
+  };
+
   /// \brief Construct a BufferedStream
   /// \param _allocator The allocator to use for the page cache.
   constexpr BufferedStream(Memory::Allocator& _allocator);
@@ -102,6 +124,15 @@ struct RX_API BufferedStream
   /// \param _stream The stream to attach.
   [[nodiscard]] bool attach(Context& _stream);
 
+  /// Attach a Filesystem::UnbufferedFile to this BufferedStream.
+  ///
+  /// Same as attach(Context&) except read-ahead windows sent in flight with
+  /// set_async_io() are read from the file directly, which lets the service
+  /// hand them to the operating system instead of a worker thread.
+  ///
+  /// \param _file The file to attach.
+  [[nodiscard]] bool attach(Filesystem::UnbufferedFile& _file);
+
   /// Detach a Context from this BufferedStream.
   ///
   /// This will flush the contents in the page cache out to the existing,
@@ -111,6 +142,22 @@ struct RX_API BufferedStream
   /// \return When the flushing fails, \c false. Otherwise, \c true.
   [[nodiscard]] bool detach();
 
+  /// \brief Read ahead in the background.
+  ///
+  /// Sequential reads will have the next read-ahead window read by
+  /// \p _async_io while the current one is consumed. Pass \c nullptr to read
+  /// ahead synchronously, which is the default.
+  ///
+  /// \param _async_io The asynchronous I/O service to read ahead with.
+  ///
+  /// \warning The attached stream must support being read from another thread
+  /// concurrently with reads on this one and \p _async_io must outlive the
+  /// buffered stream, or the next call to this function.
+  void set_async_io(Filesystem::AsyncIO* _async_io);
+
+  /// \brief Statistics about the page cache since creation.
+  const Stats& stats() const &;
+
   /// \brief The name of the stream.
   /// \warning Cannot be called if no stream is attached.
   virtual const String& name() const &;
@@ -145,6 +192,10 @@ struct RX_API BufferedStream
   /// cannot overlap.
   virtual Uint64 on_copy(Uint64 _dst_offset, Uint64 _src_offset, Uint64 _size);
 
+  /// \brief View the contents of the underlying stream in place.
+  /// \note All dirty pages are flushed first so the view is up to date.
+  virtual Optional<Span<const Byte>> on_view();
+
   /// \brief Get the attached stream.
   Context* stream() const;
 
@@ -165,14 +216,9 @@ private:
     // byte offset inside |m_buffer|.
     Uint8 buffer_index;
 
-    Uint8 hits : 7;  // Number of times this page was hit in cache.
-    Uint8 dirty : 1; // Indicates if this page is dirty and needs to be flushed.
-
-    // Called each time this page is hit. Saturates |hits| because it's only
-    // 7-bits and overflow is not desired here. If we overflow then the LRU
-    // would flush a possibly common page from cache to replace it since it
-    // would have a lower hit rate due to wrapping around.
-    Page* hit();
+    Uint8 referenced : 1; // Used again since the clock hand last passed it.
+    Uint8 dirty : 1;      // Indicates if this page is dirty and needs to be flushed.
+    Uint8 ahead : 1;      // Read ahead and not used yet.
   };
 
   // Retrieve pointer to the page data for the given page.
@@ -182,13 +228,22 @@ private:
 
   // Retrieve stream-relative offset for a page.
   RX_HINT_FORCE_INLINE Uint64 page_offset(const Page& _page) {
-    return _page.page_no * m_page_size;
+    return Uint64(_page.page_no) * m_page_size;
   }
 
   bool flush_page(Page& page_);
   Page* find_page(Uint32 _page_no);
+  void index_page(const Page& _page);
+  void unindex_page(Uint32 _page_no);
+  Page* evict_page();
   Page* lookup_page(Uint32 _page_no, Uint16 _allocate = 0);
   Page* fill_page(Uint32 _page_no, Uint16 _allocate);
+  Page* read_ahead(Uint32 _page_no);
+  bool install_pages(Uint32 _page_no, Uint64 _size, Uint32 _demand);
+  void issue_read_ahead();
+  bool complete_read_ahead();
+  Uint64 wait_read_ahead();
+  void cancel_read_ahead();
   Uint16 read_page(Uint32 _page_no, Byte* data_, Uint16 _offset, Uint16 _size);
   Uint16 write_page(Uint32 _page_no, const Byte* _data, Uint16 _offset, Uint16 _size);
 
@@ -234,8 +289,32 @@ private:
   Iterator page_iterate(Uint64 _size, Uint64 _offset) const;
 
   Context* m_stream;
+  // Set when |m_stream| is an UnbufferedFile attached as one.
+  Filesystem::UnbufferedFile* m_file;
   LinearBuffer m_buffer;
   Vector<Page> m_pages;
+
+  // Open addressed table of indices into |m_pages|, keyed by page number. The
+  // size is a power of two at least twice |m_page_count|.
+  Vector<Uint16> m_index;
+
+  // Read-ahead windows are read here before being copied into the cache.
+  LinearBuffer m_ahead;
+  Filesystem::AsyncIO* m_async_io;
+
+  // Bytes read into |m_ahead| by the window in flight, or PENDING.
+  Concurrency::Atomic<Uint64> m_ahead_result;
+
+  Stats m_stats;
+
+  Uint32 m_last_page;    // Page of the last lookup.
+  Uint32 m_ahead_page;   // First page of the window in flight.
+  Uint32 m_ahead_next;   // Page after the last page read ahead.
+  Uint32 m_trigger_page; // Reading this page sends the next window in flight.
+  Uint16 m_ahead_count;  // Pages in the window in flight, zero when none.
+  Uint8 m_window;        // Current read-ahead window size in pages.
+  Uint8 m_hand;          // Clock hand.
+
   Uint16 m_page_size;
   Uint8 m_page_count;
 };
@@ -243,13 +322,30 @@ private:
 inline constexpr BufferedStream::BufferedStream(Memory::Allocator& _allocator)
   : Context{0}
   , m_stream{nullptr}
+  , m_file{nullptr}
   , m_buffer{_allocator}
   , m_pages{_allocator}
+  , m_index{_allocator}
+  , m_ahead{_allocator}
+  , m_async_io{nullptr}
+  , m_ahead_result{0}
+  , m_stats{0, 0, 0, 0, 0}
+  , m_last_page{-1_u32}
+  , m_ahead_page{0}
+  , m_ahead_next{0}
+  , m_trigger_page{-1_u32}
+  , m_ahead_count{0}
+  , m_window{0}
+  , m_hand{0}
   , m_page_size{0}
   , m_page_count{0}
 {
 }
 
+inline const BufferedStream::Stats& BufferedStream::stats() const & {
+  return m_stats;
+}
+
 inline Context* BufferedStream::stream() const {
   return m_stream;
 }
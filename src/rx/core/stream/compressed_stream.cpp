@@ -0,0 +1,561 @@
+#include <string.h> // memcpy
+
+#include "rx/core/stream/compressed_stream.h"
+#include "rx/core/compression/lz4.h"
+
+#include "rx/core/concurrency/scheduler.h"
+#include "rx/core/concurrency/atomic.h"
+#include "rx/core/concurrency/yield.h"
+
+#include "rx/core/algorithm/min.h"
+#include "rx/core/algorithm/max.h"
+
+#include "rx/core/memory/zero.h"
+#include "rx/core/memory/copy.h"
+
+namespace Rx::Stream {
+
+static constexpr const Uint32 MAGIC = 0x5a4c5852; // "RXLZ"
+static constexpr const Uint16 VERSION = 1;
+static constexpr const Uint64 HEADER_SIZE = 32;
+static constexpr const Uint64 ENTRY_SIZE = 16;
+
+static constexpr const Uint32 STORED = 1 << 0;
+
+// Limits on the block size accepted from a header.
+static constexpr const Uint32 BLOCK_SIZE_MIN = 1_KiB;
+static constexpr const Uint32 BLOCK_SIZE_MAX = 16_MiB;
+
+// Number of blocks kept open for writing. Writes behind these fail.
+static constexpr const Size WINDOW = 4;
+
+// Sentinel for |Job::result| while a block is being compressed.
+static constexpr const auto PENDING = -1_u32;
+
+// Sentinel for no block in |m_block|.
+static constexpr const auto NO_BLOCK = -1_u64;
+
+// The layout is little-endian, as is every host Rex targets.
+template<typename T>
+static inline T get(const Byte* _data) {
+  T value;
+  memcpy(&value, _data, sizeof value);
+  return value;
+}
+
+template<typename T>
+static inline void put(Byte* data_, T _value) {
+  memcpy(data_, &_value, sizeof _value);
+}
+
+struct CompressedStream::Job {
+  Job(Memory::Allocator& _allocator)
+    : raw{_allocator}
+    , compressed{_allocator}
+    , size{0}
+    , result{0}
+  {
+  }
+
+  LinearBuffer raw;
+  LinearBuffer compressed;
+
+  // Number of bytes of |raw| in the block.
+  Uint32 size;
+
+  // Compressed size, zero when the block did not compress, or PENDING.
+  Concurrency::Atomic<Uint32> result;
+};
+
+// Compressed output is only kept when smaller, so |compressed| need only be as
+// large as |raw| and the block is stored whenever compression runs out of room.
+static void compress_job(Byte* compressed_, const Byte* _raw, Uint32 _size,
+  Concurrency::Atomic<Uint32>& result_)
+{
+  const auto size = Compression::lz4_compress(_raw, _size, compressed_, _size - 1);
+  result_.store(static_cast<Uint32>(size), Concurrency::MemoryOrder::RELEASE);
+}
+
+CompressedStream::CompressedStream(Memory::Allocator& _allocator, Uint32 _flags,
+  Context& _stream, Concurrency::Scheduler* _scheduler, Uint32 _block_size)
+  : Context{_flags}
+  , m_allocator{&_allocator}
+  , m_stream{&_stream}
+  , m_scheduler{_scheduler}
+  , m_index{_allocator}
+  , m_size{0}
+  , m_block_size{_block_size}
+  , m_block{_allocator}
+  , m_scratch{_allocator}
+  , m_view{nullptr, 0}
+  , m_block_no{NO_BLOCK}
+  , m_open{_allocator}
+  , m_flight{_allocator}
+  , m_free{_allocator}
+  , m_open_block{0}
+  , m_write_offset{HEADER_SIZE}
+{
+}
+
+CompressedStream::CompressedStream(CompressedStream&& compressed_stream_)
+  : Context{Utility::move(compressed_stream_)}
+  , m_allocator{compressed_stream_.m_allocator}
+  , m_stream{Utility::exchange(compressed_stream_.m_stream, nullptr)}
+  , m_scheduler{Utility::exchange(compressed_stream_.m_scheduler, nullptr)}
+  , m_index{Utility::move(compressed_stream_.m_index)}
+  , m_size{Utility::exchange(compressed_stream_.m_size, 0)}
+  , m_block_size{Utility::exchange(compressed_stream_.m_block_size, 0)}
+  , m_block{Utility::move(compressed_stream_.m_block)}
+  , m_scratch{Utility::move(compressed_stream_.m_scratch)}
+  , m_view{Utility::exchange(compressed_stream_.m_view, Span<const Byte>{nullptr, 0})}
+  , m_block_no{Utility::exchange(compressed_stream_.m_block_no, NO_BLOCK)}
+  , m_open{Utility::move(compressed_stream_.m_open)}
+  , m_flight{Utility::move(compressed_stream_.m_flight)}
+  , m_free{Utility::move(compressed_stream_.m_free)}
+  , m_open_block{Utility::exchange(compressed_stream_.m_open_block, 0)}
+  , m_write_offset{Utility::exchange(compressed_stream_.m_write_offset, 0)}
+{
+}
+
+CompressedStream::~CompressedStream() {
+  release();
+}
+
+CompressedStream& CompressedStream::operator=(CompressedStream&& compressed_stream_) {
+  if (this != &compressed_stream_) {
+    release();
+    Context::operator=(Utility::move(compressed_stream_));
+    m_allocator = compressed_stream_.m_allocator;
+    m_stream = Utility::exchange(compressed_stream_.m_stream, nullptr);
+    m_scheduler = Utility::exchange(compressed_stream_.m_scheduler, nullptr);
+    m_index = Utility::move(compressed_stream_.m_index);
+    m_size = Utility::exchange(compressed_stream_.m_size, 0);
+    m_block_size = Utility::exchange(compressed_stream_.m_block_size, 0);
+    m_block = Utility::move(compressed_stream_.m_block);
+    m_scratch = Utility::move(compressed_stream_.m_scratch);
+    m_view = Utility::exchange(compressed_stream_.m_view, Span<const Byte>{nullptr, 0});
+    m_block_no = Utility::exchange(compressed_stream_.m_block_no, NO_BLOCK);
+    m_open = Utility::move(compressed_stream_.m_open);
+    m_flight = Utility::move(compressed_stream_.m_flight);
+    m_free = Utility::move(compressed_stream_.m_free);
+    m_open_block = Utility::exchange(compressed_stream_.m_open_block, 0);
+    m_write_offset = Utility::exchange(compressed_stream_.m_write_offset, 0);
+  }
+  return *this;
+}
+
+void CompressedStream::release() {
+  if (m_stream && (m_flags & WRITE)) {
+    RX_ASSERT(on_flush(), "failed to flush");
+  }
+
+  // Blocks still being compressed must finish before they can be destroyed.
+  m_flight.each_fwd([](Job* _job) {
+    while (_job->result.load(Concurrency::MemoryOrder::ACQUIRE) == PENDING) {
+      Concurrency::yield();
+    }
+  });
+
+  auto destroy = [this](Job* _job) { m_allocator->destroy<Job>(_job); };
+  m_open.each_fwd(destroy);
+  m_flight.each_fwd(destroy);
+  m_free.each_fwd(destroy);
+
+  m_open.clear();
+  m_flight.clear();
+  m_free.clear();
+}
+
+Optional<CompressedStream> CompressedStream::create(Memory::Allocator& _allocator,
+  Context& _stream, Concurrency::Scheduler* _scheduler, Uint32 _block_size)
+{
+  if (!(_stream.flags() & WRITE)) {
+    return nullopt;
+  }
+
+  if (_block_size < BLOCK_SIZE_MIN || _block_size > BLOCK_SIZE_MAX) {
+    return nullopt;
+  }
+
+  // Reserve the header, a zero magic marks the contents unfinished.
+  const Byte header[HEADER_SIZE] = {};
+  if (_stream.on_write(header, HEADER_SIZE, 0) != HEADER_SIZE) {
+    return nullopt;
+  }
+
+  return CompressedStream{_allocator, WRITE | STAT | FLUSH, _stream,
+    _scheduler, _block_size};
+}
+
+Optional<CompressedStream> CompressedStream::open(Memory::Allocator& _allocator,
+  Context& _stream)
+{
+  if (!(_stream.flags() & READ)) {
+    return nullopt;
+  }
+
+  Byte header[HEADER_SIZE];
+  if (_stream.on_read(header, HEADER_SIZE, 0) != HEADER_SIZE) {
+    return nullopt;
+  }
+
+  if (get<Uint32>(header + 0) != MAGIC || get<Uint16>(header + 4) > VERSION) {
+    return nullopt;
+  }
+
+  const auto block_size = get<Uint32>(header + 8);
+  const auto count = get<Uint32>(header + 12);
+  const auto size = get<Uint64>(header + 16);
+  const auto index_offset = get<Uint64>(header + 24);
+
+  if (block_size < BLOCK_SIZE_MIN || block_size > BLOCK_SIZE_MAX) {
+    return nullopt;
+  }
+
+  if (count != (size + block_size - 1) / block_size || index_offset < HEADER_SIZE) {
+    return nullopt;
+  }
+
+  CompressedStream stream{_allocator, READ | STAT, _stream, nullptr, block_size};
+  stream.m_size = size;
+  stream.m_write_offset = index_offset + count * ENTRY_SIZE;
+
+  LinearBuffer index{_allocator};
+  if (!index.resize(count * ENTRY_SIZE) || !stream.m_index.resize(count)) {
+    return nullopt;
+  }
+
+  if (_stream.on_read(index.data(), index.size(), index_offset) != index.size()) {
+    return nullopt;
+  }
+
+  for (Uint32 i = 0; i < count; i++) {
+    const auto data = index.data() + i * ENTRY_SIZE;
+    auto& entry = stream.m_index[i];
+    entry.offset = get<Uint64>(data + 0);
+    entry.size = get<Uint32>(data + 8);
+    entry.flags = get<Uint32>(data + 12);
+
+    // Blocks must lie between the header and index. Stored blocks are exactly
+    // the size of the block and compressed blocks are smaller.
+    const auto expected = stream.block_size(i);
+    if (entry.offset < HEADER_SIZE
+      || entry.offset > index_offset
+      || entry.size > index_offset - entry.offset
+      || (entry.flags & STORED ? entry.size != expected : entry.size >= expected))
+    {
+      return nullopt;
+    }
+  }
+
+  if (!stream.m_block.resize(block_size) || !stream.m_scratch.resize(block_size)) {
+    return nullopt;
+  }
+
+  // Decompress straight out of the underlying stream when it can be viewed.
+  if (_stream.flags() & VIEW) {
+    if (auto view = _stream.on_view(); view && view->size() >= index_offset) {
+      stream.m_view = *view;
+    }
+  }
+
+  return stream;
+}
+
+// The number of bytes in block |_block|, only the last one can be short.
+Uint32 CompressedStream::block_size(Uint64 _block) const {
+  return static_cast<Uint32>(Algorithm::min(Uint64(m_block_size), m_size - _block * m_block_size));
+}
+
+// Decompresses block |_block| into |data_|.
+bool CompressedStream::decode_block(Uint64 _block, Byte* data_) {
+  const auto& entry = m_index[_block];
+  const auto size = block_size(_block);
+
+  if (entry.flags & STORED) {
+    if (m_view.data()) {
+      Memory::copy(data_, m_view.data() + entry.offset, size);
+      return true;
+    }
+    return m_stream->on_read(data_, size, entry.offset) == size;
+  }
+
+  const Byte* src = m_view.data() + entry.offset;
+  if (!m_view.data()) {
+    if (m_stream->on_read(m_scratch.data(), entry.size, entry.offset) != entry.size) {
+      return false;
+    }
+    src = m_scratch.data();
+  }
+
+  return Compression::lz4_decompress(src, entry.size, data_, size) == size;
+}
+
+Uint64 CompressedStream::on_read(Byte* data_, Uint64 _size, Uint64 _offset) {
+  if (_offset >= m_size) {
+    return 0;
+  }
+
+  const auto size = Algorithm::min(_size, m_size - _offset);
+
+  Uint64 bytes = 0;
+  while (bytes < size) {
+    const auto offset = _offset + bytes;
+    const auto block = offset / m_block_size;
+    const auto begin = Uint32(offset % m_block_size);
+    const auto length = block_size(block);
+    const auto count = Uint32(Algorithm::min(size - bytes, Uint64(length - begin)));
+
+    if (block == m_block_no) {
+      Memory::copy(data_ + bytes, m_block.data() + begin, count);
+    } else if (count == length) {
+      // Whole blocks are decompressed in place.
+      if (!decode_block(block, data_ + bytes)) {
+        break;
+      }
+    } else {
+      m_block_no = NO_BLOCK;
+      if (!decode_block(block, m_block.data())) {
+        break;
+      }
+      m_block_no = block;
+      Memory::copy(data_ + bytes, m_block.data() + begin, count);
+    }
+
+    bytes += count;
+  }
+
+  return bytes;
+}
+
+CompressedStream::Job* CompressedStream::acquire_job() {
+  if (!m_free.is_empty()) {
+    Job* job = m_free.last();
+    m_free.pop_back();
+    return job;
+  }
+
+  Job* job = m_allocator->create<Job>(*m_allocator);
+  if (!job) {
+    return nullptr;
+  }
+
+  if (!job->raw.resize(m_block_size) || !job->compressed.resize(m_block_size)) {
+    m_allocator->destroy<Job>(job);
+    return nullptr;
+  }
+
+  return job;
+}
+
+// Finds block |_block| among those open for writing, opening it and any before
+// it, which commits the oldest blocks as needed. Returns nullptr when the block
+// has already been committed.
+CompressedStream::Job* CompressedStream::open_block(Uint64 _block) {
+  if (_block < m_open_block) {
+    return nullptr;
+  }
+
+  while (_block >= m_open_block + m_open.size()) {
+    if (m_open.size() == WINDOW && !commit_block()) {
+      return nullptr;
+    }
+
+    Job* job = acquire_job();
+    if (!job) {
+      return nullptr;
+    }
+
+    job->size = 0;
+    Memory::zero(job->raw.data(), m_block_size);
+
+    if (!m_open.push_back(job)) {
+      m_allocator->destroy<Job>(job);
+      return nullptr;
+    }
+  }
+
+  return m_open[_block - m_open_block];
+}
+
+// Closes the oldest open block to writing and compresses it.
+bool CompressedStream::commit_block() {
+  Job* job = m_open[0];
+  m_open.erase(0, 1);
+  m_open_block++;
+
+  // A block followed by another is always full, the gaps are zeros.
+  job->size = m_block_size;
+  job->result.store(PENDING, Concurrency::MemoryOrder::RELAXED);
+
+  if (!m_flight.push_back(job)) {
+    m_allocator->destroy<Job>(job);
+    return false;
+  }
+
+  auto task = [job](Sint32) {
+    compress_job(job->compressed.data(), job->raw.data(), job->size, job->result);
+  };
+
+  if (!m_scheduler || !m_scheduler->add(task)) {
+    task(0);
+  }
+
+  // Keep at most two blocks per thread in flight.
+  const auto in_flight = m_scheduler ? m_scheduler->total_threads() * 2 : 0;
+  return write_jobs(in_flight);
+}
+
+// Writes compressed blocks out in order until at most |_in_flight| remain,
+// waiting on them if needed. Any other finished blocks are written too.
+bool CompressedStream::write_jobs(Size _in_flight) {
+  const auto n_jobs = m_flight.size();
+
+  bool result = true;
+  Size i = 0;
+  for (; i < n_jobs; i++) {
+    Job* job = m_flight[i];
+
+    auto compressed = job->result.load(Concurrency::MemoryOrder::ACQUIRE);
+    if (compressed == PENDING) {
+      if (n_jobs - i <= _in_flight) {
+        break;
+      }
+      do {
+        Concurrency::yield();
+      } while ((compressed = job->result.load(Concurrency::MemoryOrder::ACQUIRE)) == PENDING);
+    }
+
+    if (!write_block(*job, compressed, m_write_offset)) {
+      result = false;
+      break;
+    }
+
+    m_write_offset += compressed ? compressed : job->size;
+
+    if (!m_free.push_back(job)) {
+      m_allocator->destroy<Job>(job);
+    }
+  }
+
+  m_flight.erase(0, i);
+
+  return result;
+}
+
+// Writes a block to |_offset| in the underlying stream and adds it to the index.
+bool CompressedStream::write_block(const Job& _job, Uint32 _compressed_size,
+  Uint64 _offset)
+{
+  const auto data = _compressed_size ? _job.compressed.data() : _job.raw.data();
+  const auto size = _compressed_size ? _compressed_size : _job.size;
+  if (m_stream->on_write(data, size, _offset) != size) {
+    return false;
+  }
+  return m_index.emplace_back(_offset, size, _compressed_size ? 0_u32 : STORED);
+}
+
+Uint64 CompressedStream::on_write(const Byte* _data, Uint64 _size, Uint64 _offset) {
+  Uint64 bytes = 0;
+  while (bytes < _size) {
+    const auto offset = _offset + bytes;
+    Job* job = open_block(offset / m_block_size);
+    if (!job) {
+      break;
+    }
+
+    const auto begin = Uint32(offset % m_block_size);
+    const auto count = Uint32(Algorithm::min(_size - bytes, Uint64(m_block_size - begin)));
+
+    Memory::copy(job->raw.data() + begin, _data + bytes, count);
+    job->size = Algorithm::max(job->size, begin + count);
+
+    bytes += count;
+  }
+
+  m_size = Algorithm::max(m_size, _offset + bytes);
+
+  return bytes;
+}
+
+Optional<Stat> CompressedStream::on_stat() const {
+  Stat result;
+  result.size = m_size;
+  return result;
+}
+
+bool CompressedStream::on_flush() {
+  if (!(m_flags & WRITE)) {
+    return true;
+  }
+
+  if (!write_jobs(0)) {
+    return false;
+  }
+
+  // Open blocks are written after the committed ones without being committed
+  // so that writing can continue. They're written again once committed.
+  const auto n_committed = m_index.size();
+  auto offset = m_write_offset;
+
+  const auto n_open = m_open.size();
+  for (Size i = 0; i < n_open; i++) {
+    Job& job = *m_open[i];
+    const auto block = m_open_block + i;
+    if (block * m_block_size >= m_size) {
+      break;
+    }
+
+    const auto size = job.size;
+    job.size = block_size(block);
+    compress_job(job.compressed.data(), job.raw.data(), job.size, job.result);
+
+    const auto compressed = job.result.load(Concurrency::MemoryOrder::RELAXED);
+    const auto written = write_block(job, compressed, offset);
+    job.size = size;
+    if (!written) {
+      (void)m_index.resize(n_committed);
+      return false;
+    }
+
+    offset += compressed ? compressed : block_size(block);
+  }
+
+  const auto count = m_index.size();
+
+  LinearBuffer index{*m_allocator};
+  if (!index.resize(count * ENTRY_SIZE)) {
+    (void)m_index.resize(n_committed);
+    return false;
+  }
+
+  for (Size i = 0; i < count; i++) {
+    const auto& entry = m_index[i];
+    const auto data = index.data() + i * ENTRY_SIZE;
+    put<Uint64>(data + 0, entry.offset);
+    put<Uint32>(data + 8, entry.size);
+    put<Uint32>(data + 12, entry.flags);
+  }
+
+  (void)m_index.resize(n_committed);
+
+  Byte header[HEADER_SIZE] = {};
+  put<Uint32>(header + 0, MAGIC);
+  put<Uint16>(header + 4, VERSION);
+  put<Uint32>(header + 8, m_block_size);
+  put<Uint32>(header + 12, static_cast<Uint32>(count));
+  put<Uint64>(header + 16, m_size);
+  put<Uint64>(header + 24, offset);
+
+  if (m_stream->on_write(index.data(), index.size(), offset) != index.size()) {
+    return false;
+  }
+
+  if (m_stream->on_write(header, HEADER_SIZE, 0) != HEADER_SIZE) {
+    return false;
+  }
+
+  return (m_stream->flags() & FLUSH) ? m_stream->on_flush() : true;
+}
+
+} // namespace Rx::Stream
@@ -0,0 +1,163 @@
+#ifndef RX_CORE_STREAM_COMPRESSED_STREAM_H
+#define RX_CORE_STREAM_COMPRESSED_STREAM_H
+#include "rx/core/stream/context.h"
+#include "rx/core/vector.h"
+
+/// \file compressed_stream.h
+
+namespace Rx::Concurrency { struct Scheduler; }
+
+namespace Rx::Stream {
+
+/// \brief Compressed stream.
+///
+/// A CompressedStream has the same interface as a Context except the contents
+/// are stored LZ4 compressed in another Context, in blocks of a fixed size.
+/// Blocks that do not compress are stored as they are.
+///
+/// \code
+///   Header (32 bytes)
+///   Block
+///   ...
+///   Index  (16 bytes per block)
+/// \endcode
+///
+/// The index records where each block begins in the underlying stream, so any
+/// offset can be read by decompressing only the block that contains it. The
+/// most recently decompressed block is kept, small reads within a block are a
+/// copy. When the underlying stream supports VIEW, blocks are decompressed
+/// straight out of it.
+///
+/// A stream is either created for writing or opened for reading. Writes can go
+/// anywhere within the last few blocks, typically they are sequential, and
+/// blocks that fall behind are compressed on a Concurrency::Scheduler while
+/// writing continues. Compressed blocks are written out in order as they finish.
+/// The header and index are written by on_flush(), at which point the contents
+/// can be opened, though writing may continue afterwards.
+///
+/// \note Both Serialize::Encoder and Serialize::Decoder can be layered on top.
+struct RX_API CompressedStream
+  : Context
+{
+  RX_MARK_NO_COPY(CompressedStream);
+
+  /// Default uncompressed size of a block.
+  static constexpr const Uint32 BLOCK_SIZE = 64_KiB;
+
+  /// \brief Move construct a compressed stream.
+  /// \param compressed_stream_ The compressed stream to move from.
+  CompressedStream(CompressedStream&& compressed_stream_);
+
+  /// \brief Destroy a compressed stream.
+  /// \note Will call on_flush() when writing, asserting if the flush fails.
+  ~CompressedStream();
+
+  /// \brief Moves the compressed stream.
+  /// \param compressed_stream_ Another compressed stream.
+  /// \returns \c *this.
+  CompressedStream& operator=(CompressedStream&& compressed_stream_);
+
+  /// \brief Create a compressed stream for writing.
+  ///
+  /// \param _allocator The allocator to use for blocks.
+  /// \param _stream The stream to write compressed contents into, from the
+  /// beginning. Must outlive the compressed stream.
+  /// \param _scheduler Where to compress blocks. When \c nullptr, blocks are
+  /// compressed as they are written.
+  /// \param _block_size The uncompressed size of a block.
+  /// \returns The CompressedStream on success, nullopt otherwise.
+  static Optional<CompressedStream> create(Memory::Allocator& _allocator,
+    Context& _stream, Concurrency::Scheduler* _scheduler = nullptr,
+    Uint32 _block_size = BLOCK_SIZE);
+
+  /// \brief Open a compressed stream for reading.
+  ///
+  /// \param _allocator The allocator to use for blocks.
+  /// \param _stream The stream with compressed contents. Must outlive the
+  /// compressed stream.
+  /// \returns The CompressedStream on success, nullopt when \p _stream does
+  /// not contain valid compressed contents.
+  static Optional<CompressedStream> open(Memory::Allocator& _allocator,
+    Context& _stream);
+
+  /// \brief The name of the underlying stream.
+  virtual const String& name() const &;
+
+  /// \brief Read data.
+  /// Reads \p _size bytes from the stream at \p _offset into \p data_.
+  /// \returns The number of bytes actually read from \p _offset into \p data_.
+  virtual Uint64 on_read(Byte* data_, Uint64 _size, Uint64 _offset);
+
+  /// \brief Write data.
+  /// Writes \p _size bytes from \p _data into the steam at \p _offset.
+  /// \returns The number of bytes actually written at \p _offset from \p _data,
+  /// which stops short at blocks that have already been compressed.
+  virtual Uint64 on_write(const Byte* _data, Uint64 _size, Uint64 _offset);
+
+  /// \brief Stat the stream for information.
+  /// \note The size is the uncompressed size.
+  virtual Optional<Stat> on_stat() const;
+
+  /// \brief Write out all blocks, the index and the header.
+  /// \returns On a successful flush, \c true. Otherwise, \c false.
+  virtual bool on_flush();
+
+  /// \brief The size of the compressed contents in the underlying stream.
+  Uint64 compressed_size() const;
+
+private:
+  struct Job;
+
+  struct Entry {
+    Uint64 offset; // Offset of the block in |m_stream|.
+    Uint32 size;   // Size of the block in |m_stream|.
+    Uint32 flags;  // STORED when not compressed.
+  };
+
+  CompressedStream(Memory::Allocator& _allocator, Uint32 _flags,
+    Context& _stream, Concurrency::Scheduler* _scheduler, Uint32 _block_size);
+
+  void release();
+
+  Uint32 block_size(Uint64 _block) const;
+  bool decode_block(Uint64 _block, Byte* data_);
+
+  Job* acquire_job();
+  Job* open_block(Uint64 _block);
+  bool commit_block();
+  bool write_jobs(Size _in_flight);
+  bool write_block(const Job& _job, Uint32 _compressed_size, Uint64 _offset);
+
+  Memory::Allocator* m_allocator;
+  Context* m_stream;
+  Concurrency::Scheduler* m_scheduler;
+  Vector<Entry> m_index;
+  Uint64 m_size;
+  Uint32 m_block_size;
+
+  // Reading.
+  LinearBuffer m_block;
+  LinearBuffer m_scratch;
+  Span<const Byte> m_view;
+  Uint64 m_block_no;
+
+  // Writing. Blocks still open for writing begin with |m_open_block|, those
+  // being compressed are in |m_flight| in the order they are to be written.
+  Vector<Job*> m_open;
+  Vector<Job*> m_flight;
+  Vector<Job*> m_free;
+  Uint64 m_open_block;
+  Uint64 m_write_offset;
+};
+
+inline const String& CompressedStream::name() const & {
+  return m_stream->name();
+}
+
+inline Uint64 CompressedStream::compressed_size() const {
+  return m_write_offset;
+}
+
+} // namespace Rx::Stream
+
+#endif // RX_CORE_STREAM_COMPRESSED_STREAM_H
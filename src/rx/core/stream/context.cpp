@@ -32,6 +32,10 @@ bool Context::on_truncate(Uint64) {
   abort("Stream does not implement on_truncate");
 }
 
+Optional<Span<const Byte>> Context::on_view() {
+  abort("Stream does not implement on_view");
+}
+
 Uint64 Context::on_zero(Uint64 _size, Uint64 _offset) {
   // 4 KiB of zeros written in a loop.
   Byte zero[4096] = {0};
@@ -154,6 +158,20 @@ Optional<LinearBuffer> Context::read_binary(Memory::Allocator& _allocator) {
   return result;
 }
 
+Optional<BinaryView> Context::view_binary(Memory::Allocator& _allocator) {
+  if (m_flags & VIEW) {
+    if (auto view = on_view()) {
+      return BinaryView{*view};
+    }
+  }
+
+  if (auto data = read_binary(_allocator)) {
+    return BinaryView{Utility::move(*data)};
+  }
+
+  return nullopt;
+}
+
 Optional<LinearBuffer> Context::read_text(Memory::Allocator& _allocator) {
   if (auto result = read_binary(_allocator)) {
     // Convert the given byte stream into a compatible UTF-8 encoding. This will
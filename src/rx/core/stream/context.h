@@ -2,6 +2,7 @@
 #define RX_CORE_STREAM_UNTRACKED_STREAM_H
 #include "rx/core/linear_buffer.h"
 #include "rx/core/optional.h"
+#include "rx/core/span.h"
 
 #include "rx/core/stream/operations.h"
 
@@ -12,6 +13,39 @@ namespace Rx {
 /// Stream IO.
 namespace Rx::Stream {
 
+/// \brief Binary contents of a stream.
+///
+/// Refers directly to the memory of a stream that supports VIEW, otherwise
+/// owns a copy of the contents. Either way the contents are accessed the same.
+struct RX_API BinaryView {
+  RX_MARK_NO_COPY(BinaryView);
+
+  /// \brief Construct a view that borrows memory.
+  /// \param _view The memory, must outlive the view.
+  BinaryView(Span<const Byte> _view);
+
+  /// \brief Construct a view that owns a copy.
+  /// \param buffer_ The contents to take ownership of.
+  BinaryView(LinearBuffer&& buffer_);
+
+  /// \brief Move constructor.
+  BinaryView(BinaryView&& view_);
+
+  /// Pointer to the contents.
+  const Byte* data() const;
+  /// Size of the contents in bytes.
+  Size size() const;
+  /// The contents as a span.
+  Span<const Byte> span() const;
+
+  /// Check if the contents are borrowed rather than owned.
+  bool is_borrowed() const;
+
+private:
+  Optional<LinearBuffer> m_buffer;
+  Span<const Byte> m_view;
+};
+
 /// \brief Stream context.
 ///
 /// A Context is an interface that "stream-like" types can implement to
@@ -47,6 +81,16 @@ struct RX_API Context {
   /// contents. Otherwise, \c nullopt.
   Optional<LinearBuffer> read_binary(Memory::Allocator& _allocator);
 
+  /// \brief View the contents of the stream as binary.
+  ///
+  /// When the stream supports VIEW the contents are not copied and the view
+  /// refers directly to the memory of the stream, which remains valid only as
+  /// long as the stream is. Otherwise this behaves like read_binary().
+  ///
+  /// \param _allocator The allocator to use when the contents must be copied.
+  /// \returns On a successful call, the contents. Otherwise, \c nullopt.
+  Optional<BinaryView> view_binary(Memory::Allocator& _allocator);
+
   /// \brief Read the contents of the stream as text.
   ///
   /// This function interprets the contents of the stream as text and performs
@@ -98,10 +142,52 @@ struct RX_API Context {
   /// \returns On a successful truncation, \c true. Otherwise, \c false.
   virtual bool on_truncate(Uint64 _size);
 
+  /// \brief View the contents in place.
+  /// \returns On success, the entire contents of the stream. Otherwise,
+  /// \c nullopt.
+  virtual Optional<Span<const Byte>> on_view();
+
 protected:
   Uint32 m_flags;
 };
 
+// [BinaryView]
+inline BinaryView::BinaryView(Span<const Byte> _view)
+  : m_view{_view}
+{
+}
+
+inline BinaryView::BinaryView(LinearBuffer&& buffer_)
+  : m_buffer{Utility::move(buffer_)}
+  , m_view{nullptr, 0}
+{
+}
+
+inline BinaryView::BinaryView(BinaryView&& view_)
+  : m_buffer{Utility::move(view_.m_buffer)}
+  , m_view{Utility::exchange(view_.m_view, Span<const Byte>{nullptr, 0})}
+{
+}
+
+// The owned buffer may use in-situ storage which moves with it, so the
+// pointer is never cached.
+inline const Byte* BinaryView::data() const {
+  return m_buffer ? m_buffer->data() : m_view.data();
+}
+
+inline Size BinaryView::size() const {
+  return m_buffer ? m_buffer->size() : m_view.size();
+}
+
+inline Span<const Byte> BinaryView::span() const {
+  return {data(), size()};
+}
+
+inline bool BinaryView::is_borrowed() const {
+  return !m_buffer;
+}
+
+// [Context]
 inline constexpr Context::Context(Uint32 _flags)
   : m_flags{_flags}
 {
@@ -13,7 +13,7 @@ Uint64 MemoryStream::on_read(Byte* data_, Uint64 _size, Uint64 _offset) {
     return 0;
   }
   const auto bytes = Algorithm::min(_size, m_size - _offset);
-  Memory::copy(data_, m_data + _offset, _size);
+  Memory::copy(data_, m_data + _offset, bytes);
   return bytes;
 }
 
@@ -25,18 +25,23 @@ Uint64 MemoryStream::on_write(const Byte* _data, Uint64 _size, Uint64 _offset) {
 
   const auto bytes = Algorithm::min(_size, m_capacity - _offset);
 
-  // The write would expand the size.
+  // Zero the contents in range [m_size, _offset) when writing past the end.
   if (_offset > m_size) {
-    // Zero the contents in range [m_size, _offset).
     Memory::zero(m_data + m_size, _offset - m_size);
-    m_size = _offset + bytes;
   }
 
-  Memory::copy(m_data + _offset, _data, _size);
+  // The write would expand the size.
+  m_size = Algorithm::max(m_size, _offset + bytes);
+
+  Memory::copy(m_data + _offset, _data, bytes);
 
   return bytes;
 }
 
+Optional<Span<const Byte>> MemoryStream::on_view() {
+  return Span<const Byte>{m_data, m_size};
+}
+
 Optional<Stat> MemoryStream::on_stat() const {
   return Stat { m_size };
 }
@@ -57,6 +57,10 @@ struct MemoryStream
   /// \returns The number of bytes actually copied.
   virtual Uint64 on_copy(Uint64 _dst_offset, Uint64 _src_offset, Uint64 _size);
 
+  /// \brief View the contents in place.
+  /// \returns The memory given to the stream, up to the current size.
+  virtual Optional<Span<const Byte>> on_view();
+
   /// The name of the stream.
   virtual const String& name() const &;
 
@@ -68,7 +72,7 @@ private:
 };
 
 inline MemoryStream::MemoryStream(String&& name_, Span<const Byte> _span)
-  : Context{READ | STAT | TRUNCATE}
+  : Context{READ | STAT | TRUNCATE | VIEW}
   , m_data{const_cast<Byte*>(_span.data())}
   , m_capacity{_span.size()}
   , m_size{_span.size()}
@@ -77,7 +81,7 @@ inline MemoryStream::MemoryStream(String&& name_, Span<const Byte> _span)
 }
 
 inline MemoryStream::MemoryStream(String&& name_, Span<Byte> span_)
-  : Context{READ | WRITE | STAT}
+  : Context{READ | WRITE | STAT | VIEW}
   , m_data{span_.data()}
   , m_capacity{span_.size()}
   , m_size{0}
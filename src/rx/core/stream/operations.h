@@ -20,7 +20,8 @@ enum : Uint32 {
   WRITE    = 1 << 1, //< Stream supports write operations.
   STAT     = 1 << 3, //< Stream supports stat operations.
   FLUSH    = 1 << 4, //< Stream supports flush operations.
-  TRUNCATE = 1 << 5  //< Stream supports truncate operation.
+  TRUNCATE = 1 << 5, //< Stream supports truncate operation.
+  VIEW     = 1 << 6  //< Stream supports viewing its contents in place.
 };
 
 /// \brief Relative location for TrackedStream seeks.
@@ -14,6 +14,9 @@
 #include "rx/display.h"
 
 #include "rx/core/abort.h"
+#include "rx/core/filesystem/cache.h"
+#include "rx/core/filesystem/watcher.h"
+#include "rx/core/filesystem/vfs.h"
 
 #if defined(RX_PLATFORM_EMSCRIPTEN)
 #include <emscripten.h>
@@ -150,6 +153,32 @@ RX_CONSOLE_SVAR(
   "path to the application icon",
   "base/icon.png");
 
+RX_CONSOLE_SVAR(
+  filesystem_pack,
+  "filesystem.pack",
+  "pack to load files from before the file system, see the packer tool",
+  "");
+
+RX_CONSOLE_SVAR(
+  filesystem_cache,
+  "filesystem.cache",
+  "directory to cache processed assets in, empty to disable",
+  "cache");
+
+RX_CONSOLE_IVAR(
+  filesystem_cache_size,
+  "filesystem.cache_size",
+  "most MiB of processed assets to cache",
+  0,
+  65536,
+  1024);
+
+RX_CONSOLE_SVAR(
+  filesystem_watch,
+  "filesystem.watch",
+  "directory to watch for edited assets to reload, empty to disable",
+  "base");
+
 static constexpr const char* CONFIG = "config.cfg";
 
 RX_LOG("engine", logger);
@@ -181,6 +210,14 @@ Engine::~Engine() {
   SDL_DestroyWindow(static_cast<SDL_Window*>(m_window));
 
   SDL_QuitSubSystem(SDL_INIT_VIDEO);
+
+  Filesystem::Watcher::instance().unwatch();
+  Filesystem::Cache::instance().disable();
+  Filesystem::VFS::instance().set_async_io(nullptr);
+
+  if (!filesystem_pack->get().is_empty()) {
+    (void)Filesystem::VFS::instance().unmount(filesystem_pack->get());
+  }
 }
 
 bool Engine::init() {
@@ -194,6 +231,15 @@ bool Engine::init() {
 
   auto& allocator = Memory::SystemAllocator::instance();
 
+  // Mount the pack before anything is loaded, so it's loaded from the pack.
+  Globals::find("system")->find("vfs")->init();
+  if (const auto& pack_name = filesystem_pack->get(); !pack_name.is_empty()) {
+    auto pack = Filesystem::Pack::open(allocator, pack_name);
+    if (!pack || !Filesystem::VFS::instance().mount(Utility::move(*pack))) {
+      return false;
+    }
+  }
+
   const Size static_pool_size = *thread_pool_static_pool_size;
 
   // Determine how many threads the Emscripten pool was preallocated with.
@@ -212,9 +258,19 @@ bool Engine::init() {
 
   m_thread_pool = Utility::move(*thread_pool);
 
-  // Setup all the loggers to emit to our console.
+  // Buffered files read ahead in the background.
+  if (auto async_io = Filesystem::AsyncIO::create(allocator, m_thread_pool)) {
+    m_async_io = Utility::move(*async_io);
+    Filesystem::VFS::instance().set_async_io(&m_async_io);
+  } else {
+    logger->warning("files will not be read ahead in the background");
+  }
+
+  // Setup all the loggers to emit to our console. This is done as messages are
+  // written rather than queued so that the formatting is left to the logging
+  // thread.
   Globals::find("loggers")->each([&](GlobalNode* _logger) {
-    auto on_queue = _logger->cast<Rx::Log>()->on_queue(
+    auto on_write = _logger->cast<Rx::Log>()->on_write(
       [&](Log::Level _level, const String& _message) {
         switch (_level) {
         case Log::Level::ERROR:
@@ -234,14 +290,29 @@ bool Engine::init() {
       }
     );
 
-    if (on_queue) {
-      m_logging_event_handles.push_back(Utility::move(*on_queue));
+    if (on_write) {
+      m_logging_event_handles.push_back(Utility::move(*on_write));
     }
   });
 
   // Initialize any other globals not already initialized.
   Globals::init();
 
+  // Enable the cache of processed assets before any are loaded.
+  if (const auto& cache_path = filesystem_cache->get(); !cache_path.is_empty()) {
+    const auto capacity = Uint64(*filesystem_cache_size) * 1_MiB;
+    if (capacity && !Filesystem::Cache::instance().enable(cache_path, capacity)) {
+      logger->warning("assets will not be cached");
+    }
+  }
+
+  // Watch for edits to assets, so they're reloaded without restarting.
+  if (const auto& watch_path = filesystem_watch->get(); !watch_path.is_empty()) {
+    if (!Filesystem::Watcher::instance().watch(watch_path)) {
+      logger->warning("assets will not be reloaded");
+    }
+  }
+
   auto cmd_reset = Console::Command::Delegate::create(
     [](Console::Context& console_, const Vector<Console::Command::Argument>& _arguments) {
       if (auto* variable = console_.find_variable_by_name(_arguments[0].as_string)) {
@@ -675,6 +746,9 @@ Engine::Status Engine::integrate() {
 }
 
 Engine::Status Engine::run() {
+  // Reload what was edited before it's used this frame.
+  Filesystem::Watcher::instance().poll();
+
   const auto update_rate = 1.0 / Float64(app_update_hz->get());
   m_accumulator += m_render_frontend->timer().delta_time();
   while (m_accumulator >= update_rate) {
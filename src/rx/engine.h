@@ -5,6 +5,8 @@
 
 #include "rx/core/concurrency/thread_pool.h"
 
+#include "rx/core/filesystem/async_io.h"
+
 #include "rx/console/context.h"
 #include "rx/console/variable.h"
 
@@ -74,6 +76,9 @@ protected:
   // Thread pool
   Concurrency::ThreadPool m_thread_pool;
 
+  // Asynchronous I/O, reads with |m_thread_pool| when the kernel can't.
+  Filesystem::AsyncIO m_async_io;
+
   Float64 m_accumulator;
 };
 
@@ -125,6 +125,8 @@ void RenderStats::render() {
   render_number("points", frontend.points());
   render_number("lines", frontend.lines());
   render_number("triangles", frontend.triangles());
+  render_number("triangles saved", frontend.triangles_saved());
+  render_number("skinning saved", frontend.skinning_saved());
   render_number("vertices", frontend.vertices());
   render_number("blits", frontend.blit_calls());
   render_number("clears", frontend.clear_calls());
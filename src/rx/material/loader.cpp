@@ -1,4 +1,4 @@
-#include "rx/core/filesystem/unbuffered_file.h"
+#include "rx/core/filesystem/vfs.h"
 #include "rx/core/concurrency/thread_pool.h"
 #include "rx/core/concurrency/wait_group.h"
 #include "rx/core/serialize/json.h"
@@ -14,6 +14,7 @@ Loader::Loader(Memory::Allocator& _allocator)
   : m_allocator{&_allocator}
   , m_textures{allocator()}
   , m_name{allocator()}
+  , m_file{allocator()}
   , m_flags{0}
   , m_roughness{1.0f}
   , m_metalness{0.0f}
@@ -28,6 +29,7 @@ Loader::Loader(Loader&& loader_)
   : m_allocator{&loader_.allocator()}
   , m_textures{Utility::move(loader_.m_textures)}
   , m_name{Utility::move(loader_.m_name)}
+  , m_file{Utility::move(loader_.m_file)}
   , m_flags{Utility::exchange(loader_.m_flags, 0)}
   , m_roughness{Utility::exchange(loader_.m_roughness, 1.0f)}
   , m_metalness{Utility::exchange(loader_.m_metalness, 0.0f)}
@@ -43,6 +45,7 @@ Loader& Loader::operator=(Loader&& loader_) {
     m_allocator = &loader_.allocator();
     m_textures = Utility::move(loader_.m_textures);
     m_name = Utility::move(loader_.m_name);
+    m_file = Utility::move(loader_.m_file);
     m_flags = Utility::exchange(loader_.m_flags, 0);
     m_roughness = Utility::exchange(loader_.m_roughness, 1.0f);
     m_metalness = Utility::exchange(loader_.m_metalness, 0.0f);
@@ -66,7 +69,14 @@ bool Loader::load(Stream::Context& _stream) {
 }
 
 bool Loader::load(const StringView& _file_name) {
-  if (auto file = Filesystem::UnbufferedFile::open(allocator(), _file_name, "r")) {
+  auto file_name = _file_name.to_string(allocator());
+  if (!file_name) {
+    return false;
+  }
+
+  m_file = Utility::move(*file_name);
+
+  if (auto file = Filesystem::open_file(allocator(), _file_name)) {
     return load(*file);
   }
   return false;
@@ -29,6 +29,8 @@ struct Loader {
   constexpr Memory::Allocator& allocator() const;
   const Vector<Texture>& textures() const;
   const String& name() const;
+  // The file the material was loaded from, empty when it's from a definition.
+  const String& file() const;
   bool alpha_test() const;
   bool no_compress() const;
   Float32 roughness() const;
@@ -49,6 +51,7 @@ private:
   Memory::Allocator* m_allocator;
   Vector<Texture> m_textures;
   String m_name;
+  String m_file;
   Uint32 m_flags;
   Float32 m_roughness;
   Float32 m_metalness;
@@ -71,6 +74,10 @@ inline const String& Loader::name() const {
   return m_name;
 }
 
+inline const String& Loader::file() const {
+  return m_file;
+}
+
 inline bool Loader::alpha_test() const {
   return m_flags & ALPHA_TEST;
 }
@@ -1,8 +1,11 @@
-#include "rx/core/filesystem/unbuffered_file.h"
+#include "rx/core/filesystem/cache.h"
+#include "rx/core/filesystem/vfs.h"
+#include "rx/core/stream/memory_stream.h"
 
 #include "rx/core/algorithm/clamp.h"
 
-#include "rx/core/hash/djbx33a.h"
+#include "rx/core/memory/copy.h"
+#include "rx/core/utility/wire.h"
 #include "rx/core/serialize/json.h"
 
 #include "rx/math/transform.h"
@@ -17,6 +20,12 @@ RX_LOG("material/texture", logger);
 
 Texture::Texture(Memory::Allocator& _allocator)
   : m_allocator{&_allocator}
+  , m_min_filter{Filter::LINEAR}
+  , m_mag_filter{Filter::LINEAR}
+  , m_mipmap_mode{MipmapMode::NONE}
+  , m_address_mode_u{AddressMode::REPEAT}
+  , m_address_mode_v{AddressMode::REPEAT}
+  , m_type{Type::CUSTOM}
   , m_file{allocator()}
   , m_report{allocator(), *logger}
 {
@@ -34,7 +43,7 @@ bool Texture::load(Stream::Context& _stream) {
 }
 
 bool Texture::load(const StringView& _file_name) {
-  if (auto file = Filesystem::UnbufferedFile::open(allocator(), _file_name, "r")) {
+  if (auto file = Filesystem::open_file(allocator(), _file_name)) {
     return load(*file);
   }
   return false;
@@ -87,6 +96,14 @@ bool Texture::parse(const Serialize::JSON& _definition) {
   return load_texture_file({4096, 4096});
 }
 
+// Bumped whenever how a bitmap is produced changes, so that the cached ones
+// are not used.
+static constexpr const Uint32 BITMAP_VERSION = 1;
+
+// Cached bitmaps are a header of four Uint32: format, has mipchain, width and
+// height. Followed by the data.
+static constexpr const Size BITMAP_HEADER_SIZE = 16;
+
 bool Texture::load_texture_file(const Math::Vec2z& _max_dimensions) {
   Rx::Texture::PixelFormat want_format;
   switch (m_type) {
@@ -103,16 +120,114 @@ bool Texture::load_texture_file(const Math::Vec2z& _max_dimensions) {
     break;
   }
 
+  const bool want_mipchain = m_mipmap_mode != MipmapMode::NONE;
+
+  auto file = Filesystem::open_file(allocator(), m_file, Filesystem::FileKind::MAPPED);
+  if (!file) {
+    return m_report.error("failed to open file \"%s\"", m_file);
+  }
+
+  auto source = file->view_binary(allocator());
+  if (!source) {
+    return m_report.error("failed to read file \"%s\"", m_file);
+  }
+
+  // The bitmap is keyed by the file and everything else it's produced from.
+  const Uint32 parameters[] = {
+    BITMAP_VERSION,
+    Uint32(want_format),
+    Uint32(_max_dimensions.w),
+    Uint32(_max_dimensions.h),
+    want_mipchain
+  };
+
+  auto& cache = Filesystem::Cache::instance();
+  const auto key = Filesystem::Cache::key(source->span(),
+    {reinterpret_cast<const Byte*>(parameters), sizeof parameters});
+
+  m_bitmap.hash = key.digest;
+
+  if (auto entry = cache.find(key)) {
+    if (read_bitmap(entry->data(), want_format, _max_dimensions)) {
+      return true;
+    }
+    logger->warning("ignoring invalid cached bitmap of \"%s\"", m_file);
+  }
+
+  auto name = String::copy(m_file);
+  if (!name) {
+    return m_report.error("out of memory");
+  }
+
+  // Decode out of the view rather than reading the file again.
   Rx::Texture::Loader loader{allocator()};
-  if (!loader.load(m_file, want_format, _max_dimensions)) {
+  Stream::MemoryStream stream{Utility::move(*name), source->span()};
+  if (!loader.load(stream, want_format, _max_dimensions)) {
     return m_report.error("failed to load file \"%s\"", m_file);
   }
 
-  auto data = Utility::move(loader.data());
+  Rx::Texture::Chain chain{allocator()};
+  if (!chain.generate(Utility::move(loader), false, want_mipchain)) {
+    return m_report.error("out of memory");
+  }
+
+  m_bitmap.format = chain.format();
+  m_bitmap.dimensions = chain.dimensions();
+  m_bitmap.has_mipchain = want_mipchain;
+  m_bitmap.data = Utility::move(chain.data());
+
+  if (cache.is_enabled()) {
+    LinearBuffer data{allocator()};
+    if (!data.resize(BITMAP_HEADER_SIZE + m_bitmap.data.size())) {
+      return m_report.error("out of memory");
+    }
+    Utility::write_u32(data.data() + 0, Uint32(m_bitmap.format));
+    Utility::write_u32(data.data() + 4, m_bitmap.has_mipchain);
+    Utility::write_u32(data.data() + 8, Uint32(m_bitmap.dimensions.w));
+    Utility::write_u32(data.data() + 12, Uint32(m_bitmap.dimensions.h));
+    Memory::copy(data.data() + BITMAP_HEADER_SIZE, m_bitmap.data.data(), m_bitmap.data.size());
+    (void)cache.insert(key, {data.data(), data.size()});
+  }
+
+  return true;
+}
+
+bool Texture::read_bitmap(Span<const Byte> _data,
+  Rx::Texture::PixelFormat _format, const Math::Vec2z& _max_dimensions)
+{
+  if (_data.size() < BITMAP_HEADER_SIZE) {
+    return false;
+  }
+
+  const auto format = Utility::read_u32(_data.data() + 0);
+  const bool has_mipchain = Utility::read_u32(_data.data() + 4);
+  const Math::Vec2z dimensions{
+    Utility::read_u32(_data.data() + 8),
+    Utility::read_u32(_data.data() + 12)
+  };
+
+  if (format != Uint32(_format)
+    || dimensions.w == 0 || dimensions.w > _max_dimensions.w
+    || dimensions.h == 0 || dimensions.h > _max_dimensions.h)
+  {
+    return false;
+  }
+
+  const auto size = _data.size() - BITMAP_HEADER_SIZE;
+  const auto pixels = Rx::Texture::Chain::count_pixels(dimensions, has_mipchain);
+  if (pixels * Rx::Texture::bits_per_pixel(_format) / 8 != size) {
+    return false;
+  }
+
+  LinearBuffer data{allocator()};
+  if (!data.resize(size)) {
+    return false;
+  }
+  Memory::copy(data.data(), _data.data() + BITMAP_HEADER_SIZE, size);
 
-  m_bitmap.format = loader.format();
-  m_bitmap.dimensions = loader.dimensions();
-  m_bitmap.hash = Hash::djbx33a(data.data(), data.size());
+  m_bitmap.format = _format;
+  m_bitmap.dimensions = dimensions;
+  m_bitmap.has_mipchain = has_mipchain;
   m_bitmap.data = Utility::move(data);
 
   return true;
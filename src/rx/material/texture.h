@@ -50,6 +50,8 @@ struct Texture {
     Array<Byte[16]> hash;
     Rx::Texture::PixelFormat format;
     Math::Vec2z dimensions;
+    // When |data| has every level of the mipchain after the base level.
+    bool has_mipchain;
   };
 
   Texture(Memory::Allocator& _allocator);
@@ -76,6 +78,8 @@ struct Texture {
 
 private:
   bool load_texture_file(const Math::Vec2z& _max_dimensions);
+  bool read_bitmap(Span<const Byte> _data, Rx::Texture::PixelFormat _format,
+    const Math::Vec2z& _max_dimensions);
 
   [[nodiscard]] bool parse_type(const Serialize::JSON& _type);
   [[nodiscard]] bool parse_filter(const Serialize::JSON& _filter);
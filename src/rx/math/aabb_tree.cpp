@@ -0,0 +1,269 @@
+#include "rx/math/aabb_tree.h"
+
+#include "rx/core/algorithm/max.h"
+
+namespace Rx::Math {
+
+// Leaves are enlarged by this fraction of their size on every side.
+static constexpr const Float32 MARGIN = 0.1f;
+
+static AABB combine(const AABB& _a, const AABB& _b) {
+  return {min(_a.min(), _b.min()), max(_a.max(), _b.max())};
+}
+
+static Float32 area(const AABB& _aabb) {
+  const auto size = _aabb.max() - _aabb.min();
+  return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool contains(const AABB& _outer, const AABB& _inner) {
+  return _outer.min().x <= _inner.min().x
+      && _outer.min().y <= _inner.min().y
+      && _outer.min().z <= _inner.min().z
+      && _outer.max().x >= _inner.max().x
+      && _outer.max().y >= _inner.max().y
+      && _outer.max().z >= _inner.max().z;
+}
+
+static AABB enlarge(const AABB& _aabb) {
+  const auto margin = (_aabb.max() - _aabb.min()) * MARGIN;
+  return {_aabb.min() - margin, _aabb.max() + margin};
+}
+
+Optional<Uint32> AABBTree::allocate() {
+  if (m_free != NIL) {
+    const auto node = m_free;
+    m_free = m_nodes[node].parent;
+    return node;
+  }
+
+  if (!m_nodes.push_back({{}, NIL, NIL, NIL, 0, 0})) {
+    return nullopt;
+  }
+
+  return static_cast<Uint32>(m_nodes.size() - 1);
+}
+
+void AABBTree::release(Uint32 _node) {
+  auto& node = m_nodes[_node];
+  node.parent = m_free;
+  node.height = -1;
+  m_free = _node;
+}
+
+Optional<Uint32> AABBTree::insert(const AABB& _bounds, Uint32 _user) {
+  const auto leaf = allocate();
+  if (!leaf) {
+    return nullopt;
+  }
+
+  // Inserting a leaf takes a parent for it too, which is allocated here so
+  // that inserting cannot fail, nor can moving since removing a leaf frees
+  // its parent.
+  if (m_root != NIL) {
+    const auto parent = allocate();
+    if (!parent) {
+      release(*leaf);
+      return nullopt;
+    }
+    release(*parent);
+  }
+
+  auto& node = m_nodes[*leaf];
+  node.bounds = enlarge(_bounds);
+  node.parent = NIL;
+  node.left = NIL;
+  node.right = NIL;
+  node.user = _user;
+  node.height = 0;
+
+  insert_leaf(*leaf);
+  m_size++;
+
+  return *leaf;
+}
+
+bool AABBTree::move(Uint32 _proxy, const AABB& _bounds) {
+  RX_ASSERT(m_nodes[_proxy].is_leaf(), "not a proxy");
+
+  if (contains(m_nodes[_proxy].bounds, _bounds)) {
+    return false;
+  }
+
+  remove_leaf(_proxy);
+  m_nodes[_proxy].bounds = enlarge(_bounds);
+  insert_leaf(_proxy);
+
+  return true;
+}
+
+void AABBTree::remove(Uint32 _proxy) {
+  RX_ASSERT(m_nodes[_proxy].is_leaf(), "not a proxy");
+
+  remove_leaf(_proxy);
+  release(_proxy);
+  m_size--;
+}
+
+void AABBTree::clear() {
+  m_nodes.clear();
+  m_root = NIL;
+  m_free = NIL;
+  m_size = 0;
+}
+
+void AABBTree::insert_leaf(Uint32 _leaf) {
+  if (m_root == NIL) {
+    m_root = _leaf;
+    m_nodes[_leaf].parent = NIL;
+    return;
+  }
+
+  const auto nodes = m_nodes.data();
+  const auto bounds = nodes[_leaf].bounds;
+
+  // Descend to the sibling which adds the least surface area to the tree,
+  // counting the area every node above it grows by.
+  auto index = m_root;
+  while (!nodes[index].is_leaf()) {
+    const auto& node = nodes[index];
+    const auto node_area = area(node.bounds);
+    const auto combined_area = area(combine(node.bounds, bounds));
+
+    // The cost of a new parent for this node and the leaf.
+    const auto cost = 2.0f * combined_area;
+
+    // The cost added above the children of this node.
+    const auto inherited = 2.0f * (combined_area - node_area);
+
+    const auto cost_of = [&](Uint32 _child) {
+      const auto& child = nodes[_child];
+      const auto enlarged = area(combine(child.bounds, bounds));
+      return child.is_leaf()
+        ? enlarged + inherited
+        : enlarged - area(child.bounds) + inherited;
+    };
+
+    const auto cost_left = cost_of(node.left);
+    const auto cost_right = cost_of(node.right);
+    if (cost < cost_left && cost < cost_right) {
+      break;
+    }
+
+    index = cost_left < cost_right ? node.left : node.right;
+  }
+
+  // The parent was allocated when the leaf was inserted.
+  const auto sibling = index;
+  const auto old_parent = nodes[sibling].parent;
+  const auto new_parent = allocate();
+  RX_ASSERT(new_parent && m_nodes.data() == nodes, "no parent");
+
+  auto& parent = nodes[*new_parent];
+  parent.parent = old_parent;
+  parent.bounds = combine(bounds, nodes[sibling].bounds);
+  parent.height = nodes[sibling].height + 1;
+  parent.left = sibling;
+  parent.right = _leaf;
+  parent.user = NIL;
+
+  if (old_parent != NIL) {
+    auto& node = nodes[old_parent];
+    (node.left == sibling ? node.left : node.right) = *new_parent;
+  } else {
+    m_root = *new_parent;
+  }
+
+  nodes[sibling].parent = *new_parent;
+  nodes[_leaf].parent = *new_parent;
+
+  refit(old_parent);
+}
+
+void AABBTree::remove_leaf(Uint32 _leaf) {
+  if (_leaf == m_root) {
+    m_root = NIL;
+    return;
+  }
+
+  const auto nodes = m_nodes.data();
+  const auto parent = nodes[_leaf].parent;
+  const auto grand_parent = nodes[parent].parent;
+  const auto sibling =
+    nodes[parent].left == _leaf ? nodes[parent].right : nodes[parent].left;
+
+  // The sibling takes the place of the parent.
+  nodes[sibling].parent = grand_parent;
+  if (grand_parent != NIL) {
+    auto& node = nodes[grand_parent];
+    (node.left == parent ? node.left : node.right) = sibling;
+  } else {
+    m_root = sibling;
+  }
+
+  release(parent);
+  refit(grand_parent);
+}
+
+void AABBTree::refit(Uint32 _node) {
+  const auto nodes = m_nodes.data();
+  for (auto index = _node; index != NIL; index = nodes[index].parent) {
+    index = balance(index);
+
+    auto& node = nodes[index];
+    const auto& left = nodes[node.left];
+    const auto& right = nodes[node.right];
+    node.height = 1 + Algorithm::max(left.height, right.height);
+    node.bounds = combine(left.bounds, right.bounds);
+  }
+}
+
+Uint32 AABBTree::balance(Uint32 _node) {
+  const auto nodes = m_nodes.data();
+
+  auto& a = nodes[_node];
+  if (a.is_leaf() || a.height < 2) {
+    return _node;
+  }
+
+  const auto difference = nodes[a.right].height - nodes[a.left].height;
+  if (difference >= -1 && difference <= 1) {
+    return _node;
+  }
+
+  // The taller child is rotated up to take the place of |a|, which takes the
+  // shorter child of the promoted node in its place.
+  const bool promote_right = difference > 1;
+  auto& slot = promote_right ? a.right : a.left;
+  const auto other = promote_right ? a.left : a.right;
+  const auto promote = slot;
+
+  auto& b = nodes[promote];
+  const auto taller =
+    nodes[b.left].height > nodes[b.right].height ? b.left : b.right;
+  const auto shorter = taller == b.left ? b.right : b.left;
+
+  b.parent = a.parent;
+  if (b.parent != NIL) {
+    auto& parent = nodes[b.parent];
+    (parent.left == _node ? parent.left : parent.right) = promote;
+  } else {
+    m_root = promote;
+  }
+
+  b.left = _node;
+  b.right = taller;
+  a.parent = promote;
+
+  slot = shorter;
+  nodes[shorter].parent = _node;
+
+  a.bounds = combine(nodes[other].bounds, nodes[shorter].bounds);
+  a.height = 1 + Algorithm::max(nodes[other].height, nodes[shorter].height);
+  b.bounds = combine(a.bounds, nodes[taller].bounds);
+  b.height = 1 + Algorithm::max(a.height, nodes[taller].height);
+
+  return promote;
+}
+
+} // namespace Rx::Math
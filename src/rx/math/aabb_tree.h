@@ -0,0 +1,189 @@
+#ifndef RX_MATH_AABB_TREE_H
+#define RX_MATH_AABB_TREE_H
+#include "rx/core/vector.h"
+
+#include "rx/math/aabb.h"
+#include "rx/math/frustum.h"
+
+namespace Rx::Math {
+
+// Dynamic bounding volume hierarchy over bounds which move, like the objects
+// of a scene.
+//
+// Every bounds added is a leaf with a proxy to move or remove it by. Leaves
+// are enlarged by a fraction of their size so bounds moving a little do not
+// change the tree, and bounds moving further are removed and inserted again
+// where they add the least surface area, with the tree balanced on the way
+// back up [Catto 2009, Box2D]. Frustum queries skip the subtrees outside the
+// frustum and take the subtrees entirely inside without testing them further.
+struct AABBTree {
+  RX_MARK_NO_COPY(AABBTree);
+
+  AABBTree(Memory::Allocator& _allocator);
+  AABBTree(AABBTree&& tree_);
+  AABBTree& operator=(AABBTree&& tree_);
+
+  // Adds |_bounds| of |_user|, returning the proxy of it.
+  Optional<Uint32> insert(const AABB& _bounds, Uint32 _user);
+
+  // Moves |_proxy| to |_bounds|. Returns true when the tree changed.
+  bool move(Uint32 _proxy, const AABB& _bounds);
+
+  void remove(Uint32 _proxy);
+  void clear();
+
+  // Reserves memory for |_proxies| so that inserting as many cannot fail.
+  [[nodiscard]] bool reserve(Size _proxies);
+
+  // Calls |_function(user)| for every bounds which may be inside |_frustum|.
+  // This is conservative since the enlarged bounds are tested.
+  template<typename F>
+  void query(const Frustum& _frustum, F&& _function) const;
+
+  Uint32 user(Uint32 _proxy) const;
+  const AABB& bounds(Uint32 _proxy) const &;
+
+  Size size() const;
+  Size height() const;
+
+private:
+  static inline constexpr const Uint32 NIL = -1_u32;
+
+  // Nodes deeper than this are not reached since the tree is balanced.
+  static inline constexpr const Size MAX_DEPTH = 64;
+
+  struct Node {
+    AABB bounds;
+    Uint32 parent; // Next free node when free.
+    Uint32 left;
+    Uint32 right;
+    Uint32 user;
+    Sint32 height; // Zero for leaves, -1 when free.
+
+    bool is_leaf() const { return left == NIL; }
+  };
+
+  Optional<Uint32> allocate();
+  void release(Uint32 _node);
+
+  void insert_leaf(Uint32 _leaf);
+  void remove_leaf(Uint32 _leaf);
+
+  // Rotates the subtree at |_node| when one child is more than one taller
+  // than the other. Returns the node at the top of the subtree.
+  Uint32 balance(Uint32 _node);
+
+  // Refits the bounds and heights from |_node| up to the root.
+  void refit(Uint32 _node);
+
+  template<typename F>
+  void each_leaf(Uint32 _node, F&& _function) const;
+
+  Vector<Node> m_nodes;
+  Uint32 m_root;
+  Uint32 m_free;
+  Size m_size;
+};
+
+inline AABBTree::AABBTree(Memory::Allocator& _allocator)
+  : m_nodes{_allocator}
+  , m_root{NIL}
+  , m_free{NIL}
+  , m_size{0}
+{
+}
+
+inline AABBTree::AABBTree(AABBTree&& tree_)
+  : m_nodes{Utility::move(tree_.m_nodes)}
+  , m_root{Utility::exchange(tree_.m_root, NIL)}
+  , m_free{Utility::exchange(tree_.m_free, NIL)}
+  , m_size{Utility::exchange(tree_.m_size, 0)}
+{
+}
+
+inline AABBTree& AABBTree::operator=(AABBTree&& tree_) {
+  if (this != &tree_) {
+    m_nodes = Utility::move(tree_.m_nodes);
+    m_root = Utility::exchange(tree_.m_root, NIL);
+    m_free = Utility::exchange(tree_.m_free, NIL);
+    m_size = Utility::exchange(tree_.m_size, 0);
+  }
+  return *this;
+}
+
+template<typename F>
+void AABBTree::each_leaf(Uint32 _node, F&& _function) const {
+  const auto nodes = m_nodes.data();
+
+  Uint32 stack[MAX_DEPTH];
+  Size depth = 0;
+  stack[depth++] = _node;
+  while (depth) {
+    const auto& node = nodes[stack[--depth]];
+    if (node.is_leaf()) {
+      _function(node.user);
+    } else {
+      RX_ASSERT(depth + 2 <= MAX_DEPTH, "tree too deep");
+      stack[depth++] = node.right;
+      stack[depth++] = node.left;
+    }
+  }
+}
+
+template<typename F>
+void AABBTree::query(const Frustum& _frustum, F&& _function) const {
+  if (m_root == NIL) {
+    return;
+  }
+
+  const auto nodes = m_nodes.data();
+
+  Uint32 stack[MAX_DEPTH];
+  Size depth = 0;
+  stack[depth++] = m_root;
+  while (depth) {
+    const auto index = stack[--depth];
+    const auto& node = nodes[index];
+    switch (_frustum.intersect_aabb(node.bounds)) {
+    case Frustum::Intersection::OUTSIDE:
+      break;
+    case Frustum::Intersection::INSIDE:
+      each_leaf(index, _function);
+      break;
+    case Frustum::Intersection::PARTIAL:
+      if (node.is_leaf()) {
+        _function(node.user);
+      } else {
+        RX_ASSERT(depth + 2 <= MAX_DEPTH, "tree too deep");
+        stack[depth++] = node.right;
+        stack[depth++] = node.left;
+      }
+      break;
+    }
+  }
+}
+
+inline bool AABBTree::reserve(Size _proxies) {
+  // Every leaf but the first has a parent.
+  return m_nodes.reserve(_proxies * 2);
+}
+
+inline Uint32 AABBTree::user(Uint32 _proxy) const {
+  return m_nodes[_proxy].user;
+}
+
+inline const AABB& AABBTree::bounds(Uint32 _proxy) const & {
+  return m_nodes[_proxy].bounds;
+}
+
+inline Size AABBTree::size() const {
+  return m_size;
+}
+
+inline Size AABBTree::height() const {
+  return m_root == NIL ? 0 : m_nodes[m_root].height;
+}
+
+} // namespace Rx::Math
+
+#endif // RX_MATH_AABB_TREE_H
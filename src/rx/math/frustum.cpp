@@ -1,6 +1,12 @@
 #include "rx/math/frustum.h"
 #include "rx/math/aabb.h"
 
+#include "rx/core/math/abs.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace Rx::Math {
 
 Frustum::Frustum(const Mat4x4f& _view_projection) {
@@ -33,4 +39,169 @@ bool Frustum::is_aabb_inside(const AABB& _aabb) const {
   return true;
 }
 
+Frustum::Intersection Frustum::intersect_aabb(const AABB& _aabb) const {
+  const auto& min{_aabb.min()};
+  const auto& max{_aabb.max()};
+  auto result = Intersection::INSIDE;
+  for (Size i{0}; i < 6; i++) {
+    const auto& plane{m_planes[i]};
+    const auto& normal{plane.normal()};
+    // The corners furthest along and against the normal.
+    const Float32 furthest{normal.x * (normal.x < 0.0f ? min.x : max.x) +
+                           normal.y * (normal.y < 0.0f ? min.y : max.y) +
+                           normal.z * (normal.z < 0.0f ? min.z : max.z)};
+    if (furthest <= plane.distance()) {
+      return Intersection::OUTSIDE;
+    }
+    const Float32 nearest{normal.x * (normal.x < 0.0f ? max.x : min.x) +
+                          normal.y * (normal.y < 0.0f ? max.y : min.y) +
+                          normal.z * (normal.z < 0.0f ? max.z : min.z)};
+    if (nearest <= plane.distance()) {
+      result = Intersection::PARTIAL;
+    }
+  }
+  return result;
+}
+
+// Writes |_index| to the end of |indices_| and keeps it only when |_inside|,
+// which saves a branch that is hard to predict.
+static inline Size append(Uint32* indices_, Size _count, Size _index,
+  bool _inside)
+{
+  indices_[_count] = static_cast<Uint32>(_index);
+  return _count + _inside;
+}
+
+#if defined(__SSE2__)
+// The planes with every component in all four lanes.
+struct Planes4 {
+  Planes4(const Plane (&_planes)[6]);
+  __m128 normal[6][3];
+  __m128 absolute[6][3];
+  __m128 distance[6];
+};
+
+Planes4::Planes4(const Plane (&_planes)[6]) {
+  for (Size i = 0; i < 6; i++) {
+    const auto& plane = _planes[i];
+    for (Size j = 0; j < 3; j++) {
+      normal[i][j] = _mm_set1_ps(plane.normal()[j]);
+      absolute[i][j] = _mm_set1_ps(abs(plane.normal()[j]));
+    }
+    distance[i] = _mm_set1_ps(plane.distance());
+  }
+}
+
+static inline __m128 dot(const __m128 (&_a)[3], __m128 _x, __m128 _y,
+  __m128 _z)
+{
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_a[0], _x), _mm_mul_ps(_a[1], _y)),
+    _mm_mul_ps(_a[2], _z));
+}
+
+static inline Size append4(Uint32* indices_, Size _count, Size _index,
+  int _mask)
+{
+  for (Size i = 0; i < 4; i++) {
+    _count = append(indices_, _count, _index + i, _mask & (1 << i));
+  }
+  return _count;
+}
+#endif
+
+// Boxes are tested like |is_aabb_inside|, with the distance of the corner
+// furthest along the normal found from the center and extent.
+Size Frustum::cull(const Boxes& _boxes, Size _count, Uint32* indices_) const {
+  const auto center_x = _boxes.center[0];
+  const auto center_y = _boxes.center[1];
+  const auto center_z = _boxes.center[2];
+  const auto extent_x = _boxes.extent[0];
+  const auto extent_y = _boxes.extent[1];
+  const auto extent_z = _boxes.extent[2];
+
+  Size count = 0;
+  Size i = 0;
+
+#if defined(__SSE2__)
+  const Planes4 planes{m_planes};
+  for (; i + 4 <= _count; i += 4) {
+    const auto x = _mm_loadu_ps(center_x + i);
+    const auto y = _mm_loadu_ps(center_y + i);
+    const auto z = _mm_loadu_ps(center_z + i);
+    const auto ex = _mm_loadu_ps(extent_x + i);
+    const auto ey = _mm_loadu_ps(extent_y + i);
+    const auto ez = _mm_loadu_ps(extent_z + i);
+    auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (Size j = 0; j < 6; j++) {
+      const auto furthest = _mm_add_ps(dot(planes.normal[j], x, y, z),
+        dot(planes.absolute[j], ex, ey, ez));
+      inside = _mm_and_ps(inside, _mm_cmpgt_ps(furthest, planes.distance[j]));
+    }
+    count = append4(indices_, count, i, _mm_movemask_ps(inside));
+  }
+#endif
+
+  Vec3f absolute[6];
+  for (Size j = 0; j < 6; j++) {
+    const auto& normal = m_planes[j].normal();
+    absolute[j] = {abs(normal.x), abs(normal.y), abs(normal.z)};
+  }
+
+  for (; i < _count; i++) {
+    bool inside = true;
+    for (Size j = 0; j < 6; j++) {
+      const auto& plane = m_planes[j];
+      const auto& normal = plane.normal();
+      const Float32 furthest =
+        normal.x * center_x[i] + normal.y * center_y[i] + normal.z * center_z[i] +
+        absolute[j].x * extent_x[i] + absolute[j].y * extent_y[i] +
+        absolute[j].z * extent_z[i];
+      inside &= furthest > plane.distance();
+    }
+    count = append(indices_, count, i, inside);
+  }
+
+  return count;
+}
+
+Size Frustum::cull(const Spheres& _spheres, Size _count, Uint32* indices_) const {
+  const auto center_x = _spheres.center[0];
+  const auto center_y = _spheres.center[1];
+  const auto center_z = _spheres.center[2];
+  const auto radius = _spheres.radius;
+
+  Size count = 0;
+  Size i = 0;
+
+#if defined(__SSE2__)
+  const Planes4 planes{m_planes};
+  for (; i + 4 <= _count; i += 4) {
+    const auto x = _mm_loadu_ps(center_x + i);
+    const auto y = _mm_loadu_ps(center_y + i);
+    const auto z = _mm_loadu_ps(center_z + i);
+    const auto r = _mm_loadu_ps(radius + i);
+    auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (Size j = 0; j < 6; j++) {
+      const auto furthest = _mm_add_ps(dot(planes.normal[j], x, y, z), r);
+      inside = _mm_and_ps(inside, _mm_cmpgt_ps(furthest, planes.distance[j]));
+    }
+    count = append4(indices_, count, i, _mm_movemask_ps(inside));
+  }
+#endif
+
+  for (; i < _count; i++) {
+    bool inside = true;
+    for (Size j = 0; j < 6; j++) {
+      const auto& plane = m_planes[j];
+      const auto& normal = plane.normal();
+      const Float32 furthest = normal.x * center_x[i] + normal.y * center_y[i] +
+        normal.z * center_z[i] + radius[i];
+      inside &= furthest > plane.distance();
+    }
+    count = append(indices_, count, i, inside);
+  }
+
+  return count;
+}
+
 } // namespace Rx::Math
@@ -8,10 +8,37 @@ namespace Rx::Math {
 struct AABB;
 
 struct Frustum {
+  enum class Intersection : Uint8 {
+    OUTSIDE,
+    PARTIAL,
+    INSIDE
+  };
+
   Frustum(const Mat4x4f& _view_projection);
 
   bool is_aabb_inside(const AABB& _aabb) const;
 
+  // Like the above but also distinguishes |_aabb| being entirely inside.
+  Intersection intersect_aabb(const AABB& _aabb) const;
+
+  // Many boxes or spheres with a component of each in every array, so that
+  // a few can be tested at once.
+  struct Boxes {
+    const Float32* center[3];
+    const Float32* extent[3]; // Half of the size.
+  };
+
+  struct Spheres {
+    const Float32* center[3];
+    const Float32* radius;
+  };
+
+  // Writes the index of every one of the first |_count| of |_boxes| inside
+  // the frustum to |indices_|, which has room for |_count|, in order. Returns
+  // the number of boxes inside. Four are tested at a time with SSE2.
+  Size cull(const Boxes& _boxes, Size _count, Uint32* indices_) const;
+  Size cull(const Spheres& _spheres, Size _count, Uint32* indices_) const;
+
 private:
   Plane m_planes[6];
 };
@@ -4,11 +4,25 @@
 #include "rx/model/loader.h"
 #include "rx/model/skeleton.h"
 
+#include "rx/core/concurrency/scheduler.h"
+#include "rx/core/concurrency/wait_group.h"
+
 #include "rx/core/math/abs.h"
 #include "rx/core/math/mod.h"
+#include "rx/core/math/sqrt.h"
+
+#include "rx/core/algorithm/min.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace Rx::Model {
 
+// The number of blocks of joints interpolated by a task at least, animations
+// are grouped until they have this many.
+static constexpr const Size BLOCKS_PER_TASK = 1024;
+
 Optional<Animation> Animation::create(Memory::Allocator& _allocator,
   Skeleton& _skeleton, const Clip& _clip)
 {
@@ -17,11 +31,16 @@ Optional<Animation> Animation::create(Memory::Allocator& _allocator,
   result.m_skeleton = &_skeleton;
   result.m_clip = &_clip;
 
-  if (!result.m_rendered_lb_frames.resize(_skeleton.lb_frames().size())) {
+  const auto n_joints = _skeleton.joints().size();
+  if (!result.m_rendered_lb_frames.resize(n_joints)) {
     return nullopt;
   }
 
-  if (!result.m_rendered_dq_frames.resize(_skeleton.dq_frames().size())) {
+  if (!result.m_rendered_dq_frames.resize(n_joints)) {
+    return nullopt;
+  }
+
+  if (!result.m_cache.prepare(_skeleton)) {
     return nullopt;
   }
 
@@ -29,62 +48,208 @@ Optional<Animation> Animation::create(Memory::Allocator& _allocator,
 }
 
 void Animation::update(Float32 _delta_time, bool _loop) {
-  if (m_completed) {
+  if (m_cursor.advance(*m_clip, _delta_time, _loop)) {
+    interpolate();
+  }
+}
+
+void Animation::update(Concurrency::Scheduler& _scheduler,
+  Span<Animation*> animations_, Float32 _delta_time, bool _loop)
+{
+  const auto animations = animations_.data();
+  const auto n_animations = animations_.size();
+
+  const auto update_group = [&](Size _begin, Size _end) {
+    for (Size i = _begin; i < _end; i++) {
+      animations[i]->update(_delta_time, _loop);
+    }
+  };
+
+  // Calls |_function(begin, end)| for every group of animations with at
+  // least BLOCKS_PER_TASK blocks of joints, except for the last one.
+  const auto each_group = [&](auto&& _function) {
+    for (Size i = 0, begin = 0, blocks = 0; i < n_animations; i++) {
+      blocks += animations[i]->m_skeleton->blocks_per_frame();
+      if (blocks >= BLOCKS_PER_TASK || i == n_animations - 1) {
+        _function(begin, i + 1);
+        begin = i + 1;
+        blocks = 0;
+      }
+    }
+  };
+
+  Size n_groups = 0;
+  each_group([&](Size, Size) { n_groups++; });
+
+  // Not worth a task.
+  if (n_groups <= 1) {
+    update_group(0, n_animations);
     return;
   }
 
-  m_current_frame += m_clip->frame_rate * _delta_time;
+  Concurrency::WaitGroup group{n_groups};
+  each_group([&](Size _begin, Size _end) {
+    const bool added = _scheduler.add([&, _begin, _end](Sint32) {
+      update_group(_begin, _end);
+      group.signal();
+    });
 
-  const bool completes = m_current_frame >= m_clip->frame_count - 1;
-  const bool finished = completes && !_loop;
+    if (!added) {
+      update_group(_begin, _end);
+      group.signal();
+    }
+  });
 
-  m_current_frame = Math::mod(m_current_frame, static_cast<Float32>(m_clip->frame_count));
+  group.wait();
+}
+
+bool Animation::Cursor::advance(const Clip& _clip, Float32 _delta_time, bool _loop) {
+  if (completed) {
+    return false;
+  }
 
-  Size frame1 = finished ? m_clip->frame_count - 1 : static_cast<Size>(m_current_frame);
-  Size frame2 = finished ? m_clip->frame_count - 1 : frame1 + 1;
+  frame += _clip.frame_rate * _delta_time;
 
-  frame1 %= m_clip->frame_count;
-  frame2 %= m_clip->frame_count;
+  const bool completes = frame >= _clip.frame_count - 1;
+  const bool finished = completes && !_loop;
 
-  Math::Vec2z frame_indices;
-  frame_indices[0] = m_clip->frame_offset + frame1;
-  frame_indices[1] = m_clip->frame_offset + frame2;
+  frame = Math::mod(frame, static_cast<Float32>(_clip.frame_count));
+
+  Size frame1 = finished ? _clip.frame_count - 1 : static_cast<Size>(frame);
+  Size frame2 = finished ? _clip.frame_count - 1 : frame1 + 1;
+
+  frame1 %= _clip.frame_count;
+  frame2 %= _clip.frame_count;
 
   const Float32 offset =
-          finished ? 0.0f : Math::abs(m_current_frame - frame1);
+          finished ? 0.0f : Math::abs(frame - frame1);
 
-  m_interpolant.frame1 = frame1;
-  m_interpolant.frame2 = frame2;
-  m_interpolant.offset = offset;
+  interpolant.frame1 = frame1;
+  interpolant.frame2 = frame2;
+  interpolant.offset = offset;
 
-  const auto& lb_frames = m_skeleton->lb_frames();
-  const auto& dq_frames = m_skeleton->dq_frames();
+  if (completes) {
+    if (_loop) {
+      frame = 0.0f;
+    } else {
+      completed = true;
+    }
+  }
 
-  const auto n_joints = m_skeleton->joints().size();
+  return true;
+}
 
-  const auto* mat1 = &lb_frames[frame_indices[0] * n_joints];
-  const auto* mat2 = &lb_frames[frame_indices[1] * n_joints];
+// Interpolates the four joints of the blocks |_block1| and |_block2| by
+// |_offset|, writing the first |_joints| of them to |lb_| and |dq_|. Matrices
+// are interpolated linearly and dual quaternions along the shortest path,
+// with the real part normalized, four joints at a time.
+static void interpolate_block(const Skeleton::Block& _block1,
+  const Skeleton::Block& _block2, Float32 _offset, Size _joints,
+  Math::Mat3x4f* lb_, Math::DualQuatf* dq_)
+{
+#if defined(__SSE2__)
+  const auto t = _mm_set1_ps(_offset);
+  const auto s = _mm_set1_ps(1.0f - _offset);
 
-  const auto* dq1 = &dq_frames[frame_indices[0] * n_joints];
-  const auto* dq2 = &dq_frames[frame_indices[1] * n_joints];
+  // The matrices of the joints are after one another, so they're interpolated
+  // a row at a time.
+  const auto lb1 = &_block1.lb[0][0];
+  const auto lb2 = &_block2.lb[0][0];
+  auto lb = reinterpret_cast<Float32*>(lb_);
+  for (Size i = 0; i < _joints * 3; i++) {
+    const auto row = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(lb1 + i * 4), s),
+      _mm_mul_ps(_mm_loadu_ps(lb2 + i * 4), t));
+    _mm_storeu_ps(lb + i * 4, row);
+  }
 
-  // Interpolate matrices between the two closest frames.
-  for (Size i = 0; i < n_joints; i++) {
-    m_rendered_lb_frames[i] = mat1[i] * (1.0f - offset) + mat2[i] * offset;
+  __m128 dq1[8];
+  __m128 dq2[8];
+  for (Size i = 0; i < 8; i++) {
+    dq1[i] = _mm_loadu_ps(_block1.dq[i]);
+    dq2[i] = _mm_loadu_ps(_block2.dq[i]);
   }
 
-  // Interpolate DQs between the two closest frames.
-  for (Size i = 0; i < n_joints; i++) {
-    m_rendered_dq_frames[i] = dq1[i].lerp(dq2[i], offset);
-    m_rendered_dq_frames[i].real = Math::normalize(m_rendered_dq_frames[i].real);
+  // Negate the offset of the second when the real parts are more than a half
+  // turn apart.
+  auto dot = _mm_mul_ps(dq1[0], dq2[0]);
+  for (Size i = 1; i < 4; i++) {
+    dot = _mm_add_ps(dot, _mm_mul_ps(dq1[i], dq2[i]));
   }
+  const auto sign = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()),
+    _mm_set1_ps(-0.0f));
+  const auto k = _mm_xor_ps(t, sign);
 
-  if (completes) {
-    if (_loop) {
-      m_current_frame = 0.0f;
-    } else {
-      m_completed = true;
+  __m128 dq_rows[8];
+  for (Size i = 0; i < 8; i++) {
+    dq_rows[i] = _mm_add_ps(_mm_mul_ps(dq1[i], s), _mm_mul_ps(dq2[i], k));
+  }
+
+  auto length = _mm_mul_ps(dq_rows[0], dq_rows[0]);
+  for (Size i = 1; i < 4; i++) {
+    length = _mm_add_ps(length, _mm_mul_ps(dq_rows[i], dq_rows[i]));
+  }
+  const auto scale = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length));
+  for (Size i = 0; i < 4; i++) {
+    dq_rows[i] = _mm_mul_ps(dq_rows[i], scale);
+  }
+
+  // Transpose back to a joint in every row.
+  for (Size i = 0; i < 8; i += 4) {
+    _MM_TRANSPOSE4_PS(dq_rows[i], dq_rows[i + 1], dq_rows[i + 2], dq_rows[i + 3]);
+    for (Size lane = 0; lane < _joints; lane++) {
+      _mm_storeu_ps(reinterpret_cast<Float32*>(dq_ + lane) + i, dq_rows[i + lane]);
+    }
+  }
+#else
+  for (Size lane = 0; lane < _joints; lane++) {
+    auto lb = reinterpret_cast<Float32*>(lb_ + lane);
+    auto dq = reinterpret_cast<Float32*>(dq_ + lane);
+
+    for (Size i = 0; i < 12; i++) {
+      lb[i] =
+        _block1.lb[lane][i] * (1.0f - _offset) + _block2.lb[lane][i] * _offset;
     }
+
+    Float32 dot = 0.0f;
+    for (Size i = 0; i < 4; i++) {
+      dot += _block1.dq[i][lane] * _block2.dq[i][lane];
+    }
+    const auto k = dot < 0.0f ? -_offset : _offset;
+    for (Size i = 0; i < 8; i++) {
+      dq[i] =
+        _block1.dq[i][lane] * (1.0f - _offset) + _block2.dq[i][lane] * k;
+    }
+
+    Float32 length = 0.0f;
+    for (Size i = 0; i < 4; i++) {
+      length += dq[i] * dq[i];
+    }
+    const auto scale = 1.0f / Math::sqrt(length);
+    for (Size i = 0; i < 4; i++) {
+      dq[i] *= scale;
+    }
+  }
+#endif
+}
+
+void Animation::interpolate() {
+  const auto n_joints = m_skeleton->joints().size();
+  const auto n_blocks = m_skeleton->blocks_per_frame();
+
+  const auto& interpolant = m_cursor.interpolant;
+  const auto frame1 = m_clip->frame_offset + interpolant.frame1;
+  const auto frame2 = m_clip->frame_offset + interpolant.frame2;
+
+  const auto blocks1 = m_skeleton->frame_blocks(frame1, m_cache);
+  const auto blocks2 = m_skeleton->frame_blocks(frame2, m_cache);
+
+  auto lb_frames = m_rendered_lb_frames.data();
+  auto dq_frames = m_rendered_dq_frames.data();
+
+  for (Size i = 0; i < n_blocks; i++) {
+    const auto first = i * 4;
+    interpolate_block(blocks1[i], blocks2[i], interpolant.offset,
+      Algorithm::min(n_joints - first, 4_z), lb_frames + first, dq_frames + first);
   }
 }
 
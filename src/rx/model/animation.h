@@ -2,6 +2,7 @@
 #define RX_MODEL_ANIMATION_H
 #include "rx/core/vector.h"
 #include "rx/core/string.h"
+#include "rx/core/span.h"
 
 #include "rx/math/vec2.h"
 #include "rx/math/mat3x4.h"
@@ -9,10 +10,15 @@
 #include "rx/math/aabb.h"
 #include "rx/math/dual_quat.h"
 
+#include "rx/model/skeleton.h"
+
+namespace Rx::Concurrency {
+  struct Scheduler;
+} // namespace Rx::Concurrency
+
 namespace Rx::Model {
 
 struct Loader;
-struct Skeleton;
 
 struct Clip {
   Size index;
@@ -32,6 +38,17 @@ struct Animation {
     Float32 offset = 0;
   };
 
+  // The time in a clip.
+  struct Cursor {
+    // Advances the time by |_delta_time|, returning false when it's completed
+    // and the interpolant is unchanged.
+    bool advance(const Clip& _clip, Float32 _delta_time, bool _loop);
+
+    Float32 frame = 0.0f;
+    Interpolant interpolant;
+    bool completed = false;
+  };
+
   constexpr Animation(Memory::Allocator& _allocator);
   Animation(Animation&& animation_);
   Animation& operator=(Animation&& animation_);
@@ -41,6 +58,11 @@ struct Animation {
 
   void update(Float32 _delta_time, bool _loop);
 
+  // Updates every animation of |animations_| like the above, in groups of
+  // animations spread over |_scheduler|.
+  static void update(Concurrency::Scheduler& _scheduler,
+    Span<Animation*> animations_, Float32 _delta_time, bool _loop);
+
   Interpolant interpolant() const;
 
   const Vector<Math::Mat3x4f>& lb_frames() const &;
@@ -50,14 +72,18 @@ struct Animation {
   const Clip* clip() const;
 
 private:
+  // Interpolates the frames of every joint at the time of the animation.
+  void interpolate();
+
   const Skeleton* m_skeleton;
   const Clip* m_clip;
 
   Vector<Math::Mat3x4f> m_rendered_lb_frames;
   Vector<Math::DualQuatf> m_rendered_dq_frames;
-  Float32 m_current_frame;
-  Interpolant m_interpolant;
-  bool m_completed;
+  Cursor m_cursor;
+
+  // The frames interpolated, when compressed.
+  Skeleton::FrameCache m_cache;
 };
 
 inline constexpr Animation::Animation(Memory::Allocator& _allocator)
@@ -65,8 +91,7 @@ inline constexpr Animation::Animation(Memory::Allocator& _allocator)
   , m_clip{nullptr}
   , m_rendered_lb_frames{_allocator}
   , m_rendered_dq_frames{_allocator}
-  , m_current_frame{0.0f}
-  , m_completed{false}
+  , m_cache{_allocator}
 {
 }
 
@@ -75,9 +100,8 @@ inline Animation::Animation(Animation&& animation_)
   , m_clip{Utility::exchange(animation_.m_clip, nullptr)}
   , m_rendered_lb_frames{Utility::move(animation_.m_rendered_lb_frames)}
   , m_rendered_dq_frames{Utility::move(animation_.m_rendered_dq_frames)}
-  , m_current_frame{Utility::exchange(animation_.m_current_frame, 0.0f)}
-  , m_interpolant{Utility::move(animation_.m_interpolant)}
-  , m_completed{Utility::exchange(animation_.m_completed, false)}
+  , m_cursor{Utility::exchange(animation_.m_cursor, Cursor{})}
+  , m_cache{Utility::move(animation_.m_cache)}
 {
 }
 
@@ -87,15 +111,14 @@ inline Animation& Animation::operator=(Animation&& animation_) {
     m_clip = Utility::exchange(animation_.m_clip, nullptr);
     m_rendered_lb_frames = Utility::move(animation_.m_rendered_lb_frames);
     m_rendered_dq_frames = Utility::move(animation_.m_rendered_dq_frames);
-    m_current_frame = Utility::exchange(animation_.m_current_frame, 0.0f);
-    m_interpolant = Utility::move(animation_.m_interpolant);
-    m_completed = Utility::exchange(animation_.m_completed, false);
+    m_cursor = Utility::exchange(animation_.m_cursor, Cursor{});
+    m_cache = Utility::move(animation_.m_cache);
   }
   return *this;
 }
 
 inline Animation::Interpolant Animation::interpolant() const {
-  return m_interpolant;
+  return m_cursor.interpolant;
 }
 
 inline const Vector<Math::Mat3x4f>& Animation::lb_frames() const & {
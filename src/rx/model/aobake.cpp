@@ -2,6 +2,7 @@
 
 #include "rx/model/aobake.h"
 #include "rx/model/voxel.h"
+#include "rx/model/bvh.h"
 
 #include "rx/core/log.h"
 
@@ -9,13 +10,28 @@
 #include "rx/core/math/sin.h"
 #include "rx/core/math/cos.h"
 #include "rx/core/math/pow.h"
+#include "rx/core/math/sqrt.h"
+
+#include "rx/core/algorithm/min.h"
+#include "rx/core/algorithm/max.h"
+#include "rx/core/algorithm/clamp.h"
+
+#include "rx/core/memory/copy.h"
+#include "rx/core/memory/zero.h"
+
+#include "rx/core/hash/djbx33a.h"
+
+#include "rx/core/time/qpc.h"
 
 #include "rx/core/concurrency/scheduler.h"
 #include "rx/core/concurrency/wait_group.h"
+#include "rx/core/concurrency/atomic.h"
+#include "rx/core/concurrency/scope_lock.h"
+
+#include "rx/math/aabb.h"
 
 #include "rx/math/ray.h"
 
-#include "rx/core/random/mersenne_twister.h"
 
 namespace Rx::Model {
 
@@ -24,116 +40,178 @@ RX_LOG("model/aobake", logger);
 // Just the result of Math::sqrt(2.0) for brightness multiplier in |compute_ao|.
 static constexpr const auto SQRT_2 = 1.41421356237f;
 
+// Bumped whenever what's baked changes, so occlusion cached before is not used.
+static constexpr const Uint32 CACHE_VERSION = 1;
+
+// The vertices a task of a progressive bake traces at a time.
+static constexpr const Size PROGRESSIVE_BATCH = 64;
+
 // Small epsilon to start the ray slightly off the vertex to avoid
 // false self-occlusion.
 static constexpr const auto ORIGIN_OFFSET = 0.0001f;
 
-static Math::Vec3f random_unit_vec(Random::Context& _rng) {
-  const auto phi = _rng.f32() * Math::TAU<Float32>;
-  const auto cos_theta = _rng.f32() * 2.0f - 1.0f;
-  const auto theta = Math::acos(cos_theta);
+// The finalizer of SplitMix64, every bit of the result depends on every bit
+// of |_value|.
+static inline Uint64 mix(Uint64 _value) {
+  _value = (_value ^ (_value >> 30)) * 0xbf58476d1ce4e5b9_u64;
+  _value = (_value ^ (_value >> 27)) * 0x94d049bb133111eb_u64;
+  return _value ^ (_value >> 31);
+}
+
+// The random numbers of a ray are hashed from |_seed| and the index of the
+// ray rather than drawn in order, so any ray is generated without the ones
+// before it.
+static Math::Vec3f random_unit_vec(Uint64 _seed, Size _ray) {
+  const auto bits = mix(mix(_seed) + _ray);
+  const auto phi = Float32(bits >> 40) * (1.0f / 16777216.0f) * Math::TAU<Float32>;
+  const auto cos_theta = Float32((bits >> 8) & 0xffffff) * (2.0f / 16777216.0f) - 1.0f;
+  // Theta is in [0, pi] so the sine of it is never negative.
+  const auto sin_theta = Math::sqrt(Algorithm::max(1.0f - cos_theta * cos_theta, 0.0f));
   return {
-    Math::sin(theta) * Math::cos(phi),
-    Math::sin(theta) * Math::sin(phi),
-    Math::cos(theta)
+    sin_theta * Math::cos(phi),
+    sin_theta * Math::sin(phi),
+    cos_theta
   };
 }
 
-float compute_ao(const Vector<float>& _ray_results, Float32 _max_distance, Size _ray_count, Float32 _fall_off) {
-  Float32 brightness = 1.0f;
-  const auto inv_max_distance = 1.0f / _max_distance;
-  _ray_results.each_fwd([&](Float32 _distance) {
-    const auto normalized_distance = _distance * inv_max_distance;
-    const auto occlusion = 1.0f - Math::pow(normalized_distance, _fall_off);
-    brightness -= occlusion / _ray_count;
-  });
+// Occlusion of a ray hitting at |_distance|.
+static Float32 ray_occlusion(const Optional<Float32>& _distance,
+  Float32 _max_distance, Float32 _inv_max_distance, Float32 _fall_off)
+{
+  if (!_distance) {
+    return 0.0f;
+  }
+  const auto normalized_distance = Algorithm::min(*_distance, _max_distance) * _inv_max_distance;
+  return 1.0f - Math::pow(normalized_distance, _fall_off);
+}
+
+// The occlusion of a vertex from the total occlusion of |_rays| rays.
+static Float32 vertex_occlusion(Float32 _sum, Size _rays) {
+  const auto brightness = 1.0f - _sum / Float32(_rays);
   return Algorithm::min(1.0f, brightness * SQRT_2);
 }
 
-Optional<Vector<Float32>> bake_ao(
-  Concurrency::Scheduler& _scheduler,
-  const Math::AABB& _aabb,
-  const Vector<Math::Vec3f>& _positions,
-  const Vector<Uint32>& _elements,
-  const AoConfig& _config)
+// Traces the rays [|_first|, |_last|) of every vertex in [|_begin|, |_end|)
+// against |_tracer|, which is either of the Voxel or the Bvh, adding the
+// occlusion of each to |sums_|. The rays of every vertex are cast together so
+// they're traced in packets. Every vertex has its own random numbers so the
+// result does not depend on how the vertices and rays are split up.
+template<typename T>
+static bool trace_vertices(const T& _tracer,
+  const Vector<Math::Vec3f>& _positions, Size _begin, Size _end, Size _first,
+  Size _last, Float32 _max_distance, const AoConfig& _config, Float32* sums_)
 {
-  const auto max_distance = Math::length(_aabb.max() - _aabb.min());
+  auto& allocator = _positions.allocator();
+
+  const auto n_rays = _last - _first;
+  const auto inv_max_distance = 1.0f / _max_distance;
+  const auto fall_off = _max_distance * _config.fall_off;
 
-  Random::MersenneTwister random;
-  random.seed(_config.raytrace_seed);
+  Vector<Math::Ray> rays{allocator};
+  Vector<Optional<Float32>> results{allocator};
+  if (!rays.resize(n_rays) || !results.resize(n_rays)) {
+    return false;
+  }
 
-  auto voxel = Voxel::create(
-    _scheduler,
-    _positions.allocator(),
-    _aabb,
-    _positions,
-    _elements,
-    _config.voxelize_max_voxels_per_dimension,
-    _config.voxelize_triangles_per_task);
+  for (Size vertex = _begin; vertex < _end; vertex++) {
+    const auto& position = _positions[vertex];
+    const auto seed = (Uint64(_config.raytrace_seed) << 32) | vertex;
+    for (Size i = 0; i < n_rays; i++) {
+      auto direction = random_unit_vec(seed, _first + i);
 
-  if (!voxel) {
-    logger->error("failed to voxelize");
-    return nullopt;
+      // Should the rays always go "up"?
+      if (direction.y < 0.0f) {
+        direction.y = -direction.y;
+      }
+
+      rays[i] = {position + direction * ORIGIN_OFFSET, direction};
+    }
+
+    _tracer.ray_cast(rays.data(), n_rays, results.data());
+
+    // Added up in the order of the rays so splitting them over passes gives
+    // the same sum.
+    auto sum = sums_[vertex];
+    for (Size i = 0; i < n_rays; i++) {
+      sum += ray_occlusion(results[i], _max_distance, inv_max_distance, fall_off);
+    }
+    sums_[vertex] = sum;
   }
 
+  return true;
+}
+
+// Traces every ray of every vertex against |_tracer|, writing the occlusion
+// of the vertices to |ao_|.
+template<typename T>
+static bool trace(Concurrency::Scheduler& _scheduler, const T& _tracer,
+  const Vector<Math::Vec3f>& _positions, Float32 _max_distance,
+  const AoConfig& _config, Vector<Float32>& ao_)
+{
   const auto n_vertices = _positions.size();
-  Vector<float> ao;
-  if (!ao.resize(n_vertices)) {
-    return nullopt;
-  }
 
   auto n_vertices_per_task = _config.raytrace_vertices_per_task;
   if (n_vertices_per_task == 0) {
-    n_vertices_per_task = n_vertices / _scheduler.total_threads();
+    n_vertices_per_task =
+      Algorithm::max(n_vertices / _scheduler.total_threads(), 1_z);
   }
 
   const auto tasks = n_vertices / n_vertices_per_task;
+  const auto n_rays = _config.raytrace_rays_per_vertex;
 
-  // Kernel function for a single vertex.
-  const auto kernel = [&](Size _vertex) {
-    const auto& vertex = _positions[_vertex];
-    Vector<Float32> results;
-    for (Size i = 0; i < _config.raytrace_rays_per_vertex; i++) {
-      auto direction = random_unit_vec(random);
-
-      // Should the rays always go "up"?
-      if (direction.y < 0.0f) {
-        direction.y = -direction.y;
-      }
-
-      Math::Ray ray{vertex + direction * ORIGIN_OFFSET, direction};
-      if (const auto distance = voxel->ray_cast(ray)) {
-        results.push_back(Algorithm::min(*distance, max_distance));
-      }
-    }
-    ao[_vertex] = compute_ao(results, max_distance,
-      _config.raytrace_rays_per_vertex, max_distance * _config.fall_off);
+  // The sums start at zero in |ao_|.
+  const auto kernel = [&](Size _begin, Size _end) {
+    return trace_vertices(_tracer, _positions, _begin, _end, 0, n_rays,
+      _max_distance, _config, ao_.data());
   };
 
   // Distribute the kernel over the thread pool.
+  Concurrency::Atomic<Size> failed = 0;
   Concurrency::WaitGroup group{tasks};
   for (Size task = 0; task < tasks; task++) {
-    (void)_scheduler.add([&, task](Sint32) {
-      for (Size vertex = 0; vertex < n_vertices_per_task; vertex++) {
-        kernel(task * n_vertices_per_task + vertex);
+    const auto begin = task * n_vertices_per_task;
+    const auto end = begin + n_vertices_per_task;
+    const bool added = _scheduler.add([&, begin, end](Sint32) {
+      if (!kernel(begin, end)) {
+        failed++;
       }
       group.signal();
     });
+    if (!added) {
+      if (!kernel(begin, end)) {
+        failed++;
+      }
+      group.signal();
+    }
   }
 
   // Handle remainder vertices not handled by the above.
-  for (Size vertex = tasks * n_vertices_per_task; vertex < n_vertices; vertex++) {
-    kernel(vertex);
+  if (!kernel(tasks * n_vertices_per_task, n_vertices)) {
+    failed++;
   }
 
   // Wait for all tasks to complete.
   group.wait();
 
+  if (failed != 0) {
+    return false;
+  }
+
+  ao_.each_fwd([&](Float32& sum_) {
+    sum_ = vertex_occlusion(sum_, n_rays);
+  });
+
+  return true;
+}
+
+static void denoise(const Vector<Uint32>& _elements, const AoConfig& _config,
+  Vector<Float32>& ao_)
+{
   const auto mix = [](Float32 x, Float32 y, Float32 a) {
     return x * (1.0 - a) + y * a;
   };
 
-  // Denoising pass
+  auto ao = ao_.data();
   for (Size pass = 0; pass < _config.denoising_passes; pass++) {
     const auto n_elements = _elements.size();
     for (Size element = 0; element < n_elements; element += 3) {
@@ -147,7 +225,358 @@ Optional<Vector<Float32>> bake_ao(
       ao[_elements[element + 2]] = mix(ao[_elements[element + 2]], average, _config.denoising_weight);
     }
   }
+}
+
+Filesystem::Cache::Key ao_cache_key(
+  const Vector<Math::Vec3f>& _positions,
+  const Vector<Uint32>& _elements,
+  const AoConfig& _config)
+{
+  // Everything the occlusion is baked from besides the positions.
+  struct {
+    Uint32 version;
+    Byte elements[16];
+    Uint32 raytrace_triangles;
+    Uint32 voxelize_max_voxels_per_dimension;
+    Uint32 raytrace_rays_per_vertex;
+    Uint32 raytrace_seed;
+    Float32 fall_off;
+    Uint32 denoising_passes;
+    Float32 denoising_weight;
+  } parameters;
+
+  Memory::zero(parameters);
+
+  const auto elements = Hash::djbx33a(
+    reinterpret_cast<const Byte*>(_elements.data()), _elements.size() * sizeof(Uint32));
+
+  parameters.version = CACHE_VERSION;
+  Memory::copy(parameters.elements, elements.data(), sizeof parameters.elements);
+  parameters.raytrace_triangles = _config.raytrace_triangles;
+  if (!_config.raytrace_triangles) {
+    parameters.voxelize_max_voxels_per_dimension = Uint32(_config.voxelize_max_voxels_per_dimension);
+  }
+  parameters.raytrace_rays_per_vertex = Uint32(_config.raytrace_rays_per_vertex);
+  parameters.raytrace_seed = _config.raytrace_seed;
+  parameters.fall_off = _config.fall_off;
+  parameters.denoising_passes = Uint32(_config.denoising_passes);
+  parameters.denoising_weight = _config.denoising_weight;
+
+  return Filesystem::Cache::key(
+    {reinterpret_cast<const Byte*>(_positions.data()), _positions.size() * sizeof(Math::Vec3f)},
+    {reinterpret_cast<const Byte*>(&parameters), sizeof parameters});
+}
+
+Optional<Vector<Float32>> find_cached_ao(Memory::Allocator& _allocator,
+  const Filesystem::Cache::Key& _key, Size _vertices)
+{
+  auto entry = Filesystem::Cache::instance().find(_key);
+  if (!entry) {
+    return nullopt;
+  }
+
+  const auto data = entry->data();
+  if (data.size() != _vertices * sizeof(Float32)) {
+    logger->warning("ignoring invalid cached occlusion");
+    return nullopt;
+  }
+
+  Vector<Float32> ao{_allocator};
+  if (!ao.resize(_vertices)) {
+    return nullopt;
+  }
+
+  Memory::copy(ao.data(), reinterpret_cast<const Float32*>(data.data()), _vertices);
 
   return ao;
 }
-}
\ No newline at end of file
+
+static void cache_ao(const Filesystem::Cache::Key& _key, const Vector<Float32>& _ao) {
+  auto& cache = Filesystem::Cache::instance();
+  if (cache.is_enabled()) {
+    (void)cache.insert(_key,
+      {reinterpret_cast<const Byte*>(_ao.data()), _ao.size() * sizeof(Float32)});
+  }
+}
+
+Optional<Vector<Float32>> bake_ao(
+  Concurrency::Scheduler& _scheduler,
+  const Math::AABB& _aabb,
+  const Vector<Math::Vec3f>& _positions,
+  const Vector<Uint32>& _elements,
+  const AoConfig& _config)
+{
+  auto& allocator = _positions.allocator();
+
+  const auto key = ao_cache_key(_positions, _elements, _config);
+  if (auto ao = find_cached_ao(allocator, key, _positions.size())) {
+    return ao;
+  }
+
+  const auto max_distance = Math::length(_aabb.max() - _aabb.min());
+
+  Vector<Float32> ao{allocator};
+  if (!ao.resize(_positions.size(), 0.0f)) {
+    return nullopt;
+  }
+
+  if (_config.raytrace_triangles) {
+    auto bvh = Bvh::create(_scheduler, allocator, _positions, _elements);
+    if (!bvh) {
+      logger->error("failed to build bvh");
+      return nullopt;
+    }
+
+    if (!trace(_scheduler, *bvh, _positions, max_distance, _config, ao)) {
+      return nullopt;
+    }
+  } else {
+    auto voxel = Voxel::create(
+      _scheduler,
+      allocator,
+      _aabb,
+      _positions,
+      _elements,
+      _config.voxelize_max_voxels_per_dimension,
+      _config.voxelize_triangles_per_task);
+
+    if (!voxel) {
+      logger->error("failed to voxelize");
+      return nullopt;
+    }
+
+    if (!trace(_scheduler, *voxel, _positions, max_distance, _config, ao)) {
+      return nullopt;
+    }
+  }
+
+  denoise(_elements, _config, ao);
+
+  cache_ao(key, ao);
+
+  return ao;
+}
+
+// [AoBaker]
+Ptr<AoBaker> AoBaker::create(
+  Concurrency::Scheduler& _scheduler,
+  const Math::AABB& _aabb,
+  Vector<Math::Vec3f>&& positions_,
+  Vector<Uint32>&& elements_,
+  const AoConfig& _config)
+{
+  auto& allocator = positions_.allocator();
+
+  const auto max_distance = Math::length(_aabb.max() - _aabb.min());
+
+  auto baker = make_ptr<AoBaker>(allocator, _scheduler,
+    Utility::move(positions_), Utility::move(elements_), _config, max_distance);
+  if (!baker || !baker->m_sums.resize(baker->m_positions.size(), 0.0f)) {
+    return {};
+  }
+
+  baker->m_key = ao_cache_key(baker->m_positions, baker->m_elements, _config);
+
+  // Built here rather than in a task as building waits on tasks of its own.
+  if (_config.raytrace_triangles) {
+    auto bvh = Bvh::create(_scheduler, allocator, baker->m_positions, baker->m_elements);
+    if (!bvh) {
+      logger->error("failed to build bvh");
+      return {};
+    }
+    baker->m_bvh = make_ptr<Bvh>(allocator, Utility::move(*bvh));
+    if (!baker->m_bvh) {
+      return {};
+    }
+  } else {
+    auto voxel = Voxel::create(
+      _scheduler,
+      allocator,
+      _aabb,
+      baker->m_positions,
+      baker->m_elements,
+      _config.voxelize_max_voxels_per_dimension,
+      _config.voxelize_triangles_per_task);
+    if (!voxel) {
+      logger->error("failed to voxelize");
+      return {};
+    }
+    baker->m_voxel = make_ptr<Voxel>(allocator, Utility::move(*voxel));
+    if (!baker->m_voxel) {
+      return {};
+    }
+  }
+
+  baker->start_pass();
+
+  return baker;
+}
+
+AoBaker::AoBaker(Concurrency::Scheduler& _scheduler,
+  Vector<Math::Vec3f>&& positions_, Vector<Uint32>&& elements_,
+  const AoConfig& _config, Float32 _max_distance)
+  : m_scheduler{_scheduler}
+  , m_positions{Utility::move(positions_)}
+  , m_elements{Utility::move(elements_)}
+  , m_config{_config}
+  , m_max_distance{_max_distance}
+  , m_bvh{m_positions.allocator()}
+  , m_voxel{m_positions.allocator()}
+  , m_sums{m_positions.allocator()}
+  , m_pass{0}
+  , m_cursor{0}
+  , m_active{0}
+  , m_stop{false}
+  , m_running{0}
+  , m_occlusion{m_positions.allocator()}
+  , m_completed{0}
+  , m_failed{false}
+  , m_polled{0}
+{
+  // Every pass traces at least one ray.
+  m_config.progressive_passes = Algorithm::clamp(m_config.progressive_passes,
+    1_z, Algorithm::max(m_config.raytrace_rays_per_vertex, 1_z));
+}
+
+AoBaker::~AoBaker() {
+  m_stop = true;
+
+  Concurrency::ScopeLock lock{m_lock};
+  m_condition.wait(lock, [&] { return m_running == 0; });
+}
+
+void AoBaker::start_pass() {
+  const auto n_batches =
+    (m_positions.size() + PROGRESSIVE_BATCH - 1) / PROGRESSIVE_BATCH;
+  const auto tasks =
+    Algorithm::max(Algorithm::min(n_batches, m_scheduler.total_threads()), 1_z);
+
+  m_cursor = 0;
+  m_active = tasks;
+
+  {
+    Concurrency::ScopeLock lock{m_lock};
+    m_running += tasks;
+  }
+
+  for (Size task = 0; task < tasks; task++) {
+    if (!m_scheduler.add([this](Sint32) { run(); })) {
+      run();
+    }
+  }
+}
+
+void AoBaker::run() {
+  const auto frequency = Float32(Time::qpc_frequency());
+  const auto slice = Uint64(m_config.progressive_slice * frequency);
+
+  const auto n_vertices = m_positions.size();
+  const auto n_rays = m_config.raytrace_rays_per_vertex;
+  const auto n_passes = m_config.progressive_passes;
+  const auto first = n_rays * m_pass / n_passes;
+  const auto last = n_rays * (m_pass + 1) / n_passes;
+
+  auto start = Time::qpc_ticks();
+  while (!m_stop) {
+    const auto begin = m_cursor.fetch_add(PROGRESSIVE_BATCH);
+    if (begin >= n_vertices) {
+      break;
+    }
+
+    const auto end = Algorithm::min(begin + PROGRESSIVE_BATCH, n_vertices);
+    const bool traced = m_bvh
+      ? trace_vertices(*m_bvh, m_positions, begin, end, first, last, m_max_distance, m_config, m_sums.data())
+      : trace_vertices(*m_voxel, m_positions, begin, end, first, last, m_max_distance, m_config, m_sums.data());
+
+    if (!traced) {
+      Concurrency::ScopeLock lock{m_lock};
+      m_failed = true;
+      m_stop = true;
+      break;
+    }
+
+    // Out of time, continue behind the tasks queued since. When the scheduler
+    // cannot take it, continue here.
+    if (Time::qpc_ticks() - start >= slice) {
+      if (m_scheduler.add([this](Sint32) { run(); })) {
+        return;
+      }
+      start = Time::qpc_ticks();
+    }
+  }
+
+  leave();
+}
+
+void AoBaker::leave() {
+  // The last task of a pass finishes it and starts the next, still counting
+  // as running so the baker cannot be destroyed from under it.
+  if (m_active.fetch_sub(1) == 1 && finish_pass()) {
+    start_pass();
+  }
+
+  Concurrency::ScopeLock lock{m_lock};
+  if (--m_running == 0) {
+    m_condition.broadcast();
+  }
+}
+
+bool AoBaker::finish_pass() {
+  if (m_stop) {
+    return false;
+  }
+
+  const auto n_vertices = m_positions.size();
+  const auto n_passes = m_config.progressive_passes;
+  const auto n_rays = m_config.raytrace_rays_per_vertex * (m_pass + 1) / n_passes;
+
+  Vector<Float32> occlusion{m_positions.allocator()};
+  if (!occlusion.resize(n_vertices)) {
+    Concurrency::ScopeLock lock{m_lock};
+    m_failed = true;
+    return false;
+  }
+
+  for (Size i = 0; i < n_vertices; i++) {
+    occlusion[i] = vertex_occlusion(m_sums[i], n_rays);
+  }
+
+  denoise(m_elements, m_config, occlusion);
+
+  m_pass++;
+
+  const bool done = m_pass == n_passes;
+  if (done) {
+    cache_ao(m_key, occlusion);
+  }
+
+  Concurrency::ScopeLock lock{m_lock};
+  m_occlusion = Utility::move(occlusion);
+  m_completed = m_pass;
+
+  return !done;
+}
+
+bool AoBaker::poll(Vector<Float32>& occlusion_) {
+  Concurrency::ScopeLock lock{m_lock};
+  if (m_completed == m_polled || !occlusion_.resize(m_occlusion.size())) {
+    return false;
+  }
+
+  Memory::copy(occlusion_.data(), m_occlusion.data(), m_occlusion.size());
+  m_polled = m_completed;
+
+  return true;
+}
+
+Size AoBaker::passes() const {
+  Concurrency::ScopeLock lock{m_lock};
+  return m_completed;
+}
+
+bool AoBaker::is_done() const {
+  Concurrency::ScopeLock lock{m_lock};
+  return m_failed || m_completed == m_config.progressive_passes;
+}
+
+} // namespace Rx::Model
@@ -2,6 +2,13 @@
 #ifndef RX_MODEL_AOBAKE_H
 #define RX_MODEL_AOBAKE_H
 #include "rx/core/vector.h"
+#include "rx/core/ptr.h"
+
+#include "rx/core/filesystem/cache.h"
+
+#include "rx/core/concurrency/atomic.h"
+#include "rx/core/concurrency/mutex.h"
+#include "rx/core/concurrency/condition_variable.h"
 
 namespace Rx::Concurrency {
 
@@ -21,6 +28,11 @@ using Vec3f = Vec3<Float32>;
 namespace Rx::Model {
 
 struct AoConfig {
+  // Trace rays against the triangles through a BVH rather than against the
+  // voxelized geometry. Exact, so thin features do not leak and detail is not
+  // lost on large meshes, the voxel options below are then unused.
+  bool raytrace_triangles = false;
+
   // Number of triangles per thread when voxelizing the geometry.
   // A value of 0 attempts to utilize all available threads on the scheduler.
   Size voxelize_triangles_per_task = 0;
@@ -44,8 +56,29 @@ struct AoConfig {
   // Denoising passes to cleanup noise. The more passes the softer.
   Size denoising_passes = 2;
   Float32 denoising_weight = 0.2f; // In range [0, 1]
+
+  // Progressive bakes trace the rays of every vertex over this many passes,
+  // the occlusion being refined after each.
+  Size progressive_passes = 8;
+
+  // Seconds a progressive bake runs on a thread of the scheduler before giving
+  // it up to other tasks.
+  Float32 progressive_slice = 0.002f;
 };
 
+// Key of the occlusion of |_positions| baked with |_config| in the cache.
+// Options which do not change the result are not part of it.
+Filesystem::Cache::Key ao_cache_key(
+  const Vector<Math::Vec3f>& _positions,
+  const Vector<Uint32>& _elements,
+  const AoConfig& _config);
+
+// Looks up the occlusion of |_vertices| vertices baked before under |_key|.
+Optional<Vector<Float32>> find_cached_ao(Memory::Allocator& _allocator,
+  const Filesystem::Cache::Key& _key, Size _vertices);
+
+// Bakes the occlusion of every vertex of |_positions|. The result is kept in
+// the Filesystem::Cache when it is enabled and taken from it when baked before.
 Optional<Vector<Float32>> bake_ao(
   Concurrency::Scheduler& _scheduler,
   const Math::AABB& _aabb,
@@ -53,6 +86,80 @@ Optional<Vector<Float32>> bake_ao(
   const Vector<Uint32>& _elements,
   const AoConfig& _config);
 
+struct Bvh;
+struct Voxel;
+
+// Bakes occlusion in the background, in passes over every vertex with a share
+// of the rays each, so a model can be shown before it's baked and refined as
+// the passes complete. The vertices of a pass are traced by tasks on the
+// scheduler which give up their thread after every slice of time, and the
+// result of the last pass is the same as that of |bake_ao|, which is cached.
+struct AoBaker {
+  RX_MARK_NO_COPY(AoBaker);
+  RX_MARK_NO_MOVE(AoBaker);
+
+  // The geometry to trace against is built before returning, the passes run
+  // on |_scheduler|, which must outlive the baker.
+  static Ptr<AoBaker> create(
+    Concurrency::Scheduler& _scheduler,
+    const Math::AABB& _aabb,
+    Vector<Math::Vec3f>&& positions_,
+    Vector<Uint32>&& elements_,
+    const AoConfig& _config);
+
+  // Stops baking, waiting for the tasks running.
+  ~AoBaker();
+
+  // When a pass completed since the last call, copies the occlusion of every
+  // vertex to |occlusion_| and returns true.
+  bool poll(Vector<Float32>& occlusion_);
+
+  // The number of passes completed.
+  Size passes() const;
+
+  // When every pass completed, or the bake failed.
+  bool is_done() const;
+
+  AoBaker(Concurrency::Scheduler& _scheduler, Vector<Math::Vec3f>&& positions_,
+    Vector<Uint32>&& elements_, const AoConfig& _config, Float32 _max_distance);
+
+private:
+  void start_pass();
+  void run();
+  void leave();
+  bool finish_pass();
+
+  Concurrency::Scheduler& m_scheduler;
+  Vector<Math::Vec3f> m_positions;
+  Vector<Uint32> m_elements;
+  AoConfig m_config;
+  Float32 m_max_distance;
+  Filesystem::Cache::Key m_key;
+
+  Ptr<Bvh> m_bvh;
+  Ptr<Voxel> m_voxel;
+
+  // The occlusion of the rays of every vertex traced so far, added up in the
+  // order of the rays. Every vertex is written by one task of a pass.
+  Vector<Float32> m_sums;
+
+  // The pass being traced and the next vertex of it to trace.
+  Size m_pass;
+  Concurrency::Atomic<Size> m_cursor;
+  Concurrency::Atomic<Size> m_active;
+  Concurrency::Atomic<bool> m_stop;
+
+  mutable Concurrency::Mutex m_lock;
+  Concurrency::ConditionVariable m_condition;
+  Size m_running RX_HINT_GUARDED_BY(m_lock);
+  Vector<Float32> m_occlusion RX_HINT_GUARDED_BY(m_lock);
+  Size m_completed RX_HINT_GUARDED_BY(m_lock);
+  bool m_failed RX_HINT_GUARDED_BY(m_lock);
+
+  // The number of passes |poll| copied.
+  Size m_polled;
+};
+
 } // namespace Rx::Model
 
 #endif // RX_MODEL_AOBAKE_H
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "rx/model/blend_tree.h"
+
+namespace Rx::Model {
+
+Optional<BlendTree> BlendTree::create(Memory::Allocator& _allocator,
+  const Skeleton& _skeleton)
+{
+  const auto n_joints = _skeleton.joints().size();
+
+  Vector<Math::Mat3x4f> lb_frames{_allocator};
+  Vector<Math::DualQuatf> dq_frames{_allocator};
+  if (!lb_frames.resize(n_joints) || !dq_frames.resize(n_joints)) {
+    return nullopt;
+  }
+
+  return BlendTree{_allocator, _skeleton, Utility::move(lb_frames),
+    Utility::move(dq_frames)};
+}
+
+Optional<Size> BlendTree::add(Node&& node_) {
+  if (!m_nodes.push_back(Utility::move(node_))) {
+    return nullopt;
+  }
+  return m_nodes.size() - 1;
+}
+
+Optional<Size> BlendTree::add_clip(const Clip& _clip, bool _loop) {
+  auto pose = Pose::create(*m_allocator, *m_skeleton);
+  if (!pose) {
+    return nullopt;
+  }
+
+  Node node{Type::CLIP, Utility::move(*pose)};
+  node.clip = &_clip;
+  node.loop = _loop;
+
+  // Start on the first frame of the clip.
+  node.pose.sample(*m_skeleton, _clip.frame_offset, _clip.frame_offset, 0.0f);
+
+  return add(Utility::move(node));
+}
+
+Optional<Size> BlendTree::add_blend(Size _from, Size _to, Float32 _weight,
+  const JointMask* _mask)
+{
+  RX_ASSERT(_from < m_nodes.size() && _to < m_nodes.size(), "invalid node");
+
+  auto pose = Pose::create(*m_allocator, *m_skeleton);
+  if (!pose) {
+    return nullopt;
+  }
+
+  Node node{Type::BLEND, Utility::move(*pose)};
+  node.inputs[0] = _from;
+  node.inputs[1] = _to;
+  node.weight = _weight;
+  node.mask = _mask;
+
+  return add(Utility::move(node));
+}
+
+Optional<Size> BlendTree::add_additive(Size _base, Size _additive,
+  const Clip& _reference, Size _reference_frame, Float32 _weight,
+  const JointMask* _mask)
+{
+  RX_ASSERT(_base < m_nodes.size() && _additive < m_nodes.size(), "invalid node");
+  RX_ASSERT(_reference_frame < _reference.frame_count, "invalid frame");
+
+  auto pose = Pose::create(*m_allocator, *m_skeleton);
+  auto inverse_reference = Pose::create(*m_allocator, *m_skeleton);
+  if (!pose || !inverse_reference) {
+    return nullopt;
+  }
+
+  // The reference is inverted once here rather than every evaluation.
+  const auto frame = _reference.frame_offset + _reference_frame;
+  inverse_reference->sample(*m_skeleton, frame, frame, 0.0f);
+  inverse_reference->invert();
+
+  Node node{Type::ADDITIVE, Utility::move(*pose)};
+  node.inputs[0] = _base;
+  node.inputs[1] = _additive;
+  node.weight = _weight;
+  node.mask = _mask;
+  node.inverse_reference = Utility::move(inverse_reference);
+
+  return add(Utility::move(node));
+}
+
+void BlendTree::update(Float32 _delta_time) {
+  m_nodes.each_fwd([&](Node& node_) {
+    if (node_.type == Type::CLIP) {
+      (void)node_.cursor.advance(*node_.clip, _delta_time, node_.loop);
+    }
+  });
+}
+
+void BlendTree::evaluate(Size _root) {
+  RX_ASSERT(_root < m_nodes.size(), "invalid node");
+
+  // Nodes are after the nodes they blend.
+  const auto nodes = m_nodes.data();
+  for (Size i = 0; i <= _root; i++) {
+    auto& node = nodes[i];
+    switch (node.type) {
+    case Type::CLIP:
+      {
+        const auto& interpolant = node.cursor.interpolant;
+        const auto offset = node.clip->frame_offset;
+        node.pose.sample(*m_skeleton, offset + interpolant.frame1,
+          offset + interpolant.frame2, interpolant.offset);
+      }
+      break;
+    case Type::BLEND:
+      node.pose.blend(nodes[node.inputs[0]].pose, nodes[node.inputs[1]].pose,
+        node.weight, node.mask);
+      break;
+    case Type::ADDITIVE:
+      node.pose.add(nodes[node.inputs[0]].pose, nodes[node.inputs[1]].pose,
+        *node.inverse_reference, node.weight, node.mask);
+      break;
+    }
+  }
+
+  nodes[_root].pose.write(m_lb_frames.data(), m_dq_frames.data());
+}
+
+} // namespace Rx::Model
@@ -0,0 +1,180 @@
+#ifndef RX_MODEL_BLEND_TREE_H
+#define RX_MODEL_BLEND_TREE_H
+#include "rx/model/animation.h"
+#include "rx/model/pose.h"
+
+namespace Rx::Model {
+
+// A tree of clips blended together. Nodes are added after the nodes they
+// blend, each with a pose to evaluate into, so evaluating the tree does not
+// allocate.
+//
+// There are three kinds of nodes:
+//  * Clips, which play a clip like |Animation|.
+//  * Blends, which cross-fade from one node to another by a weight, limited
+//    to the joints of a mask when given.
+//  * Additive layers, which add the difference of a node from a reference
+//    frame onto another node by a weight, limited to the joints of a mask
+//    when given.
+struct BlendTree {
+  RX_MARK_NO_COPY(BlendTree);
+
+  BlendTree(BlendTree&& blend_tree_);
+  BlendTree& operator=(BlendTree&& blend_tree_);
+
+  static Optional<BlendTree> create(Memory::Allocator& _allocator,
+    const Skeleton& _skeleton);
+
+  // Each returns the index of the node added. The masks given must outlive
+  // the tree.
+  Optional<Size> add_clip(const Clip& _clip, bool _loop);
+  Optional<Size> add_blend(Size _from, Size _to, Float32 _weight,
+    const JointMask* _mask = nullptr);
+  Optional<Size> add_additive(Size _base, Size _additive,
+    const Clip& _reference, Size _reference_frame, Float32 _weight,
+    const JointMask* _mask = nullptr);
+
+  // Changes the weight of a blend or additive node.
+  void set_weight(Size _node, Float32 _weight);
+
+  // Advances the time of every clip.
+  void update(Float32 _delta_time);
+
+  // Evaluates every node up to |_root|, writing the frames of |_root|.
+  void evaluate(Size _root);
+
+  const Pose& pose(Size _node) const &;
+
+  const Vector<Math::Mat3x4f>& lb_frames() const &;
+  const Vector<Math::DualQuatf>& dq_frames() const &;
+
+  const Skeleton* skeleton() const;
+
+private:
+  enum class Type : Uint8 {
+    CLIP,
+    BLEND,
+    ADDITIVE
+  };
+
+  struct Node {
+    Node(Type _type, Pose&& pose_);
+    Node(Node&& node_);
+    Node& operator=(Node&& node_);
+
+    Type type;
+    Pose pose;
+
+    // Clip nodes.
+    const Clip* clip = nullptr;
+    Animation::Cursor cursor;
+    bool loop = false;
+
+    // Blend and additive nodes.
+    Size inputs[2] = {0, 0};
+    Float32 weight = 0.0f;
+    const JointMask* mask = nullptr;
+    Optional<Pose> inverse_reference;
+  };
+
+  BlendTree(Memory::Allocator& _allocator, const Skeleton& _skeleton,
+    Vector<Math::Mat3x4f>&& lb_frames_, Vector<Math::DualQuatf>&& dq_frames_);
+
+  Optional<Size> add(Node&& node_);
+
+  Memory::Allocator* m_allocator;
+  const Skeleton* m_skeleton;
+  Vector<Node> m_nodes;
+  Vector<Math::Mat3x4f> m_lb_frames;
+  Vector<Math::DualQuatf> m_dq_frames;
+};
+
+inline BlendTree::Node::Node(Type _type, Pose&& pose_)
+  : type{_type}
+  , pose{Utility::move(pose_)}
+{
+}
+
+inline BlendTree::Node::Node(Node&& node_)
+  : type{node_.type}
+  , pose{Utility::move(node_.pose)}
+  , clip{node_.clip}
+  , cursor{node_.cursor}
+  , loop{node_.loop}
+  , inputs{node_.inputs[0], node_.inputs[1]}
+  , weight{node_.weight}
+  , mask{node_.mask}
+  , inverse_reference{Utility::move(node_.inverse_reference)}
+{
+}
+
+inline BlendTree::Node& BlendTree::Node::operator=(Node&& node_) {
+  if (this != &node_) {
+    type = node_.type;
+    pose = Utility::move(node_.pose);
+    clip = node_.clip;
+    cursor = node_.cursor;
+    loop = node_.loop;
+    inputs[0] = node_.inputs[0];
+    inputs[1] = node_.inputs[1];
+    weight = node_.weight;
+    mask = node_.mask;
+    inverse_reference = Utility::move(node_.inverse_reference);
+  }
+  return *this;
+}
+
+inline BlendTree::BlendTree(Memory::Allocator& _allocator,
+  const Skeleton& _skeleton, Vector<Math::Mat3x4f>&& lb_frames_,
+  Vector<Math::DualQuatf>&& dq_frames_)
+  : m_allocator{&_allocator}
+  , m_skeleton{&_skeleton}
+  , m_nodes{_allocator}
+  , m_lb_frames{Utility::move(lb_frames_)}
+  , m_dq_frames{Utility::move(dq_frames_)}
+{
+}
+
+inline BlendTree::BlendTree(BlendTree&& blend_tree_)
+  : m_allocator{blend_tree_.m_allocator}
+  , m_skeleton{Utility::exchange(blend_tree_.m_skeleton, nullptr)}
+  , m_nodes{Utility::move(blend_tree_.m_nodes)}
+  , m_lb_frames{Utility::move(blend_tree_.m_lb_frames)}
+  , m_dq_frames{Utility::move(blend_tree_.m_dq_frames)}
+{
+}
+
+inline BlendTree& BlendTree::operator=(BlendTree&& blend_tree_) {
+  if (this != &blend_tree_) {
+    m_allocator = blend_tree_.m_allocator;
+    m_skeleton = Utility::exchange(blend_tree_.m_skeleton, nullptr);
+    m_nodes = Utility::move(blend_tree_.m_nodes);
+    m_lb_frames = Utility::move(blend_tree_.m_lb_frames);
+    m_dq_frames = Utility::move(blend_tree_.m_dq_frames);
+  }
+  return *this;
+}
+
+inline void BlendTree::set_weight(Size _node, Float32 _weight) {
+  m_nodes[_node].weight = _weight;
+}
+
+inline const Pose& BlendTree::pose(Size _node) const & {
+  return m_nodes[_node].pose;
+}
+
+inline const Vector<Math::Mat3x4f>& BlendTree::lb_frames() const & {
+  return m_lb_frames;
+}
+
+inline const Vector<Math::DualQuatf>& BlendTree::dq_frames() const & {
+  return m_dq_frames;
+}
+
+inline const Skeleton* BlendTree::skeleton() const {
+  return m_skeleton;
+}
+
+} // namespace Rx::Model
+
+#endif // RX_MODEL_BLEND_TREE_H
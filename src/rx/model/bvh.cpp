@@ -0,0 +1,617 @@
+#include "rx/model/bvh.h"
+
+#include "rx/core/math/abs.h"
+
+#include "rx/core/algorithm/min.h"
+#include "rx/core/algorithm/max.h"
+
+#include "rx/core/utility/swap.h"
+
+#include "rx/core/memory/zero.h"
+
+#include "rx/core/concurrency/wait_group.h"
+#include "rx/core/concurrency/scheduler.h"
+#include "rx/core/concurrency/atomic.h"
+
+#include "rx/math/ray.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Rx::Model {
+
+// Number of bins the centroids are sorted into on every axis.
+static constexpr const Size BINS = 16;
+
+// Triangles in a packet, nodes with this many triangles or fewer are leaves
+// as intersecting a packet costs the same however many triangles are in it.
+static constexpr const Size PACKET_TRIANGLES = 4;
+
+// Beyond this depth nodes are split in half rather than by the surface area
+// heuristic, which bounds the depth of the tree, and so the stack needed to
+// traverse it, to this plus the log2 of the number of triangles.
+static constexpr const Size MAX_HEURISTIC_DEPTH = 32;
+static constexpr const Size MAX_DEPTH = MAX_HEURISTIC_DEPTH + 32;
+
+// Nodes with fewer triangles than this are not split over tasks.
+static constexpr const Size MIN_TASK_TRIANGLES = 1024;
+
+// Time of rays which do not hit anything.
+static constexpr const auto NEVER = 3.0e38f;
+
+struct Bounds {
+  void expand(const Math::Vec3f& _point) {
+    min.x = Algorithm::min(min.x, _point.x);
+    min.y = Algorithm::min(min.y, _point.y);
+    min.z = Algorithm::min(min.z, _point.z);
+    max.x = Algorithm::max(max.x, _point.x);
+    max.y = Algorithm::max(max.y, _point.y);
+    max.z = Algorithm::max(max.z, _point.z);
+  }
+
+  void expand(const Bounds& _bounds) {
+    expand(_bounds.min);
+    expand(_bounds.max);
+  }
+
+  // Half of the surface area, which is all the heuristic needs.
+  Float32 area() const {
+    const auto extent = max - min;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+  }
+
+  Math::Vec3f min{ 3.0e38f,  3.0e38f,  3.0e38f};
+  Math::Vec3f max{-3.0e38f, -3.0e38f, -3.0e38f};
+};
+
+// Cost of intersecting the packets of |_triangles|.
+static inline Float32 packets(Uint32 _triangles) {
+  return Float32((_triangles + PACKET_TRIANGLES - 1) / PACKET_TRIANGLES);
+}
+
+struct BuildNode {
+  Bounds bounds;
+  Uint32 children[2];
+  Uint32 offset; // First triangle in the permutation.
+  Uint32 count;  // Triangles, zero once split.
+  Uint32 depth;
+};
+
+// State shared by the tasks building the tree. Every task builds a subtree
+// over a range of the permutation and a range of nodes of its own.
+struct Builder {
+  // Splits |_node| in two by the surface area heuristic, allocating the two
+  // children from |next_|, or leaves it a leaf.
+  void split(Uint32 _node, Uint32& next_) const;
+
+  const Bounds* bounds;
+  const Math::Vec3f* centroids;
+  Uint32* permutation;
+  BuildNode* nodes;
+};
+
+void Builder::split(Uint32 _node, Uint32& next_) const {
+  auto& node = nodes[_node];
+  const auto begin = node.offset;
+  const auto end = begin + node.count;
+
+  Bounds centroid_bounds;
+  for (Size i = begin; i < end; i++) {
+    const auto triangle = permutation[i];
+    node.bounds.expand(bounds[triangle]);
+    centroid_bounds.expand(centroids[triangle]);
+  }
+
+  if (node.count <= PACKET_TRIANGLES) {
+    return;
+  }
+
+  const auto extent = centroid_bounds.max - centroid_bounds.min;
+
+  // Find the cheapest split between two bins on any axis.
+  Size best_axis = 0;
+  Size best_bin = 0;
+  auto best_cost = NEVER;
+  if (node.depth < MAX_HEURISTIC_DEPTH) {
+    struct Bin {
+      Bounds bounds;
+      Uint32 count = 0;
+    };
+
+    Bin bins[3][BINS];
+    Float32 scale[3];
+    for (Size axis = 0; axis < 3; axis++) {
+      scale[axis] = extent[axis] > 0.0f ? Float32(BINS) / extent[axis] : 0.0f;
+    }
+
+    for (Size i = begin; i < end; i++) {
+      const auto triangle = permutation[i];
+      const auto& centroid = centroids[triangle];
+      for (Size axis = 0; axis < 3; axis++) {
+        const auto index = Algorithm::min(
+          Size((centroid[axis] - centroid_bounds.min[axis]) * scale[axis]), BINS - 1);
+        bins[axis][index].bounds.expand(bounds[triangle]);
+        bins[axis][index].count++;
+      }
+    }
+
+    for (Size axis = 0; axis < 3; axis++) {
+      if (extent[axis] <= 0.0f) {
+        continue;
+      }
+
+      // Sweep from the right to have the cost of everything right of a split.
+      Float32 right_costs[BINS];
+      Bounds right;
+      Uint32 right_count = 0;
+      for (Size i = BINS - 1; i > 0; i--) {
+        right.expand(bins[axis][i].bounds);
+        right_count += bins[axis][i].count;
+        right_costs[i] = right_count ? right.area() * packets(right_count) : 0.0f;
+      }
+
+      Bounds left;
+      Uint32 left_count = 0;
+      for (Size i = 1; i < BINS; i++) {
+        left.expand(bins[axis][i - 1].bounds);
+        left_count += bins[axis][i - 1].count;
+        if (left_count == 0 || left_count == node.count) {
+          continue;
+        }
+        const auto cost = left.area() * packets(left_count) + right_costs[i];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_bin = i;
+        }
+      }
+    }
+  }
+
+  // Leaves are a single packet so every node with more triangles is split,
+  // even when the heuristic estimates a leaf to be cheaper.
+  auto middle = begin;
+  if (best_cost < NEVER) {
+    // Partition the triangles on either side of the split.
+    const auto min = centroid_bounds.min[best_axis];
+    const auto scale = Float32(BINS) / extent[best_axis];
+    auto lo = begin;
+    auto hi = end;
+    while (lo < hi) {
+      const auto& centroid = centroids[permutation[lo]];
+      const auto index = Algorithm::min(
+        Size((centroid[best_axis] - min) * scale), BINS - 1);
+      if (index < best_bin) {
+        lo++;
+      } else {
+        Utility::swap(permutation[lo], permutation[--hi]);
+      }
+    }
+    middle = lo;
+  }
+
+  // All centroids in the same place or the tree is too deep, split in half.
+  if (middle == begin || middle == end) {
+    middle = begin + node.count / 2;
+  }
+
+  const auto left = next_++;
+  const auto right = next_++;
+  nodes[left] = {{}, {0, 0}, begin, middle - begin, node.depth + 1};
+  nodes[right] = {{}, {0, 0}, middle, end - middle, node.depth + 1};
+  node.children[0] = left;
+  node.children[1] = right;
+  node.count = 0;
+}
+
+Optional<Bvh> Bvh::create(Concurrency::Scheduler& _scheduler,
+  Memory::Allocator& _allocator, const Vector<Math::Vec3f>& _positions,
+  const Vector<Uint32>& _elements)
+{
+  const auto n_triangles = _elements.size() / 3;
+  if (n_triangles == 0) {
+    return Bvh{{_allocator}, {_allocator}};
+  }
+
+  Vector<Bounds> bounds{_allocator};
+  Vector<Math::Vec3f> centroids{_allocator};
+  Vector<Uint32> permutation{_allocator};
+  Vector<BuildNode> nodes{_allocator};
+  if (!bounds.resize(n_triangles) || !centroids.resize(n_triangles)
+    || !permutation.resize(n_triangles) || !nodes.resize(2 * n_triangles - 1))
+  {
+    return nullopt;
+  }
+
+  const auto positions = _positions.data();
+  const auto elements = _elements.data();
+  for (Size i = 0; i < n_triangles; i++) {
+    auto& triangle = bounds[i];
+    triangle.expand(positions[elements[i * 3 + 0]]);
+    triangle.expand(positions[elements[i * 3 + 1]]);
+    triangle.expand(positions[elements[i * 3 + 2]]);
+    centroids[i] = (triangle.min + triangle.max) * 0.5f;
+    permutation[i] = Uint32(i);
+  }
+
+  const Builder builder{
+    bounds.data(),
+    centroids.data(),
+    permutation.data(),
+    nodes.data()
+  };
+
+  // Split the top of the tree here until the nodes are small enough to give
+  // every thread a few subtrees to build. Every subtree of n triangles has a
+  // range of the 2n - 2 nodes it can have below its root to itself.
+  struct Task {
+    Uint32 node;
+    Uint32 next;
+  };
+
+  const auto task_triangles = Algorithm::max(
+    n_triangles / (_scheduler.total_threads() * 4), MIN_TASK_TRIANGLES);
+
+  Vector<Task> tasks{_allocator};
+  Vector<Uint32> stack{_allocator};
+  nodes[0] = {{}, {0, 0}, 0, Uint32(n_triangles), 0};
+  if (!stack.push_back(0)) {
+    return nullopt;
+  }
+
+  Uint32 next = 1;
+  while (!stack.is_empty()) {
+    const auto node = stack.last();
+    stack.pop_back();
+    const auto count = nodes[node].count;
+    if (count > task_triangles) {
+      builder.split(node, next);
+      const auto& children = nodes[node].children;
+      if (nodes[node].count == 0 && (!stack.push_back(children[1]) || !stack.push_back(children[0]))) {
+        return nullopt;
+      }
+    } else {
+      if (!tasks.push_back({node, next})) {
+        return nullopt;
+      }
+      next += 2 * count - 2;
+    }
+  }
+
+  Concurrency::Atomic<Size> failed = 0;
+  const auto build = [&](const Task& _task) {
+    Vector<Uint32> stack{_allocator};
+    if (!stack.push_back(_task.node)) {
+      failed++;
+      return;
+    }
+    auto next = _task.next;
+    while (!stack.is_empty()) {
+      const auto node = stack.last();
+      stack.pop_back();
+      builder.split(node, next);
+      if (nodes[node].count == 0) {
+        const auto& children = nodes[node].children;
+        if (!stack.push_back(children[1]) || !stack.push_back(children[0])) {
+          failed++;
+          return;
+        }
+      }
+    }
+  };
+
+  Concurrency::WaitGroup group{tasks.size()};
+  tasks.each_fwd([&](const Task& _task) {
+    const bool added = _scheduler.add([&, _task](Sint32) {
+      build(_task);
+      group.signal();
+    });
+    if (!added) {
+      build(_task);
+      group.signal();
+    }
+  });
+
+  group.wait();
+
+  if (failed) {
+    return nullopt;
+  }
+
+  // Lay the nodes out depth first, leaving out those reserved but not used,
+  // and pack the triangles of every leaf.
+  Vector<Node> result{_allocator};
+  Vector<Packet> packets{_allocator};
+
+  struct Visit {
+    Uint32 node;
+    Uint32 parent; // The node to link as the right child of, when not -1.
+  };
+
+  Vector<Visit> visits{_allocator};
+  if (!visits.push_back({0, -1_u32})) {
+    return nullopt;
+  }
+
+  while (!visits.is_empty()) {
+    const auto visit = visits.last();
+    visits.pop_back();
+
+    const auto& node = nodes[visit.node];
+    const auto index = Uint32(result.size());
+    if (visit.parent != -1_u32) {
+      result[visit.parent].index = index;
+    }
+
+    Node compact;
+    compact.min[0] = node.bounds.min.x;
+    compact.min[1] = node.bounds.min.y;
+    compact.min[2] = node.bounds.min.z;
+    compact.max[0] = node.bounds.max.x;
+    compact.max[1] = node.bounds.max.y;
+    compact.max[2] = node.bounds.max.z;
+    compact.index = Uint32(packets.size());
+    compact.count = node.count;
+    if (!result.push_back(compact)) {
+      return nullopt;
+    }
+
+    if (node.count == 0) {
+      if (!visits.push_back({node.children[1], index})
+        || !visits.push_back({node.children[0], -1_u32}))
+      {
+        return nullopt;
+      }
+      continue;
+    }
+
+    Packet packet;
+    Memory::zero(packet);
+    for (Size lane = 0; lane < node.count; lane++) {
+      const auto triangle = permutation[node.offset + lane];
+      const auto& a = positions[elements[triangle * 3 + 0]];
+      const auto edge1 = positions[elements[triangle * 3 + 1]] - a;
+      const auto edge2 = positions[elements[triangle * 3 + 2]] - a;
+      for (Size i = 0; i < 3; i++) {
+        packet.vertex[i][lane] = a[i];
+        packet.edge1[i][lane] = edge1[i];
+        packet.edge2[i][lane] = edge2[i];
+      }
+    }
+
+    if (!packets.push_back(packet)) {
+      return nullopt;
+    }
+  }
+
+  return Bvh{Utility::move(result), Utility::move(packets)};
+}
+
+// Returns the time a ray enters the bounds |_min, _max| when it does so
+// before |_limit|, otherwise NEVER. The ray is given by its point and the
+// inverse of its direction.
+#if defined(__SSE2__)
+static inline Float32 enter(const Float32* _min, const Float32* _max,
+  __m128 _point, __m128 _inverse, Float32 _limit)
+{
+  // The fourth lane of the node is not a bound, only the first three are used.
+  const auto t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(_min), _point), _inverse);
+  const auto t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(_max), _point), _inverse);
+  const auto lo = _mm_min_ps(t0, t1);
+  const auto hi = _mm_max_ps(t0, t1);
+  const auto near = _mm_max_ss(
+    _mm_max_ss(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1, 1, 1, 1))),
+    _mm_max_ss(_mm_movehl_ps(lo, lo), _mm_setzero_ps()));
+  const auto far = _mm_min_ss(
+    _mm_min_ss(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(1, 1, 1, 1))),
+    _mm_min_ss(_mm_movehl_ps(hi, hi), _mm_set_ss(_limit)));
+  return _mm_comile_ss(near, far) ? _mm_cvtss_f32(near) : NEVER;
+}
+#else
+static inline Float32 enter(const Float32* _min, const Float32* _max,
+  const Math::Vec3f& _point, const Math::Vec3f& _inverse, Float32 _limit)
+{
+  auto near = 0.0f;
+  auto far = _limit;
+  for (Size i = 0; i < 3; i++) {
+    const auto t0 = (_min[i] - _point[i]) * _inverse[i];
+    const auto t1 = (_max[i] - _point[i]) * _inverse[i];
+    near = Algorithm::max(near, Algorithm::min(t0, t1));
+    far = Algorithm::min(far, Algorithm::max(t0, t1));
+  }
+  return near <= far ? near : NEVER;
+}
+#endif
+
+// Returns the time of the nearest hit of the ray with |_packet| before
+// |_limit|, otherwise |_limit|.
+#if defined(__SSE2__)
+static inline Float32 intersect(const Bvh::Packet& _packet,
+  const __m128 (&_point)[3], const __m128 (&_direction)[3], Float32 _limit)
+{
+  const auto load = [](const Float32 (&_lanes)[4]) {
+    return _mm_loadu_ps(_lanes);
+  };
+
+  const auto cross = [](const __m128 (&_a)[3], const __m128 (&_b)[3], __m128 (&result_)[3]) {
+    result_[0] = _mm_sub_ps(_mm_mul_ps(_a[1], _b[2]), _mm_mul_ps(_a[2], _b[1]));
+    result_[1] = _mm_sub_ps(_mm_mul_ps(_a[2], _b[0]), _mm_mul_ps(_a[0], _b[2]));
+    result_[2] = _mm_sub_ps(_mm_mul_ps(_a[0], _b[1]), _mm_mul_ps(_a[1], _b[0]));
+  };
+
+  const auto dot = [](const __m128 (&_a)[3], const __m128 (&_b)[3]) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_a[0], _b[0]), _mm_mul_ps(_a[1], _b[1])),
+      _mm_mul_ps(_a[2], _b[2]));
+  };
+
+  const __m128 edge1[3] = {load(_packet.edge1[0]), load(_packet.edge1[1]), load(_packet.edge1[2])};
+  const __m128 edge2[3] = {load(_packet.edge2[0]), load(_packet.edge2[1]), load(_packet.edge2[2])};
+  const __m128 s[3] = {
+    _mm_sub_ps(_point[0], load(_packet.vertex[0])),
+    _mm_sub_ps(_point[1], load(_packet.vertex[1])),
+    _mm_sub_ps(_point[2], load(_packet.vertex[2]))
+  };
+
+  __m128 p[3], q[3];
+  cross(_direction, edge2, p);
+  cross(s, edge1, q);
+
+  const auto determinant = dot(edge1, p);
+  const auto inverse = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+  const auto u = _mm_mul_ps(dot(s, p), inverse);
+  const auto v = _mm_mul_ps(dot(_direction, q), inverse);
+  const auto t = _mm_mul_ps(dot(edge2, q), inverse);
+
+  const auto zero = _mm_setzero_ps();
+  const auto one = _mm_set1_ps(1.0f);
+  const auto epsilon = _mm_set1_ps(1.0e-12f);
+  const auto limit = _mm_set1_ps(_limit);
+
+  // Lanes without a triangle have a determinant of zero.
+  const auto hit = _mm_and_ps(
+    _mm_and_ps(
+      _mm_or_ps(_mm_cmpgt_ps(determinant, epsilon), _mm_cmplt_ps(determinant, _mm_sub_ps(zero, epsilon))),
+      _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero))),
+    _mm_and_ps(
+      _mm_cmple_ps(_mm_add_ps(u, v), one),
+      _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, limit))));
+
+  if (!_mm_movemask_ps(hit)) {
+    return _limit;
+  }
+
+  auto nearest = _mm_or_ps(_mm_and_ps(hit, t), _mm_andnot_ps(hit, limit));
+  nearest = _mm_min_ps(nearest, _mm_shuffle_ps(nearest, nearest, _MM_SHUFFLE(2, 3, 0, 1)));
+  nearest = _mm_min_ps(nearest, _mm_shuffle_ps(nearest, nearest, _MM_SHUFFLE(1, 0, 3, 2)));
+  return _mm_cvtss_f32(nearest);
+}
+#else
+static inline Float32 intersect(const Bvh::Packet& _packet,
+  const Math::Vec3f& _point, const Math::Vec3f& _direction, Float32 _limit)
+{
+  auto nearest = _limit;
+  for (Size lane = 0; lane < PACKET_TRIANGLES; lane++) {
+    const Math::Vec3f vertex{_packet.vertex[0][lane], _packet.vertex[1][lane], _packet.vertex[2][lane]};
+    const Math::Vec3f edge1{_packet.edge1[0][lane], _packet.edge1[1][lane], _packet.edge1[2][lane]};
+    const Math::Vec3f edge2{_packet.edge2[0][lane], _packet.edge2[1][lane], _packet.edge2[2][lane]};
+    const auto p = Math::cross(_direction, edge2);
+    const auto determinant = Math::dot(edge1, p);
+    if (determinant > -1.0e-12f && determinant < 1.0e-12f) {
+      continue;
+    }
+    const auto inverse = 1.0f / determinant;
+    const auto s = _point - vertex;
+    const auto u = Math::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f) {
+      continue;
+    }
+    const auto q = Math::cross(s, edge1);
+    const auto v = Math::dot(_direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f) {
+      continue;
+    }
+    const auto t = Math::dot(edge2, q) * inverse;
+    if (t > 0.0f && t < nearest) {
+      nearest = t;
+    }
+  }
+  return nearest;
+}
+#endif
+
+Optional<Float32> Bvh::ray_cast(const Math::Ray& _ray) const {
+  if (m_nodes.is_empty()) {
+    return nullopt;
+  }
+
+  // Avoid infinities for axes the ray does not move along, as those make NaN
+  // when the ray lies in the plane of a side of the bounds.
+  const auto inverse = _ray.direction().map([](Float32 _value) {
+    return 1.0f / (Math::abs(_value) > 1.0e-20f
+      ? _value : (_value < 0.0f ? -1.0e-20f : 1.0e-20f));
+  });
+
+#if defined(__SSE2__)
+  const auto& point = _ray.point();
+  const auto& direction = _ray.direction();
+  const auto box_point = _mm_setr_ps(point.x, point.y, point.z, 0.0f);
+  const auto box_inverse = _mm_setr_ps(inverse.x, inverse.y, inverse.z, 0.0f);
+  const __m128 packet_point[3] = {
+    _mm_set1_ps(point.x), _mm_set1_ps(point.y), _mm_set1_ps(point.z)
+  };
+  const __m128 packet_direction[3] = {
+    _mm_set1_ps(direction.x), _mm_set1_ps(direction.y), _mm_set1_ps(direction.z)
+  };
+#else
+  const auto& box_point = _ray.point();
+  const auto& box_inverse = inverse;
+  const auto& packet_point = _ray.point();
+  const auto& packet_direction = _ray.direction();
+#endif
+
+  const auto nodes = m_nodes.data();
+  const auto packets = m_packets.data();
+
+  struct Entry {
+    Uint32 node;
+    Float32 time;
+  };
+
+  Entry stack[MAX_DEPTH];
+  Size depth = 0;
+
+  auto nearest = NEVER;
+  auto time = enter(nodes[0].min, nodes[0].max, box_point, box_inverse, nearest);
+  Uint32 index = 0;
+  while (time < nearest) {
+    const auto& node = nodes[index];
+    if (node.count) {
+      nearest = intersect(packets[node.index], packet_point, packet_direction, nearest);
+    } else {
+      // Visit the nearer child first and the other after.
+      auto left = index + 1;
+      auto right = node.index;
+      auto left_time = enter(nodes[left].min, nodes[left].max, box_point, box_inverse, nearest);
+      auto right_time = enter(nodes[right].min, nodes[right].max, box_point, box_inverse, nearest);
+      if (right_time < left_time) {
+        Utility::swap(left, right);
+        Utility::swap(left_time, right_time);
+      }
+      if (left_time < NEVER) {
+        if (right_time < NEVER) {
+          stack[depth++] = {right, right_time};
+        }
+        index = left;
+        time = left_time;
+        continue;
+      }
+    }
+
+    // Take the next node off the stack which the ray may hit before the
+    // nearest hit so far.
+    time = NEVER;
+    while (depth) {
+      const auto& entry = stack[--depth];
+      if (entry.time < nearest) {
+        index = entry.node;
+        time = entry.time;
+        break;
+      }
+    }
+  }
+
+  if (nearest < NEVER) {
+    return nearest;
+  }
+
+  return nullopt;
+}
+
+void Bvh::ray_cast(const Math::Ray* _rays, Size _count, Optional<Float32>* results_) const {
+  for (Size i = 0; i < _count; i++) {
+    results_[i] = ray_cast(_rays[i]);
+  }
+}
+
+} // namespace Rx::Model
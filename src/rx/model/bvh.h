@@ -0,0 +1,89 @@
+#ifndef RX_MODEL_BVH_H
+#define RX_MODEL_BVH_H
+#include "rx/core/vector.h"
+#include "rx/math/vec3.h"
+
+namespace Rx::Concurrency {
+  struct Scheduler;
+} // namespace Rx::Concurrency
+
+namespace Rx::Math {
+  struct Ray;
+} // namespace Rx::Math
+
+namespace Rx::Model {
+
+// Bounding volume hierarchy over triangles for exact ray queries. Built top
+// down with the surface area heuristic evaluated over bins of the triangle
+// centroids [Wald 2007], with the subtrees built in parallel.
+struct Bvh {
+  static Optional<Bvh> create(
+    Concurrency::Scheduler& _scheduler,
+    Memory::Allocator& _allocator,
+    const Vector<Math::Vec3f>& _positions,
+    const Vector<Uint32>& _elements);
+
+  // Casts |_ray| against the triangles, returning the time of the nearest hit,
+  // which is the distance to it for rays with a direction of unit length.
+  // Both sides of the triangles are hit.
+  Optional<Float32> ray_cast(const Math::Ray& _ray) const;
+
+  // Casts the |_count| rays of |_rays| like the above, writing the result of
+  // each to |results_|.
+  void ray_cast(const Math::Ray* _rays, Size _count, Optional<Float32>* results_) const;
+
+  Size nodes() const;
+  Size packets() const;
+
+  Bvh(Bvh&& bvh_);
+
+  // Nodes are in depth-first order, the left child of an interior node is the
+  // node after it.
+  struct Node {
+    Float32 min[3];
+    Uint32 index; // Packet of a leaf or right child of an interior node.
+    Float32 max[3];
+    Uint32 count; // Triangles of a leaf, zero for interior nodes.
+  };
+
+  static_assert(sizeof(Node) == 32, "nodes should be 32 bytes");
+
+  // The triangles of every leaf are stored together, a component of each in
+  // every lane, so they're intersected four at a time [Moller and Trumbore
+  // 1997]. Lanes without a triangle are zero and never hit.
+  struct Packet {
+    Float32 vertex[3][4];
+    Float32 edge1[3][4];
+    Float32 edge2[3][4];
+  };
+
+private:
+  Bvh(Vector<Node>&& nodes_, Vector<Packet>&& packets_);
+
+  Vector<Node> m_nodes;
+  Vector<Packet> m_packets;
+};
+
+inline Bvh::Bvh(Bvh&& bvh_)
+  : m_nodes{Utility::move(bvh_.m_nodes)}
+  , m_packets{Utility::move(bvh_.m_packets)}
+{
+}
+
+inline Bvh::Bvh(Vector<Node>&& nodes_, Vector<Packet>&& packets_)
+  : m_nodes{Utility::move(nodes_)}
+  , m_packets{Utility::move(packets_)}
+{
+}
+
+inline Size Bvh::nodes() const {
+  return m_nodes.size();
+}
+
+inline Size Bvh::packets() const {
+  return m_packets.size();
+}
+
+} // namespace Rx::Model
+
+#endif // RX_MODEL_BVH_H
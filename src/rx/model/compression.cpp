@@ -0,0 +1,706 @@
+#include "rx/model/compression.h"
+#include "rx/model/animation.h"
+
+#include "rx/core/math/abs.h"
+#include "rx/core/math/sqrt.h"
+#include "rx/core/math/round.h"
+
+#include "rx/core/algorithm/clamp.h"
+#include "rx/core/algorithm/max.h"
+#include "rx/core/algorithm/min.h"
+
+#include "rx/math/quat.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Rx::Model {
+
+// The three smallest components of a rotation are in [-1/sqrt(2), 1/sqrt(2)]
+// and quantized to 15 bits, with an odd number of steps so zero is exact. The
+// index of the largest component is in the top bit of the first two.
+static constexpr const Float32 ROTATION_ZERO = 16383.0f;
+static constexpr const Float32 ROTATION_SCALE = ROTATION_ZERO * 1.41421356f;
+static constexpr const Float32 ROTATION_STEP = 1.0f / ROTATION_SCALE;
+
+// Translations and scales are quantized to 16 bits of the range they span.
+static constexpr const Float32 RANGE_STEPS = 65535.0f;
+
+// Frames of a clip are kept in 16 bits.
+static constexpr const Size MAX_CLIP_FRAMES = 65536;
+
+struct Decomposed {
+  Math::Quatf rotation;
+  Math::Vec3f translation;
+  Math::Vec3f scale;
+};
+
+// Splits |_frame| into the scale of every column and the rotation and
+// translation left.
+static Decomposed decompose(const Math::Mat3x4f& _frame) {
+  Math::Vec3f scale;
+  Float32 inverse[3];
+  for (Size i = 0; i < 3; i++) {
+    scale[i] = Math::length(Math::Vec3f{_frame.x[i], _frame.y[i], _frame.z[i]});
+    inverse[i] = scale[i] > 0.0f ? 1.0f / scale[i] : 1.0f;
+  }
+
+  const Math::Mat3x4f rotation{
+    {_frame.x.x * inverse[0], _frame.x.y * inverse[1], _frame.x.z * inverse[2], 0.0f},
+    {_frame.y.x * inverse[0], _frame.y.y * inverse[1], _frame.y.z * inverse[2], 0.0f},
+    {_frame.z.x * inverse[0], _frame.z.y * inverse[1], _frame.z.z * inverse[2], 0.0f}};
+
+  return {
+    Math::normalize(Math::Quatf{rotation}),
+    {_frame.x.w, _frame.y.w, _frame.z.w},
+    scale
+  };
+}
+
+static Math::Quatf nlerp(const Math::Quatf& _from, const Math::Quatf& _to, Float32 _t) {
+  const auto k = Math::dot(_from, _to) < 0.0f ? -_t : _t;
+  return Math::normalize(_from * (1.0f - _t) + _to * k);
+}
+
+static Math::Vec3f lerp(const Math::Vec3f& _from, const Math::Vec3f& _to, Float32 _t) {
+  return _from * (1.0f - _t) + _to * _t;
+}
+
+// The angle between two rotations, for small angles, which is about twice
+// the distance between them.
+static Float32 rotation_distance(const Math::Quatf& _a, const Math::Quatf& _b) {
+  const auto sign = Math::dot(_a, _b) < 0.0f ? -1.0f : 1.0f;
+  return 2.0f * Math::length(_a - _b * sign);
+}
+
+static Float32 range_distance(const Math::Vec3f& _a, const Math::Vec3f& _b) {
+  return Algorithm::max(Math::abs(_a.x - _b.x), Math::abs(_a.y - _b.y),
+    Math::abs(_a.z - _b.z));
+}
+
+// [CompressedFrames]
+Optional<CompressedFrames> CompressedFrames::copy(const CompressedFrames& _frames) {
+  auto clips = Utility::copy(_frames.m_clips);
+  auto tracks = Utility::copy(_frames.m_tracks);
+  auto times = Utility::copy(_frames.m_times);
+  auto keys = Utility::copy(_frames.m_keys);
+
+  if (!clips || !tracks || !times || !keys) {
+    return nullopt;
+  }
+
+  return CompressedFrames {
+    _frames.m_joints,
+    Utility::move(*clips),
+    Utility::move(*tracks),
+    Utility::move(*times),
+    Utility::move(*keys)
+  };
+}
+
+CompressedFrames::Key CompressedFrames::encode(const Math::Quatf& _rotation) {
+  const Float32 components[]{_rotation.x, _rotation.y, _rotation.z, _rotation.w};
+
+  Size largest = 0;
+  for (Size i = 1; i < 4; i++) {
+    if (Math::abs(components[i]) > Math::abs(components[largest])) {
+      largest = i;
+    }
+  }
+
+  // The largest is implied positive, which is the same rotation.
+  const auto sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+  Key key;
+  for (Size i = 0, j = 0; i < 4; i++) {
+    if (i != largest) {
+      const auto value =
+        Math::round(components[i] * sign * ROTATION_SCALE) + ROTATION_ZERO;
+      key.value[j++] =
+        static_cast<Uint16>(Algorithm::clamp(value, 0.0f, ROTATION_ZERO * 2.0f));
+    }
+  }
+
+  key.value[0] |= (largest & 1) << 15;
+  key.value[1] |= (largest >> 1) << 15;
+
+  return key;
+}
+
+Math::Quatf CompressedFrames::decode(const Key& _key) {
+  const Size largest = (_key.value[0] >> 15) | ((_key.value[1] >> 15) << 1);
+
+  Float32 components[4];
+  Float32 sum = 0.0f;
+  for (Size i = 0, j = 0; i < 4; i++) {
+    if (i != largest) {
+      const auto value = Float32(_key.value[j++] & 0x7fff);
+      components[i] = (value - ROTATION_ZERO) * ROTATION_STEP;
+      sum += components[i] * components[i];
+    }
+  }
+  components[largest] = Math::sqrt(Algorithm::max(1.0f - sum, 0.0f));
+
+  return {components[0], components[1], components[2], components[3]};
+}
+
+CompressedFrames::Key CompressedFrames::encode(const Range& _range,
+  const Math::Vec3f& _value)
+{
+  Key key;
+  for (Size i = 0; i < 3; i++) {
+    const auto value = _range.step[i] > 0.0f
+      ? Math::round((_value[i] - _range.min[i]) / _range.step[i]) : 0.0f;
+    key.value[i] = static_cast<Uint16>(Algorithm::clamp(value, 0.0f, RANGE_STEPS));
+  }
+  return key;
+}
+
+Math::Vec3f CompressedFrames::decode(const Range& _range, const Key& _key) {
+  return {
+    _range.min[0] + Float32(_key.value[0]) * _range.step[0],
+    _range.min[1] + Float32(_key.value[1]) * _range.step[1],
+    _range.min[2] + Float32(_key.value[2]) * _range.step[2]
+  };
+}
+
+CompressedFrames::Range CompressedFrames::range_of(const Math::Vec3f* _values,
+  Size _count)
+{
+  Math::Vec3f min = _values[0];
+  Math::Vec3f max = _values[0];
+  for (Size i = 1; i < _count; i++) {
+    for (Size j = 0; j < 3; j++) {
+      min[j] = Algorithm::min(min[j], _values[i][j]);
+      max[j] = Algorithm::max(max[j], _values[i][j]);
+    }
+  }
+
+  Range range;
+  for (Size i = 0; i < 3; i++) {
+    range.min[i] = min[i];
+    range.step[i] = (max[i] - min[i]) / RANGE_STEPS;
+  }
+  return range;
+}
+
+// Writes the frames of the keys of |_decoded| to keep to |times_|. Every
+// frame not kept is within |_error| of the values interpolated from the keys
+// around it, measured from |_original| by |_distance|.
+//
+// Keys are kept greedily, each as far from the last as the frames between
+// them allow. A single key is kept when every frame is within the error of
+// the first.
+template<typename T, typename L, typename D>
+static bool reduce(const T* _decoded, const T* _original, Size _count,
+  Float32 _error, L&& _lerp, D&& _distance, Vector<Uint16>& times_)
+{
+  bool constant = true;
+  for (Size i = 0; i < _count && constant; i++) {
+    constant = _distance(_decoded[0], _original[i]) <= _error;
+  }
+
+  if (!times_.push_back(0)) {
+    return false;
+  }
+
+  if (constant || _count == 1) {
+    return true;
+  }
+
+  Size start = 0;
+  for (Size end = 2; end < _count; end++) {
+    bool fits = true;
+    for (Size i = start + 1; i < end && fits; i++) {
+      const auto t = Float32(i - start) / Float32(end - start);
+      fits = _distance(_lerp(_decoded[start], _decoded[end], t), _original[i]) <= _error;
+    }
+    if (!fits) {
+      start = end - 1;
+      if (!times_.push_back(static_cast<Uint16>(start))) {
+        return false;
+      }
+    }
+  }
+
+  return times_.push_back(static_cast<Uint16>(_count - 1));
+}
+
+Optional<CompressedFrames> CompressedFrames::create(Memory::Allocator& _allocator,
+  const Skeleton& _skeleton, const Vector<Clip>& _clips,
+  const CompressConfig& _config, Vector<CompressionStats>& stats_)
+{
+  const auto n_joints = _skeleton.joints().size();
+  const auto n_blocks = _skeleton.blocks_per_frame();
+  const auto& frames = _skeleton.blocks();
+  const auto n_frames = _skeleton.frames();
+
+  Vector<ClipFrames> clips{_allocator};
+  Vector<Track> tracks{_allocator};
+  Vector<Uint16> times{_allocator};
+  Vector<Key> keys{_allocator};
+
+  // The frames of a joint in a clip, as they are and once quantized.
+  Vector<Math::Quatf> rotations{_allocator};
+  Vector<Math::Vec3f> translations{_allocator};
+  Vector<Math::Vec3f> scales{_allocator};
+  Vector<Key> quantized{_allocator};
+  Vector<Math::Quatf> decoded_rotations{_allocator};
+  Vector<Math::Vec3f> decoded_translations{_allocator};
+  Vector<Math::Vec3f> decoded_scales{_allocator};
+
+  // Adds the keys of |quantized| at |times| after |_offset|.
+  const auto add_keys = [&](Uint32 _offset, Channel& channel_) {
+    channel_.offset = _offset;
+    channel_.count = static_cast<Uint32>(times.size() - _offset);
+    for (Size i = _offset; i < times.size(); i++) {
+      if (!keys.push_back(quantized[times[i]])) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  const auto rotation_lerp = [](const Math::Quatf& _a, const Math::Quatf& _b, Float32 _t) {
+    return nlerp(_a, _b, _t);
+  };
+
+  const auto range_lerp = [](const Math::Vec3f& _a, const Math::Vec3f& _b, Float32 _t) {
+    return lerp(_a, _b, _t);
+  };
+
+  Size next_frame = 0;
+  for (Size i = 0; i < _clips.size(); i++) {
+    const auto& clip = _clips[i];
+    const auto n_clip_frames = clip.frame_count;
+
+    if (clip.frame_offset < next_frame || n_clip_frames == 0
+      || n_clip_frames > MAX_CLIP_FRAMES
+      || clip.frame_offset + n_clip_frames > n_frames)
+    {
+      return nullopt;
+    }
+
+    next_frame = clip.frame_offset + n_clip_frames;
+
+    if (!clips.push_back({clip.frame_offset, n_clip_frames})) {
+      return nullopt;
+    }
+
+    if (!rotations.resize(n_clip_frames) || !translations.resize(n_clip_frames)
+      || !scales.resize(n_clip_frames) || !quantized.resize(n_clip_frames)
+      || !decoded_rotations.resize(n_clip_frames)
+      || !decoded_translations.resize(n_clip_frames)
+      || !decoded_scales.resize(n_clip_frames))
+    {
+      return nullopt;
+    }
+
+    const auto first_key = keys.size();
+
+    for (Size j = 0; j < n_joints; j++) {
+      for (Size k = 0; k < n_clip_frames; k++) {
+        const auto frame = _skeleton.lb_frame(clip.frame_offset + k, j);
+        const auto decomposed = decompose(frame);
+        rotations[k] = decomposed.rotation;
+        translations[k] = decomposed.translation;
+        scales[k] = decomposed.scale;
+      }
+
+      Track track;
+      track.translation_range = range_of(translations.data(), n_clip_frames);
+      track.scale_range = range_of(scales.data(), n_clip_frames);
+
+      for (Size k = 0; k < n_clip_frames; k++) {
+        quantized[k] = encode(rotations[k]);
+        decoded_rotations[k] = decode(quantized[k]);
+      }
+      auto offset = static_cast<Uint32>(times.size());
+      if (!reduce(decoded_rotations.data(), rotations.data(), n_clip_frames,
+        _config.rotation_error, rotation_lerp, rotation_distance, times)
+        || !add_keys(offset, track.rotation))
+      {
+        return nullopt;
+      }
+
+      for (Size k = 0; k < n_clip_frames; k++) {
+        quantized[k] = encode(track.translation_range, translations[k]);
+        decoded_translations[k] = decode(track.translation_range, quantized[k]);
+      }
+      offset = static_cast<Uint32>(times.size());
+      if (!reduce(decoded_translations.data(), translations.data(), n_clip_frames,
+        _config.translation_error, range_lerp, range_distance, times)
+        || !add_keys(offset, track.translation))
+      {
+        return nullopt;
+      }
+
+      for (Size k = 0; k < n_clip_frames; k++) {
+        quantized[k] = encode(track.scale_range, scales[k]);
+        decoded_scales[k] = decode(track.scale_range, quantized[k]);
+      }
+      offset = static_cast<Uint32>(times.size());
+      if (!reduce(decoded_scales.data(), scales.data(), n_clip_frames,
+        _config.scale_error, range_lerp, range_distance, times)
+        || !add_keys(offset, track.scale))
+      {
+        return nullopt;
+      }
+
+      if (!tracks.push_back(track)) {
+        return nullopt;
+      }
+    }
+
+    CompressionStats stats;
+    stats.raw_bytes = n_clip_frames * n_joints
+      * (sizeof(Math::Mat3x4f) + sizeof(Math::DualQuatf))
+      + n_clip_frames * n_blocks * sizeof(Skeleton::Block);
+    stats.keys = keys.size() - first_key;
+    stats.samples = n_clip_frames * n_joints * 3;
+    stats.compressed_bytes = sizeof(ClipFrames) + n_joints * sizeof(Track)
+      + stats.keys * (sizeof(Key) + sizeof(Uint16));
+
+    if (!stats_.push_back(stats)) {
+      return nullopt;
+    }
+  }
+
+  CompressedFrames result {
+    n_joints,
+    Utility::move(clips),
+    Utility::move(tracks),
+    Utility::move(times),
+    Utility::move(keys)
+  };
+
+  // Measure the error of every clip from the frames as they were.
+  Vector<Skeleton::Block> blocks{_allocator};
+  if (!blocks.resize(n_blocks)) {
+    return nullopt;
+  }
+
+  const auto first_stats = stats_.size() - _clips.size();
+  for (Size i = 0; i < _clips.size(); i++) {
+    const auto& clip = _clips[i];
+    auto& stats = stats_[first_stats + i];
+    for (Size k = 0; k < clip.frame_count; k++) {
+      const auto frame = clip.frame_offset + k;
+      result.decompress(frame, blocks.data());
+      for (Size j = 0; j < n_joints; j++) {
+        const auto& block = blocks[j / 4];
+        const auto& source = frames[frame * n_blocks + j / 4];
+        const auto lane = j % 4;
+
+        for (Size l = 0; l < 12; l++) {
+          stats.lb_error = Algorithm::max(stats.lb_error,
+            Math::abs(block.lb[lane][l] - source.lb[lane][l]));
+        }
+
+        // Either sign of a dual quaternion is the same transform.
+        Float32 same = 0.0f;
+        Float32 opposite = 0.0f;
+        for (Size l = 0; l < 8; l++) {
+          same = Algorithm::max(same, Math::abs(block.dq[l][lane] - source.dq[l][lane]));
+          opposite = Algorithm::max(opposite, Math::abs(block.dq[l][lane] + source.dq[l][lane]));
+        }
+        stats.dq_error = Algorithm::max(stats.dq_error, Algorithm::min(same, opposite));
+      }
+    }
+  }
+
+  return result;
+}
+
+CompressedFrames::Sample CompressedFrames::sample(const Channel& _channel,
+  Size _frame) const
+{
+  const auto times = m_times.data() + _channel.offset;
+  const auto keys = m_keys.data() + _channel.offset;
+
+  // The last key at or before the frame, the first key is at the first frame.
+  // Halved without branching on the keys, which would be unpredictable.
+  Size lo = 0;
+  for (Size n = _channel.count; n > 1; n -= n / 2) {
+    const auto half = lo + n / 2;
+    lo = times[half] <= _frame ? half : lo;
+  }
+
+  if (lo + 1 == _channel.count) {
+    return {keys + lo, keys + lo, 0.0f};
+  }
+
+  const auto t = Float32(_frame - times[lo]) / Float32(times[lo + 1] - times[lo]);
+  return {keys + lo, keys + lo + 1, t};
+}
+
+void CompressedFrames::decompress(Size _frame, Skeleton::Block* blocks_) const {
+  // The last clip starting at or before the frame.
+  Size lo = 0;
+  Size hi = m_clips.size();
+  while (hi - lo > 1) {
+    const auto mid = (lo + hi) / 2;
+    if (m_clips[mid].frame_offset <= _frame) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  const auto& clip = m_clips[lo];
+  RX_ASSERT(_frame >= clip.frame_offset
+    && _frame - clip.frame_offset < clip.frame_count, "frame not in a clip");
+
+  const auto frame = _frame - clip.frame_offset;
+  const auto tracks = m_tracks.data() + lo * m_joints;
+  const auto n_blocks = (m_joints + 3) / 4;
+  for (Size i = 0; i < n_blocks; i++) {
+    const auto first = i * 4;
+    decompress_block(tracks + first, Algorithm::min(m_joints - first, 4_z),
+      frame, blocks_[i]);
+  }
+}
+
+#if defined(__SSE2__)
+static inline __m128 select(__m128 _mask, __m128 _a, __m128 _b) {
+  return _mm_or_ps(_mm_and_ps(_mask, _a), _mm_andnot_ps(_mask, _b));
+}
+
+// Decodes the rotations of four keys, the three smallest components and the
+// index of the largest in every lane.
+static inline void decode4(const Sint32 (&_key)[4][4], __m128 (&rotation_)[4]) {
+  const auto zero = _mm_set1_ps(ROTATION_ZERO);
+  const auto step = _mm_set1_ps(ROTATION_STEP);
+
+  __m128 small[3];
+  auto sum = _mm_setzero_ps();
+  for (Size i = 0; i < 3; i++) {
+    const auto value = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_key[i])));
+    small[i] = _mm_mul_ps(_mm_sub_ps(value, zero), step);
+    sum = _mm_add_ps(sum, _mm_mul_ps(small[i], small[i]));
+  }
+  const auto largest =
+    _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), sum), _mm_setzero_ps()));
+
+  const auto index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_key[3]));
+  const auto is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(0)));
+  const auto is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(1)));
+  const auto is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(2)));
+  const auto is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(3)));
+
+  // The smallest are in order around the largest.
+  rotation_[0] = select(is0, largest, small[0]);
+  rotation_[1] = select(is0, small[0], select(is1, largest, small[1]));
+  rotation_[2] = select(_mm_or_ps(is0, is1), small[1], select(is2, largest, small[2]));
+  rotation_[3] = select(is3, largest, small[2]);
+}
+
+static inline __m128 lerp4(__m128 _a, __m128 _b, __m128 _t) {
+  return _mm_add_ps(_a, _mm_mul_ps(_mm_sub_ps(_b, _a), _t));
+}
+#endif
+
+void CompressedFrames::decompress_block(const Track* _tracks, Size _joints,
+  Size _frame, Skeleton::Block& block_) const
+{
+#if defined(__SSE2__)
+  // The keys around the frame of every joint, a joint in every lane. Lanes
+  // past the last joint repeat the first and are replaced after.
+  Sint32 rotations[2][4][4];
+  Sint32 translations[2][3][4];
+  Sint32 scales[2][3][4];
+  Float32 translation_ranges[2][3][4];
+  Float32 scale_ranges[2][3][4];
+  Float32 t[3][4];
+
+  for (Size lane = 0; lane < 4; lane++) {
+    const auto& track = _tracks[lane < _joints ? lane : 0];
+
+    const auto rotation = sample(track.rotation, _frame);
+    const auto translation = sample(track.translation, _frame);
+    const auto scale = sample(track.scale, _frame);
+
+    const Key* rotation_keys[]{rotation.a, rotation.b};
+    const Key* translation_keys[]{translation.a, translation.b};
+    const Key* scale_keys[]{scale.a, scale.b};
+    for (Size i = 0; i < 2; i++) {
+      const auto& key = *rotation_keys[i];
+      rotations[i][0][lane] = key.value[0] & 0x7fff;
+      rotations[i][1][lane] = key.value[1] & 0x7fff;
+      rotations[i][2][lane] = key.value[2];
+      rotations[i][3][lane] = (key.value[0] >> 15) | ((key.value[1] >> 15) << 1);
+      for (Size j = 0; j < 3; j++) {
+        translations[i][j][lane] = translation_keys[i]->value[j];
+        scales[i][j][lane] = scale_keys[i]->value[j];
+      }
+    }
+
+    for (Size j = 0; j < 3; j++) {
+      translation_ranges[0][j][lane] = track.translation_range.min[j];
+      translation_ranges[1][j][lane] = track.translation_range.step[j];
+      scale_ranges[0][j][lane] = track.scale_range.min[j];
+      scale_ranges[1][j][lane] = track.scale_range.step[j];
+    }
+
+    t[0][lane] = rotation.t;
+    t[1][lane] = translation.t;
+    t[2][lane] = scale.t;
+  }
+
+  // Interpolate the rotations along the shortest path.
+  __m128 from[4];
+  __m128 to[4];
+  decode4(rotations[0], from);
+  decode4(rotations[1], to);
+
+  const auto rotation_t = _mm_loadu_ps(t[0]);
+  auto dot = _mm_mul_ps(from[0], to[0]);
+  for (Size i = 1; i < 4; i++) {
+    dot = _mm_add_ps(dot, _mm_mul_ps(from[i], to[i]));
+  }
+  const auto sign = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()),
+    _mm_set1_ps(-0.0f));
+
+  __m128 q[4];
+  auto length = _mm_setzero_ps();
+  for (Size i = 0; i < 4; i++) {
+    q[i] = lerp4(from[i], _mm_xor_ps(to[i], sign), rotation_t);
+    length = _mm_add_ps(length, _mm_mul_ps(q[i], q[i]));
+  }
+  const auto scale = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length));
+  for (Size i = 0; i < 4; i++) {
+    q[i] = _mm_mul_ps(q[i], scale);
+  }
+
+  // Decode the translations and scales from their ranges.
+  const auto decode_range = [](const Sint32 (&_keys)[2][3][4],
+    const Float32 (&_ranges)[2][3][4], __m128 _t, __m128 (&result_)[3])
+  {
+    for (Size i = 0; i < 3; i++) {
+      const auto min = _mm_loadu_ps(_ranges[0][i]);
+      const auto step = _mm_loadu_ps(_ranges[1][i]);
+      const auto a = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_keys[0][i])));
+      const auto b = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_keys[1][i])));
+      result_[i] = lerp4(_mm_add_ps(min, _mm_mul_ps(a, step)),
+        _mm_add_ps(min, _mm_mul_ps(b, step)), _t);
+    }
+  };
+
+  __m128 tr[3];
+  __m128 sc[3];
+  decode_range(translations, translation_ranges, _mm_loadu_ps(t[1]), tr);
+  decode_range(scales, scale_ranges, _mm_loadu_ps(t[2]), sc);
+
+  // The rotation matrix scaled by column, with the translation last.
+  const auto one = _mm_set1_ps(1.0f);
+  const auto two = _mm_set1_ps(2.0f);
+  const auto xx = _mm_mul_ps(q[0], q[0]);
+  const auto yy = _mm_mul_ps(q[1], q[1]);
+  const auto zz = _mm_mul_ps(q[2], q[2]);
+  const auto xy = _mm_mul_ps(q[0], q[1]);
+  const auto xz = _mm_mul_ps(q[0], q[2]);
+  const auto yz = _mm_mul_ps(q[1], q[2]);
+  const auto wx = _mm_mul_ps(q[3], q[0]);
+  const auto wy = _mm_mul_ps(q[3], q[1]);
+  const auto wz = _mm_mul_ps(q[3], q[2]);
+
+  __m128 rows[3][4] = {
+    {
+      _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sc[0]),
+      _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sc[1]),
+      _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sc[2]),
+      tr[0]
+    },
+    {
+      _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sc[0]),
+      _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sc[1]),
+      _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sc[2]),
+      tr[1]
+    },
+    {
+      _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sc[0]),
+      _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sc[1]),
+      _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sc[2]),
+      tr[2]
+    }
+  };
+
+  // Transpose to the row of a joint in every lane.
+  for (Size i = 0; i < 3; i++) {
+    _MM_TRANSPOSE4_PS(rows[i][0], rows[i][1], rows[i][2], rows[i][3]);
+    for (Size lane = 0; lane < 4; lane++) {
+      _mm_storeu_ps(block_.lb[lane] + i * 4, rows[i][lane]);
+    }
+  }
+
+  // The dual quaternions are a component in every lane already.
+  const auto half = _mm_set1_ps(0.5f);
+  const auto dual_x = _mm_add_ps(_mm_mul_ps(tr[0], q[3]),
+    _mm_sub_ps(_mm_mul_ps(tr[1], q[2]), _mm_mul_ps(tr[2], q[1])));
+  const auto dual_y = _mm_add_ps(_mm_mul_ps(tr[1], q[3]),
+    _mm_sub_ps(_mm_mul_ps(tr[2], q[0]), _mm_mul_ps(tr[0], q[2])));
+  const auto dual_z = _mm_add_ps(_mm_mul_ps(tr[2], q[3]),
+    _mm_sub_ps(_mm_mul_ps(tr[0], q[1]), _mm_mul_ps(tr[1], q[0])));
+  const auto dual_w = _mm_add_ps(_mm_mul_ps(tr[0], q[0]),
+    _mm_add_ps(_mm_mul_ps(tr[1], q[1]), _mm_mul_ps(tr[2], q[2])));
+
+  for (Size i = 0; i < 4; i++) {
+    _mm_storeu_ps(block_.dq[i], q[i]);
+  }
+  _mm_storeu_ps(block_.dq[4], _mm_mul_ps(dual_x, half));
+  _mm_storeu_ps(block_.dq[5], _mm_mul_ps(dual_y, half));
+  _mm_storeu_ps(block_.dq[6], _mm_mul_ps(dual_z, half));
+  _mm_storeu_ps(block_.dq[7], _mm_mul_ps(dual_w, _mm_set1_ps(-0.5f)));
+#else
+  for (Size lane = 0; lane < _joints; lane++) {
+    const auto& track = _tracks[lane];
+
+    const auto rotation = sample(track.rotation, _frame);
+    const auto translation = sample(track.translation, _frame);
+    const auto scale = sample(track.scale, _frame);
+
+    const auto q = nlerp(decode(*rotation.a), decode(*rotation.b), rotation.t);
+    const auto tr = lerp(decode(track.translation_range, *translation.a),
+      decode(track.translation_range, *translation.b), translation.t);
+    const auto sc = lerp(decode(track.scale_range, *scale.a),
+      decode(track.scale_range, *scale.b), scale.t);
+
+    const Math::Mat3x4f lb{
+      {(1.0f - 2.0f * (q.y * q.y + q.z * q.z)) * sc.x,
+        2.0f * (q.x * q.y - q.w * q.z) * sc.y,
+        2.0f * (q.x * q.z + q.w * q.y) * sc.z,
+        tr.x},
+      {2.0f * (q.x * q.y + q.w * q.z) * sc.x,
+        (1.0f - 2.0f * (q.x * q.x + q.z * q.z)) * sc.y,
+        2.0f * (q.y * q.z - q.w * q.x) * sc.z,
+        tr.y},
+      {2.0f * (q.x * q.z - q.w * q.y) * sc.x,
+        2.0f * (q.y * q.z + q.w * q.x) * sc.y,
+        (1.0f - 2.0f * (q.x * q.x + q.y * q.y)) * sc.z,
+        tr.z}};
+    const Math::DualQuatf dq{q, tr};
+
+    const auto lb_data = lb.data();
+    const auto dq_data = reinterpret_cast<const Float32*>(&dq);
+    for (Size i = 0; i < 12; i++) {
+      block_.lb[lane][i] = lb_data[i];
+    }
+    for (Size i = 0; i < 8; i++) {
+      block_.dq[i][lane] = dq_data[i];
+    }
+  }
+#endif
+
+  // Joints past the last are the identity, like the blocks of the skeleton.
+  for (Size lane = _joints; lane < 4; lane++) {
+    for (Size i = 0; i < 12; i++) {
+      block_.lb[lane][i] = i % 5 == 0 ? 1.0f : 0.0f;
+    }
+    for (Size i = 0; i < 8; i++) {
+      block_.dq[i][lane] = i == 3 ? 1.0f : 0.0f;
+    }
+  }
+}
+
+} // namespace Rx::Model
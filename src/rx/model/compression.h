@@ -0,0 +1,183 @@
+#ifndef RX_MODEL_COMPRESSION_H
+#define RX_MODEL_COMPRESSION_H
+#include "rx/model/skeleton.h"
+
+#include "rx/math/quat.h"
+#include "rx/math/vec3.h"
+
+namespace Rx::Model {
+
+struct Clip;
+
+struct CompressConfig {
+  // The largest error of the rotation of any joint, in radians.
+  Float32 rotation_error = 0.001f;
+
+  // The largest error of the translation of any joint on any axis, in the
+  // units of the model.
+  Float32 translation_error = 0.001f;
+
+  // The largest error of the scale of any joint on any axis.
+  Float32 scale_error = 0.001f;
+};
+
+// The size and accuracy of the frames of a clip once compressed.
+struct CompressionStats {
+  // The bytes taken by the frames before and after.
+  Size raw_bytes = 0;
+  Size compressed_bytes = 0;
+
+  // The keys kept of the rotations, translations and scales of every joint
+  // in every frame.
+  Size keys = 0;
+  Size samples = 0;
+
+  // The largest difference of any component of the matrices and dual
+  // quaternions decompressed from the frames they were compressed from.
+  Float32 lb_error = 0.0f;
+  Float32 dq_error = 0.0f;
+};
+
+// The frames of a skeleton, compressed clip by clip.
+//
+// Every frame is split into the rotation, translation and scale of each joint.
+// Rotations are quantized to their three smallest components, the largest
+// being implied, and translations and scales to the range they span in the
+// clip. Frames which are within the error bounds of the frames interpolated
+// from their neighbours are then removed, so only keys are kept.
+//
+// Frames are decompressed into |Skeleton::Block|, four joints at a time.
+struct CompressedFrames {
+  RX_MARK_NO_COPY(CompressedFrames);
+
+  CompressedFrames(CompressedFrames&& frames_);
+  CompressedFrames& operator=(CompressedFrames&& frames_);
+
+  // Compresses the frames of |_clips| of |_skeleton|, which must be after one
+  // another, writing the stats of every clip to |stats_|.
+  static Optional<CompressedFrames> create(Memory::Allocator& _allocator,
+    const Skeleton& _skeleton, const Vector<Clip>& _clips,
+    const CompressConfig& _config, Vector<CompressionStats>& stats_);
+
+  static Optional<CompressedFrames> copy(const CompressedFrames& _frames);
+
+  // Decompresses |_frame| of every joint into |blocks_|, a block for every
+  // four joints.
+  void decompress(Size _frame, Skeleton::Block* blocks_) const;
+
+  // The number of frames.
+  Size frames() const;
+
+  // The bytes taken by the compressed frames.
+  Size bytes() const;
+
+private:
+  // The three components of a key, quantized.
+  struct Key {
+    Uint16 value[3];
+  };
+
+  // The keys of a channel, at |offset| in the times and keys.
+  struct Channel {
+    Uint32 offset;
+    Uint32 count;
+  };
+
+  // Quantized values are |min| plus |step| times the value.
+  struct Range {
+    Float32 min[3];
+    Float32 step[3];
+  };
+
+  // The channels of a joint in a clip.
+  struct Track {
+    Channel rotation;
+    Channel translation;
+    Channel scale;
+    Range translation_range;
+    Range scale_range;
+  };
+
+  struct ClipFrames {
+    Size frame_offset;
+    Size frame_count;
+  };
+
+  // The keys around a frame of a channel and the offset between them.
+  struct Sample {
+    const Key* a;
+    const Key* b;
+    Float32 t;
+  };
+
+  CompressedFrames(Size _joints, Vector<ClipFrames>&& clips_,
+    Vector<Track>&& tracks_, Vector<Uint16>&& times_, Vector<Key>&& keys_);
+
+  static Key encode(const Math::Quatf& _rotation);
+  static Math::Quatf decode(const Key& _key);
+  static Key encode(const Range& _range, const Math::Vec3f& _value);
+  static Math::Vec3f decode(const Range& _range, const Key& _key);
+  static Range range_of(const Math::Vec3f* _values, Size _count);
+
+  Sample sample(const Channel& _channel, Size _frame) const;
+
+  // Decompresses |_frame| of the |_joints| of |_tracks| into |block_|.
+  void decompress_block(const Track* _tracks, Size _joints, Size _frame,
+    Skeleton::Block& block_) const;
+
+  Size m_joints;
+  Vector<ClipFrames> m_clips;
+  Vector<Track> m_tracks;
+  Vector<Uint16> m_times;
+  Vector<Key> m_keys;
+};
+
+inline CompressedFrames::CompressedFrames(Size _joints,
+  Vector<ClipFrames>&& clips_, Vector<Track>&& tracks_,
+  Vector<Uint16>&& times_, Vector<Key>&& keys_)
+  : m_joints{_joints}
+  , m_clips{Utility::move(clips_)}
+  , m_tracks{Utility::move(tracks_)}
+  , m_times{Utility::move(times_)}
+  , m_keys{Utility::move(keys_)}
+{
+}
+
+inline CompressedFrames::CompressedFrames(CompressedFrames&& frames_)
+  : m_joints{Utility::exchange(frames_.m_joints, 0)}
+  , m_clips{Utility::move(frames_.m_clips)}
+  , m_tracks{Utility::move(frames_.m_tracks)}
+  , m_times{Utility::move(frames_.m_times)}
+  , m_keys{Utility::move(frames_.m_keys)}
+{
+}
+
+inline CompressedFrames& CompressedFrames::operator=(CompressedFrames&& frames_) {
+  if (this != &frames_) {
+    m_joints = Utility::exchange(frames_.m_joints, 0);
+    m_clips = Utility::move(frames_.m_clips);
+    m_tracks = Utility::move(frames_.m_tracks);
+    m_times = Utility::move(frames_.m_times);
+    m_keys = Utility::move(frames_.m_keys);
+  }
+  return *this;
+}
+
+inline Size CompressedFrames::frames() const {
+  if (m_clips.is_empty()) {
+    return 0;
+  }
+  const auto& last = m_clips.last();
+  return last.frame_offset + last.frame_count;
+}
+
+inline Size CompressedFrames::bytes() const {
+  return m_clips.size() * sizeof(ClipFrames)
+    + m_tracks.size() * sizeof(Track)
+    + m_times.size() * sizeof(Uint16)
+    + m_keys.size() * sizeof(Key);
+}
+
+} // namespace Rx::Model
+
+#endif // RX_MODEL_COMPRESSION_H
@@ -1,8 +1,6 @@
 #include "rx/model/loader.h"
-#include "rx/model/aobake.h"
 
-#include "rx/core/concurrency/thread_pool.h"
-#include "rx/core/filesystem/buffered_file.h"
+#include "rx/core/filesystem/vfs.h"
 #include "rx/core/algorithm/max.h"
 #include "rx/core/map.h"
 #include "rx/core/log.h"
@@ -31,10 +29,13 @@ Importer::Importer(Memory::Allocator& _allocator)
   , m_clips{allocator()}
   , m_name{allocator()}
   , m_report{allocator(), *logger}
+  , m_file{allocator()}
+  , m_elements_in_place{nullptr, 0}
+  , m_coordinates_in_place{nullptr, 0}
 {
 }
 
-bool Importer::load(Stream::Context& _stream) {
+bool Importer::load(Concurrency::Scheduler& _scheduler, Stream::Context& _stream) {
   auto name = Utility::copy(_stream.name());
   if (!name) {
     return false;
@@ -48,19 +49,21 @@ bool Importer::load(Stream::Context& _stream) {
 
   Time::StopWatch time;
   time.start();
-  if (!read(_stream)) {
+  if (!read(_scheduler, _stream)) {
     return false;
   }
   time.stop();
 
-  if (m_elements.is_empty() || m_positions.is_empty()) {
+  const auto elements = element_span();
+
+  if (elements.size() == 0 || m_positions.is_empty()) {
     return m_report.error("missing vertices");
   }
 
   // Ensure none of the elements go out of bounds.
   const Size vertices = m_positions.size();
   Uint32 max_element = 0;
-  m_elements.each_fwd([&max_element](Uint32 _element) {
+  elements.each_fwd([&max_element](Uint32 _element) {
     max_element = Algorithm::max(max_element, _element);
   });
 
@@ -68,12 +71,22 @@ bool Importer::load(Stream::Context& _stream) {
     return m_report.error("element %zu out of bounds", max_element);
   }
 
-  if (m_elements.size() % 3 != 0) {
+  if (elements.size() % 3 != 0) {
     return m_report.error("unfinished triangles");
   }
 
+  // Ensure none of the meshes go out of bounds.
+  const auto mesh_in_bounds = [&](const Mesh& _mesh) {
+    return _mesh.offset <= elements.size()
+      && _mesh.count <= elements.size() - _mesh.offset;
+  };
+
+  if (!m_meshes.each_fwd(mesh_in_bounds)) {
+    return m_report.error("mesh out of bounds");
+  }
+
   m_report.log(Log::Level::VERBOSE, "loaded %zu triangles, %zu vertices, %zu meshes in %s",
-    m_elements.size() / 3, m_positions.size(), m_meshes.size(), time.elapsed());
+    elements.size() / 3, m_positions.size(), m_meshes.size(), time.elapsed());
 
   // Check for normals.
   if (m_normals.is_empty()) {
@@ -87,7 +100,7 @@ bool Importer::load(Stream::Context& _stream) {
   if (m_tangents.is_empty()) {
     // Generating tangent vectors cannot be done unless the model contains
     // appropriate texture coordinates.
-    if (m_coordinates.is_empty()) {
+    if (coordinates().size() == 0) {
       return m_report.error("missing tangents and texture coordinates, bailing");
     } else {
       m_report.log(Log::Level::WARNING, "missing tangents, generating them");
@@ -115,9 +128,18 @@ bool Importer::load(Stream::Context& _stream) {
     }
   }
 
-  if (!m_coordinates.is_empty() && m_coordinates.size() != vertices) {
+  const auto n_coordinates = coordinates().size();
+  if (n_coordinates && n_coordinates != vertices) {
     m_report.log(Log::Level::WARNING, "too %s coordinates",
-      m_coordinates.size() > vertices ? "many" : "few");
+      n_coordinates > vertices ? "many" : "few");
+    // Coordinates referred to in place have to be copied to be resized.
+    if (m_coordinates_in_place.size()) {
+      if (!m_coordinates.resize(n_coordinates)) {
+        return m_report.error("out of memory");
+      }
+      Memory::copy(m_coordinates.data(), m_coordinates_in_place.data(), n_coordinates);
+      m_coordinates_in_place = {nullptr, 0};
+    }
     if (!m_coordinates.resize(vertices)) {
       return m_report.error("out of memory");
     }
@@ -158,7 +180,7 @@ bool Importer::load(Stream::Context& _stream) {
         return false;
       }
       Memory::copy(optimized_elements.data() + count,
-        m_elements.data() + _batch->offset, _batch->count);
+        elements.data() + _batch->offset, _batch->count);
       if (!mesh_name.is_empty() && !mesh_name.append(" & ")) {
         return false;
       }
@@ -191,6 +213,7 @@ bool Importer::load(Stream::Context& _stream) {
 
   m_meshes = Utility::move(optimized_meshes);
   m_elements = Utility::move(optimized_elements);
+  m_elements_in_place = {nullptr, 0};
 
   // Calculate per frame AABBs for each mesh.
   const auto n_animations = m_clips.size();
@@ -198,45 +221,69 @@ bool Importer::load(Stream::Context& _stream) {
 
   const auto animated = n_animations > 0;
 
+  // Each vertex is transformed once per mesh rather than once per element
+  // that refers to it. The vertices of a mesh are found by marking them with
+  // the mesh's index, plus one.
+  Vector<Uint32> marks{allocator()};
+  Vector<Uint32> mesh_vertices{allocator()};
+  if (animated && !marks.resize(vertices, 0)) {
+    return m_report.error("out of memory");
+  }
+
+  time.start();
   for (Size i = 0; i < n_meshes; i++) {
     auto& mesh = m_meshes[i];
     if (!mesh.bounds.resize(animated ? n_animations : 1, {allocator()})) {
       return false;
     }
     if (animated) {
-      const auto& frames = m_skeleton->lb_frames();
-      const auto& joints = m_skeleton->joints();
+      const auto& skeleton = *m_skeleton;
+
+      mesh_vertices.clear();
+      for (Size k = 0; k < mesh.count; k++) {
+        const auto element = m_elements[mesh.offset + k];
+        if (marks[element] != i + 1) {
+          marks[element] = i + 1;
+          if (!mesh_vertices.push_back(element)) {
+            return m_report.error("out of memory");
+          }
+        }
+      }
 
       for (Size j = 0; j < n_animations; j++) {
         const auto& animation = m_clips[j];
-        for (Size k = 0; k < mesh.count; k++) {
-          const auto element = m_elements[mesh.offset + k];
-          const auto& position = m_positions[element];
-          const auto& blend_indices = m_blend_indices[element];
-          const auto& blend_weights = m_blend_weights[element];
-          if (!mesh.bounds[j].resize(animation.frame_count)) {
-            return false;
-          }
-          for (Size l = 0; l < animation.frame_count; l++) {
-            const auto index = (animation.frame_offset + l) * joints.size();
-            Math::Mat3x4f transform;
-            transform  = frames[index + blend_indices.x] * blend_weights.x;
-            transform += frames[index + blend_indices.y] * blend_weights.y;
-            transform += frames[index + blend_indices.z] * blend_weights.z;
-            transform += frames[index + blend_indices.w] * blend_weights.w;
-            const Math::Vec3f x = {transform.x.x, transform.y.x, transform.z.x};
-            const Math::Vec3f y = {transform.x.y, transform.y.y, transform.z.y};
-            const Math::Vec3f z = {transform.x.z, transform.y.z, transform.z.z};
-            const Math::Vec3f w = {transform.x.w, transform.y.w, transform.z.w};
-            const Math::Mat4x4f m = {
-              {x.x, x.y, x.z, 0.0f},
-              {y.x, y.y, y.z, 0.0f},
-              {z.x, z.y, z.z, 0.0f},
-              {w.x, w.y, w.z, 1.0f}
-            };
-            mesh.bounds[j][l].expand(Math::transform_point(position, m));
-          }
+        auto& bounds = mesh.bounds[j];
+        if (!bounds.resize(animation.frame_count)) {
+          return false;
         }
+
+        // Frames are independent of one another.
+        parallel_for(_scheduler, animation.frame_count, 1, [&](Size _begin, Size _end) {
+          for (Size l = _begin; l < _end; l++) {
+            const auto frame = animation.frame_offset + l;
+            mesh_vertices.each_fwd([&](Uint32 _vertex) {
+              const auto& position = m_positions[_vertex];
+              const auto& blend_indices = m_blend_indices[_vertex];
+              const auto& blend_weights = m_blend_weights[_vertex];
+              Math::Mat3x4f transform;
+              transform  = skeleton.lb_frame(frame, blend_indices.x) * blend_weights.x;
+              transform += skeleton.lb_frame(frame, blend_indices.y) * blend_weights.y;
+              transform += skeleton.lb_frame(frame, blend_indices.z) * blend_weights.z;
+              transform += skeleton.lb_frame(frame, blend_indices.w) * blend_weights.w;
+              const Math::Vec3f x = {transform.x.x, transform.y.x, transform.z.x};
+              const Math::Vec3f y = {transform.x.y, transform.y.y, transform.z.y};
+              const Math::Vec3f z = {transform.x.z, transform.y.z, transform.z.z};
+              const Math::Vec3f w = {transform.x.w, transform.y.w, transform.z.w};
+              const Math::Mat4x4f m = {
+                {x.x, x.y, x.z, 0.0f},
+                {y.x, y.y, y.z, 0.0f},
+                {z.x, z.y, z.z, 0.0f},
+                {w.x, w.y, w.z, 1.0f}
+              };
+              bounds[l].expand(Math::transform_point(position, m));
+            });
+          }
+        });
       }
     } else {
       // Calculate the bounds for this mesh.
@@ -251,52 +298,43 @@ bool Importer::load(Stream::Context& _stream) {
       }
     }
   }
+  time.stop();
 
-  // Check for occlusions.
-  if (m_occlusions.is_empty()) {
-    Math::AABB aabb;
-    m_meshes.each_fwd([&](const Mesh& _mesh) {
-      aabb.expand(_mesh.bounds[0][0]);
-    });
-
-    /*
-    auto& scheduler = Concurrency::ThreadPool::instance();
-
-    // Set them all to 1.0 (full distance).
-    AoConfig config;
-    if (auto ao = bake_ao(scheduler, aabb, m_positions, m_elements, config)) {
-      m_occlusions = Utility::move(*ao);
-    }
-    */
+  if (animated) {
+    m_report.log(Log::Level::VERBOSE, "calculated bounds for %zu meshes in %zu animations in %s",
+      n_meshes, n_animations, time.elapsed());
+  }
 
-    // Set them all to 1.0 if none.
-    if (m_occlusions.is_empty() && !m_occlusions.resize(m_positions.size(), 1.0f)) {
-      return m_report.error("out of memory");
-    }
+  // Vertices are unoccluded unless the format has occlusion, Loader bakes it
+  // when asked to.
+  if (m_occlusions.is_empty() && !m_occlusions.resize(m_positions.size(), 1.0f)) {
+    return m_report.error("out of memory");
   }
 
   return true;
 }
 
-bool Importer::load(const StringView& _file_name) {
-  if (auto file = Filesystem::BufferedFile::open(allocator(), _file_name, "r")) {
-    return load(*file);
+bool Importer::load(Concurrency::Scheduler& _scheduler, const StringView& _file_name) {
+  m_file = Filesystem::open_file(allocator(), _file_name, Filesystem::FileKind::MAPPED);
+  if (m_file) {
+    return load(_scheduler, *m_file);
   }
   return m_report.error("failed to open file: %s", _file_name);
 }
 
 bool Importer::generate_normals() {
+  const auto elements = element_span();
   const auto n_vertices = m_positions.size();
-  const auto n_elements = m_elements.size();
+  const auto n_elements = elements.size();
 
   if (!m_normals.resize(n_vertices)) {
     return m_report.error("out of memory");
   }
 
   for (Size i = 0; i < n_elements; i += 3) {
-    const Uint32 index0 = m_elements[i + 0];
-    const Uint32 index1 = m_elements[i + 1];
-    const Uint32 index2 = m_elements[i + 2];
+    const Uint32 index0 = elements[i + 0];
+    const Uint32 index1 = elements[i + 1];
+    const Uint32 index2 = elements[i + 2];
 
     const Math::Vec3f p1p0{m_positions[index1] - m_positions[index0]};
     const Math::Vec3f p2p0{m_positions[index2] - m_positions[index0]};
@@ -316,8 +354,10 @@ bool Importer::generate_normals() {
 }
 
 bool Importer::generate_tangents() {
+  const auto elements = element_span();
+  const auto coordinates = this->coordinates();
   const auto n_vertices = m_positions.size();
-  const auto n_elements = m_elements.size();
+  const auto n_elements = elements.size();
 
   Vector<Math::Vec3f> tangents{allocator()};
   Vector<Math::Vec3f> bitangents{allocator()};
@@ -331,14 +371,14 @@ bool Importer::generate_tangents() {
   }
 
   for (Size i = 0; i < n_elements; i += 3) {
-    const Uint32 index0 = m_elements[i + 0];
-    const Uint32 index1 = m_elements[i + 1];
-    const Uint32 index2 = m_elements[i + 2];
+    const Uint32 index0 = elements[i + 0];
+    const Uint32 index1 = elements[i + 1];
+    const Uint32 index2 = elements[i + 2];
 
     const Math::Mat3x3f triangle{m_positions[index0], m_positions[index1], m_positions[index2]};
 
-    const Math::Vec2f uv0{m_coordinates[index1] - m_coordinates[index0]};
-    const Math::Vec2f uv1{m_coordinates[index2] - m_coordinates[index0]};
+    const Math::Vec2f uv0{coordinates[index1] - coordinates[index0]};
+    const Math::Vec2f uv1{coordinates[index2] - coordinates[index0]};
 
     const Math::Vec3f q1{triangle.y - triangle.x};
     const Math::Vec3f q2{triangle.z - triangle.x};
@@ -2,6 +2,14 @@
 #define RX_MODEL_IMPORTER_H
 #include "rx/core/vector.h"
 #include "rx/core/report.h"
+#include "rx/core/span.h"
+#include "rx/core/algorithm/max.h"
+#include "rx/core/ptr.h"
+
+#include "rx/core/stream/context.h"
+
+#include "rx/core/concurrency/scheduler.h"
+#include "rx/core/concurrency/wait_group.h"
 
 #include "rx/math/vec2.h"
 #include "rx/math/vec3.h"
@@ -11,8 +19,6 @@
 #include "rx/model/skeleton.h"
 #include "rx/model/animation.h"
 
-namespace Rx::Stream { struct Context; }
-
 namespace Rx::Model {
 
 struct Mesh {
@@ -24,6 +30,15 @@ struct Mesh {
   // Contains the per frame bounds for mesh. When the mesh contains no
   // animations, bounds[0][0] contains the bounds for the static mesh.
   Vector<Vector<Math::AABB>> bounds; // bounds[animation][frame]
+
+  // Simplified versions of the mesh, in order of decreasing detail, with the
+  // elements after those of every mesh. Empty unless generated by the loader.
+  struct Lod {
+    Size offset;
+    Size count;
+    Float32 error; // Relative to the size of the mesh.
+  };
+  Vector<Lod> lods = {};
 };
 
 struct Importer {
@@ -34,11 +49,13 @@ struct Importer {
 
   Importer(Memory::Allocator& _allocator);
 
-  [[nodiscard]] bool load(Stream::Context& _stream);
-  [[nodiscard]] bool load(const StringView& _file_name);
+  // When loading from a stream, arrays may refer to the stream's contents
+  // in place, the stream must outlive the importer.
+  [[nodiscard]] bool load(Concurrency::Scheduler& _scheduler, Stream::Context& _stream);
+  [[nodiscard]] bool load(Concurrency::Scheduler& _scheduler, const StringView& _file_name);
 
   // implemented by each model loader
-  [[nodiscard]] virtual bool read(Stream::Context& _stream) = 0;
+  [[nodiscard]] virtual bool read(Concurrency::Scheduler& _scheduler, Stream::Context& _stream) = 0;
 
   Vector<Mesh>&& meshes();
   Vector<Uint32>&& elements();
@@ -46,7 +63,7 @@ struct Importer {
 
   const Vector<Math::Vec3f>& positions() const &;
   const Vector<Float32>& occlusions() const &;
-  const Vector<Math::Vec2f>& coordinates() const &;
+  Span<const Math::Vec2f> coordinates() const &;
   const Vector<Math::Vec3f>& normals() const &;
   const Vector<Math::Vec4f>& tangents() const &;
 
@@ -61,6 +78,15 @@ protected:
   [[nodiscard]] bool generate_normals();
   [[nodiscard]] bool generate_tangents();
 
+  // Calls |_function(begin, end)| for ranges of at least |_grain| indices
+  // covering [0, |_count|), spread over |_scheduler|. Ranges the scheduler
+  // cannot take run on the calling thread. Returns once all have run.
+  template<typename F>
+  static void parallel_for(Concurrency::Scheduler& _scheduler, Size _count,
+    Size _grain, F&& _function);
+
+  Span<const Uint32> element_span() const;
+
   Memory::Allocator& m_allocator;
 
   Vector<Mesh> m_meshes;
@@ -76,6 +102,15 @@ protected:
   Optional<Skeleton> m_skeleton;
   String m_name;
   Report m_report;
+
+  // Files loaded by name are opened mapped and kept open so importers can
+  // parse, and refer to, the mapping in place.
+  Ptr<Stream::Context> m_file;
+
+  // Elements and coordinates already in the layout used here can be referred
+  // to in place by the importer rather than copied into the vectors above.
+  Span<const Uint32> m_elements_in_place;
+  Span<const Math::Vec2f> m_coordinates_in_place;
 };
 
 inline Vector<Mesh>&& Importer::meshes() {
@@ -94,8 +129,11 @@ inline const Vector<Float32>& Importer::occlusions() const & {
   return m_occlusions;
 }
 
-inline const Vector<Math::Vec2f>& Importer::coordinates() const & {
-  return m_coordinates;
+inline Span<const Math::Vec2f> Importer::coordinates() const & {
+  if (m_coordinates_in_place.size()) {
+    return m_coordinates_in_place;
+  }
+  return {m_coordinates.data(), m_coordinates.size()};
 }
 
 inline const Vector<Math::Vec3f>& Importer::normals() const & {
@@ -126,6 +164,44 @@ RX_HINT_FORCE_INLINE constexpr Memory::Allocator& Importer::allocator() const {
   return m_allocator;
 }
 
+template<typename F>
+void Importer::parallel_for(Concurrency::Scheduler& _scheduler, Size _count,
+  Size _grain, F&& _function)
+{
+  // A few ranges per thread so threads finishing early can take another.
+  const auto ranges = _scheduler.total_threads() * 4;
+  const auto size = Algorithm::max(_grain, (_count + ranges - 1) / ranges);
+  const auto tasks = _count ? (_count - 1) / size : 0;
+
+  Concurrency::WaitGroup group{tasks};
+  for (Size task = 0; task < tasks; task++) {
+    const auto begin = task * size;
+    const auto end = begin + size;
+    const bool added = _scheduler.add([&, begin, end](Sint32) {
+      _function(begin, end);
+      group.signal();
+    });
+    if (!added) {
+      _function(begin, end);
+      group.signal();
+    }
+  }
+
+  // The last range, which may be short, runs here.
+  if (_count) {
+    _function(tasks * size, _count);
+  }
+
+  group.wait();
+}
+
+inline Span<const Uint32> Importer::element_span() const {
+  if (m_elements_in_place.size()) {
+    return m_elements_in_place;
+  }
+  return {m_elements.data(), m_elements.size()};
+}
+
 } // namespace Rx::Model
 
 #endif // RX_MODEL_IMPORTER_H
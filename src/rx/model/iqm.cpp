@@ -5,6 +5,7 @@
 #include "rx/model/iqm.h"
 
 #include "rx/core/map.h"
+#include "rx/core/utility/bit.h"
 
 #include "rx/core/stream/context.h"
 #include "rx/core/stream/advancing_stream.h"
@@ -116,7 +117,11 @@ struct IQM::Header {
   Uint32 extensions_offset;
 };
 
-bool IQM::read(Stream::Context& _stream) {
+// Vertices and frames converted by each task, at least.
+static constexpr const Size VERTICES_PER_TASK = 4096;
+static constexpr const Size FRAMES_PER_TASK = 16;
+
+bool IQM::read(Concurrency::Scheduler& _scheduler, Stream::Context& _stream) {
   Stream::AdvancingStream stream{_stream};
 
   const auto stat = stream.stat();
@@ -143,32 +148,56 @@ bool IQM::read(Stream::Context& _stream) {
     return m_report.error("unsupported iqm version %d", read_header.version);
   }
 
-  // Offsets in the header are relative to the beginning of the file, make a
-  // hole in the memory and skip it, such that |read_meshes| and
-  // |read_animations| can use the |read_header|'s values directly.
-  LinearBuffer data{allocator()};
-  if (!data.resize(stat->size)) {
-    return m_report.error("out of memory");
+  // Offsets in the header are relative to the beginning of the file, so the
+  // contents are used directly. Mapped files and files in packs are parsed in
+  // place, anything else is read into memory.
+  m_data = _stream.view_binary(allocator());
+  if (!m_data) {
+    return m_report.error("could not read contents");
   }
 
-  const auto size_no_header = data.size() - sizeof read_header;
-  if (stream.read(data.data() + sizeof read_header, size_no_header) != size_no_header) {
+  if (m_data->size() != read_header.file_size) {
     return m_report.error("unexpected end of file");
   }
 
-  if (read_header.meshes && !read_meshes(read_header, data)) {
+  // Ensure every section is inside the file before referring to it.
+  const Uint64 file_size = read_header.file_size;
+  const auto in_file = [&](Uint64 _offset, Uint64 _count, Uint64 _size) {
+    return _offset <= file_size && _count * _size <= file_size - _offset;
+  };
+
+  if (!in_file(read_header.text_offset, read_header.text, 1)
+    || !in_file(read_header.meshes_offset, read_header.meshes, sizeof(IQMMesh))
+    || !in_file(read_header.vertex_arrays_offset, read_header.vertex_arrays, sizeof(IQMVertexArray))
+    || !in_file(read_header.triangles_offset, read_header.triangles, sizeof(IQMTriangle))
+    || !in_file(read_header.joints_offset, read_header.joints, sizeof(IQMJoint))
+    || !in_file(read_header.poses_offset, read_header.poses, sizeof(IQMPose))
+    || !in_file(read_header.animations_offset, read_header.animations, sizeof(IQMAnimation))
+    || !in_file(read_header.frames_offset, Uint64{read_header.frames} * read_header.frame_channels, sizeof(Uint16)))
+  {
+    return m_report.error("section out of bounds");
+  }
+
+  // Names are offsets into the text, which must be terminated.
+  if (read_header.text && m_data->data()[read_header.text_offset + read_header.text - 1] != 0) {
+    return m_report.error("malformed text");
+  }
+
+  if (read_header.meshes && !read_meshes(_scheduler, read_header)) {
     return false;
   }
 
-  if (!read_animations(read_header, data)) {
+  if (!read_animations(_scheduler, read_header)) {
     return false;
   }
 
   return true;
 }
 
-bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
-  const char* string_table{_header.text_offset ? reinterpret_cast<const char *>(_data.data() + _header.text_offset) : ""};
+bool IQM::read_meshes(Concurrency::Scheduler& _scheduler, const Header& _header) {
+  const Byte* data = m_data->data();
+
+  const char* string_table{_header.text_offset ? reinterpret_cast<const char *>(data + _header.text_offset) : ""};
 
   const Float32* in_position{nullptr};
   const Float32* in_normal{nullptr};
@@ -178,7 +207,10 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
   const Byte* in_blend_weight{nullptr};
 
   const auto* vertex_arrays =
-    reinterpret_cast<const IQMVertexArray*>(_data.data() + _header.vertex_arrays_offset);
+    reinterpret_cast<const IQMVertexArray*>(data + _header.vertex_arrays_offset);
+
+  const Size vertices = _header.vertexes;
+  const Size elements = _header.triangles * 3;
 
   for (Uint32 i = 0; i < _header.vertex_arrays; i++) {
     const auto& array = vertex_arrays[i];
@@ -187,6 +219,12 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
     const Size size = array.size;
     const Size offset = array.offset;
 
+    // Only arrays of F32 and U8 are read.
+    const Size bytes = vertices * size * (format == VertexFormat::F32 ? 4 : 1);
+    if (offset > m_data->size() || bytes > m_data->size() - offset) {
+      return m_report.error("vertex array out of bounds");
+    }
+
     switch (attribute) {
     case VertexAttribute::POSITION:
       if (format != VertexFormat::F32) {
@@ -195,7 +233,7 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
       if (size != 3) {
         return m_report.error("invalid size for position");
       }
-      in_position = reinterpret_cast<const Float32*>(_data.data() + offset);
+      in_position = reinterpret_cast<const Float32*>(data + offset);
       break;
     case VertexAttribute::NORMAL:
       if (format != VertexFormat::F32) {
@@ -204,7 +242,7 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
       if (size != 3) {
         return m_report.error("invalid size for normal");
       }
-      in_normal = reinterpret_cast<const Float32*>(_data.data() + offset);
+      in_normal = reinterpret_cast<const Float32*>(data + offset);
       break;
     case VertexAttribute::TANGENT:
       if (format != VertexFormat::F32) {
@@ -213,7 +251,7 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
       if (size != 4) {
         return m_report.error("invalid size for tangent");
       }
-      in_tangent = reinterpret_cast<const Float32*>(_data.data() + offset);
+      in_tangent = reinterpret_cast<const Float32*>(data + offset);
       break;
     case VertexAttribute::COORDINATE:
       if (format != VertexFormat::F32) {
@@ -222,7 +260,7 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
       if (size != 2) {
         return m_report.error("invalid size for coordinate");
       }
-      in_coordinate = reinterpret_cast<const Float32*>(_data.data() + offset);
+      in_coordinate = reinterpret_cast<const Float32*>(data + offset);
       break;
     case VertexAttribute::BLEND_WEIGHTS:
       if (format != VertexFormat::U8) {
@@ -231,7 +269,7 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
       if (size != 4) {
         return m_report.error("invalid size for blend weights");
       }
-      in_blend_weight = _data.data() + offset;
+      in_blend_weight = data + offset;
       break;
     case VertexAttribute::BLEND_INDEXES:
       if (format != VertexFormat::U8) {
@@ -240,20 +278,13 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
       if (size != 4) {
         return m_report.error("invalid size for blend indices");
       }
-      in_blend_index = _data.data() + offset;
+      in_blend_index = data + offset;
     default:
       break;
     }
   }
 
-  if (!m_elements.resize(_header.triangles * 3)) {
-    return false;
-  }
-
-  const Size vertices = _header.vertexes;
-  const Size elements = _header.triangles * 3;
-
-  bool result = m_elements.resize(elements);
+  bool result = true;
 
   if (in_position) {
     result &= m_positions.resize(vertices);
@@ -267,10 +298,6 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
     result &= m_tangents.resize(vertices);
   }
 
-  if (in_coordinate) {
-    result &= m_coordinates.resize(vertices);
-  }
-
   if (in_blend_index) {
     result &= m_blend_indices.resize(vertices);
   }
@@ -283,48 +310,71 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
     return m_report.error("out of memory");
   }
 
-  for (Size i = 0; i < vertices; i++) {
+  // Coordinates and triangles are already in the layout used by the importer
+  // and are referred to in place.
+  static_assert(sizeof(Math::Vec2f) == sizeof(Float32[2]));
+  static_assert(sizeof(IQMTriangle) == sizeof(Uint32[3]));
+
+  if (in_coordinate) {
+    m_coordinates_in_place = {reinterpret_cast<const Math::Vec2f*>(in_coordinate), vertices};
+  }
+
+  m_elements_in_place = {reinterpret_cast<const Uint32*>(data + _header.triangles_offset), elements};
+
+  auto* positions = m_positions.data();
+  auto* normals = m_normals.data();
+  auto* tangents = m_tangents.data();
+  auto* blend_indices = m_blend_indices.data();
+  auto* blend_weights = m_blend_weights.data();
+
+  // Convert IQM's Z-up coordinate system to Y-up since that's what we use.
+  parallel_for(_scheduler, vertices, VERTICES_PER_TASK, [&](Size _begin, Size _end) {
     if (in_position) {
-      m_positions[i].x = in_position[i * 3 + 0];
-      m_positions[i].y = in_position[i * 3 + 2];
-      m_positions[i].z = in_position[i * 3 + 1];
+      for (Size i = _begin; i < _end; i++) {
+        positions[i].x = in_position[i * 3 + 0];
+        positions[i].y = in_position[i * 3 + 2];
+        positions[i].z = in_position[i * 3 + 1];
+      }
     }
 
     if (in_normal) {
-      m_normals[i].x = in_normal[i * 3 + 0];
-      m_normals[i].y = in_normal[i * 3 + 2];
-      m_normals[i].z = in_normal[i * 3 + 1];
+      for (Size i = _begin; i < _end; i++) {
+        normals[i].x = in_normal[i * 3 + 0];
+        normals[i].y = in_normal[i * 3 + 2];
+        normals[i].z = in_normal[i * 3 + 1];
+      }
     }
 
     if (in_tangent) {
-      m_tangents[i].x = in_tangent[i * 4 + 0];
-      m_tangents[i].y = in_tangent[i * 4 + 2];
-      m_tangents[i].z = in_tangent[i * 4 + 1];
-      m_tangents[i].w = in_tangent[i * 4 + 3];
-    }
-
-    if (in_coordinate) {
-      m_coordinates[i].u = in_coordinate[i * 2 + 0];
-      m_coordinates[i].v = in_coordinate[i * 2 + 1];
+      for (Size i = _begin; i < _end; i++) {
+        tangents[i].x = in_tangent[i * 4 + 0];
+        tangents[i].y = in_tangent[i * 4 + 2];
+        tangents[i].z = in_tangent[i * 4 + 1];
+        tangents[i].w = in_tangent[i * 4 + 3];
+      }
     }
 
     if (in_blend_index) {
-      m_blend_indices[i].x = in_blend_index[i * 4 + 0];
-      m_blend_indices[i].y = in_blend_index[i * 4 + 1];
-      m_blend_indices[i].z = in_blend_index[i * 4 + 2];
-      m_blend_indices[i].w = in_blend_index[i * 4 + 3];
+      for (Size i = _begin; i < _end; i++) {
+        blend_indices[i].x = in_blend_index[i * 4 + 0];
+        blend_indices[i].y = in_blend_index[i * 4 + 1];
+        blend_indices[i].z = in_blend_index[i * 4 + 2];
+        blend_indices[i].w = in_blend_index[i * 4 + 3];
+      }
     }
 
     if (in_blend_weight) {
-      m_blend_weights[i].x = in_blend_weight[i * 4 + 0] / 255.0f;
-      m_blend_weights[i].y = in_blend_weight[i * 4 + 1] / 255.0f;
-      m_blend_weights[i].z = in_blend_weight[i * 4 + 2] / 255.0f;
-      m_blend_weights[i].w = in_blend_weight[i * 4 + 3] / 255.0f;
+      for (Size i = _begin; i < _end; i++) {
+        blend_weights[i].x = in_blend_weight[i * 4 + 0] / 255.0f;
+        blend_weights[i].y = in_blend_weight[i * 4 + 1] / 255.0f;
+        blend_weights[i].z = in_blend_weight[i * 4 + 2] / 255.0f;
+        blend_weights[i].w = in_blend_weight[i * 4 + 3] / 255.0f;
+      }
     }
-  }
+  });
 
   const auto* meshes =
-    reinterpret_cast<const IQMMesh *>(_data.data() + _header.meshes_offset);
+    reinterpret_cast<const IQMMesh *>(data + _header.meshes_offset);
   
   // TODO(dweiler): Consider moving this to the importer so every model
   // loader can take advantage of it.
@@ -336,6 +386,10 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
   for (Uint32 i = 0; i < _header.meshes; i++) {
     const auto& mesh = meshes[i];
 
+    if (mesh.name >= _header.text || mesh.material >= _header.text) {
+      return m_report.error("malformed mesh");
+    }
+
     // Work out the mesh name, taking special care to deduplicate meshes.
     const auto iqm_mesh_name = string_table + mesh.name;
     Optional<String> mesh_name;
@@ -370,21 +424,18 @@ bool IQM::read_meshes(const Header& _header, const LinearBuffer& _data) {
     return m_meshes[*find].name.append("(0)");
   });
 
-  for (Uint32 i = 0; i < _header.triangles; i++) {
-    const auto* triangle =
-      reinterpret_cast<const IQMTriangle*>(_data.data() + _header.triangles_offset) + i;
-
-    m_elements[i * 3 + 0] = triangle->vertex[0];
-    m_elements[i * 3 + 1] = triangle->vertex[1];
-    m_elements[i * 3 + 2] = triangle->vertex[2];
-  }
-
   return true;
 }
 
-bool IQM::read_animations(const Header& _header, const LinearBuffer& _data) {
+bool IQM::read_animations(Concurrency::Scheduler& _scheduler, const Header& _header) {
+  const Byte* data = m_data->data();
   const auto n_joints = static_cast<Size>(_header.joints);
 
+  // Every frame has a pose for each joint.
+  if (_header.frames && _header.poses != _header.joints) {
+    return m_report.error("malformed poses");
+  }
+
   Vector<Math::Mat3x4f> generic_base_frame{allocator()};
   Vector<Math::Mat3x4f> inverse_base_frame{allocator()};
 
@@ -402,12 +453,17 @@ bool IQM::read_animations(const Header& _header, const LinearBuffer& _data) {
   }
 
   const auto joints =
-    reinterpret_cast<const IQMJoint*>(_data.data() + _header.joints_offset);
+    reinterpret_cast<const IQMJoint*>(data + _header.joints_offset);
 
   // Read base bind pose.
   for (Size i = 0; i < n_joints; i++) {
     const auto& this_joint{joints[i]};
 
+    // Parents come before their children.
+    if (this_joint.parent >= Sint32(i)) {
+      return m_report.error("malformed joint");
+    }
+
     // Convert IQM's Z-up coordinate system to Y-up since that's what we use.
     const Math::Vec3f scale{this_joint.scale[0], this_joint.scale[2], this_joint.scale[1]};
     const Math::Quatf rotate{this_joint.rotate[0], this_joint.rotate[2], this_joint.rotate[1], -this_joint.rotate[3]};
@@ -425,13 +481,19 @@ bool IQM::read_animations(const Header& _header, const LinearBuffer& _data) {
   }
 
   const auto* string_table =
-    reinterpret_cast<const char *>(_data.data() + _header.text_offset);
+    reinterpret_cast<const char *>(data + _header.text_offset);
 
   const auto* animations =
-    reinterpret_cast<const IQMAnimation*>(_data.data() + _header.animations_offset);
+    reinterpret_cast<const IQMAnimation*>(data + _header.animations_offset);
 
   for (Uint32 i = 0; i < _header.animations; i++) {
     const auto& animation = animations[i];
+    if (animation.name >= _header.text
+      || animation.first_frame > _header.frames
+      || animation.num_frames > _header.frames - animation.first_frame)
+    {
+      return m_report.error("malformed animation");
+    }
     auto name = String::create(allocator(), string_table + animation.name);
     if (!name || !m_clips.emplace_back(i, animation.frame_rate, animation.first_frame, animation.num_frames, Utility::move(*name))) {
       return m_report.error("out of memory");
@@ -439,51 +501,68 @@ bool IQM::read_animations(const Header& _header, const LinearBuffer& _data) {
   }
 
   const auto* poses =
-    reinterpret_cast<const IQMPose*>(_data.data() + _header.poses_offset);
-
-  const auto* frame_data =
-    reinterpret_cast<const Uint16*>(_data.data() + _header.frames_offset);
-
-  for (Uint32 i = 0; i < _header.frames; i++) {
-    for (Uint32 j = 0; j < _header.poses; j++) {
-      const auto& this_pose = poses[j];
-      Float32 channel_data[10];
-      for (Size k = 0; k < 10; k++) {
-        channel_data[k] = this_pose.channel_offset[k];
-        if (this_pose.mask & (1 << k)) {
-          channel_data[k] += (*frame_data++) * this_pose.channel_scale[k];
+    reinterpret_cast<const IQMPose*>(data + _header.poses_offset);
+
+  // Ensure the channels of each pose fit in a frame.
+  Size n_channels = 0;
+  for (Uint32 i = 0; i < _header.poses; i++) {
+    n_channels += bit_pop_count(poses[i].mask & 0x3ff);
+    if (poses[i].parent >= Sint32(n_joints)) {
+      return m_report.error("malformed pose");
+    }
+  }
+
+  if (_header.frames && n_channels > _header.frame_channels) {
+    return m_report.error("malformed frames");
+  }
+
+  const auto* frames =
+    reinterpret_cast<const Uint16*>(data + _header.frames_offset);
+
+  // Frames only refer to the base pose and to themselves.
+  parallel_for(_scheduler, _header.frames, FRAMES_PER_TASK, [&](Size _begin, Size _end) {
+    for (Size i = _begin; i < _end; i++) {
+      const auto* frame_data = frames + i * _header.frame_channels;
+      for (Uint32 j = 0; j < _header.poses; j++) {
+        const auto& this_pose = poses[j];
+        Float32 channel_data[10];
+        for (Size k = 0; k < 10; k++) {
+          channel_data[k] = this_pose.channel_offset[k];
+          if (this_pose.mask & (1 << k)) {
+            channel_data[k] += (*frame_data++) * this_pose.channel_scale[k];
+          }
         }
-      }
 
-      // Convert IQM's Z-up coordinate system to Y-up since that's what we use.
-      const Math::Vec3f scale{channel_data[7], channel_data[9], channel_data[8]};
-      const Math::Quatf rotate{channel_data[3], channel_data[5], channel_data[4], -channel_data[6]};
-      const Math::Vec3f translate{channel_data[0], channel_data[2], channel_data[1]};
-
-      Math::Mat3x4 scale_rotate_translate{scale, Math::normalize(rotate), translate};
-
-      // Concatenate each and every pose with the inverse base pose to avoid having to do it
-      // at animation time; if the joint has a parent, then it needs to be preconcatenated with
-      // it's parent's base pose, this will all negate at animation time; consider:
-      //
-      // (parent_pose * parent_inverse_base_pose) * (parent_base_pose * child_pose * child_inverse_base_pose) =>
-      // parent_pose * (parent_inverse_base_pose * parent_base_pose) * child_pose * child_inverse_base_pose =>
-      // parent_pose * child_pose * child_inverse_base_pose
-      if (this_pose.parent >= 0) {
-        scale_rotate_translate = generic_base_frame[this_pose.parent] * scale_rotate_translate * inverse_base_frame[j];
-      } else {
-        scale_rotate_translate = scale_rotate_translate * inverse_base_frame[j];
-      }
+        // Convert IQM's Z-up coordinate system to Y-up since that's what we use.
+        const Math::Vec3f scale{channel_data[7], channel_data[9], channel_data[8]};
+        const Math::Quatf rotate{channel_data[3], channel_data[5], channel_data[4], -channel_data[6]};
+        const Math::Vec3f translate{channel_data[0], channel_data[2], channel_data[1]};
+
+        Math::Mat3x4 scale_rotate_translate{scale, Math::normalize(rotate), translate};
+
+        // Concatenate each and every pose with the inverse base pose to avoid having to do it
+        // at animation time; if the joint has a parent, then it needs to be preconcatenated with
+        // it's parent's base pose, this will all negate at animation time; consider:
+        //
+        // (parent_pose * parent_inverse_base_pose) * (parent_base_pose * child_pose * child_inverse_base_pose) =>
+        // parent_pose * (parent_inverse_base_pose * parent_base_pose) * child_pose * child_inverse_base_pose =>
+        // parent_pose * child_pose * child_inverse_base_pose
+        if (this_pose.parent >= 0) {
+          scale_rotate_translate = generic_base_frame[this_pose.parent] * scale_rotate_translate * inverse_base_frame[j];
+        } else {
+          scale_rotate_translate = scale_rotate_translate * inverse_base_frame[j];
+        }
 
-      // The parent multiplication is done here to avoid having to do it at animation time too,
-      // this will need to be moved to support more complicated animation blending.
-      if (joints[j].parent >= 0) {
-        scale_rotate_translate = s_frames[i * _header.poses + joints[j].parent] * scale_rotate_translate;
-      }
+        // The parent multiplication is done here to avoid having to do it at animation time too,
+        // this will need to be moved to support more complicated animation blending.
+        if (joints[j].parent >= 0) {
+          scale_rotate_translate = s_frames[i * _header.poses + joints[j].parent] * scale_rotate_translate;
+        }
 
-      s_frames[i * _header.poses + j] = scale_rotate_translate;
+        s_frames[i * _header.poses + j] = scale_rotate_translate;
+      }
     }
-  }
+  });
 
   if (_header.joints || _header.frames) {
     m_skeleton = Skeleton::create(Utility::move(s_joints), Utility::move(s_frames));
@@ -11,11 +11,14 @@ struct IQM
 
   struct Header;
 
-  [[nodiscard]] virtual bool read(Stream::Context& _stream);
+  [[nodiscard]] virtual bool read(Concurrency::Scheduler& _scheduler, Stream::Context& _stream);
 
 private:
-  bool read_meshes(const Header& _header, const LinearBuffer& _data);
-  bool read_animations(const Header& _header, const LinearBuffer& _data);
+  bool read_meshes(Concurrency::Scheduler& _scheduler, const Header& _header);
+  bool read_animations(Concurrency::Scheduler& _scheduler, const Header& _header);
+
+  // The contents of the file, which the elements and coordinates refer to.
+  Optional<Stream::BinaryView> m_data;
 };
 
 inline IQM::IQM(Memory::Allocator& _allocator)
@@ -1,3 +1,5 @@
+#include <stddef.h> // offsetof
+
 #include "rx/model/loader.h"
 #include "rx/model/iqm.h"
 #include "rx/model/obj.h"
@@ -7,12 +9,16 @@
 #include "rx/core/set.h"
 #include "rx/core/ptr.h"
 #include "rx/core/serialize/json.h"
-#include "rx/core/filesystem/unbuffered_file.h"
+#include "rx/core/filesystem/vfs.h"
 #include "rx/core/algorithm/clamp.h"
+#include "rx/core/algorithm/max.h"
+#include "rx/core/memory/copy.h"
 
 #include "rx/core/concurrency/thread_pool.h"
 #include "rx/core/concurrency/wait_group.h"
 
+#include "rx/core/time/stop_watch.h"
+
 #include "rx/math/quat.h"
 
 #include "rx/material/loader.h"
@@ -27,6 +33,8 @@ Loader::Loader(Memory::Allocator& _allocator)
   , m_elements{allocator()}
   , m_meshes{allocator()}
   , m_clips{allocator()}
+  , m_progressive_occlusion{false}
+  , m_occlusion_baker{allocator()}
   , m_materials{allocator()}
   , m_name{allocator()}
   , m_flags{0}
@@ -62,7 +70,7 @@ bool Loader::load(Concurrency::Scheduler& _scheduler, Stream::Context& _stream)
 }
 
 bool Loader::load(Concurrency::Scheduler& _scheduler, const StringView& _file_name) {
-  if (auto file = Filesystem::UnbufferedFile::open(allocator(), _file_name, "r")) {
+  if (auto file = Filesystem::open_file(allocator(), _file_name)) {
     return load(_scheduler, *file);
   }
   return false;
@@ -86,6 +94,10 @@ bool Loader::parse(Concurrency::Scheduler& _scheduler, const Serialize::JSON& _d
   const auto& file = _definition["file"];
   const auto& materials = _definition["materials"];
   const auto& transform = _definition["transform"];
+  const auto& optimize = _definition["optimize"];
+  const auto& lods = _definition["lods"];
+  const auto& occlusion = _definition["occlusion"];
+  const auto& compress = _definition["compress"];
 
   if (!name) {
     return m_report.error("missing 'name'");
@@ -129,6 +141,28 @@ bool Loader::parse(Concurrency::Scheduler& _scheduler, const Serialize::JSON& _d
     return false;
   }
 
+  m_optimize = nullopt;
+  if (optimize && !parse_optimize(optimize)) {
+    return false;
+  }
+
+  m_lods = nullopt;
+  if (lods && !parse_lods(lods)) {
+    return false;
+  }
+
+  m_occlusion = nullopt;
+  m_progressive_occlusion = false;
+  m_occlusion_baker = nullptr;
+  if (occlusion && !parse_occlusion(occlusion)) {
+    return false;
+  }
+
+  m_compress = nullopt;
+  if (compress && !parse_compress(compress)) {
+    return false;
+  }
+
   // Clear incase we're being run multiple times to change.
   m_materials.clear();
 
@@ -137,7 +171,24 @@ bool Loader::parse(Concurrency::Scheduler& _scheduler, const Serialize::JSON& _d
     return false;
   }
 
-  if (!import(*file_name)) {
+  if (!import(_scheduler, *file_name)) {
+    return false;
+  }
+
+  if (m_optimize && !this->optimize(_scheduler, *m_optimize)) {
+    return false;
+  }
+
+  if (m_compress && !this->compress(*m_compress)) {
+    return false;
+  }
+
+  // Baked before the levels of detail are added so only the meshes occlude.
+  if (m_occlusion && !bake_occlusion(_scheduler, *m_occlusion, m_progressive_occlusion)) {
+    return false;
+  }
+
+  if (m_lods && !generate_lods(_scheduler, *m_lods)) {
     return false;
   }
 
@@ -174,7 +225,7 @@ bool Loader::parse(Concurrency::Scheduler& _scheduler, const Serialize::JSON& _d
   return !error.test() && validate();
 }
 
-bool Loader::import(const StringView& _file_name) {
+bool Loader::import(Concurrency::Scheduler& _scheduler, const StringView& _file_name) {
   Ptr<Importer> new_loader;
 
   // determine the model format based on the extension
@@ -190,7 +241,7 @@ bool Loader::import(const StringView& _file_name) {
     return m_report.error("out of memory");
   }
 
-  const bool result = new_loader->load(_file_name);
+  const bool result = new_loader->load(_scheduler, _file_name);
   if (!result) {
     return m_report.error("failed to import");
   }
@@ -299,6 +350,558 @@ bool Loader::import(const StringView& _file_name) {
   return true;
 }
 
+// The optimizations find the positions of the vertices at the beginning.
+static_assert(offsetof(Loader::Vertex, position) == 0);
+static_assert(offsetof(Loader::AnimatedVertex, position) == 0);
+
+template<typename T>
+static bool remap_vertices(Vector<T>& vertices_, const Vector<Uint32>& _remap,
+  Size _vertices)
+{
+  Vector<T> vertices{vertices_.allocator()};
+  if (!vertices.resize(_vertices)) {
+    return false;
+  }
+
+  const auto n_vertices = vertices_.size();
+  for (Size i = 0; i < n_vertices; i++) {
+    if (const auto index = _remap[i]; index != -1_u32) {
+      vertices[index] = vertices_[i];
+    }
+  }
+
+  vertices_ = Utility::move(vertices);
+
+  return true;
+}
+
+bool Loader::optimize(Concurrency::Scheduler& _scheduler, const OptimizeConfig& _config) {
+  const auto animated = is_animated();
+  const auto vertices = animated
+    ? reinterpret_cast<const Byte*>(as_animated_vertices.data())
+    : reinterpret_cast<const Byte*>(as_vertices.data());
+  const auto stride = animated ? sizeof(AnimatedVertex) : sizeof(Vertex);
+  const auto n_vertices = animated ? as_animated_vertices.size() : as_vertices.size();
+  const auto n_meshes = m_meshes.size();
+  const auto cache_size = _config.cache_size;
+
+  Time::StopWatch time;
+  time.start();
+
+  auto welded = weld_vertices(allocator(), vertices, stride, n_vertices,
+    _config.weld_distance);
+  if (!welded) {
+    return m_report.error("out of memory");
+  }
+
+  m_elements.each_fwd([&](Uint32& element_) {
+    element_ = (*welded)[element_];
+  });
+
+  const auto before = analyze_vertex_cache(allocator(),
+    {m_elements.data(), m_elements.size()}, n_vertices, cache_size);
+
+  // Meshes refer to their own elements so each is optimized by a task.
+  struct Result {
+    CacheStats before;
+    CacheStats after;
+    bool optimized;
+  };
+
+  Vector<Result> results{allocator()};
+  if (!results.resize(n_meshes, {{}, {}, false})) {
+    return m_report.error("out of memory");
+  }
+
+  auto optimize_mesh = [&](Size _index) {
+    const auto& mesh = m_meshes[_index];
+    auto& result = results[_index];
+    const Span<Uint32> elements{m_elements.data() + mesh.offset, mesh.count};
+    const Span<const Uint32> view{elements.data(), elements.size()};
+    result.before = analyze_vertex_cache(allocator(), view, n_vertices, cache_size);
+    result.optimized =
+      optimize_vertex_cache(allocator(), elements, n_vertices, cache_size) &&
+      optimize_overdraw(allocator(), elements,
+        reinterpret_cast<const Math::Vec3f*>(vertices), stride, n_vertices,
+        cache_size, _config.overdraw_threshold);
+    result.after = analyze_vertex_cache(allocator(), view, n_vertices, cache_size);
+  };
+
+  Concurrency::WaitGroup group{n_meshes};
+  for (Size i = 0; i < n_meshes; i++) {
+    const bool added = _scheduler.add([&, i](Sint32) {
+      optimize_mesh(i);
+      group.signal();
+    });
+    if (!added) {
+      optimize_mesh(i);
+      group.signal();
+    }
+  }
+  group.wait();
+
+  for (Size i = 0; i < n_meshes; i++) {
+    const auto& result = results[i];
+    if (!result.optimized) {
+      return m_report.error("out of memory");
+    }
+    m_report.log(Log::Level::VERBOSE, "mesh \"%s\": ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+      m_meshes[i].name, result.before.acmr, result.after.acmr,
+      result.before.atvr, result.after.atvr);
+  }
+
+  const auto after = analyze_vertex_cache(allocator(),
+    {m_elements.data(), m_elements.size()}, n_vertices, cache_size);
+
+  // Vertices are ordered last, welded vertices are no longer referred to and
+  // are removed here.
+  Size n_optimized_vertices = 0;
+  auto remap = optimize_vertex_fetch(allocator(),
+    {m_elements.data(), m_elements.size()}, n_vertices, n_optimized_vertices);
+  if (!remap) {
+    return m_report.error("out of memory");
+  }
+
+  m_elements.each_fwd([&](Uint32& element_) {
+    element_ = (*remap)[element_];
+  });
+
+  const bool result = animated
+    ? remap_vertices(as_animated_vertices, *remap, n_optimized_vertices)
+    : remap_vertices(as_vertices, *remap, n_optimized_vertices);
+  if (!result) {
+    return m_report.error("out of memory");
+  }
+
+  time.stop();
+
+  m_report.log(Log::Level::INFO,
+    "optimized %zu meshes in %s: %zu -> %zu vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+    n_meshes, time.elapsed(), n_vertices, n_optimized_vertices,
+    before.acmr, after.acmr, before.atvr, after.atvr);
+
+  return true;
+}
+
+bool Loader::generate_lods(Concurrency::Scheduler& _scheduler, const LodConfig& _config) {
+  const auto animated = is_animated();
+  const auto vertices = animated
+    ? reinterpret_cast<const Math::Vec3f*>(as_animated_vertices.data())
+    : reinterpret_cast<const Math::Vec3f*>(as_vertices.data());
+  const auto stride = animated ? sizeof(AnimatedVertex) : sizeof(Vertex);
+  const auto n_vertices = animated ? as_animated_vertices.size() : as_vertices.size();
+  const auto n_meshes = m_meshes.size();
+
+  Time::StopWatch time;
+  time.start();
+
+  // Every level is simplified from the mesh itself so errors don't add up.
+  struct Level {
+    Vector<Uint32> elements;
+    Float32 error;
+  };
+
+  struct Result {
+    Vector<Level> levels;
+    bool generated;
+  };
+
+  Vector<Result> results{allocator()};
+  for (Size i = 0; i < n_meshes; i++) {
+    if (!results.push_back({Vector<Level>{allocator()}, false})) {
+      return m_report.error("out of memory");
+    }
+  }
+
+  auto generate_mesh = [&](Size _index) {
+    const auto& mesh = m_meshes[_index];
+    auto& result = results[_index];
+    const Span<const Uint32> elements{m_elements.data() + mesh.offset, mesh.count};
+
+    Size n_triangles = mesh.count / 3;
+    Float32 target = Float32(n_triangles);
+    for (Size level = 0; level < _config.levels; level++) {
+      target *= _config.ratio;
+
+      Vector<Uint32> simplified{allocator()};
+      const auto error = simplify(allocator(), elements, vertices, stride,
+        n_vertices, Size(target), _config.max_error, simplified);
+      if (!error) {
+        return;
+      }
+
+      // Stop once a level would hardly draw fewer triangles than the last.
+      const auto n_simplified = simplified.size() / 3;
+      if (n_simplified == 0 || n_simplified * 10 > n_triangles * 9) {
+        break;
+      }
+
+      if (m_optimize) {
+        const Span<Uint32> span{simplified.data(), simplified.size()};
+        if (!optimize_vertex_cache(allocator(), span, n_vertices, m_optimize->cache_size)) {
+          return;
+        }
+      }
+
+      if (!result.levels.push_back({Utility::move(simplified), *error})) {
+        return;
+      }
+
+      n_triangles = n_simplified;
+    }
+
+    result.generated = true;
+  };
+
+  Concurrency::WaitGroup group{n_meshes};
+  for (Size i = 0; i < n_meshes; i++) {
+    const bool added = _scheduler.add([&, i](Sint32) {
+      generate_mesh(i);
+      group.signal();
+    });
+    if (!added) {
+      generate_mesh(i);
+      group.signal();
+    }
+  }
+  group.wait();
+
+  // The levels go after the elements of every mesh so the offsets of meshes
+  // stay the same.
+  const auto n_elements = m_elements.size();
+  for (Size i = 0; i < n_meshes; i++) {
+    auto& mesh = m_meshes[i];
+    const auto& result = results[i];
+    if (!result.generated) {
+      return m_report.error("out of memory");
+    }
+
+    mesh.lods.clear();
+
+    const auto n_levels = result.levels.size();
+    for (Size j = 0; j < n_levels; j++) {
+      const auto& level = result.levels[j];
+      const auto offset = m_elements.size();
+      if (!m_elements.append(level.elements)) {
+        return m_report.error("out of memory");
+      }
+      if (!mesh.lods.push_back({offset, level.elements.size(), level.error})) {
+        return m_report.error("out of memory");
+      }
+      m_report.log(Log::Level::VERBOSE, "mesh \"%s\": LOD %zu with %zu triangles, error %f",
+        mesh.name, j + 1, level.elements.size() / 3, level.error);
+    }
+  }
+
+  time.stop();
+
+  m_report.log(Log::Level::INFO,
+    "generated LODs for %zu meshes in %s: %zu -> %zu elements",
+    n_meshes, time.elapsed(), n_elements, m_elements.size());
+
+  return true;
+}
+
+template<typename T>
+static void write_occlusion(Vector<T>& vertices_, const Vector<Float32>& _occlusion) {
+  const auto n_vertices = vertices_.size();
+  for (Size i = 0; i < n_vertices; i++) {
+    vertices_[i].occlusion = _occlusion[i];
+  }
+}
+
+bool Loader::bake_occlusion(Concurrency::Scheduler& _scheduler,
+  const AoConfig& _config, bool _progressive)
+{
+  const auto animated = is_animated();
+  const auto n_vertices = animated ? as_animated_vertices.size() : as_vertices.size();
+
+  Vector<Math::Vec3f> positions{allocator()};
+  if (!positions.resize(n_vertices)) {
+    return m_report.error("out of memory");
+  }
+
+  Math::AABB aabb;
+  for (Size i = 0; i < n_vertices; i++) {
+    positions[i] = animated ? as_animated_vertices[i].position : as_vertices[i].position;
+    aabb.expand(positions[i]);
+  }
+
+  // Only the elements of the meshes, any levels of detail come after them.
+  Size n_elements = 0;
+  m_meshes.each_fwd([&](const Mesh& _mesh) {
+    n_elements = Algorithm::max(n_elements, _mesh.offset + _mesh.count);
+  });
+
+  Vector<Uint32> elements{allocator()};
+  if (!elements.resize(n_elements)) {
+    return m_report.error("out of memory");
+  }
+  Memory::copy(elements.data(), m_elements.data(), n_elements);
+
+  m_occlusion_baker = nullptr;
+
+  Time::StopWatch time;
+  time.start();
+
+  if (_progressive) {
+    const auto key = ao_cache_key(positions, elements, _config);
+    if (auto occlusion = find_cached_ao(allocator(), key, n_vertices)) {
+      animated
+        ? write_occlusion(as_animated_vertices, *occlusion)
+        : write_occlusion(as_vertices, *occlusion);
+      m_report.log(Log::Level::VERBOSE, "found baked occlusion of %zu vertices",
+        n_vertices);
+      return true;
+    }
+
+    m_occlusion_baker = AoBaker::create(_scheduler, aabb,
+      Utility::move(positions), Utility::move(elements), _config);
+    if (!m_occlusion_baker) {
+      return m_report.error("failed to bake occlusion");
+    }
+
+    time.stop();
+    m_report.log(Log::Level::INFO,
+      "baking occlusion of %zu vertices in %zu passes, started in %s",
+      n_vertices, _config.progressive_passes, time.elapsed());
+    return true;
+  }
+
+  auto occlusion = bake_ao(_scheduler, aabb, positions, elements, _config);
+  if (!occlusion) {
+    return m_report.error("failed to bake occlusion");
+  }
+
+  animated
+    ? write_occlusion(as_animated_vertices, *occlusion)
+    : write_occlusion(as_vertices, *occlusion);
+
+  time.stop();
+  m_report.log(Log::Level::INFO, "baked occlusion of %zu vertices in %s",
+    n_vertices, time.elapsed());
+
+  return true;
+}
+
+bool Loader::compress(const CompressConfig& _config) {
+  if (!m_skeleton || m_clips.is_empty()) {
+    return true;
+  }
+
+  Time::StopWatch time;
+  time.start();
+
+  Vector<CompressionStats> stats{allocator()};
+  if (!m_skeleton->compress(m_clips, _config, stats)) {
+    return m_report.error("failed to compress animations");
+  }
+
+  time.stop();
+
+  Size raw_bytes = 0;
+  Size compressed_bytes = 0;
+  for (Size i = 0; i < stats.size(); i++) {
+    const auto& clip = stats[i];
+    raw_bytes += clip.raw_bytes;
+    compressed_bytes += clip.compressed_bytes;
+    m_report.log(Log::Level::VERBOSE,
+      "clip \"%s\": %zu -> %zu bytes, %zu of %zu keys, error %f (matrices), %f (dual quaternions)",
+      m_clips[i].name, clip.raw_bytes, clip.compressed_bytes, clip.keys,
+      clip.samples, clip.lb_error, clip.dq_error);
+  }
+
+  m_report.log(Log::Level::INFO,
+    "compressed %zu animations in %s: %zu -> %zu bytes",
+    m_clips.size(), time.elapsed(), raw_bytes, compressed_bytes);
+
+  return true;
+}
+
+bool Loader::parse_occlusion(const Serialize::JSON& _occlusion) {
+  AoConfig config;
+
+  if (_occlusion.is_boolean()) {
+    if (_occlusion.as_boolean()) {
+      m_occlusion = config;
+    }
+    return true;
+  }
+
+  if (!_occlusion.is_object()) {
+    return m_report.error("expected Boolean or Object for 'occlusion'");
+  }
+
+  const auto& rays = _occlusion["rays"];
+  const auto& exact = _occlusion["exact"];
+  const auto& voxels = _occlusion["voxels"];
+  const auto& progressive = _occlusion["progressive"];
+
+  if (rays) {
+    if (!rays.is_integer() || rays.as_integer() < 1) {
+      return m_report.error("expected Integer of at least 1 for 'rays'");
+    }
+    config.raytrace_rays_per_vertex = rays.as_integer();
+  }
+
+  if (exact) {
+    if (!exact.is_boolean()) {
+      return m_report.error("expected Boolean for 'exact'");
+    }
+    config.raytrace_triangles = exact.as_boolean();
+  }
+
+  if (voxels) {
+    if (!voxels.is_integer() || voxels.as_integer() < 1) {
+      return m_report.error("expected Integer of at least 1 for 'voxels'");
+    }
+    config.voxelize_max_voxels_per_dimension = voxels.as_integer();
+  }
+
+  if (progressive) {
+    if (!progressive.is_boolean()) {
+      return m_report.error("expected Boolean for 'progressive'");
+    }
+    m_progressive_occlusion = progressive.as_boolean();
+  }
+
+  m_occlusion = config;
+
+  return true;
+}
+
+bool Loader::parse_compress(const Serialize::JSON& _compress) {
+  CompressConfig config;
+
+  if (_compress.is_boolean()) {
+    if (_compress.as_boolean()) {
+      m_compress = config;
+    }
+    return true;
+  }
+
+  if (!_compress.is_object()) {
+    return m_report.error("expected Boolean or Object for 'compress'");
+  }
+
+  const auto& rotation = _compress["rotation"];
+  const auto& translation = _compress["translation"];
+  const auto& scale = _compress["scale"];
+
+  if (rotation) {
+    if (!rotation.is_number() || rotation.as_float() < 0.0f) {
+      return m_report.error("expected positive Number for 'rotation'");
+    }
+    config.rotation_error = rotation.as_float();
+  }
+
+  if (translation) {
+    if (!translation.is_number() || translation.as_float() < 0.0f) {
+      return m_report.error("expected positive Number for 'translation'");
+    }
+    config.translation_error = translation.as_float();
+  }
+
+  if (scale) {
+    if (!scale.is_number() || scale.as_float() < 0.0f) {
+      return m_report.error("expected positive Number for 'scale'");
+    }
+    config.scale_error = scale.as_float();
+  }
+
+  m_compress = config;
+
+  return true;
+}
+
+bool Loader::parse_lods(const Serialize::JSON& _lods) {
+  LodConfig config;
+
+  if (_lods.is_boolean()) {
+    if (_lods.as_boolean()) {
+      m_lods = config;
+    }
+    return true;
+  }
+
+  if (!_lods.is_object()) {
+    return m_report.error("expected Boolean or Object for 'lods'");
+  }
+
+  const auto& levels = _lods["levels"];
+  const auto& ratio = _lods["ratio"];
+  const auto& error = _lods["error"];
+
+  if (levels) {
+    if (!levels.is_integer() || levels.as_integer() < 1) {
+      return m_report.error("expected Integer of at least 1 for 'levels'");
+    }
+    config.levels = levels.as_integer();
+  }
+
+  if (ratio) {
+    if (!ratio.is_number() || ratio.as_float() <= 0.0f || ratio.as_float() >= 1.0f) {
+      return m_report.error("expected Number between 0 and 1 for 'ratio'");
+    }
+    config.ratio = ratio.as_float();
+  }
+
+  if (error) {
+    if (!error.is_number() || error.as_float() < 0.0f) {
+      return m_report.error("expected positive Number for 'error'");
+    }
+    config.max_error = error.as_float();
+  }
+
+  m_lods = config;
+
+  return true;
+}
+
+bool Loader::parse_optimize(const Serialize::JSON& _optimize) {
+  OptimizeConfig config;
+
+  if (_optimize.is_boolean()) {
+    if (_optimize.as_boolean()) {
+      m_optimize = config;
+    }
+    return true;
+  }
+
+  if (!_optimize.is_object()) {
+    return m_report.error("expected Boolean or Object for 'optimize'");
+  }
+
+  const auto& weld = _optimize["weld"];
+  const auto& cache_size = _optimize["cache_size"];
+  const auto& overdraw_threshold = _optimize["overdraw_threshold"];
+
+  if (weld) {
+    if (!weld.is_number() || weld.as_float() < 0.0f) {
+      return m_report.error("expected positive Number for 'weld'");
+    }
+    config.weld_distance = weld.as_float();
+  }
+
+  if (cache_size) {
+    if (!cache_size.is_integer() || cache_size.as_integer() < 3) {
+      return m_report.error("expected Integer of at least 3 for 'cache_size'");
+    }
+    config.cache_size = cache_size.as_integer();
+  }
+
+  if (overdraw_threshold) {
+    if (!overdraw_threshold.is_number() || overdraw_threshold.as_float() < 1.0f) {
+      return m_report.error("expected Number of at least 1 for 'overdraw_threshold'");
+    }
+    config.overdraw_threshold = overdraw_threshold.as_float();
+  }
+
+  m_optimize = config;
+
+  return true;
+}
+
 bool Loader::parse_transform(const Serialize::JSON& _transform) {
   const auto& scale = _transform["scale"];
   const auto& rotate = _transform["rotate"];
@@ -1,6 +1,10 @@
 #ifndef RX_MODEL_LOADER_H
 #define RX_MODEL_LOADER_H
 #include "rx/model/importer.h"
+#include "rx/model/optimize.h"
+#include "rx/model/simplify.h"
+#include "rx/model/aobake.h"
+#include "rx/model/compression.h"
 
 #include "rx/material/loader.h"
 
@@ -54,11 +58,35 @@ struct Loader {
 
   constexpr Memory::Allocator& allocator() const;
 
-  bool import(const StringView& _file_name);
+  bool import(Concurrency::Scheduler& _scheduler, const StringView& _file_name);
+
+  // Welds duplicate vertices and reorders the triangles of each mesh, then
+  // the vertices, for the vertex cache, overdraw and vertex fetch.
+  [[nodiscard]] bool optimize(Concurrency::Scheduler& _scheduler, const OptimizeConfig& _config);
+
+  // Simplifies each mesh into levels of detail, the elements of which are
+  // appended after those of every mesh.
+  [[nodiscard]] bool generate_lods(Concurrency::Scheduler& _scheduler, const LodConfig& _config);
+
+  // Bakes the ambient occlusion of every vertex. When |_progressive| and not
+  // baked before, the vertices are left unoccluded and the occlusion is baked
+  // in the background by the baker taken with |occlusion_baker|.
+  [[nodiscard]] bool bake_occlusion(Concurrency::Scheduler& _scheduler,
+    const AoConfig& _config, bool _progressive);
+
+  Ptr<AoBaker>&& occlusion_baker();
+
+  // Compresses the frames of every clip of the skeleton, which are then
+  // decompressed as they're played.
+  [[nodiscard]] bool compress(const CompressConfig& _config);
 
 private:
   void destroy();
   bool parse_transform(const Serialize::JSON& _transform);
+  bool parse_optimize(const Serialize::JSON& _optimize);
+  bool parse_lods(const Serialize::JSON& _lods);
+  bool parse_occlusion(const Serialize::JSON& _occlusion);
+  bool parse_compress(const Serialize::JSON& _compress);
   bool validate();
 
   enum {
@@ -79,6 +107,12 @@ private:
   Vector<Clip> m_clips;
   Optional<Skeleton> m_skeleton;
   Optional<Math::Transform> m_transform;
+  Optional<OptimizeConfig> m_optimize;
+  Optional<LodConfig> m_lods;
+  Optional<AoConfig> m_occlusion;
+  Optional<CompressConfig> m_compress;
+  bool m_progressive_occlusion;
+  Ptr<AoBaker> m_occlusion_baker;
   Map<String, Material::Loader> m_materials;
   String m_name;
   int m_flags;
@@ -119,6 +153,10 @@ inline const Vector<Clip>& Loader::clips() const {
   return m_clips;
 }
 
+inline Ptr<AoBaker>&& Loader::occlusion_baker() {
+  return Utility::move(m_occlusion_baker);
+}
+
 inline const String& Loader::name() const {
   return m_name;
 }
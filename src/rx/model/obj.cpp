@@ -1,30 +1,47 @@
 #include <stdlib.h> // strtof
-#include <string.h> // strncmp
+#include <string.h> // strncmp, memchr, memcpy
+#include <float.h> // FLT_MIN, FLT_MAX
 
 #include "rx/model/obj.h"
 
 #include "rx/core/map.h"
 #include "rx/core/hash/combine.h"
 #include "rx/core/stream/context.h"
-#include "rx/core/memory/temporary_allocator.h"
+#include "rx/core/algorithm/min.h"
+#include "rx/core/algorithm/max.h"
+#include "rx/core/algorithm/clamp.h"
+#include "rx/core/concurrency/atomic.h"
 
 namespace Rx::Model {
 
 struct Key {
   Array<Sint32[3]> attributes = { -1, -1, -1 };
 
+  // Vertices are only shared by faces of the same mesh. Every "g" and
+  // "usemtl" line starts a new segment, and a mesh never spans segments.
+  Uint32 segment = 0;
+
   Size hash() const {
     const auto h0 = Hash::mix_sint32(attributes[0]);
     const auto h1 = Hash::mix_sint32(attributes[1]);
     const auto h2 = Hash::mix_sint32(attributes[2]);
-    return Hash::combine(h0, Hash::combine(h1, h2));
+    const auto h3 = Hash::mix_uint32(segment);
+    return Hash::combine(Hash::combine(h0, h1), Hash::combine(h2, h3));
   }
 
   bool operator==(const Key& _other) const {
-    return attributes == _other.attributes;
+    return attributes == _other.attributes && segment == _other.segment;
   }
 };
 
+// The contents are split at line boundaries into chunks parsed in parallel,
+// of at least this many bytes.
+static constexpr const Size CHUNK_SIZE = 256_KiB;
+
+// At most this many tasks deduplicate vertices, each taking the keys which
+// hash to it.
+static constexpr const Size MAX_PARTITIONS = 64;
+
 static bool is_space(int _ch) {
   return _ch == ' ' || _ch == '\t' || _ch == '\r';
 }
@@ -33,6 +50,10 @@ static bool is_alpha(int _ch) {
   return (_ch >= 'a' && _ch <= 'z') || (_ch >= 'A' && _ch <= 'Z');
 }
 
+static bool is_digit(int _ch) {
+  return _ch >= '0' && _ch <= '9';
+}
+
 static bool skip_when(char*& string_, auto&& _filter) {
   while (*string_ && _filter(*string_)) {
     string_++;
@@ -40,25 +61,142 @@ static bool skip_when(char*& string_, auto&& _filter) {
   return *string_ != '\0';
 }
 
-// Read up to a three value attribute into |out_| from |_string|.
-static bool read_attribute(char* _string, Vector<Math::Vec3f>& out_) {
-  if (!out_.emplace_back(0.0f, 0.0f, 0.0f)) {
-    return false;
+// Parse a float like strtof. Decimals with few enough digits are converted
+// with a single correctly rounded floating-point operation, everything else
+// is left to strtof.
+static Float32 read_float(char* _string, char** end_) {
+  static constexpr const Float64 POWERS[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  char* ch = _string;
+  const bool negative = *ch == '-';
+  if (*ch == '-' || *ch == '+') {
+    ch++;
+  }
+
+  Uint64 mantissa = 0;
+  Sint32 exponent = 0;
+  Size digits = 0;
+  bool any = false;
+
+  // Up to 19 significant digits fit in the mantissa.
+  const auto read_digit = [&](int _ch) {
+    if (digits == 19) {
+      return false;
+    }
+    mantissa = mantissa * 10 + (_ch - '0');
+    digits += mantissa != 0;
+    any = true;
+    return true;
+  };
+
+  for (; is_digit(*ch); ch++) {
+    if (!read_digit(*ch)) {
+      return strtof(_string, end_);
+    }
   }
 
-  auto& vec = out_[out_.size() - 1];
+  if (*ch == '.') {
+    for (ch++; is_digit(*ch); ch++) {
+      if (!read_digit(*ch)) {
+        return strtof(_string, end_);
+      }
+      exponent--;
+    }
+  }
+
+  // Infinities, NaNs, hexadecimal and anything which isn't a number.
+  if (!any || *ch == 'x' || *ch == 'X' || *ch == 'n' || *ch == 'N') {
+    return strtof(_string, end_);
+  }
+
+  if (*ch == 'e' || *ch == 'E') {
+    char* e = ch + 1;
+    const bool negative_exponent = *e == '-';
+    if (*e == '-' || *e == '+') {
+      e++;
+    }
+    // Without digits the 'e' isn't part of the number.
+    if (is_digit(*e)) {
+      Sint32 value = 0;
+      for (; is_digit(*e); e++) {
+        value = Algorithm::min(value * 10 + (*e - '0'), 1000);
+      }
+      exponent += negative_exponent ? -value : value;
+      ch = e;
+    }
+  }
+
+  if (mantissa == 0) {
+    *end_ = ch;
+    return negative ? -0.0f : 0.0f;
+  }
+
+  // Both the mantissa and the power of ten are exact doubles, the one
+  // operation rounds correctly.
+  if (mantissa > (1_u64 << 53) || exponent < -22 || exponent > 22) {
+    return strtof(_string, end_);
+  }
+
+  const Float64 value = exponent < 0
+    ? Float64(mantissa) / POWERS[-exponent]
+    : Float64(mantissa) * POWERS[exponent];
+
+  // Converting to float rounds again. That's only different from rounding
+  // once when the double lies exactly halfway between two floats. Subnormal
+  // and out of range floats are left to strtof as well.
+  Uint64 bits;
+  memcpy(&bits, &value, sizeof bits);
+  if ((bits & 0x1fffffff) == 0x10000000 || value < FLT_MIN || value > FLT_MAX) {
+    return strtof(_string, end_);
+  }
+
+  *end_ = ch;
+  return negative ? -Float32(value) : Float32(value);
+}
+
+// Parse an integer like strtol with base 10. Values too large to be an index
+// saturate.
+static Sint64 read_integer(char* _string, char** end_) {
+  char* ch = _string;
+  while (*ch == ' ' || *ch == '\t' || *ch == '\r' || *ch == '\v' || *ch == '\f') {
+    ch++;
+  }
+
+  const bool negative = *ch == '-';
+  if (*ch == '-' || *ch == '+') {
+    ch++;
+  }
+
+  if (!is_digit(*ch)) {
+    *end_ = _string;
+    return 0;
+  }
+
+  Sint64 value = 0;
+  for (; is_digit(*ch); ch++) {
+    value = Algorithm::min(value * 10 + (*ch - '0'), Sint64{1} << 40);
+  }
+
+  *end_ = ch;
+  return negative ? -value : value;
+}
+
+// Read up to a three value attribute into |out_| from |_string|.
+static void read_attribute(char* _string, Math::Vec3f& out_) {
+  out_ = {0.0f, 0.0f, 0.0f};
 
   skip_when(_string, is_alpha);
 
   for (Size i = 0; i < 3; i++) {
-    vec[i] = strtof(_string, &_string);
+    out_[i] = read_float(_string, &_string);
     if (!skip_when(_string, is_space)) {
       break;
     }
   }
-
-  return true;
-};
+}
 
 // Read a string literal trimming unnecessary characters.
 static bool read_string(char* _string, String& out_) {
@@ -71,129 +209,487 @@ static bool read_string(char* _string, String& out_) {
   return out_.append(_string, len);
 };
 
-bool OBJ::read(Stream::Context& _stream) {
-  auto& allocator = Memory::SystemAllocator::instance();
+// Call |_function| with each line in [|_begin|, |_end|), terminating them.
+template<typename F>
+static bool each_line(char* _begin, char* _end, F&& _function) {
+  for (char* line = _begin; line < _end; ) {
+    auto next = static_cast<char*>(memchr(line, '\n', _end - line));
+    if (next) {
+      *next++ = '\0';
+    } else {
+      // The last line is terminated by the contents.
+      next = _end;
+    }
+    if (!_function(line)) {
+      return false;
+    }
+    line = next;
+  }
+  return true;
+}
 
-  // Read the entire contents into memory.
-  auto contents = _stream.read_text(allocator);
-  if (!contents) {
-    return m_report.error("out of memory");
+// Each chunk of lines is parsed on its own. Attributes are written where they
+// go in the file's attributes, which is found by counting them beforehand.
+// Faces and the lines which start new meshes are recorded for merging.
+struct Chunk {
+  Chunk(Memory::Allocator& _allocator, char* _begin, char* _end);
+
+  struct Event {
+    enum class Type : Uint8 {
+      GROUP,
+      MATERIAL,
+      FACE // The first face since the start of the chunk or the last event.
+    };
+
+    Type type;
+    Size elements; // Number of elements in this chunk before the event.
+    String name;
+  };
+
+  char* begin;
+  char* end;
+
+  // Attributes in, and before, this chunk.
+  Array<Size[3]> attributes;
+  Array<Size[3]> base;
+
+  // Number of events before this chunk, which is the chunk's first segment.
+  Size segment;
+
+  Vector<Key> corners;
+  Vector<Uint32> faces; // Corners per face.
+  Vector<Event> events;
+
+  // Number of elements, vertices and normals in, and before, this chunk.
+  Size elements;
+  Size elements_base;
+  Size corners_base;
+  Size vertices;
+  Size vertices_base;
+  Size normals;
+  Size normals_base;
+};
+
+Chunk::Chunk(Memory::Allocator& _allocator, char* _begin, char* _end)
+  : begin{_begin}
+  , end{_end}
+  , attributes{0_z, 0_z, 0_z}
+  , base{0_z, 0_z, 0_z}
+  , segment{0}
+  , corners{_allocator}
+  , faces{_allocator}
+  , events{_allocator}
+  , elements{0}
+  , elements_base{0}
+  , corners_base{0}
+  , vertices{0}
+  , vertices_base{0}
+  , normals{0}
+  , normals_base{0}
+{
+}
+
+// The attribute a "v", "vt" or "vn" line is, otherwise -1.
+static int attribute_of(const char* _line) {
+  if (_line[0] != 'v') {
+    return -1;
+  }
+  switch (_line[1]) {
+  case ' ':
+    return 0;
+  case 't':
+    return 1;
+  case 'n':
+    return 2;
   }
+  return -1;
+}
 
-  // NOTE(dweiler): These need the system allocator since they're moved from.
-  String mesh_name{allocator};
-  String material_name{allocator};
+static bool parse_chunk(Chunk& chunk_, Vector<Math::Vec3f> (&attributes_)[3]) {
+  auto& allocator = Memory::SystemAllocator::instance();
 
-  // 1MiB of scratch memory for temporaries used during loading below.
-  Memory::TemporaryAllocator<1_MiB> scratch{allocator};
+  Array<Size[3]> counts{chunk_.base[0], chunk_.base[1], chunk_.base[2]};
+  Size segment = chunk_.segment;
+  bool face = false;
 
-  Map<Key, Uint32> hash{scratch};
-  Vector<Math::Vec3f> attributes[3]{scratch, scratch, scratch};
+  const auto event = [&](Chunk::Event::Type _type, char* _line) {
+    String name{allocator};
+    if (_type != Chunk::Event::Type::FACE && !read_string(_line, name)) {
+      return false;
+    }
+    return chunk_.events.emplace_back(_type, chunk_.elements, Utility::move(name));
+  };
 
-  // Process the content line-by-line.
-  auto data = reinterpret_cast<char*>(contents->data());
-  bool result = true;
-  bool mesh = false;
-  while (auto line = String::read_line(data)) {
-    skip_when(line, is_space);
-    switch (*line) {
-    case '#':
-      // Skip comment lines.
-      continue;
+  return each_line(chunk_.begin, chunk_.end, [&](char* _line) {
+    skip_when(_line, is_space);
+    switch (*_line) {
     case 'v':
-      switch (line[1]) {
-      case ' ':
-        result &= read_attribute(line, attributes[0]);
-        break;
-      case 't':
-        result &= read_attribute(line, attributes[1]);
-        break;
-      case 'n':
-        result &= read_attribute(line, attributes[2]);
-        break;
+      if (const auto attribute = attribute_of(_line); attribute != -1) {
+        read_attribute(_line, attributes_[attribute][counts[attribute]++]);
       }
-      break;
+      return true;
     case 'u':
       // Skip unless the line is "usemtl".
-      if (strncmp(line, "usemtl", 6)) {
-        continue;
+      if (strncmp(_line, "usemtl", 6)) {
+        return true;
       }
-      result &= read_string(line, material_name);
-      mesh = false;
-      break;
+      segment++;
+      face = false;
+      return event(Chunk::Event::Type::MATERIAL, _line);
     case 'g':
-      result &= read_string(line, mesh_name);
-      mesh = false;
-      break;
+      segment++;
+      face = false;
+      return event(Chunk::Event::Type::GROUP, _line);
     case 'f':
-      if (!mesh) {
-        result &= m_meshes.emplace_back(
-          Utility::move(mesh_name),
-          Utility::move(material_name),
-          m_elements.size(),
-          0_z,
-          Vector<Vector<Math::AABB>>{});
-        mesh = true;
-        hash.clear();
+      if (!face) {
+        if (!event(Chunk::Event::Type::FACE, _line)) {
+          return false;
+        }
+        face = true;
       }
-      skip_when(line, is_alpha);
-      for (Uint32 indices[3], count = 0;;) {
-        if (!skip_when(line, is_space)) {
+      break;
+    default:
+      return true;
+    }
+
+    skip_when(_line, is_alpha);
+
+    Uint32 corners = 0;
+    while (skip_when(_line, is_space)) {
+      const char* corner = _line;
+      Key key;
+      key.segment = Uint32(segment);
+      for (Size i = 0; i < 3; i++) {
+        // Indices are one-based, or relative to the attributes before the
+        // line when negative. Anything else is no attribute.
+        const auto value = read_integer(_line, &_line);
+        const auto index = value < 0 ? counts[i] + value : value - 1;
+        key.attributes[i] = Size(index) < counts[i] ? Sint32(index) : -1;
+        if (*_line != '/') {
           break;
         }
-        Key key;
-        for (Size i = 0; i < 3; i++) {
-          const auto value = strtol(line, &line, 10);
-          const auto index = value < 0 ? attributes[i].size() + value : value - 1;
-          key.attributes[i] = attributes[i].in_range(index) ? index : -1;
-          if (*line != '/') {
-            break;
-          }
-          line++;
+        _line++;
+      }
+
+      // Skip over what isn't an index.
+      if (_line == corner) {
+        while (*_line && !is_space(*_line)) {
+          _line++;
         }
-        auto index = hash.find(key);
-        if (!index) {
-          index = hash.insert(key, m_positions.size());
-          if (!index) {
-            result = false;
-            break;
-          }
-          if (key.attributes[0] < 0) {
-            m_positions.emplace_back(0.0f, 0.0f, 0.0f);
-          } else {
-            m_positions.push_back(attributes[0][key.attributes[0]]);
+      }
+
+      if (!chunk_.corners.push_back(key)) {
+        return false;
+      }
+
+      corners++;
+    }
+
+    // Implicitly triangulated as a fan, even for malformed OBJ.
+    if (corners > 2) {
+      chunk_.elements += (corners - 2) * 3;
+    }
+
+    return chunk_.faces.push_back(corners);
+  });
+}
+
+bool OBJ::read(Concurrency::Scheduler& _scheduler, Stream::Context& _stream) {
+  auto& allocator = Memory::SystemAllocator::instance();
+
+  // Read the entire contents into memory.
+  auto contents = _stream.read_text(allocator);
+  if (!contents) {
+    return m_report.error("out of memory");
+  }
+
+  // Split the contents into chunks of whole lines. The contents are
+  // terminated, which isn't part of the last chunk.
+  auto data = reinterpret_cast<char*>(contents->data());
+  auto data_end = data + contents->size() - 1;
+
+  const auto chunk_size = Algorithm::max(CHUNK_SIZE,
+    Size(data_end - data) / (_scheduler.total_threads() * 4));
+
+  Vector<Chunk> chunks{allocator};
+  for (char* begin = data; begin < data_end; ) {
+    char* end = begin + Algorithm::min(chunk_size, Size(data_end - begin));
+    if (end < data_end) {
+      auto newline = static_cast<char*>(memchr(end, '\n', data_end - end));
+      end = newline ? newline + 1 : data_end;
+    }
+    if (!chunks.emplace_back(allocator, begin, end)) {
+      return m_report.error("out of memory");
+    }
+    begin = end;
+  }
+
+  const auto n_chunks = chunks.size();
+
+  // Count the attributes of each chunk so every chunk knows where its own go
+  // and what its relative indices refer to.
+  parallel_for(_scheduler, n_chunks, 1, [&](Size _begin, Size _end) {
+    for (Size i = _begin; i < _end; i++) {
+      auto& chunk = chunks[i];
+      for (char* line = chunk.begin; line < chunk.end; ) {
+        auto next = static_cast<char*>(memchr(line, '\n', chunk.end - line));
+        next = next ? next + 1 : chunk.end;
+        skip_when(line, is_space);
+        if (const auto attribute = attribute_of(line); attribute != -1) {
+          chunk.attributes[attribute]++;
+        }
+        line = next;
+      }
+    }
+  });
+
+  Array<Size[3]> n_attributes{0_z, 0_z, 0_z};
+  chunks.each_fwd([&](Chunk& chunk_) {
+    for (Size i = 0; i < 3; i++) {
+      chunk_.base[i] = n_attributes[i];
+      n_attributes[i] += chunk_.attributes[i];
+    }
+  });
+
+  Vector<Math::Vec3f> attributes[3]{allocator, allocator, allocator};
+  for (Size i = 0; i < 3; i++) {
+    if (!attributes[i].resize(n_attributes[i])) {
+      return m_report.error("out of memory");
+    }
+  }
+
+  // Parse every chunk. Events are counted in the chunk and then given their
+  // segments with the number of events before the chunk, so the segment
+  // begins as zero here.
+  Concurrency::Atomic<bool> failed = false;
+  parallel_for(_scheduler, n_chunks, 1, [&](Size _begin, Size _end) {
+    for (Size i = _begin; i < _end; i++) {
+      if (!parse_chunk(chunks[i], attributes)) {
+        failed = true;
+      }
+    }
+  });
+
+  if (failed) {
+    return m_report.error("out of memory");
+  }
+
+  // Offset the segments of each chunk by the events before it.
+  Size n_segments = 0;
+  Size n_corners = 0;
+  Size n_elements = 0;
+  chunks.each_fwd([&](Chunk& chunk_) {
+    chunk_.segment = n_segments;
+    chunk_.corners_base = n_corners;
+    chunk_.elements_base = n_elements;
+    chunk_.events.each_fwd([&](const Chunk::Event& _event) {
+      n_segments += _event.type != Chunk::Event::Type::FACE;
+    });
+    n_corners += chunk_.corners.size();
+    n_elements += chunk_.elements;
+  });
+
+  if (n_segments > 0xffffffff_z) {
+    return m_report.error("too many groups");
+  }
+
+  parallel_for(_scheduler, n_chunks, 1, [&](Size _begin, Size _end) {
+    for (Size i = _begin; i < _end; i++) {
+      auto& chunk = chunks[i];
+      chunk.corners.each_fwd([&](Key& key_) {
+        key_.segment += Uint32(chunk.segment);
+      });
+    }
+  });
+
+  // Find the first corner with the same key for every corner. Keys are
+  // partitioned by their hash and each partition is searched in order of the
+  // corners by a task, so the first is the same regardless of threads.
+  Vector<Uint32> first{allocator};
+  Vector<Uint8> partitions{allocator};
+  if (!first.resize(n_corners) || !partitions.resize(n_corners)) {
+    return m_report.error("out of memory");
+  }
+
+  const auto n_partitions =
+    Algorithm::clamp(_scheduler.total_threads(), 1_z, MAX_PARTITIONS);
+
+  // These loops run for every corner, index the storage directly.
+  auto first_data = first.data();
+  auto partitions_data = partitions.data();
+
+  parallel_for(_scheduler, n_chunks, 1, [&](Size _begin, Size _end) {
+    for (Size i = _begin; i < _end; i++) {
+      const auto& chunk = chunks[i];
+      const auto n_chunk_corners = chunk.corners.size();
+      const auto keys = chunk.corners.data();
+      for (Size j = 0; j < n_chunk_corners; j++) {
+        partitions_data[chunk.corners_base + j] = keys[j].hash() % n_partitions;
+      }
+    }
+  });
+
+  parallel_for(_scheduler, n_partitions, 1, [&](Size _begin, Size _end) {
+    for (Size partition = _begin; partition < _end; partition++) {
+      Map<Key, Uint32> corners{allocator};
+      chunks.each_fwd([&](const Chunk& _chunk) {
+        const auto n_chunk_corners = _chunk.corners.size();
+        const auto keys = _chunk.corners.data();
+        for (Size j = 0; j < n_chunk_corners; j++) {
+          const auto corner = _chunk.corners_base + j;
+          if (partitions_data[corner] != partition) {
+            continue;
           }
-          if (key.attributes[1] < 0) {
-            m_coordinates.emplace_back(0.0f, 0.0f);
+          const auto& key = keys[j];
+          if (auto find = corners.find(key)) {
+            first_data[corner] = *find;
+          } else if (corners.insert(key, Uint32(corner))) {
+            first_data[corner] = Uint32(corner);
           } else {
-            const auto& coordinate = attributes[1][key.attributes[1]];
-            m_coordinates.emplace_back(coordinate.x, coordinate.y);
-          }
-          // Special case for normals if present.
-          if (key.attributes[2] >= 0) {
-            m_normals.push_back(attributes[2][key.attributes[2]]);
+            failed = true;
+            return false;
           }
         }
-        // Implicitly triangulates the input even for malformed OBJ.
-        if (count < 2) {
-          indices[count++] = *index;
-        } else {
-          result &= m_elements.push_back(indices[0]);
-          result &= m_elements.push_back(indices[1]);
-          result &= m_elements.push_back(*index);
-          indices[1] = *index;
+        return true;
+      });
+    }
+  });
+
+  if (failed) {
+    return m_report.error("out of memory");
+  }
+
+  // The first corner of a key is a vertex, numbered in order of the corners.
+  // Normals are only given to the vertices which have them.
+  parallel_for(_scheduler, n_chunks, 1, [&](Size _begin, Size _end) {
+    for (Size i = _begin; i < _end; i++) {
+      auto& chunk = chunks[i];
+      const auto n_chunk_corners = chunk.corners.size();
+      for (Size j = 0; j < n_chunk_corners; j++) {
+        const auto corner = chunk.corners_base + j;
+        if (first_data[corner] == corner) {
+          chunk.vertices++;
+          chunk.normals += chunk.corners[j].attributes[2] >= 0;
         }
       }
-      break;
     }
+  });
 
-    if (!result) {
-      return m_report.error("out of memory");
+  Size n_vertices = 0;
+  Size n_normals = 0;
+  chunks.each_fwd([&](Chunk& chunk_) {
+    chunk_.vertices_base = n_vertices;
+    chunk_.normals_base = n_normals;
+    n_vertices += chunk_.vertices;
+    n_normals += chunk_.normals;
+  });
+
+  if (n_vertices > 0xffffffff_z) {
+    return m_report.error("too many vertices");
+  }
+
+  Vector<Uint32> vertices{allocator};
+  bool result = vertices.resize(n_corners);
+  result &= m_positions.resize(n_vertices);
+  result &= m_coordinates.resize(n_vertices);
+  result &= m_normals.resize(n_normals);
+  result &= m_elements.resize(n_elements);
+  if (!result) {
+    return m_report.error("out of memory");
+  }
+
+  auto vertices_data = vertices.data();
+
+  parallel_for(_scheduler, n_chunks, 1, [&](Size _begin, Size _end) {
+    for (Size i = _begin; i < _end; i++) {
+      const auto& chunk = chunks[i];
+      const auto n_chunk_corners = chunk.corners.size();
+      const auto keys = chunk.corners.data();
+      auto vertex = chunk.vertices_base;
+      auto normal = chunk.normals_base;
+      for (Size j = 0; j < n_chunk_corners; j++) {
+        const auto corner = chunk.corners_base + j;
+        if (first_data[corner] != corner) {
+          continue;
+        }
+
+        const auto& key = keys[j];
+        if (key.attributes[0] >= 0) {
+          m_positions.data()[vertex] = attributes[0].data()[key.attributes[0]];
+        }
+        if (key.attributes[1] >= 0) {
+          const auto& coordinate = attributes[1].data()[key.attributes[1]];
+          m_coordinates.data()[vertex] = {coordinate.x, coordinate.y};
+        }
+        // Special case for normals if present.
+        if (key.attributes[2] >= 0) {
+          m_normals.data()[normal++] = attributes[2].data()[key.attributes[2]];
+        }
+
+        vertices_data[corner] = Uint32(vertex++);
+      }
     }
+  });
+
+  // The vertices of every first corner are known, triangulate each chunk's
+  // faces with them.
+  parallel_for(_scheduler, n_chunks, 1, [&](Size _begin, Size _end) {
+    for (Size i = _begin; i < _end; i++) {
+      const auto& chunk = chunks[i];
+      auto corner = chunk.corners_base;
+      auto element = m_elements.data() + chunk.elements_base;
+      chunk.faces.each_fwd([&](Uint32 _corners) {
+        for (Uint32 j = 2; j < _corners; j++) {
+          *element++ = vertices_data[first_data[corner]];
+          *element++ = vertices_data[first_data[corner + j - 1]];
+          *element++ = vertices_data[first_data[corner + j]];
+        }
+        corner += _corners;
+      });
+    }
+  });
+
+  // NOTE(dweiler): These need the system allocator since they're moved from.
+  String mesh_name{allocator};
+  String material_name{allocator};
+
+  // Meshes begin with the first face after a "g" or "usemtl" line, in order.
+  bool mesh = false;
+  for (Size i = 0; i < n_chunks; i++) {
+    auto& chunk = chunks[i];
+    const auto n_events = chunk.events.size();
+    for (Size j = 0; j < n_events; j++) {
+      auto& event = chunk.events[j];
+      switch (event.type) {
+      case Chunk::Event::Type::GROUP:
+        mesh_name = Utility::move(event.name);
+        mesh = false;
+        break;
+      case Chunk::Event::Type::MATERIAL:
+        material_name = Utility::move(event.name);
+        mesh = false;
+        break;
+      case Chunk::Event::Type::FACE:
+        if (mesh) {
+          break;
+        }
+        result &= m_meshes.emplace_back(
+          Utility::move(mesh_name),
+          Utility::move(material_name),
+          chunk.elements_base + event.elements,
+          0_z,
+          Vector<Vector<Math::AABB>>{});
+        mesh = true;
+        break;
+      }
+    }
+  }
+
+  if (!result) {
+    return m_report.error("out of memory");
   }
 
   const auto n_meshes = m_meshes.size();
-  const auto n_elements = m_elements.size();
 
   // TODO(dweiler): Consider moving this to the importer?
   if (n_meshes && n_elements) {
@@ -209,4 +705,4 @@ bool OBJ::read(Stream::Context& _stream) {
   return true;
 }
 
-} // namespace Rx::Model
\ No newline at end of file
+} // namespace Rx::Model
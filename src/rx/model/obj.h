@@ -9,7 +9,7 @@ struct OBJ
 {
   OBJ(Memory::Allocator& _allocator);
 
-  [[nodiscard]] virtual bool read(Stream::Context& _stream);
+  [[nodiscard]] virtual bool read(Concurrency::Scheduler& _scheduler, Stream::Context& _stream);
 };
 
 inline OBJ::OBJ(Memory::Allocator& _allocator)
@@ -0,0 +1,509 @@
+#include <string.h> // memcmp, memcpy
+
+#include "rx/model/optimize.h"
+
+#include "rx/core/map.h"
+#include "rx/core/hash/combine.h"
+#include "rx/core/hash/mix_int.h"
+#include "rx/core/math/abs.h"
+#include "rx/core/math/floor.h"
+#include "rx/core/algorithm/quick_sort.h"
+#include "rx/core/memory/copy.h"
+
+#include "rx/math/vec3.h"
+
+namespace Rx::Model {
+
+// Simulates a FIFO cache with timestamps: a vertex is in the cache when fewer
+// than |_cache_size| vertices were added since it was. Returns the number of
+// vertices of the triangle which were not in the cache.
+static Size update_cache(const Uint32* _triangle, Size _cache_size,
+  Uint32* timestamps_, Uint32& timestamp_)
+{
+  Size misses = 0;
+  for (Size i = 0; i < 3; i++) {
+    const auto vertex = _triangle[i];
+    if (timestamp_ - timestamps_[vertex] > _cache_size) {
+      timestamps_[vertex] = timestamp_++;
+      misses++;
+    }
+  }
+  return misses;
+}
+
+static const Math::Vec3f& position_of(const Math::Vec3f* _positions,
+  Size _stride, Uint32 _vertex)
+{
+  const auto data = reinterpret_cast<const Byte*>(_positions);
+  return *reinterpret_cast<const Math::Vec3f*>(data + _stride * _vertex);
+}
+
+CacheStats analyze_vertex_cache(Memory::Allocator& _allocator,
+  const Span<const Uint32>& _elements, Size _vertices, Size _cache_size)
+{
+  const auto n_triangles = _elements.size() / 3;
+  if (n_triangles == 0) {
+    return {};
+  }
+
+  Vector<Uint32> timestamps{_allocator};
+  if (!timestamps.resize(_vertices, 0)) {
+    return {};
+  }
+
+  auto timestamp = Uint32(_cache_size + 1);
+  Size misses = 0;
+  for (Size i = 0; i < n_triangles; i++) {
+    misses += update_cache(_elements.data() + i * 3, _cache_size,
+      timestamps.data(), timestamp);
+  }
+
+  // Every vertex referenced has been in the cache at some point.
+  Size referenced = 0;
+  timestamps.each_fwd([&](Uint32 _timestamp) {
+    referenced += _timestamp != 0;
+  });
+
+  return {
+    Float32(misses) / Float32(n_triangles),
+    Float32(misses) / Float32(referenced)
+  };
+}
+
+bool optimize_vertex_cache(Memory::Allocator& _allocator,
+  Span<Uint32> elements_, Size _vertices, Size _cache_size)
+{
+  const auto n_elements = elements_.size();
+  const auto n_triangles = n_elements / 3;
+  if (n_triangles == 0) {
+    return true;
+  }
+
+  const auto elements = elements_.data();
+
+  Vector<Uint32> offsets{_allocator};
+  Vector<Uint32> live{_allocator};
+  Vector<Uint32> adjacency{_allocator};
+  Vector<Uint32> timestamps{_allocator};
+  Vector<Uint8> emitted{_allocator};
+  Vector<Uint32> output{_allocator};
+
+  bool result = true;
+  result &= offsets.resize(_vertices + 1, 0);
+  result &= live.resize(_vertices, 0);
+  result &= adjacency.resize(n_elements);
+  result &= timestamps.resize(_vertices, 0);
+  result &= emitted.resize(n_triangles, 0);
+  result &= output.resize(n_elements);
+  if (!result) {
+    return false;
+  }
+
+  // The triangles of every vertex, the number of which is also the number of
+  // triangles still to be emitted that use the vertex.
+  for (Size i = 0; i < n_elements; i++) {
+    live[elements[i]]++;
+  }
+
+  for (Size i = 0; i < _vertices; i++) {
+    offsets[i + 1] = offsets[i] + live[i];
+  }
+
+  {
+    auto cursors = Utility::copy(offsets);
+    if (!cursors) {
+      return false;
+    }
+    for (Size i = 0; i < n_elements; i++) {
+      adjacency[(*cursors)[elements[i]]++] = Uint32(i / 3);
+    }
+  }
+
+  // Vertices of emitted triangles are where to continue from on a dead end,
+  // and those of the last fan are the candidates for the next.
+  Vector<Uint32> dead_ends{_allocator};
+  Vector<Uint32> candidates{_allocator};
+
+  auto timestamp = Uint32(_cache_size + 1);
+  Size n_output = 0;
+  Size cursor = 0;
+
+  for (Sint64 fanning = elements[0]; fanning >= 0; ) {
+    candidates.clear();
+
+    // Emit every triangle of the fanning vertex not yet emitted.
+    const auto vertex = Size(fanning);
+    for (Size i = offsets[vertex]; i < offsets[vertex + 1]; i++) {
+      const auto triangle = adjacency[i];
+      if (emitted[triangle]) {
+        continue;
+      }
+
+      for (Size j = 0; j < 3; j++) {
+        const auto v = elements[triangle * 3 + j];
+        output[n_output++] = v;
+        if (!dead_ends.push_back(v) || !candidates.push_back(v)) {
+          return false;
+        }
+        live[v]--;
+        if (timestamp - timestamps[v] > _cache_size) {
+          timestamps[v] = timestamp++;
+        }
+      }
+
+      emitted[triangle] = 1;
+    }
+
+    // Prefer the candidate that entered the cache the earliest which will
+    // still be in it after its remaining triangles are emitted.
+    fanning = -1;
+    Sint64 best_priority = -1;
+    candidates.each_fwd([&](Uint32 _vertex) {
+      if (live[_vertex] == 0) {
+        return;
+      }
+      Sint64 priority = 0;
+      const Sint64 age = timestamp - timestamps[_vertex];
+      if (age + 2 * Sint64(live[_vertex]) <= Sint64(_cache_size)) {
+        priority = age;
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        fanning = _vertex;
+      }
+    });
+
+    if (fanning != -1) {
+      continue;
+    }
+
+    // Dead end, continue from the most recent vertex with triangles left.
+    while (!dead_ends.is_empty()) {
+      const auto dead_end = dead_ends.last();
+      dead_ends.pop_back();
+      if (live[dead_end]) {
+        fanning = dead_end;
+        break;
+      }
+    }
+
+    if (fanning != -1) {
+      continue;
+    }
+
+    // Otherwise from the next vertex in order with triangles left.
+    for (; cursor < _vertices; cursor++) {
+      if (live[cursor]) {
+        fanning = cursor;
+        break;
+      }
+    }
+  }
+
+  // Meshes may be optimized already, by a better algorithm or for another
+  // cache, keep them as they are unless this is better.
+  const auto misses = [&](const Uint32* _elements) {
+    timestamps.each_fwd([](Uint32& timestamp_) { timestamp_ = 0; });
+    timestamp = Uint32(_cache_size + 1);
+    Size result = 0;
+    for (Size i = 0; i < n_triangles; i++) {
+      result += update_cache(_elements + i * 3, _cache_size, timestamps.data(), timestamp);
+    }
+    return result;
+  };
+
+  if (misses(output.data()) < misses(elements)) {
+    Memory::copy(elements, output.data(), n_elements);
+  }
+
+  return true;
+}
+
+bool optimize_overdraw(Memory::Allocator& _allocator,
+  Span<Uint32> elements_, const Math::Vec3f* _positions, Size _stride,
+  Size _vertices, Size _cache_size, Float32 _threshold)
+{
+  const auto n_elements = elements_.size();
+  const auto n_triangles = n_elements / 3;
+  if (n_triangles < 2) {
+    return true;
+  }
+
+  const auto elements = elements_.data();
+
+  Vector<Uint32> timestamps{_allocator};
+  if (!timestamps.resize(_vertices, 0)) {
+    return false;
+  }
+
+  auto timestamp = Uint32(_cache_size + 1);
+  auto update = [&](Size _triangle) {
+    return update_cache(elements + _triangle * 3, _cache_size,
+      timestamps.data(), timestamp);
+  };
+
+  // Flushing the cache makes every vertex miss.
+  auto flush = [&] {
+    timestamp += Uint32(_cache_size + 1);
+  };
+
+  // A triangle with no vertices in the cache usually begins a part of the
+  // mesh disjoint from the one before, which can be moved freely.
+  Vector<Uint32> hard_boundaries{_allocator};
+  for (Size i = 0; i < n_triangles; i++) {
+    if (update(i) == 3 || i == 0) {
+      if (!hard_boundaries.push_back(Uint32(i))) {
+        return false;
+      }
+    }
+  }
+
+  // Split those parts further wherever the cache could be flushed with the
+  // ACMR within the threshold of the part.
+  Vector<Uint32> clusters{_allocator};
+  const auto n_hard_boundaries = hard_boundaries.size();
+  for (Size i = 0; i < n_hard_boundaries; i++) {
+    const Size begin = hard_boundaries[i];
+    const Size end = i + 1 < n_hard_boundaries ? hard_boundaries[i + 1] : n_triangles;
+
+    flush();
+    Size misses = 0;
+    for (Size j = begin; j < end; j++) {
+      misses += update(j);
+    }
+
+    const auto threshold = _threshold * Float32(misses) / Float32(end - begin);
+
+    if (!clusters.push_back(Uint32(begin))) {
+      return false;
+    }
+
+    flush();
+    Size running_misses = 0;
+    Size running_triangles = 0;
+    for (Size j = begin; j < end; j++) {
+      running_misses += update(j);
+      running_triangles++;
+      if (Float32(running_misses) <= threshold * Float32(running_triangles)) {
+        if (!clusters.push_back(Uint32(j + 1))) {
+          return false;
+        }
+        flush();
+        running_misses = 0;
+        running_triangles = 0;
+      }
+    }
+
+    // The last cluster ending the part is empty.
+    if (clusters.last() == end) {
+      clusters.pop_back();
+    }
+  }
+
+  const auto n_clusters = clusters.size();
+  if (n_clusters < 2) {
+    return true;
+  }
+
+  // Clusters facing away from the center of the mesh, weighted by area,
+  // are drawn first.
+  struct Cluster {
+    Math::Vec3f centroid;
+    Math::Vec3f normal;
+    Float32 area;
+  };
+
+  Vector<Cluster> data{_allocator};
+  if (!data.resize(n_clusters, {{}, {}, 0.0f})) {
+    return false;
+  }
+
+  Math::Vec3f centroid;
+  Float32 area = 0.0f;
+  for (Size i = 0; i < n_clusters; i++) {
+    const Size begin = clusters[i];
+    const Size end = i + 1 < n_clusters ? clusters[i + 1] : n_triangles;
+    auto& cluster = data[i];
+    for (Size j = begin; j < end; j++) {
+      const auto& p0 = position_of(_positions, _stride, elements[j * 3 + 0]);
+      const auto& p1 = position_of(_positions, _stride, elements[j * 3 + 1]);
+      const auto& p2 = position_of(_positions, _stride, elements[j * 3 + 2]);
+      const auto normal = Math::cross(p1 - p0, p2 - p0);
+      const auto triangle_area = Math::length(normal);
+      cluster.centroid += (p0 + p1 + p2) * (triangle_area / 3.0f);
+      cluster.normal += normal;
+      cluster.area += triangle_area;
+    }
+    centroid += cluster.centroid;
+    area += cluster.area;
+  }
+
+  if (area > 0.0f) {
+    centroid = centroid / area;
+  }
+
+  Vector<Float32> keys{_allocator};
+  Vector<Uint32> order{_allocator};
+  if (!keys.resize(n_clusters) || !order.resize(n_clusters)) {
+    return false;
+  }
+
+  for (Size i = 0; i < n_clusters; i++) {
+    const auto& cluster = data[i];
+    const auto cluster_centroid =
+      cluster.area > 0.0f ? cluster.centroid / cluster.area : centroid;
+    const auto length = Math::length(cluster.normal);
+    const auto normal =
+      length > 0.0f ? cluster.normal / length : Math::Vec3f{};
+    keys[i] = Math::dot(cluster_centroid - centroid, normal);
+    order[i] = Uint32(i);
+  }
+
+  // Ties are broken by the original order to keep the result stable.
+  Algorithm::quick_sort(order.data(), order.data() + n_clusters,
+    [&](Uint32 _lhs, Uint32 _rhs) {
+      if (keys[_lhs] != keys[_rhs]) {
+        return keys[_lhs] > keys[_rhs];
+      }
+      return _lhs < _rhs;
+    });
+
+  Vector<Uint32> output{_allocator};
+  if (!output.resize(n_elements)) {
+    return false;
+  }
+
+  Size n_output = 0;
+  order.each_fwd([&](Uint32 _cluster) {
+    const Size begin = clusters[_cluster];
+    const Size end = _cluster + 1 < n_clusters ? clusters[_cluster + 1] : n_triangles;
+    Memory::copy(output.data() + n_output, elements + begin * 3, (end - begin) * 3);
+    n_output += (end - begin) * 3;
+  });
+
+  Memory::copy(elements, output.data(), n_elements);
+
+  return true;
+}
+
+// A cell of the spatial hash used to find vertices to weld.
+struct Cell {
+  Sint64 x, y, z;
+
+  Size hash() const {
+    const auto h0 = Hash::mix_sint64(x);
+    const auto h1 = Hash::mix_sint64(y);
+    const auto h2 = Hash::mix_sint64(z);
+    return Hash::combine(Hash::combine(h0, h1), h2);
+  }
+
+  bool operator==(const Cell& _other) const {
+    return x == _other.x && y == _other.y && z == _other.z;
+  }
+};
+
+Optional<Vector<Uint32>> weld_vertices(Memory::Allocator& _allocator,
+  const Byte* _vertices, Size _stride, Size _count, Float32 _distance)
+{
+  Vector<Uint32> result{_allocator};
+  Vector<Uint32> next{_allocator};
+  if (!result.resize(_count) || !next.resize(_count)) {
+    return nullopt;
+  }
+
+  // Cells are twice the distance so the vertices to weld with are in at most
+  // two cells on every axis. Without a distance the cell is the value itself.
+  const auto cell_size = Float64(_distance) * 2.0;
+  const auto cell_of = [&](Float32 _value) -> Sint64 {
+    if (cell_size <= 0.0) {
+      Uint32 bits;
+      const Float32 value = _value + 0.0f; // -0 is 0.
+      memcpy(&bits, &value, sizeof bits);
+      return bits;
+    }
+    const auto cell = Math::floor(Float64(_value) / cell_size);
+    // Also for NaN which doesn't weld.
+    if (!(cell > -1e18 && cell < 1e18)) {
+      return cell > 0.0 ? 1'000'000'000'000'000'000 : -1'000'000'000'000'000'000;
+    }
+    return Sint64(cell);
+  };
+
+  // The first vertex of every cell, the rest are linked through |next|.
+  // Only vertices which weld with none before them are in a cell.
+  Map<Cell, Uint32> cells{_allocator};
+
+  const auto rest = sizeof(Math::Vec3f);
+  for (Size i = 0; i < _count; i++) {
+    const auto vertex = _vertices + _stride * i;
+    const auto& position = *reinterpret_cast<const Math::Vec3f*>(vertex);
+
+    auto match = Uint32(i);
+    const Cell min{cell_of(position.x - _distance), cell_of(position.y - _distance), cell_of(position.z - _distance)};
+    const Cell max{cell_of(position.x + _distance), cell_of(position.y + _distance), cell_of(position.z + _distance)};
+    const auto weld = [&](const Cell& _cell) {
+      const auto head = cells.find(_cell);
+      if (!head) {
+        return;
+      }
+      for (auto j = *head; j != -1_u32; j = next[j]) {
+        const auto other = _vertices + _stride * j;
+        const auto& other_position = *reinterpret_cast<const Math::Vec3f*>(other);
+        if (j < match
+          && Math::abs(position.x - other_position.x) <= _distance
+          && Math::abs(position.y - other_position.y) <= _distance
+          && Math::abs(position.z - other_position.z) <= _distance
+          && memcmp(vertex + rest, other + rest, _stride - rest) == 0)
+        {
+          match = j;
+        }
+      }
+    };
+
+    for (auto z = min.z; z <= max.z; z++) {
+      for (auto y = min.y; y <= max.y; y++) {
+        for (auto x = min.x; x <= max.x; x++) {
+          weld({x, y, z});
+        }
+      }
+    }
+
+    result[i] = match;
+    if (match != i) {
+      continue;
+    }
+
+    const Cell cell{cell_of(position.x), cell_of(position.y), cell_of(position.z)};
+    if (auto head = cells.find(cell)) {
+      next[i] = Utility::exchange(*head, Uint32(i));
+    } else if (cells.insert(cell, Uint32(i))) {
+      next[i] = -1_u32;
+    } else {
+      return nullopt;
+    }
+  }
+
+  return result;
+}
+
+Optional<Vector<Uint32>> optimize_vertex_fetch(Memory::Allocator& _allocator,
+  const Span<const Uint32>& _elements, Size _count, Size& vertices_)
+{
+  Vector<Uint32> result{_allocator};
+  if (!result.resize(_count, -1_u32)) {
+    return nullopt;
+  }
+
+  Uint32 vertices = 0;
+  _elements.each_fwd([&](Uint32 _element) {
+    if (result[_element] == -1_u32) {
+      result[_element] = vertices++;
+    }
+  });
+
+  vertices_ = vertices;
+
+  return result;
+}
+
+} // namespace Rx::Model
@@ -0,0 +1,80 @@
+#ifndef RX_MODEL_OPTIMIZE_H
+#define RX_MODEL_OPTIMIZE_H
+#include "rx/core/vector.h"
+#include "rx/core/span.h"
+
+namespace Rx::Math {
+
+template<typename> struct Vec3;
+using Vec3f = Vec3<Float32>;
+
+} // namespace Rx::Math
+
+namespace Rx::Model {
+
+struct OptimizeConfig {
+  // Vertices with positions at most this far apart on every axis, and all
+  // other attributes the same, are welded into one. A value of 0 only welds
+  // vertices which are exactly the same.
+  Float32 weld_distance = 0.0f;
+
+  // The number of vertices in the FIFO post-transform cache optimized for,
+  // and measured with.
+  Size cache_size = 16;
+
+  // How much worse the ACMR of a mesh may get, as a factor, to draw the
+  // outward facing parts of it first.
+  Float32 overdraw_threshold = 1.05f;
+};
+
+// The vertex cache efficiency of a list of triangles.
+struct CacheStats {
+  // Average cache miss ratio, transformed vertices per triangle. In the
+  // range [0.5, 3] where lower is better.
+  Float32 acmr = 0.0f;
+
+  // Average transform to vertex ratio, transformed vertices per vertex
+  // referenced. In the range [1, 3], where 1 is ideal.
+  Float32 atvr = 0.0f;
+};
+
+// Simulates a FIFO cache of |_cache_size| vertices for |_elements|, which
+// refer to |_vertices| vertices.
+CacheStats analyze_vertex_cache(Memory::Allocator& _allocator,
+  const Span<const Uint32>& _elements, Size _vertices, Size _cache_size);
+
+// Reorders the triangles of |elements_| in place for a FIFO cache of
+// |_cache_size| vertices with Tipsify [Sander et al. 2007]. Triangles in an
+// order already better for the cache are left as they are.
+[[nodiscard]] bool optimize_vertex_cache(Memory::Allocator& _allocator,
+  Span<Uint32> elements_, Size _vertices, Size _cache_size);
+
+// Reorders clusters of triangles of |elements_| in place so the ones facing
+// away from the center of the mesh are drawn first, which tends to reduce
+// overdraw from every direction. The triangles should be optimized for the
+// vertex cache first, clusters are only split where the ACMR stays within
+// |_threshold| of that.
+//
+// The positions are read |_stride| bytes apart.
+[[nodiscard]] bool optimize_overdraw(Memory::Allocator& _allocator,
+  Span<Uint32> elements_, const Math::Vec3f* _positions, Size _stride,
+  Size _vertices, Size _cache_size, Float32 _threshold);
+
+// Finds the vertices which can be welded. The result has, for every vertex,
+// the index of the first vertex it welds with, which is itself when none.
+//
+// The vertices are |_stride| bytes apart with the position first. Every byte
+// after the position has to be the same for vertices to weld.
+Optional<Vector<Uint32>> weld_vertices(Memory::Allocator& _allocator,
+  const Byte* _vertices, Size _stride, Size _count, Float32 _distance);
+
+// Numbers the vertices in the order |_elements| first refer to them for
+// locality of vertex fetches. The result has, for every vertex, the new
+// index, or -1 when not referred to at all. The new number of vertices is
+// written to |vertices_|.
+Optional<Vector<Uint32>> optimize_vertex_fetch(Memory::Allocator& _allocator,
+  const Span<const Uint32>& _elements, Size _count, Size& vertices_);
+
+} // namespace Rx::Model
+
+#endif // RX_MODEL_OPTIMIZE_H
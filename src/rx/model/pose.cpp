@@ -0,0 +1,366 @@
+#include "rx/model/pose.h"
+
+#include "rx/core/math/sqrt.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Rx::Model {
+
+// [JointMask]
+Optional<JointMask> JointMask::create(Memory::Allocator& _allocator,
+  const Skeleton& _skeleton, Float32 _weight)
+{
+  const auto n_joints = _skeleton.joints().size();
+
+  Vector<Float32> weights{_allocator};
+  if (!weights.resize(_skeleton.blocks_per_frame() * 4, 0.0f)) {
+    return nullopt;
+  }
+
+  for (Size i = 0; i < n_joints; i++) {
+    weights[i] = _weight;
+  }
+
+  return JointMask{Utility::move(weights)};
+}
+
+void JointMask::set(const Skeleton& _skeleton, Size _joint, Float32 _weight) {
+  // Parents are before the joints under them.
+  const auto& joints = _skeleton.joints();
+  for (Size i = _joint; i < joints.size(); i++) {
+    auto joint = Sint32(i);
+    while (joint > Sint32(_joint)) {
+      joint = joints[joint].parent;
+    }
+    if (joint == Sint32(_joint)) {
+      m_weights[i] = _weight;
+    }
+  }
+}
+
+// [Pose]
+Optional<Pose> Pose::create(Memory::Allocator& _allocator, const Skeleton& _skeleton) {
+  const auto n_joints = _skeleton.joints().size();
+  const auto n_blocks = _skeleton.blocks_per_frame();
+
+  Vector<Skeleton::Block> blocks{_allocator};
+  if (!blocks.resize(n_blocks)) {
+    return nullopt;
+  }
+
+  Skeleton::FrameCache cache{_allocator};
+  if (!cache.prepare(_skeleton)) {
+    return nullopt;
+  }
+
+  // Start in the first frame, if any.
+  if (_skeleton.frames()) {
+    const auto first = _skeleton.frame_blocks(0, blocks.data());
+    for (Size i = 0; i < n_blocks && first != blocks.data(); i++) {
+      blocks[i] = first[i];
+    }
+  }
+
+  return Pose{Utility::move(blocks), Utility::move(cache), n_joints};
+}
+
+#if defined(__SSE2__)
+// The dual quaternions of the four joints of a block, a component in every
+// lane.
+struct DualQuat4 {
+  __m128 real[4];
+  __m128 dual[4];
+};
+
+static inline DualQuat4 load(const Skeleton::Block& _block) {
+  DualQuat4 result;
+  for (Size i = 0; i < 4; i++) {
+    result.real[i] = _mm_loadu_ps(_block.dq[i]);
+    result.dual[i] = _mm_loadu_ps(_block.dq[i + 4]);
+  }
+  return result;
+}
+
+static inline void store(const DualQuat4& _dq, Skeleton::Block& block_) {
+  for (Size i = 0; i < 4; i++) {
+    _mm_storeu_ps(block_.dq[i], _dq.real[i]);
+    _mm_storeu_ps(block_.dq[i + 4], _dq.dual[i]);
+  }
+}
+
+static inline __m128 dot(const __m128 (&_lhs)[4], const __m128 (&_rhs)[4]) {
+  auto result = _mm_mul_ps(_lhs[0], _rhs[0]);
+  for (Size i = 1; i < 4; i++) {
+    result = _mm_add_ps(result, _mm_mul_ps(_lhs[i], _rhs[i]));
+  }
+  return result;
+}
+
+// Interpolates from |_from| to |_to| by |_t| in every lane along the shortest
+// path, normalizing the real part.
+static inline DualQuat4 nlerp(const DualQuat4& _from, const DualQuat4& _to, __m128 _t) {
+  const auto s = _mm_sub_ps(_mm_set1_ps(1.0f), _t);
+  const auto sign = _mm_and_ps(_mm_cmplt_ps(dot(_from.real, _to.real), _mm_setzero_ps()),
+    _mm_set1_ps(-0.0f));
+  const auto k = _mm_xor_ps(_t, sign);
+
+  DualQuat4 result;
+  for (Size i = 0; i < 4; i++) {
+    result.real[i] = _mm_add_ps(_mm_mul_ps(_from.real[i], s), _mm_mul_ps(_to.real[i], k));
+    result.dual[i] = _mm_add_ps(_mm_mul_ps(_from.dual[i], s), _mm_mul_ps(_to.dual[i], k));
+  }
+
+  const auto scale =
+    _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(dot(result.real, result.real)));
+  for (Size i = 0; i < 4; i++) {
+    result.real[i] = _mm_mul_ps(result.real[i], scale);
+  }
+
+  return result;
+}
+
+// The product of quaternions |_lhs| and |_rhs| in every lane.
+static inline void multiply(const __m128 (&_lhs)[4], const __m128 (&_rhs)[4],
+  __m128 (&result_)[4])
+{
+  const auto& [ax, ay, az, aw] = _lhs;
+  const auto& [bx, by, bz, bw] = _rhs;
+  const auto mul = [](__m128 _a, __m128 _b) { return _mm_mul_ps(_a, _b); };
+  const auto add = [](__m128 _a, __m128 _b) { return _mm_add_ps(_a, _b); };
+  const auto sub = [](__m128 _a, __m128 _b) { return _mm_sub_ps(_a, _b); };
+  result_[0] = sub(add(add(mul(aw, bx), mul(ax, bw)), mul(ay, bz)), mul(az, by));
+  result_[1] = add(add(sub(mul(aw, by), mul(ax, bz)), mul(ay, bw)), mul(az, bx));
+  result_[2] = add(sub(add(mul(aw, bz), mul(ax, by)), mul(ay, bx)), mul(az, bw));
+  result_[3] = sub(sub(sub(mul(aw, bw), mul(ax, bx)), mul(ay, by)), mul(az, bz));
+}
+
+// The product of |_lhs| and |_rhs| in every lane, in the order of the product
+// of the matrices they're made from.
+static inline DualQuat4 multiply(const DualQuat4& _lhs, const DualQuat4& _rhs) {
+  DualQuat4 result;
+  __m128 dual[4];
+  multiply(_lhs.real, _rhs.real, result.real);
+  multiply(_lhs.real, _rhs.dual, result.dual);
+  multiply(_lhs.dual, _rhs.real, dual);
+  for (Size i = 0; i < 4; i++) {
+    result.dual[i] = _mm_add_ps(result.dual[i], dual[i]);
+  }
+  return result;
+}
+
+// Broadcasts lane |I| of |_value|.
+template<int I>
+static inline __m128 broadcast(__m128 _value) {
+  return _mm_shuffle_ps(_value, _value, _MM_SHUFFLE(I, I, I, I));
+}
+
+// Interpolates the three rows of the matrix of a joint by |_t|.
+static inline void lerp_rows(const Float32* _from, const Float32* _to,
+  __m128 _t, Float32* result_)
+{
+  const auto s = _mm_sub_ps(_mm_set1_ps(1.0f), _t);
+  for (Size i = 0; i < 12; i += 4) {
+    _mm_storeu_ps(result_ + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(_from + i), s),
+      _mm_mul_ps(_mm_loadu_ps(_to + i), _t)));
+  }
+}
+
+// Interpolates the matrix of a joint from the identity to |_delta| by |_t|,
+// then multiplies |_base| by it.
+static inline void add_rows(const Float32* _base, const Float32* _delta,
+  __m128 _t, Float32* result_)
+{
+  const auto s = _mm_sub_ps(_mm_set1_ps(1.0f), _t);
+  const __m128 identity[] = {
+    _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f),
+    _mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f),
+    _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f)
+  };
+  const __m128 base[] = {
+    _mm_loadu_ps(_base),
+    _mm_loadu_ps(_base + 4),
+    _mm_loadu_ps(_base + 8)
+  };
+  const auto w = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+  for (Size i = 0; i < 3; i++) {
+    const auto row = _mm_add_ps(_mm_mul_ps(identity[i], s),
+      _mm_mul_ps(_mm_loadu_ps(_delta + i * 4), _t));
+    auto result = _mm_mul_ps(broadcast<0>(row), base[0]);
+    result = _mm_add_ps(result, _mm_mul_ps(broadcast<1>(row), base[1]));
+    result = _mm_add_ps(result, _mm_mul_ps(broadcast<2>(row), base[2]));
+    result = _mm_add_ps(result, _mm_mul_ps(broadcast<3>(row), w));
+    _mm_storeu_ps(result_ + i * 4, result);
+  }
+}
+
+// The weights of the joints of block |_block|.
+static inline __m128 weights(Float32 _weight, const JointMask* _mask, Size _block) {
+  const auto weight = _mm_set1_ps(_weight);
+  return _mask ? _mm_mul_ps(weight, _mm_loadu_ps(_mask->data() + _block * 4)) : weight;
+}
+#else
+static Math::DualQuatf load(const Skeleton::Block& _block, Size _lane) {
+  Math::DualQuatf result;
+  auto data = reinterpret_cast<Float32*>(&result);
+  for (Size i = 0; i < 8; i++) {
+    data[i] = _block.dq[i][_lane];
+  }
+  return result;
+}
+
+static void store(const Math::DualQuatf& _dq, Skeleton::Block& block_, Size _lane) {
+  const auto data = reinterpret_cast<const Float32*>(&_dq);
+  for (Size i = 0; i < 8; i++) {
+    block_.dq[i][_lane] = data[i];
+  }
+}
+
+static Math::DualQuatf nlerp(const Math::DualQuatf& _from, const Math::DualQuatf& _to, Float32 _t) {
+  auto result = _from.lerp(_to, _t);
+  result.real = result.real * (1.0f / Math::sqrt(Math::dot(result.real, result.real)));
+  return result;
+}
+
+// Quaternions multiply in the opposite order of the matrices they're made
+// from.
+static Math::DualQuatf multiply(const Math::DualQuatf& _lhs, const Math::DualQuatf& _rhs) {
+  return {_rhs.real * _lhs.real, _rhs.real * _lhs.dual + _rhs.dual * _lhs.real};
+}
+
+static Float32 weight(Float32 _weight, const JointMask* _mask, Size _joint) {
+  return _mask ? _weight * (*_mask)[_joint] : _weight;
+}
+#endif
+
+// Blends |_count| blocks of |_from| to |_to| into |result_|.
+static void blend_blocks(const Skeleton::Block* _from, const Skeleton::Block* _to,
+  Float32 _weight, const JointMask* _mask, Size _count, Skeleton::Block* result_)
+{
+  for (Size i = 0; i < _count; i++) {
+    const auto& from = _from[i];
+    const auto& to = _to[i];
+    auto& result = result_[i];
+#if defined(__SSE2__)
+    const auto t = weights(_weight, _mask, i);
+    lerp_rows(from.lb[0], to.lb[0], broadcast<0>(t), result.lb[0]);
+    lerp_rows(from.lb[1], to.lb[1], broadcast<1>(t), result.lb[1]);
+    lerp_rows(from.lb[2], to.lb[2], broadcast<2>(t), result.lb[2]);
+    lerp_rows(from.lb[3], to.lb[3], broadcast<3>(t), result.lb[3]);
+    store(nlerp(load(from), load(to), t), result);
+#else
+    for (Size lane = 0; lane < 4; lane++) {
+      const auto t = weight(_weight, _mask, i * 4 + lane);
+      for (Size j = 0; j < 12; j++) {
+        result.lb[lane][j] = from.lb[lane][j] * (1.0f - t) + to.lb[lane][j] * t;
+      }
+      store(nlerp(load(from, lane), load(to, lane), t), result, lane);
+    }
+#endif
+  }
+}
+
+void Pose::sample(const Skeleton& _skeleton, Size _frame1, Size _frame2, Float32 _offset) {
+  const auto n_blocks = m_blocks.size();
+  const auto blocks1 = _skeleton.frame_blocks(_frame1, m_cache);
+  const auto blocks2 = _skeleton.frame_blocks(_frame2, m_cache);
+  blend_blocks(blocks1, blocks2, _offset, nullptr, n_blocks, m_blocks.data());
+}
+
+void Pose::blend(const Pose& _from, const Pose& _to, Float32 _weight,
+  const JointMask* _mask)
+{
+  blend_blocks(_from.m_blocks.data(), _to.m_blocks.data(), _weight, _mask,
+    m_blocks.size(), m_blocks.data());
+}
+
+void Pose::add(const Pose& _base, const Pose& _additive,
+  const Pose& _inverse_reference, Float32 _weight, const JointMask* _mask)
+{
+  for (Size i = 0; i < m_blocks.size(); i++) {
+    const auto& base = _base.m_blocks[i];
+    const auto& additive = _additive.m_blocks[i];
+    const auto& inverse_reference = _inverse_reference.m_blocks[i];
+    auto& result = m_blocks[i];
+
+    // The difference of the additive frame from the reference one.
+    Float32 delta[4][12];
+#if defined(__SSE2__)
+    const auto t = weights(_weight, _mask, i);
+    const auto zero = _mm_setzero_ps();
+    for (Size lane = 0; lane < 4; lane++) {
+      add_rows(inverse_reference.lb[lane], additive.lb[lane], _mm_set1_ps(1.0f), delta[lane]);
+    }
+    add_rows(base.lb[0], delta[0], broadcast<0>(t), result.lb[0]);
+    add_rows(base.lb[1], delta[1], broadcast<1>(t), result.lb[1]);
+    add_rows(base.lb[2], delta[2], broadcast<2>(t), result.lb[2]);
+    add_rows(base.lb[3], delta[3], broadcast<3>(t), result.lb[3]);
+
+    const DualQuat4 identity = {{zero, zero, zero, _mm_set1_ps(1.0f)}, {zero, zero, zero, zero}};
+    const auto difference = nlerp(identity,
+      multiply(load(additive), load(inverse_reference)), t);
+    auto dq = multiply(difference, load(base));
+
+    const auto scale =
+      _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(dot(dq.real, dq.real)));
+    for (Size j = 0; j < 4; j++) {
+      dq.real[j] = _mm_mul_ps(dq.real[j], scale);
+    }
+    store(dq, result);
+#else
+    const auto identity = Math::DualQuatf{};
+    for (Size lane = 0; lane < 4; lane++) {
+      const auto t = weight(_weight, _mask, i * 4 + lane);
+
+      const auto& base_lb = *reinterpret_cast<const Math::Mat3x4f*>(base.lb[lane]);
+      const auto& additive_lb = *reinterpret_cast<const Math::Mat3x4f*>(additive.lb[lane]);
+      const auto& inverse_reference_lb =
+        *reinterpret_cast<const Math::Mat3x4f*>(inverse_reference.lb[lane]);
+      auto& delta_lb = *reinterpret_cast<Math::Mat3x4f*>(delta[lane]);
+      delta_lb = Math::Mat3x4f{} * (1.0f - t) + additive_lb * inverse_reference_lb * t;
+      delta_lb.x.x += 1.0f - t;
+      delta_lb.y.y += 1.0f - t;
+      delta_lb.z.z += 1.0f - t;
+      *reinterpret_cast<Math::Mat3x4f*>(result.lb[lane]) = delta_lb * base_lb;
+
+      const auto difference = nlerp(identity,
+        multiply(load(additive, lane), load(inverse_reference, lane)), t);
+      auto dq = multiply(difference, load(base, lane));
+      dq.real = dq.real * (1.0f / Math::sqrt(Math::dot(dq.real, dq.real)));
+      store(dq, result, lane);
+    }
+#endif
+  }
+}
+
+void Pose::invert() {
+  for (Size i = 0; i < m_joints; i++) {
+    auto& block = m_blocks[i / 4];
+    const auto lane = i % 4;
+
+    auto& lb = *reinterpret_cast<Math::Mat3x4f*>(block.lb[lane]);
+    lb = Math::invert(lb);
+
+    // The conjugate of both parts inverts a dual quaternion of unit length.
+    for (Size j = 0; j < 8; j++) {
+      if (j % 4 != 3) {
+        block.dq[j][lane] = -block.dq[j][lane];
+      }
+    }
+  }
+}
+
+void Pose::write(Math::Mat3x4f* lb_, Math::DualQuatf* dq_) const {
+  for (Size i = 0; i < m_joints; i++) {
+    const auto& block = m_blocks[i / 4];
+    const auto lane = i % 4;
+    lb_[i] = *reinterpret_cast<const Math::Mat3x4f*>(block.lb[lane]);
+    auto dq = reinterpret_cast<Float32*>(dq_ + i);
+    for (Size j = 0; j < 8; j++) {
+      dq[j] = block.dq[j][lane];
+    }
+  }
+}
+
+} // namespace Rx::Model
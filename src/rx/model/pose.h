@@ -0,0 +1,140 @@
+#ifndef RX_MODEL_POSE_H
+#define RX_MODEL_POSE_H
+#include "rx/model/skeleton.h"
+
+namespace Rx::Model {
+
+// Weights of every joint of a skeleton, to limit a blend to some of them.
+struct JointMask {
+  RX_MARK_NO_COPY(JointMask);
+
+  JointMask(JointMask&& mask_);
+  JointMask& operator=(JointMask&& mask_);
+
+  // Creates a mask of the joints of |_skeleton|, each weighted by |_weight|.
+  static Optional<JointMask> create(Memory::Allocator& _allocator,
+    const Skeleton& _skeleton, Float32 _weight);
+
+  // Weights |_joint| and every joint under it by |_weight|.
+  void set(const Skeleton& _skeleton, Size _joint, Float32 _weight);
+
+  Float32 operator[](Size _joint) const;
+
+  // The weights of the joints, padded with zero to the joints of a block.
+  const Float32* data() const;
+
+private:
+  JointMask(Vector<Float32>&& weights_);
+
+  Vector<Float32> m_weights;
+};
+
+// The frames of every joint of a skeleton, in the blocks of |Skeleton::Block|
+// so poses are blended four joints at a time. Poses are created with the
+// skeleton and blended into in place, which does not allocate.
+//
+// Blends are of the frames of the skeleton, which are in the space of the
+// model rather than relative to the parent of the joint, so the joints of a
+// mask keep the frames of the pose blended to rather than following their
+// parents in the other.
+struct Pose {
+  RX_MARK_NO_COPY(Pose);
+
+  Pose(Pose&& pose_);
+  Pose& operator=(Pose&& pose_);
+
+  static Optional<Pose> create(Memory::Allocator& _allocator, const Skeleton& _skeleton);
+
+  // Samples the frames |_frame1| and |_frame2| of |_skeleton| interpolated by
+  // |_offset|.
+  void sample(const Skeleton& _skeleton, Size _frame1, Size _frame2, Float32 _offset);
+
+  // Blends from |_from| to |_to| by |_weight|, times the weight of every joint
+  // in |_mask| when given. Matrices are interpolated linearly and dual
+  // quaternions along the shortest path, with the real part normalized.
+  void blend(const Pose& _from, const Pose& _to, Float32 _weight,
+    const JointMask* _mask);
+
+  // Adds the difference of |_additive| from the reference inverted by
+  // |_inverse_reference| onto |_base|, by |_weight| times the weight of every
+  // joint in |_mask| when given.
+  void add(const Pose& _base, const Pose& _additive,
+    const Pose& _inverse_reference, Float32 _weight, const JointMask* _mask);
+
+  // Inverts the frame of every joint.
+  void invert();
+
+  // Writes the frames of the joints to |lb_| and |dq_|.
+  void write(Math::Mat3x4f* lb_, Math::DualQuatf* dq_) const;
+
+  Size joints() const;
+
+private:
+  Pose(Vector<Skeleton::Block>&& blocks_, Skeleton::FrameCache&& cache_,
+    Size _joints);
+
+  Vector<Skeleton::Block> m_blocks;
+
+  // The frames sampled, when compressed.
+  Skeleton::FrameCache m_cache;
+  Size m_joints;
+};
+
+// [JointMask]
+inline JointMask::JointMask(Vector<Float32>&& weights_)
+  : m_weights{Utility::move(weights_)}
+{
+}
+
+inline JointMask::JointMask(JointMask&& mask_)
+  : m_weights{Utility::move(mask_.m_weights)}
+{
+}
+
+inline JointMask& JointMask::operator=(JointMask&& mask_) {
+  if (this != &mask_) {
+    m_weights = Utility::move(mask_.m_weights);
+  }
+  return *this;
+}
+
+inline Float32 JointMask::operator[](Size _joint) const {
+  return m_weights[_joint];
+}
+
+inline const Float32* JointMask::data() const {
+  return m_weights.data();
+}
+
+// [Pose]
+inline Pose::Pose(Vector<Skeleton::Block>&& blocks_,
+  Skeleton::FrameCache&& cache_, Size _joints)
+  : m_blocks{Utility::move(blocks_)}
+  , m_cache{Utility::move(cache_)}
+  , m_joints{_joints}
+{
+}
+
+inline Pose::Pose(Pose&& pose_)
+  : m_blocks{Utility::move(pose_.m_blocks)}
+  , m_cache{Utility::move(pose_.m_cache)}
+  , m_joints{Utility::exchange(pose_.m_joints, 0)}
+{
+}
+
+inline Pose& Pose::operator=(Pose&& pose_) {
+  if (this != &pose_) {
+    m_blocks = Utility::move(pose_.m_blocks);
+    m_cache = Utility::move(pose_.m_cache);
+    m_joints = Utility::exchange(pose_.m_joints, 0);
+  }
+  return *this;
+}
+
+inline Size Pose::joints() const {
+  return m_joints;
+}
+
+} // namespace Rx::Model
+
+#endif // RX_MODEL_POSE_H
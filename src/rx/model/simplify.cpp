@@ -0,0 +1,507 @@
+#include <string.h> // memcpy
+
+#include "rx/model/simplify.h"
+
+#include "rx/core/map.h"
+#include "rx/core/hash/combine.h"
+#include "rx/core/hash/mix_int.h"
+#include "rx/core/math/sqrt.h"
+#include "rx/core/algorithm/min.h"
+#include "rx/core/algorithm/max.h"
+#include "rx/core/algorithm/quick_sort.h"
+
+#include "rx/math/vec3.h"
+
+namespace Rx::Model {
+
+// Vertices on borders are held in place by planes through the border,
+// perpendicular to the triangle, weighted by this much more than triangles.
+static constexpr const Float64 BORDER_WEIGHT = 10.0;
+
+namespace {
+
+// The sum of squared distances to planes, weighted.
+struct Quadric {
+  Float64 a00 = 0.0, a11 = 0.0, a22 = 0.0;
+  Float64 a10 = 0.0, a20 = 0.0, a21 = 0.0;
+  Float64 b0 = 0.0, b1 = 0.0, b2 = 0.0;
+  Float64 c = 0.0;
+  Float64 w = 0.0;
+
+  static Quadric plane(const Math::Vec3f& _normal, const Math::Vec3f& _point,
+    Float64 _weight)
+  {
+    const Float64 a = _normal.x;
+    const Float64 b = _normal.y;
+    const Float64 c = _normal.z;
+    const Float64 d = -(a * _point.x + b * _point.y + c * _point.z);
+    Quadric result;
+    result.a00 = a * a * _weight;
+    result.a11 = b * b * _weight;
+    result.a22 = c * c * _weight;
+    result.a10 = a * b * _weight;
+    result.a20 = a * c * _weight;
+    result.a21 = b * c * _weight;
+    result.b0 = a * d * _weight;
+    result.b1 = b * d * _weight;
+    result.b2 = c * d * _weight;
+    result.c = d * d * _weight;
+    result.w = _weight;
+    return result;
+  }
+
+  void operator+=(const Quadric& _other) {
+    a00 += _other.a00; a11 += _other.a11; a22 += _other.a22;
+    a10 += _other.a10; a20 += _other.a20; a21 += _other.a21;
+    b0 += _other.b0; b1 += _other.b1; b2 += _other.b2;
+    c += _other.c;
+    w += _other.w;
+  }
+
+  // The weighted average of the squared distances to the planes.
+  Float64 error(const Math::Vec3f& _point) const {
+    const Float64 x = _point.x;
+    const Float64 y = _point.y;
+    const Float64 z = _point.z;
+    const Float64 rx = a00 * x + a10 * y + a20 * z + b0 * 2.0;
+    const Float64 ry = a10 * x + a11 * y + a21 * z + b1 * 2.0;
+    const Float64 rz = a20 * x + a21 * y + a22 * z + b2 * 2.0;
+    const Float64 result = rx * x + ry * y + rz * z + c;
+    return w > 0.0 ? Algorithm::max(result / w, 0.0) : 0.0;
+  }
+};
+
+// Vertices with the same position.
+struct Position {
+  Uint32 x, y, z;
+
+  Size hash() const {
+    const auto h0 = Hash::mix_uint32(x);
+    const auto h1 = Hash::mix_uint32(y);
+    const auto h2 = Hash::mix_uint32(z);
+    return Hash::combine(Hash::combine(h0, h1), h2);
+  }
+
+  bool operator==(const Position& _other) const {
+    return x == _other.x && y == _other.y && z == _other.z;
+  }
+};
+
+struct Collapse {
+  Uint32 from;
+  Uint32 to;
+  Float64 error;
+};
+
+enum class Kind : Uint8 {
+  MANIFOLD, // Can collapse into any vertex.
+  BORDER,   // Can collapse along the border.
+  LOCKED    // Never collapses.
+};
+
+} // namespace
+
+Optional<Float32> simplify(Memory::Allocator& _allocator,
+  const Span<const Uint32>& _elements, const Math::Vec3f* _positions,
+  Size _stride, Size _vertices, Size _target, Float32 _max_error,
+  Vector<Uint32>& result_)
+{
+  const auto position_of = [&](Uint32 _vertex) -> const Math::Vec3f& {
+    const auto data = reinterpret_cast<const Byte*>(_positions);
+    return *reinterpret_cast<const Math::Vec3f*>(data + _stride * _vertex);
+  };
+
+  const auto n_elements = _elements.size();
+
+  if (!result_.resize(n_elements)) {
+    return nullopt;
+  }
+
+  for (Size i = 0; i < n_elements; i++) {
+    result_[i] = _elements[i];
+  }
+
+  // Every vertex refers to the first vertex with the same position, which
+  // the topology and quadrics are in terms of.
+  Vector<Uint32> remap{_allocator};
+  Vector<Uint32> wedges{_allocator};
+  if (!remap.resize(_vertices, -1_u32) || !wedges.resize(_vertices, 0)) {
+    return nullopt;
+  }
+
+  Math::Vec3f min{position_of(_elements[0])};
+  Math::Vec3f max{min};
+
+  {
+    Map<Position, Uint32> positions{_allocator};
+    for (Size i = 0; i < n_elements; i++) {
+      const auto vertex = _elements[i];
+      if (remap[vertex] != -1_u32) {
+        continue;
+      }
+
+      const auto& position = position_of(vertex);
+      min = {Algorithm::min(min.x, position.x), Algorithm::min(min.y, position.y), Algorithm::min(min.z, position.z)};
+      max = {Algorithm::max(max.x, position.x), Algorithm::max(max.y, position.y), Algorithm::max(max.z, position.z)};
+
+      Position key;
+      const Float32 values[3] = {position.x + 0.0f, position.y + 0.0f, position.z + 0.0f};
+      memcpy(&key, values, sizeof key);
+      if (auto find = positions.find(key)) {
+        remap[vertex] = *find;
+      } else if (positions.insert(key, vertex)) {
+        remap[vertex] = vertex;
+      } else {
+        return nullopt;
+      }
+      wedges[remap[vertex]]++;
+    }
+  }
+
+  const auto extent = (max - min).max_element();
+  const auto error_scale = extent > 0.0f ? 1.0 / (Float64(extent) * extent) : 0.0;
+
+  // The half-edges out of every vertex.
+  const auto n_triangles = n_elements / 3;
+
+  Vector<Uint32> offsets{_allocator};
+  Vector<Uint32> edges{_allocator};
+  if (!offsets.resize(_vertices + 1, 0) || !edges.resize(n_elements)) {
+    return nullopt;
+  }
+
+  for (Size i = 0; i < n_elements; i++) {
+    offsets[remap[_elements[i]] + 1]++;
+  }
+
+  for (Size i = 0; i < _vertices; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+
+  {
+    auto cursors = Utility::copy(offsets);
+    if (!cursors) {
+      return nullopt;
+    }
+    for (Size i = 0; i < n_elements; i++) {
+      const auto from = remap[_elements[i]];
+      const auto to = remap[_elements[i - i % 3 + (i + 1) % 3]];
+      edges[(*cursors)[from]++] = to;
+    }
+  }
+
+  const auto has_edge = [&](Uint32 _from, Uint32 _to) {
+    for (Uint32 i = offsets[_from]; i < offsets[_from + 1]; i++) {
+      if (edges[i] == _to) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // A vertex with one border edge in and one out is on a single border, with
+  // more it joins several and is locked, like those on seams.
+  Vector<Uint8> borders_in{_allocator};
+  Vector<Uint8> borders_out{_allocator};
+  Vector<Kind> kinds{_allocator};
+  if (!borders_in.resize(_vertices, 0) || !borders_out.resize(_vertices, 0)
+    || !kinds.resize(_vertices, Kind::LOCKED))
+  {
+    return nullopt;
+  }
+
+  for (Size i = 0; i < _vertices; i++) {
+    if (remap[i] != i) {
+      continue;
+    }
+    for (Uint32 j = offsets[i]; j < offsets[i + 1]; j++) {
+      const auto to = edges[j];
+      if (!has_edge(to, Uint32(i))) {
+        borders_out[i] = Uint8(Algorithm::min(borders_out[i] + 1, 255));
+        borders_in[to] = Uint8(Algorithm::min(borders_in[to] + 1, 255));
+      }
+      // The same half-edge twice is not manifold.
+      for (Uint32 k = j + 1; k < offsets[i + 1]; k++) {
+        if (edges[k] == to) {
+          borders_out[i] = 255;
+        }
+      }
+    }
+  }
+
+  for (Size i = 0; i < _vertices; i++) {
+    if (remap[i] != i || wedges[i] != 1) {
+      continue;
+    }
+    if (borders_in[i] == 0 && borders_out[i] == 0) {
+      kinds[i] = Kind::MANIFOLD;
+    } else if (borders_in[i] == 1 && borders_out[i] == 1) {
+      kinds[i] = Kind::BORDER;
+    }
+  }
+
+  // The planes of the triangles around every vertex, and of the borders.
+  Vector<Quadric> quadrics{_allocator};
+  if (!quadrics.resize(_vertices)) {
+    return nullopt;
+  }
+
+  for (Size i = 0; i < n_triangles; i++) {
+    const Uint32 vertices[3] = {
+      remap[_elements[i * 3 + 0]],
+      remap[_elements[i * 3 + 1]],
+      remap[_elements[i * 3 + 2]]
+    };
+
+    const auto& p0 = position_of(vertices[0]);
+    const auto& p1 = position_of(vertices[1]);
+    const auto& p2 = position_of(vertices[2]);
+
+    const auto normal = Math::cross(p1 - p0, p2 - p0);
+    const auto area = Math::length(normal);
+    if (area <= 0.0f) {
+      continue;
+    }
+
+    const auto unit_normal = normal / area;
+    const auto quadric = Quadric::plane(unit_normal, p0, area);
+    for (Size j = 0; j < 3; j++) {
+      quadrics[vertices[j]] += quadric;
+    }
+
+    for (Size j = 0; j < 3; j++) {
+      const auto from = vertices[j];
+      const auto to = vertices[(j + 1) % 3];
+      if (has_edge(to, from)) {
+        continue;
+      }
+      const auto edge = position_of(to) - position_of(from);
+      const auto length = Math::length(edge);
+      if (length <= 0.0f) {
+        continue;
+      }
+      const auto border_normal = Math::cross(edge, unit_normal) / length;
+      const auto border = Quadric::plane(border_normal, position_of(from),
+        Float64(length) * length * BORDER_WEIGHT);
+      quadrics[from] += border;
+      quadrics[to] += border;
+    }
+  }
+
+  // Collapses can only happen into vertices of edges along which they keep
+  // the shape of borders.
+  const auto can_collapse = [&](Uint32 _from, Uint32 _to) {
+    switch (kinds[_from]) {
+    case Kind::MANIFOLD:
+      return true;
+    case Kind::BORDER:
+      return kinds[_to] != Kind::MANIFOLD && !has_edge(_to, _from);
+    case Kind::LOCKED:
+      return false;
+    }
+    return false;
+  };
+
+  const auto max_error = Float64(_max_error) * _max_error;
+
+  Vector<Uint32> collapse_remap{_allocator};
+  Vector<Uint8> collapse_locked{_allocator};
+  Vector<Collapse> collapses{_allocator};
+  Vector<Uint32> triangle_offsets{_allocator};
+  Vector<Uint32> triangles{_allocator};
+  if (!collapse_remap.resize(_vertices) || !collapse_locked.resize(_vertices, 0)
+    || !triangle_offsets.resize(_vertices + 1))
+  {
+    return nullopt;
+  }
+
+  for (Size i = 0; i < _vertices; i++) {
+    collapse_remap[i] = Uint32(i);
+  }
+
+  Float64 result_error = 0.0;
+  Size n_result = n_elements / 3;
+
+  while (n_result > _target) {
+    const auto elements = result_.data();
+
+    // The triangles around every vertex for checking flips.
+    for (Size i = 0; i <= _vertices; i++) {
+      triangle_offsets[i] = 0;
+    }
+    for (Size i = 0; i < n_result * 3; i++) {
+      triangle_offsets[remap[elements[i]] + 1]++;
+    }
+    for (Size i = 0; i < _vertices; i++) {
+      triangle_offsets[i + 1] += triangle_offsets[i];
+    }
+    if (!triangles.resize(n_result * 3)) {
+      return nullopt;
+    }
+    {
+      auto cursors = Utility::copy(triangle_offsets);
+      if (!cursors) {
+        return nullopt;
+      }
+      for (Size i = 0; i < n_result * 3; i++) {
+        triangles[(*cursors)[remap[elements[i]]]++] = Uint32(i / 3);
+      }
+    }
+
+    // Find the cheapest direction to collapse every edge in.
+    collapses.clear();
+    for (Size i = 0; i < n_result * 3; i++) {
+      const auto v0 = elements[i];
+      const auto v1 = elements[i - i % 3 + (i + 1) % 3];
+      const auto r0 = remap[v0];
+      const auto r1 = remap[v1];
+      if (r0 == r1) {
+        continue;
+      }
+
+      // Edges between two triangles are seen from both.
+      const bool border = !has_edge(r1, r0);
+      if (!border && r0 > r1) {
+        continue;
+      }
+
+      const bool forward = can_collapse(r0, r1);
+      const bool backward = can_collapse(r1, r0);
+      if (!forward && !backward) {
+        continue;
+      }
+
+      auto quadric = quadrics[r0];
+      quadric += quadrics[r1];
+
+      const auto forward_error = forward ? quadric.error(position_of(v1)) : 0.0;
+      const auto backward_error = backward ? quadric.error(position_of(v0)) : 0.0;
+
+      Collapse collapse;
+      if (forward && (!backward || forward_error <= backward_error)) {
+        collapse = {v0, v1, forward_error * error_scale};
+      } else {
+        collapse = {v1, v0, backward_error * error_scale};
+      }
+
+      if (!collapses.push_back(collapse)) {
+        return nullopt;
+      }
+    }
+
+    // Ties are broken by the vertices to keep the result stable.
+    Algorithm::quick_sort(collapses.data(), collapses.data() + collapses.size(),
+      [](const Collapse& _lhs, const Collapse& _rhs) {
+        if (_lhs.error != _rhs.error) {
+          return _lhs.error < _rhs.error;
+        }
+        if (_lhs.from != _rhs.from) {
+          return _lhs.from < _rhs.from;
+        }
+        return _lhs.to < _rhs.to;
+      });
+
+    // A collapse which turns a triangle around would fold the surface.
+    const auto flips = [&](Uint32 _from, Uint32 _to) {
+      const auto from = remap[_from];
+      const auto& target = position_of(_to);
+      for (Uint32 i = triangle_offsets[from]; i < triangle_offsets[from + 1]; i++) {
+        const auto triangle = triangles[i];
+        Uint32 vertices[3];
+        for (Size j = 0; j < 3; j++) {
+          vertices[j] = remap[collapse_remap[elements[triangle * 3 + j]]];
+        }
+
+        // Triangles with both vertices are removed.
+        if (vertices[0] == remap[_to] || vertices[1] == remap[_to] || vertices[2] == remap[_to]) {
+          continue;
+        }
+
+        const auto& p0 = position_of(vertices[0]);
+        const auto& p1 = position_of(vertices[1]);
+        const auto& p2 = position_of(vertices[2]);
+        const auto before = Math::cross(p1 - p0, p2 - p0);
+
+        const auto& q0 = vertices[0] == from ? target : p0;
+        const auto& q1 = vertices[1] == from ? target : p1;
+        const auto& q2 = vertices[2] == from ? target : p2;
+        const auto after = Math::cross(q1 - q0, q2 - q0);
+
+        if (Math::dot(before, after) <= 0.0f) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    // Each vertex collapses at most once per pass since the errors of the
+    // collapses after would be out of date. Manifold collapses remove two
+    // triangles, border collapses one.
+    const auto goal = n_result - _target;
+    Size removed = 0;
+    Size collapsed = 0;
+    const auto n_collapses = collapses.size();
+    for (Size i = 0; i < n_collapses && removed < goal; i++) {
+      const auto& collapse = collapses[i];
+      if (collapse.error > max_error) {
+        break;
+      }
+
+      const auto from = remap[collapse.from];
+      const auto to = remap[collapse.to];
+      if (collapse_locked[from] || collapse_locked[to]) {
+        continue;
+      }
+
+      if (flips(collapse.from, collapse.to)) {
+        continue;
+      }
+
+      collapse_remap[collapse.from] = collapse.to;
+      quadrics[to] += quadrics[from];
+      collapse_locked[from] = 1;
+      collapse_locked[to] = 1;
+
+      removed += kinds[from] == Kind::BORDER ? 1 : 2;
+      collapsed++;
+      result_error = Algorithm::max(result_error, collapse.error);
+    }
+
+    if (collapsed == 0) {
+      break;
+    }
+
+    // Remove the triangles which are now degenerate.
+    Size n_written = 0;
+    for (Size i = 0; i < n_result; i++) {
+      const auto v0 = collapse_remap[elements[i * 3 + 0]];
+      const auto v1 = collapse_remap[elements[i * 3 + 1]];
+      const auto v2 = collapse_remap[elements[i * 3 + 2]];
+      const auto r0 = remap[v0];
+      const auto r1 = remap[v1];
+      const auto r2 = remap[v2];
+      if (r0 == r1 || r1 == r2 || r2 == r0) {
+        continue;
+      }
+      elements[n_written * 3 + 0] = v0;
+      elements[n_written * 3 + 1] = v1;
+      elements[n_written * 3 + 2] = v2;
+      n_written++;
+    }
+
+    n_result = n_written;
+
+    for (Size i = 0; i < _vertices; i++) {
+      collapse_remap[i] = Uint32(i);
+      collapse_locked[i] = 0;
+    }
+  }
+
+  if (!result_.resize(n_result * 3)) {
+    return nullopt;
+  }
+
+  return Math::sqrt(Float32(result_error));
+}
+
+} // namespace Rx::Model
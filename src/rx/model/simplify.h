@@ -0,0 +1,48 @@
+#ifndef RX_MODEL_SIMPLIFY_H
+#define RX_MODEL_SIMPLIFY_H
+#include "rx/core/vector.h"
+#include "rx/core/span.h"
+
+namespace Rx::Math {
+
+template<typename> struct Vec3;
+using Vec3f = Vec3<Float32>;
+
+} // namespace Rx::Math
+
+namespace Rx::Model {
+
+struct LodConfig {
+  // The number of levels of detail to generate for every mesh, not counting
+  // the mesh itself. Fewer are generated when a mesh cannot be simplified
+  // further.
+  Size levels = 3;
+
+  // The number of triangles of every level as a fraction of the one before.
+  Float32 ratio = 0.5f;
+
+  // The largest error of any level, relative to the size of the mesh.
+  Float32 max_error = 0.05f;
+};
+
+// Simplifies the triangles |_elements| by collapsing edges in order of least
+// quadric error [Garland and Heckbert 1997] until at most |_target| triangles
+// are left, or any further collapse would have an error larger than
+// |_max_error|. The result is written to |result_|.
+//
+// Edges are collapsed into one of their vertices so the result refers to the
+// same vertices, which are |_stride| bytes apart with the position first.
+// Vertices which share a position but differ in other attributes, like those
+// on texture seams, are kept. Those on borders are only collapsed along the
+// border.
+//
+// Errors are relative to the size of the triangles. Returns the error of the
+// result, or nullopt when out of memory.
+Optional<Float32> simplify(Memory::Allocator& _allocator,
+  const Span<const Uint32>& _elements, const Math::Vec3f* _positions,
+  Size _stride, Size _vertices, Size _target, Float32 _max_error,
+  Vector<Uint32>& result_);
+
+} // namespace Rx::Model
+
+#endif // RX_MODEL_SIMPLIFY_H
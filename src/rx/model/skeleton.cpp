@@ -1,20 +1,95 @@
 #include "rx/model/skeleton.h"
+#include "rx/model/compression.h"
 
 namespace Rx::Model {
 
+// The matrix of joints past the last in a block.
+static constexpr const Math::Mat3x4f IDENTITY{
+  {1.0f, 0.0f, 0.0f, 0.0f},
+  {0.0f, 1.0f, 0.0f, 0.0f},
+  {0.0f, 0.0f, 1.0f, 0.0f}};
+
+// Reads the frames of the joint in |_lane| of |_block|.
+static Math::Mat3x4f lb_of(const Skeleton::Block& _block, Size _lane) {
+  Math::Mat3x4f result;
+  const auto lb_data = reinterpret_cast<Float32*>(&result);
+  for (Size component = 0; component < 12; component++) {
+    lb_data[component] = _block.lb[_lane][component];
+  }
+  return result;
+}
+
+static Math::DualQuatf dq_of(const Skeleton::Block& _block, Size _lane) {
+  Math::DualQuatf result;
+  const auto dq_data = reinterpret_cast<Float32*>(&result);
+  for (Size component = 0; component < 8; component++) {
+    dq_data[component] = _block.dq[component][_lane];
+  }
+  return result;
+}
+
+// Writes the frames of the joint in |_lane| of |block_|.
+static void write_lane(Skeleton::Block& block_, Size _lane,
+  const Math::Mat3x4f& _lb, const Math::DualQuatf& _dq)
+{
+  const auto lb_data = reinterpret_cast<const Float32*>(&_lb);
+  const auto dq_data = reinterpret_cast<const Float32*>(&_dq);
+  for (Size component = 0; component < 12; component++) {
+    block_.lb[_lane][component] = lb_data[component];
+  }
+  for (Size component = 0; component < 8; component++) {
+    block_.dq[component][_lane] = dq_data[component];
+  }
+}
+
+static void write_lane(Skeleton::Block& block_, Size _lane, const Math::Mat3x4f& _frame) {
+  Math::DualQuatf dq = _frame;
+  dq.real = Math::normalize(dq.real);
+  write_lane(block_, _lane, _frame, dq);
+}
+
+// The compressed frames are only complete here.
+Skeleton::Skeleton(Vector<Joint>&& joints_, Vector<Block>&& blocks_,
+  Ptr<CompressedFrames>&& compressed_)
+  : m_joints{Utility::move(joints_)}
+  , m_blocks{Utility::move(blocks_)}
+  , m_compressed{Utility::move(compressed_)}
+{
+}
+
+Skeleton::Skeleton(Skeleton&& skeleton_)
+  : m_joints{Utility::move(skeleton_.m_joints)}
+  , m_blocks{Utility::move(skeleton_.m_blocks)}
+  , m_compressed{Utility::move(skeleton_.m_compressed)}
+{
+}
+
+Skeleton::~Skeleton() = default;
+
+Skeleton& Skeleton::operator=(Skeleton&& skeleton_) {
+  if (&skeleton_ != this) {
+    m_joints = Utility::move(skeleton_.m_joints);
+    m_blocks = Utility::move(skeleton_.m_blocks);
+    m_compressed = Utility::move(skeleton_.m_compressed);
+  }
+  return *this;
+}
+
 void Skeleton::transform(const Math::Mat3x4f& _transform) {
-  const auto inverse = Math::invert(_transform);
+  RX_ASSERT(!is_compressed(), "cannot transform compressed frames");
 
-  const auto n_frames = m_lb_frames.size();
+  const auto inverse = Math::invert(_transform);
 
-  m_lb_frames.each_fwd([&](Math::Mat3x4f& frame_) {
-    frame_ = _transform * frame_ * inverse;
-  });
+  const auto n_joints = m_joints.size();
+  const auto n_blocks = blocks_per_frame();
 
   // TODO(dweiler): Transform the DQ frames instead of recreating them.
-  for (Size i = 0; i < n_frames; i++) {
-    m_dq_frames[i] = m_lb_frames[i];
-    m_dq_frames[i].real = Math::normalize(m_dq_frames[i].real);
+  for (Size i = 0; i < m_blocks.size(); i++) {
+    const auto first = (i % n_blocks) * 4;
+    auto& block = m_blocks[i];
+    for (Size lane = 0; lane < 4 && first + lane < n_joints; lane++) {
+      write_lane(block, lane, _transform * lb_of(block, lane) * inverse);
+    }
   }
 
   m_joints.each_fwd([&](Joint& joint_) {
@@ -23,40 +98,141 @@ void Skeleton::transform(const Math::Mat3x4f& _transform) {
 }
 
 Optional<Skeleton> Skeleton::create(Vector<Joint>&& joints_, Vector<Math::Mat3x4f>&& frames_) {
-  const auto n_frames = frames_.size();
+  const auto n_joints = joints_.size();
+  const auto n_blocks = (n_joints + 3) / 4;
 
+  // The frames are only kept in blocks, |frames_| is released on return.
   auto& allocator = frames_.allocator();
-  Vector<Math::DualQuatf> dq_frames{allocator};
-  if (!dq_frames.resize(n_frames)) {
+  Vector<Block> blocks{allocator};
+  if (n_joints && !blocks.resize(frames_.size() / n_joints * n_blocks)) {
     return nullopt;
   }
 
-  for (Size i = 0; i < n_frames; i++) {
-    dq_frames[i] = frames_[i];
-    dq_frames[i].real = Math::normalize(dq_frames[i].real);
+  for (Size i = 0; i < blocks.size(); i++) {
+    const auto frame = i / n_blocks;
+    const auto first = (i % n_blocks) * 4;
+    for (Size lane = 0; lane < 4; lane++) {
+      const auto joint = first + lane;
+      if (joint < n_joints) {
+        write_lane(blocks[i], lane, frames_[frame * n_joints + joint]);
+      } else {
+        // Joints past the last are the identity.
+        write_lane(blocks[i], lane, IDENTITY, Math::DualQuatf{});
+      }
+    }
   }
 
   return Skeleton {
     Utility::move(joints_),
-    Utility::move(frames_),
-    Utility::move(dq_frames)
+    Utility::move(blocks),
+    Ptr<CompressedFrames>{allocator}
   };
 }
 
 Optional<Skeleton> Skeleton::copy(const Skeleton& _skeleton) {
   auto joints = Utility::copy(_skeleton.m_joints);
-  auto lb_frames = Utility::copy(_skeleton.m_lb_frames);
-  auto dq_frames = Utility::copy(_skeleton.m_dq_frames);
+  auto blocks = Utility::copy(_skeleton.m_blocks);
 
-  if (!joints || !lb_frames || !dq_frames) {
+  if (!joints || !blocks) {
     return nullopt;
   }
 
+  auto& allocator = joints->allocator();
+  Ptr<CompressedFrames> compressed{allocator};
+  if (const auto& frames = _skeleton.m_compressed) {
+    auto copy = CompressedFrames::copy(*frames);
+    if (!copy) {
+      return nullopt;
+    }
+    compressed = make_ptr<CompressedFrames>(allocator, Utility::move(*copy));
+    if (!compressed) {
+      return nullopt;
+    }
+  }
+
   return Skeleton {
     Utility::move(*joints),
-    Utility::move(*lb_frames),
-    Utility::move(*dq_frames)
+    Utility::move(*blocks),
+    Utility::move(compressed)
   };
 }
 
+bool Skeleton::compress(const Vector<Clip>& _clips,
+  const CompressConfig& _config, Vector<CompressionStats>& stats_)
+{
+  auto& allocator = m_blocks.allocator();
+
+  auto frames = CompressedFrames::create(allocator, *this, _clips, _config, stats_);
+  if (!frames) {
+    return false;
+  }
+
+  auto compressed = make_ptr<CompressedFrames>(allocator, Utility::move(*frames));
+  if (!compressed) {
+    return false;
+  }
+
+  m_compressed = Utility::move(compressed);
+  m_blocks = Vector<Block>{allocator};
+
+  return true;
+}
+
+const Skeleton::Block* Skeleton::frame_blocks(Size _frame, Block* scratch_) const {
+  if (m_compressed) {
+    m_compressed->decompress(_frame, scratch_);
+    return scratch_;
+  }
+  return m_blocks.data() + _frame * blocks_per_frame();
+}
+
+const Skeleton::Block* Skeleton::frame_blocks(Size _frame, FrameCache& cache_) const {
+  if (!m_compressed) {
+    return m_blocks.data() + _frame * blocks_per_frame();
+  }
+
+  const auto n_blocks = blocks_per_frame();
+  for (Size i = 0; i < 2; i++) {
+    if (cache_.frames[i] == _frame) {
+      cache_.last = i;
+      return cache_.blocks.data() + i * n_blocks;
+    }
+  }
+
+  // The other frame is usually sampled with this one.
+  const auto slot = cache_.last ^ 1;
+  const auto blocks = cache_.blocks.data() + slot * n_blocks;
+  m_compressed->decompress(_frame, blocks);
+  cache_.frames[slot] = _frame;
+  cache_.last = slot;
+
+  return blocks;
+}
+
+Math::Mat3x4f Skeleton::lb_frame(Size _frame, Size _joint) const {
+  RX_ASSERT(!is_compressed(), "frames are compressed");
+  return lb_of(m_blocks[_frame * blocks_per_frame() + _joint / 4], _joint % 4);
+}
+
+Math::DualQuatf Skeleton::dq_frame(Size _frame, Size _joint) const {
+  RX_ASSERT(!is_compressed(), "frames are compressed");
+  return dq_of(m_blocks[_frame * blocks_per_frame() + _joint / 4], _joint % 4);
+}
+
+bool Skeleton::FrameCache::prepare(const Skeleton& _skeleton) {
+  frames[0] = -1_z;
+  frames[1] = -1_z;
+  last = 0;
+  return !_skeleton.is_compressed()
+    || blocks.resize(_skeleton.blocks_per_frame() * 2);
+}
+
+Size Skeleton::frames() const {
+  if (m_compressed) {
+    return m_compressed->frames();
+  }
+  const auto n_blocks = blocks_per_frame();
+  return n_blocks ? m_blocks.size() / n_blocks : 0;
+}
+
 } // namespace Rx::Model
\ No newline at end of file
@@ -1,59 +1,116 @@
 #ifndef RX_MODEL_SKELETON_H
 #define RX_MODEL_SKELETON_H
 #include "rx/core/vector.h"
+#include "rx/core/ptr.h"
 
 #include "rx/math/mat3x4.h"
 #include "rx/math/dual_quat.h"
 
 namespace Rx::Model {
 
+struct Clip;
+struct CompressConfig;
+struct CompressionStats;
+struct CompressedFrames;
+
 struct Skeleton {
   RX_MARK_NO_COPY(Skeleton);
 
   Skeleton(Skeleton&& skeleton_);
   Skeleton& operator=(Skeleton&& skeleton_);
+  ~Skeleton();
 
   struct Joint {
     Math::Mat3x4f frame;
     Sint32 parent;
   };
 
+  // The frames of four joints together. The dual quaternions have a component
+  // of each joint in every lane, so the joints are interpolated and normalized
+  // four at a time, while the matrices, which are only interpolated, are kept
+  // after one another. The blocks of every frame are after one another, with
+  // joints past the last being the identity.
+  struct Block {
+    Float32 lb[4][12];
+    Float32 dq[8][4];
+  };
+
+  // The blocks of the last two frames decompressed, which are sampled over
+  // and over as a clip is played.
+  struct FrameCache {
+    constexpr FrameCache(Memory::Allocator& _allocator);
+
+    // Makes room for the frames of |_skeleton|, when compressed.
+    [[nodiscard]] bool prepare(const Skeleton& _skeleton);
+
+    Vector<Block> blocks;
+    Size frames[2];
+    Size last;
+  };
+
   static Optional<Skeleton> create(Vector<Joint>&& joints_, Vector<Math::Mat3x4f>&& frames_);
   static Optional<Skeleton> copy(const Skeleton& _skeleton);
 
+  // Cannot transform compressed frames, transform before compressing.
   void transform(const Math::Mat3x4f& _transform);
 
+  // Compresses the frames of |_clips|, writing the stats of every clip to
+  // |stats_|. The blocks compressed from are released, only the joints and
+  // the compressed frames decompressed by |frame_blocks| are left.
+  [[nodiscard]] bool compress(const Vector<Clip>& _clips,
+    const CompressConfig& _config, Vector<CompressionStats>& stats_);
+
+  // The blocks of |_frame|. Compressed frames are decompressed into
+  // |scratch_|, which has room for the blocks of a frame, and that returned.
+  const Block* frame_blocks(Size _frame, Block* scratch_) const;
+
+  // The blocks of |_frame|. Compressed frames are decompressed into |cache_|
+  // unless already there, replacing the frame used least recently.
+  const Block* frame_blocks(Size _frame, FrameCache& cache_) const;
+
   const Vector<Joint>& joints() const & { return m_joints; }
-  const Vector<Math::Mat3x4f>& lb_frames() const & { return m_lb_frames; }
-  const Vector<Math::DualQuatf>& dq_frames() const & { return m_dq_frames; }
+  const Vector<Block>& blocks() const & { return m_blocks; }
+
+  // The frame of |_joint| in |_frame|, read back from the blocks. The frames
+  // are only kept in blocks, so these cannot be used once compressed.
+  Math::Mat3x4f lb_frame(Size _frame, Size _joint) const;
+  Math::DualQuatf dq_frame(Size _frame, Size _joint) const;
+
+  // The number of blocks in every frame.
+  Size blocks_per_frame() const;
+
+  // The number of frames, compressed or not.
+  Size frames() const;
+
+  bool is_compressed() const;
+  const CompressedFrames* compressed_frames() const;
 
 private:
-  Skeleton(Vector<Joint>&& joints_, Vector<Math::Mat3x4f>&& lb_frames_, Vector<Math::DualQuatf>&& dq_frames_)
-    : m_joints{Utility::move(joints_)}
-    , m_lb_frames{Utility::move(lb_frames_)}
-    , m_dq_frames{Utility::move(dq_frames_)}
-  {
-  }
+  Skeleton(Vector<Joint>&& joints_, Vector<Block>&& blocks_,
+    Ptr<CompressedFrames>&& compressed_);
 
   Vector<Joint> m_joints;
-  Vector<Math::Mat3x4f> m_lb_frames;
-  Vector<Math::DualQuatf> m_dq_frames;
+  Vector<Block> m_blocks;
+  Ptr<CompressedFrames> m_compressed;
 };
 
-inline Skeleton::Skeleton(Skeleton&& skeleton_)
-  : m_joints{Utility::move(skeleton_.m_joints)}
-  , m_lb_frames{Utility::move(skeleton_.m_lb_frames)}
-  , m_dq_frames{Utility::move(skeleton_.m_dq_frames)}
+inline constexpr Skeleton::FrameCache::FrameCache(Memory::Allocator& _allocator)
+  : blocks{_allocator}
+  , frames{-1_z, -1_z}
+  , last{0}
 {
 }
 
-inline Skeleton& Skeleton::operator=(Skeleton&& skeleton_) {
-  if (&skeleton_ != this) {
-    m_joints = Utility::move(skeleton_.m_joints);
-    m_lb_frames = Utility::move(skeleton_.m_lb_frames);
-    m_dq_frames = Utility::move(skeleton_.m_dq_frames);
-  }
-  return *this;
+inline Size Skeleton::blocks_per_frame() const {
+  return (m_joints.size() + 3) / 4;
+}
+
+inline bool Skeleton::is_compressed() const {
+  return m_compressed;
+}
+
+inline const CompressedFrames* Skeleton::compressed_frames() const {
+  return m_compressed.get();
 }
 
 } // namespace Rx::Model
@@ -0,0 +1,191 @@
+#include "rx/model/skinning.h"
+
+#include "rx/core/math/sqrt.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Rx::Model {
+
+static inline Float32 dot(const Math::Quatf& _a, const Math::Quatf& _b) {
+  return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z + _a.w * _b.w;
+}
+
+// The weights of the frames of |_vertex|, negated for frames on the other
+// side of the first so they do not cancel out when blended.
+static inline void weights_of(const Loader::AnimatedVertex& _vertex,
+  const Math::DualQuatf* _frames, Float32 (&weights_)[4])
+{
+  const auto& real = _frames[_vertex.blend_indices.x].real;
+  weights_[0] = _vertex.blend_weights.x;
+  weights_[1] = dot(real, _frames[_vertex.blend_indices.y].real) < 0.0f
+    ? -_vertex.blend_weights.y : _vertex.blend_weights.y;
+  weights_[2] = dot(real, _frames[_vertex.blend_indices.z].real) < 0.0f
+    ? -_vertex.blend_weights.z : _vertex.blend_weights.z;
+  weights_[3] = dot(real, _frames[_vertex.blend_indices.w].real) < 0.0f
+    ? -_vertex.blend_weights.w : _vertex.blend_weights.w;
+}
+
+static inline void copy_attributes(const Loader::AnimatedVertex& _vertex,
+  Loader::Vertex& vertex_)
+{
+  vertex_.occlusion = _vertex.occlusion;
+  vertex_.tangent = _vertex.tangent;
+  vertex_.coordinate = _vertex.coordinate;
+}
+
+static void skin_vertex(const Loader::AnimatedVertex& _vertex,
+  const Math::DualQuatf* _frames, Loader::Vertex& vertex_)
+{
+  Float32 weights[4];
+  weights_of(_vertex, _frames, weights);
+
+  auto blend = _frames[_vertex.blend_indices.x] * weights[0]
+             + _frames[_vertex.blend_indices.y] * weights[1]
+             + _frames[_vertex.blend_indices.z] * weights[2]
+             + _frames[_vertex.blend_indices.w] * weights[3];
+  blend = blend * (1.0f / Math::sqrt(dot(blend.real, blend.real)));
+
+  const Math::Vec3f real{blend.real.x, blend.real.y, blend.real.z};
+  const Math::Vec3f dual{blend.dual.x, blend.dual.y, blend.dual.z};
+
+  const auto& point = _vertex.position;
+  const auto& normal = _vertex.normal;
+
+  vertex_.position = Math::cross(real, Math::cross(real, point)
+    + point * blend.real.w + dual) * 2.0f
+    + (dual * blend.real.w - real * blend.dual.w) * 2.0f + point;
+
+  vertex_.normal = Math::cross(real, Math::cross(real, normal)
+    + normal * blend.real.w) * 2.0f + normal;
+
+  copy_attributes(_vertex, vertex_);
+}
+
+#if defined(__SSE2__)
+// Three components of four vectors.
+struct Vec3x4 {
+  __m128 x, y, z;
+};
+
+static inline Vec3x4 cross(const Vec3x4& _a, const Vec3x4& _b) {
+  return {
+    _mm_sub_ps(_mm_mul_ps(_a.y, _b.z), _mm_mul_ps(_a.z, _b.y)),
+    _mm_sub_ps(_mm_mul_ps(_a.z, _b.x), _mm_mul_ps(_a.x, _b.z)),
+    _mm_sub_ps(_mm_mul_ps(_a.x, _b.y), _mm_mul_ps(_a.y, _b.x))
+  };
+}
+
+// The frames of four vertices are blended one vertex at a time, then
+// transposed so the rest is done for all four at once.
+static void skin_vertices(const Loader::AnimatedVertex* _vertices,
+  const Math::DualQuatf* _frames, Loader::Vertex* vertices_)
+{
+  __m128 real[4];
+  __m128 dual[4];
+  for (Size i = 0; i < 4; i++) {
+    const auto& vertex = _vertices[i];
+
+    Float32 weights[4];
+    weights_of(vertex, _frames, weights);
+
+    const Sint32 indices[4]{vertex.blend_indices.x, vertex.blend_indices.y,
+      vertex.blend_indices.z, vertex.blend_indices.w};
+
+    __m128 blend_real = _mm_setzero_ps();
+    __m128 blend_dual = _mm_setzero_ps();
+    for (Size j = 0; j < 4; j++) {
+      const auto& frame = _frames[indices[j]];
+      const auto weight = _mm_set1_ps(weights[j]);
+      blend_real = _mm_add_ps(blend_real,
+        _mm_mul_ps(_mm_loadu_ps(&frame.real.x), weight));
+      blend_dual = _mm_add_ps(blend_dual,
+        _mm_mul_ps(_mm_loadu_ps(&frame.dual.x), weight));
+    }
+
+    real[i] = blend_real;
+    dual[i] = blend_dual;
+  }
+
+  _MM_TRANSPOSE4_PS(real[0], real[1], real[2], real[3]);
+  _MM_TRANSPOSE4_PS(dual[0], dual[1], dual[2], dual[3]);
+
+  const auto length = _mm_sqrt_ps(_mm_add_ps(
+    _mm_add_ps(_mm_mul_ps(real[0], real[0]), _mm_mul_ps(real[1], real[1])),
+    _mm_add_ps(_mm_mul_ps(real[2], real[2]), _mm_mul_ps(real[3], real[3]))));
+  const auto scale = _mm_div_ps(_mm_set1_ps(1.0f), length);
+  for (Size i = 0; i < 4; i++) {
+    real[i] = _mm_mul_ps(real[i], scale);
+    dual[i] = _mm_mul_ps(dual[i], scale);
+  }
+
+  const Vec3x4 r{real[0], real[1], real[2]};
+  const Vec3x4 d{dual[0], dual[1], dual[2]};
+  const auto rw = real[3];
+  const auto dw = dual[3];
+  const auto two = _mm_set1_ps(2.0f);
+
+  const Vec3x4 p{
+    _mm_setr_ps(_vertices[0].position.x, _vertices[1].position.x, _vertices[2].position.x, _vertices[3].position.x),
+    _mm_setr_ps(_vertices[0].position.y, _vertices[1].position.y, _vertices[2].position.y, _vertices[3].position.y),
+    _mm_setr_ps(_vertices[0].position.z, _vertices[1].position.z, _vertices[2].position.z, _vertices[3].position.z)
+  };
+
+  const Vec3x4 n{
+    _mm_setr_ps(_vertices[0].normal.x, _vertices[1].normal.x, _vertices[2].normal.x, _vertices[3].normal.x),
+    _mm_setr_ps(_vertices[0].normal.y, _vertices[1].normal.y, _vertices[2].normal.y, _vertices[3].normal.y),
+    _mm_setr_ps(_vertices[0].normal.z, _vertices[1].normal.z, _vertices[2].normal.z, _vertices[3].normal.z)
+  };
+
+  // The position.
+  auto c = cross(r, p);
+  c.x = _mm_add_ps(_mm_add_ps(c.x, _mm_mul_ps(p.x, rw)), d.x);
+  c.y = _mm_add_ps(_mm_add_ps(c.y, _mm_mul_ps(p.y, rw)), d.y);
+  c.z = _mm_add_ps(_mm_add_ps(c.z, _mm_mul_ps(p.z, rw)), d.z);
+  c = cross(r, c);
+
+  Float32 position[3][4];
+  _mm_storeu_ps(position[0], _mm_add_ps(_mm_mul_ps(_mm_add_ps(c.x,
+    _mm_sub_ps(_mm_mul_ps(d.x, rw), _mm_mul_ps(r.x, dw))), two), p.x));
+  _mm_storeu_ps(position[1], _mm_add_ps(_mm_mul_ps(_mm_add_ps(c.y,
+    _mm_sub_ps(_mm_mul_ps(d.y, rw), _mm_mul_ps(r.y, dw))), two), p.y));
+  _mm_storeu_ps(position[2], _mm_add_ps(_mm_mul_ps(_mm_add_ps(c.z,
+    _mm_sub_ps(_mm_mul_ps(d.z, rw), _mm_mul_ps(r.z, dw))), two), p.z));
+
+  // The normal.
+  c = cross(r, n);
+  c.x = _mm_add_ps(c.x, _mm_mul_ps(n.x, rw));
+  c.y = _mm_add_ps(c.y, _mm_mul_ps(n.y, rw));
+  c.z = _mm_add_ps(c.z, _mm_mul_ps(n.z, rw));
+  c = cross(r, c);
+
+  Float32 normal[3][4];
+  _mm_storeu_ps(normal[0], _mm_add_ps(_mm_mul_ps(c.x, two), n.x));
+  _mm_storeu_ps(normal[1], _mm_add_ps(_mm_mul_ps(c.y, two), n.y));
+  _mm_storeu_ps(normal[2], _mm_add_ps(_mm_mul_ps(c.z, two), n.z));
+
+  for (Size i = 0; i < 4; i++) {
+    auto& vertex = vertices_[i];
+    vertex.position = {position[0][i], position[1][i], position[2][i]};
+    vertex.normal = {normal[0][i], normal[1][i], normal[2][i]};
+    copy_attributes(_vertices[i], vertex);
+  }
+}
+#endif
+
+void skin(const Loader::AnimatedVertex* _vertices, Size _count,
+  const Math::DualQuatf* _frames, Loader::Vertex* vertices_)
+{
+  Size i = 0;
+#if defined(__SSE2__)
+  for (; i + 4 <= _count; i += 4) {
+    skin_vertices(_vertices + i, _frames, vertices_ + i);
+  }
+#endif
+  for (; i < _count; i++) {
+    skin_vertex(_vertices[i], _frames, vertices_[i]);
+  }
+}
+
+} // namespace Rx::Model
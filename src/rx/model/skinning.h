@@ -0,0 +1,20 @@
+#ifndef RX_MODEL_SKINNING_H
+#define RX_MODEL_SKINNING_H
+#include "rx/model/loader.h"
+
+#include "rx/math/dual_quat.h"
+
+namespace Rx::Model {
+
+// Skins |_count| vertices of |_vertices| by the joint frames |_frames|,
+// writing vertices which need no further skinning to |vertices_|.
+//
+// This is the dual quaternion skinning of the geometry technique done on the
+// CPU, so the positions and normals match those skinned in the vertex shader
+// and the tangents are kept as they are.
+void skin(const Loader::AnimatedVertex* _vertices, Size _count,
+  const Math::DualQuatf* _frames, Loader::Vertex* vertices_);
+
+} // namespace Rx::Model
+
+#endif // RX_MODEL_SKINNING_H
@@ -1,117 +1,175 @@
 #include "rx/model/voxel.h"
 
-#include "rx/core/bitset.h"
+#include "rx/core/utility/bit.h"
+
+#include "rx/core/memory/zero.h"
 
 #include "rx/core/math/ceil.h"
 #include "rx/core/math/abs.h"
 
 #include "rx/core/algorithm/clamp.h"
-#include "rx/core/algorithm/saturate.h"
+#include "rx/core/algorithm/min.h"
+#include "rx/core/algorithm/max.h"
 
 #include "rx/core/concurrency/wait_group.h"
 #include "rx/core/concurrency/scheduler.h"
 #include "rx/core/concurrency/atomic.h"
 
-#include "rx/math/compare.h"
-#include "rx/math/mat3x3.h"
-#include "rx/math/plane.h"
-#include "rx/math/vec2.h"
 #include "rx/math/ray.h"
 
-namespace Rx::Model {
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-// Maximum distance to rasterize in [0, 1) range. A value close to 1.0 is ideal.
-static constexpr const auto RASTERIZE_MAX_DISTANCE = 0.7f;
+namespace Rx::Model {
 
-// Calculate the distance from point |_p| to a line segment [|_l0|, |_l1|].
-static Float32 line_segment_point_distance(const Math::Vec2f& _p,
-  const Math::Vec2f& _l0, const Math::Vec2f& _l1)
+// Voxels are binned and voxelized in bricks of BRICK_SIZE voxels on every
+// axis, the 4x4x4 words of a word of the first level above the voxels, so the
+// voxels of a brick are written by one task alone.
+static constexpr const Size BRICK_WORDS = 64;
+
+// Bounds the number of tasks binning triangles, each of which counts the
+// triangles of every brick.
+static constexpr const Size MAX_BINNING_TASKS = 256;
+
+// The number of separating axes of a triangle and a box.
+static constexpr const Size AXES = 13;
+
+// Triangle and box overlap by the separating axis theorem [Akenine-Moller
+// 2001]. In the space of the voxels, where voxels are boxes of unit size, a
+// triangle and a voxel overlap when the center of the voxel projected onto
+// each of the axes is within an interval depending only on the triangle, so
+// the intervals are found once for every triangle.
+struct Overlap {
+  Float32 axis[3][AXES]; // Components of every axis.
+  Float32 min[AXES];
+  Float32 max[AXES];
+};
+
+static void setup_overlap(const Math::Vec3f& _a, const Math::Vec3f& _b,
+  const Math::Vec3f& _c, Overlap& overlap_)
 {
-  const auto length = Math::squared_length(_l0 - _l1);
-  if (length == 0.0f) {
-    return Math::squared_length(_p - _l0);
-  }
+  Size n = 0;
+  const auto add = [&](const Math::Vec3f& _axis) {
+    const auto a = Math::dot(_axis, _a);
+    const auto b = Math::dot(_axis, _b);
+    const auto c = Math::dot(_axis, _c);
+    // The projected radius of a box of unit size.
+    const auto radius =
+      0.5f * (Math::abs(_axis.x) + Math::abs(_axis.y) + Math::abs(_axis.z));
+    overlap_.axis[0][n] = _axis.x;
+    overlap_.axis[1][n] = _axis.y;
+    overlap_.axis[2][n] = _axis.z;
+    overlap_.min[n] = Algorithm::min(a, b, c) - radius;
+    overlap_.max[n] = Algorithm::max(a, b, c) + radius;
+    n++;
+  };
 
-  const auto time =
-    ((_p.x - _l0.x) * (_l1.x - _l0.x) + (_p.y - _l0.y) * (_l1.y - _l0.y)) / length;
+  const Math::Vec3f edges[] = {_b - _a, _c - _b, _a - _c};
+  const Math::Vec3f units[] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
 
-  return Math::length(_p - (_l0 + Algorithm::saturate(time) * (_l1 - _l0)));
+  // The normals of the faces of the box, which are the bounds of the triangle,
+  // the normal of the triangle and the cross products of the edges of both.
+  // Axes of degenerate triangles which are zero never separate anything.
+  for (const auto& unit : units) {
+    add(unit);
+  }
+  add(Math::cross(edges[0], edges[1]));
+  for (const auto& edge : edges) {
+    for (const auto& unit : units) {
+      add(Math::cross(unit, edge));
+    }
+  }
 }
 
-// Checks if a point |_p| intersects the triangle |_t0, _t1, _t2|.
-static bool tri_point_intersect(const Math::Vec2f& _p, const Math::Vec2f& _t0,
-  const Math::Vec2f& _t1, const Math::Vec2f& _t2)
-{
-  const auto d1 = (_p.x - _t1.x) * (_t0.y - _t1.y) - (_t0.x - _t1.x) * (_p.y - _t1.y);
-  const auto d2 = (_p.x - _t2.x) * (_t1.y - _t2.y) - (_t1.x - _t2.x) * (_p.y - _t2.y);
-  const auto d3 = (_p.x - _t0.x) * (_t2.y - _t0.y) - (_t2.x - _t0.x) * (_p.y - _t0.y);
-
-  const auto has_neg = (d1 < 0.0f) || (d2 < 0.0f) || (d3 < 0.0f);
-  const auto has_pos = (d1 > 0.0f) || (d2 > 0.0f) || (d3 > 0.0f);
-
-  return !(has_neg && has_pos);
+// The word in a brick and the bit in that word of the voxel at |_x, _y, _z|.
+// Bricks start on a multiple of BRICK_SIZE voxels, so both are found from the
+// lowest bits of the voxel.
+static inline Size brick_word(Sint32 _x, Sint32 _y, Sint32 _z) {
+  return (((_x >> 2) & 3) << 4) | (((_y >> 2) & 3) << 2) | ((_z >> 2) & 3);
 }
 
-// Distance from point |_p| to triangle |_t0, _t1, _t2|.
-static Float32 tri_point_distance(const Math::Vec2f& _p, const Math::Vec2f& _t0,
-  const Math::Vec2f& _t1, const Math::Vec2f& _t2)
-{
-  if (tri_point_intersect(_p, _t0, _t1, _t2)) {
-    return 0.0f;
-  }
-
-  const auto a = line_segment_point_distance(_p, _t0, _t1);
-  const auto b = line_segment_point_distance(_p, _t1, _t2);
-  const auto c = line_segment_point_distance(_p, _t2, _t0);
-
-  return Algorithm::min(a, b, c);
+static inline Size brick_bit(Sint32 _x, Sint32 _y, Sint32 _z) {
+  return ((_x & 3) << 4) | ((_y & 3) << 2) | (_z & 3);
 }
 
-// Rasterizes triangle |_triangle| within the voxel space bounded by
-// [|_min, |_max|) into |plane_set| with voxel size |_voxel_size|.
-template<Size I, Size J>
-static void voxelize_in_plane(
-  const Math::Mat3x3f& _triangle,
-  const Math::Vec3z& _min,
-  const Math::Vec3z& _max,
-  const Math::Vec3z& _count,
-  const Math::Vec3f& _min_point,
-  Float32 _full_voxel_size,
-  Float32 _half_voxel_size,
-  Bitset& plane_set_)
+// Sets the bit in |words_| of every voxel in [|_min|, |_max|] of a brick
+// overlapping the triangle of |_overlap|. The voxels of a word along the z
+// axis are tested together, four at a time with SIMD when available.
+static void voxelize_brick(const Overlap& _overlap, const Sint32 (&_min)[3],
+  const Sint32 (&_max)[3], Sint32 _count_z, Uint64* words_)
 {
-  const auto x = _min_point[I];
-  const auto y = _min_point[J];
-
-  const auto t0x = _triangle.x[I];
-  const auto t1x = _triangle.y[I];
-  const auto t2x = _triangle.z[I];
-
-  const auto t0y = _triangle.x[J];
-  const auto t1y = _triangle.y[J];
-  const auto t2y = _triangle.z[J];
-
-  for (auto i = _min[I]; i <= _max[I]; i++) {
-    for (auto j = _min[J]; j <= _max[J]; j++) {
-      const auto index =
-        (i - _min[I]) * _count[J] + (j - _min[J]);
+#if defined(__SSE2__)
+  __m128 axis_z[AXES];
+  __m128 min[AXES];
+  __m128 max[AXES];
+  for (Size i = 0; i < AXES; i++) {
+    // Projections of voxels one after another along the z axis.
+    axis_z[i] = _mm_mul_ps(_mm_set1_ps(_overlap.axis[2][i]),
+      _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+    min[i] = _mm_set1_ps(_overlap.min[i]);
+    max[i] = _mm_set1_ps(_overlap.max[i]);
+  }
+#endif
+
+  const auto k_begin = _min[2] & ~3;
+  for (Sint32 i = _min[0]; i <= _max[0]; i++) {
+    for (Sint32 j = _min[1]; j <= _max[1]; j++) {
+      for (Sint32 k = k_begin; k <= _max[2]; k += 4) {
+        // Voxels beyond the last on the z axis are in the last word.
+        const auto lanes = Algorithm::min(_count_z - k, 4);
+
+        const auto x = Float32(i) + 0.5f;
+        const auto y = Float32(j) + 0.5f;
+        const auto z = Float32(k) + 0.5f;
+
+#if defined(__SSE2__)
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (Size a = 0; a < AXES; a++) {
+          const auto base = _overlap.axis[0][a] * x
+            + _overlap.axis[1][a] * y + _overlap.axis[2][a] * z;
+          const auto projection = _mm_add_ps(_mm_set1_ps(base), axis_z[a]);
+          inside = _mm_and_ps(inside, _mm_cmpge_ps(projection, min[a]));
+          inside = _mm_and_ps(inside, _mm_cmple_ps(projection, max[a]));
+        }
+        const auto mask = Uint64(_mm_movemask_ps(inside)) & ((1_u64 << lanes) - 1);
+#else
+        Uint64 mask = 0;
+        for (Sint32 lane = 0; lane < lanes; lane++) {
+          bool inside = true;
+          for (Size a = 0; a < AXES && inside; a++) {
+            const auto projection = _overlap.axis[0][a] * x
+              + _overlap.axis[1][a] * y + _overlap.axis[2][a] * (z + Float32(lane));
+            inside = projection >= _overlap.min[a] && projection <= _overlap.max[a];
+          }
+          mask |= Uint64(inside) << lane;
+        }
+#endif
 
-      // Don't bother performing the intersection test if there's a voxel already
-      // occuping on this plane set.
-      if (plane_set_.test(index)) {
-        continue;
+        if (mask) {
+          words_[brick_word(i, j, k)] |= mask << brick_bit(i, j, k);
+        }
       }
+    }
+  }
+}
 
-      const Math::Vec2f center = {
-        x + (i * _full_voxel_size + _half_voxel_size),
-        y + (j * _full_voxel_size + _half_voxel_size)
-      };
-
-      if (tri_point_distance(center, {t0x, t0y}, {t1x, t1y}, {t2x, t2y}) < _full_voxel_size * RASTERIZE_MAX_DISTANCE) {
-        plane_set_.set(index);
-      }
+// Runs |_function(task)| for every task in [0, |_tasks|) on |_scheduler|,
+// on this thread when the scheduler cannot take it.
+template<typename F>
+static void run_tasks(Concurrency::Scheduler& _scheduler, Size _tasks, F&& _function) {
+  Concurrency::WaitGroup group{_tasks};
+  for (Size task = 0; task < _tasks; task++) {
+    const bool added = _scheduler.add([&, task](Sint32) {
+      _function(task);
+      group.signal();
+    });
+    if (!added) {
+      _function(task);
+      group.signal();
     }
   }
+  group.wait();
 }
 
 Optional<Voxel> Voxel::create(Concurrency::Scheduler& _scheduler,
@@ -123,11 +181,16 @@ Optional<Voxel> Voxel::create(Concurrency::Scheduler& _scheduler,
 
   const auto full_voxel_size = corner_to_corner.max_element() / static_cast<Float32>(_max_voxels);
   const auto half_voxel_size = full_voxel_size * 0.5f;
+  const auto inv_voxel_size = 1.0f / full_voxel_size;
 
+  // Flat geometry is still a voxel thick.
   const auto voxel_count = (corner_to_corner / full_voxel_size)
-    .map([](Float32 _value) { return Math::ceil(_value); })
+    .map([](Float32 _value) { return Algorithm::max(Math::ceil(_value), 1.0f); })
     .cast<Size>();
 
+  const auto brick_count = voxel_count
+    .map([](Size _value) { return (_value + BRICK_SIZE - 1) / BRICK_SIZE; });
+
   const auto& min = _aabb.min();
 
   const Math::AABB bounds = {
@@ -135,234 +198,653 @@ Optional<Voxel> Voxel::create(Concurrency::Scheduler& _scheduler,
     min + voxel_count.cast<Float32>() * full_voxel_size
   };
 
-  Vector<Concurrency::Atomic<Uint8>> matrix;
-  if (!matrix.resize(voxel_count.area())) {
-    return nullopt;
-  }
-
-  // Zero initialize since Atomic<Uint8> has no zero initialization.
-  matrix.each_fwd([](auto& atomic_) { atomic_.store(0); });
+  const Sint32 count[3] = {
+    Sint32(voxel_count.x),
+    Sint32(voxel_count.y),
+    Sint32(voxel_count.z)
+  };
 
   const auto n_triangles = _elements.size() / 3;
+  const auto n_bricks = brick_count.area();
+
+  // Triangles in the space of the voxels.
+  const auto vertex = [&](Size _triangle, Size _index) {
+    return (_positions[_elements[_triangle * 3 + _index]] - min) * inv_voxel_size;
+  };
+
+  // The voxels, or bricks, in the bounds of |_triangle|.
+  const auto range = [&](Size _triangle, Sint32 _shift, Sint32 (&min_)[3], Sint32 (&max_)[3]) {
+    const auto a = vertex(_triangle, 0);
+    const auto b = vertex(_triangle, 1);
+    const auto c = vertex(_triangle, 2);
+    for (Size i = 0; i < 3; i++) {
+      const auto lo = Algorithm::min(a[i], b[i], c[i]);
+      const auto hi = Algorithm::max(a[i], b[i], c[i]);
+      min_[i] = Algorithm::clamp(Sint32(lo), 0, count[i] - 1) >> _shift;
+      max_[i] = Algorithm::clamp(Sint32(hi), 0, count[i] - 1) >> _shift;
+    }
+  };
 
+  const auto brick_index = [&](Sint32 _x, Sint32 _y, Sint32 _z) {
+    return (Size(_x) * brick_count.y + Size(_y)) * brick_count.z + Size(_z);
+  };
+
+  // Every task bins a range of the triangles by the bricks they're in.
   if (_triangles_per_task == 0) {
-    _triangles_per_task = n_triangles / _scheduler.total_threads();
+    _triangles_per_task =
+      Algorithm::max(n_triangles / _scheduler.total_threads(), 1_z);
   }
-
-  const auto n_tasks = n_triangles / _triangles_per_task;
-
-  // Kernel function called for a given triangle index.
-  const auto kernel = [&](Size _triangle) {
-    // Read three vertices of the triangle |_triangle|.
-    const auto& a = _positions[_elements[_triangle * 3 + 0]];
-    const auto& b = _positions[_elements[_triangle * 3 + 1]];
-    const auto& c = _positions[_elements[_triangle * 3 + 2]];
-
-    // Calculate facet normal of triangle.
-    const auto normal = Math::cross(b - a, c - a);
-
-    // Calculate axis-aligned bounding-box of the triangle.
-    Math::AABB bb;
-    bb.expand(a);
-    bb.expand(b);
-    bb.expand(c);
-
-    const auto& min_coord = ((bb.min() - min) / full_voxel_size).cast<Sint32>();
-    const auto& max_coord = ((bb.max() - min) / full_voxel_size).cast<Sint32>();
-
-    // Determine the minimum and maximum coordinates in voxel-space, bounding
-    // the triangle's axis-aligned bounding-box, this is the area that will be
-    // rastized to.
-    const Math::Vec3z min_coords = {
-      Size(Algorithm::clamp(min_coord.x, 0, Sint32(voxel_count.x - 1))),
-      Size(Algorithm::clamp(min_coord.y, 0, Sint32(voxel_count.y - 1))),
-      Size(Algorithm::clamp(min_coord.z, 0, Sint32(voxel_count.z - 1)))
-    };
-
-    const Math::Vec3z max_coords = {
-      Size(Algorithm::clamp(max_coord.x, 0, Sint32(voxel_count.x - 1))),
-      Size(Algorithm::clamp(max_coord.y, 0, Sint32(voxel_count.y - 1))),
-      Size(Algorithm::clamp(max_coord.z, 0, Sint32(voxel_count.z - 1)))
-    };
-
-    const auto count = max_coords - min_coords + 1_z;
-
-    // Create 3x planes representing "two dimensional" voxel-space in the x-y,
-    // x-z, and z-y planes. This separable approach to filling voxel space
-    // reduces a lot of duplicate work and is more cache-efficient.
-    auto xy_mat = Bitset::create(_allocator, count.x * count.y);
-    auto xz_mat = Bitset::create(_allocator, count.x * count.z);
-    auto zy_mat = Bitset::create(_allocator, count.z * count.y);
-
-    // Out of memory.
-    if (RX_HINT_UNLIKELY(!xy_mat || !xz_mat || !zy_mat)) {
-       return false;
-     }
-
-    // Render the voxels for triangle |_triangle| in each plane.
-    const Math::Mat3x3f triangle{a, b, c};
-    voxelize_in_plane<0, 1>(triangle, min_coords, max_coords, count, min,
-      full_voxel_size, half_voxel_size, *xy_mat);
-    voxelize_in_plane<0, 2>(triangle, min_coords, max_coords, count, min,
-      full_voxel_size, half_voxel_size, *xz_mat);
-    voxelize_in_plane<2, 1>(triangle, min_coords, max_coords, count, min,
-      full_voxel_size, half_voxel_size, *zy_mat);
-
-    // Look at each individual plane separately, if a voxel is in all three
-    // planes and the plane formed by the triangle is not too far away from
-    // center of the voxel, then reasterize it into the 3D volume.
-    for (Size i = min_coords.x; i <= max_coords.x; i++) {
-      const auto ix = i - min_coords.x;
-
-      for (Size j = min_coords.y; j <= max_coords.y; j++) {
-        const auto jy = j - min_coords.y;
-
-        for (Size k = min_coords.z; k <= max_coords.z; k++) {
-          const auto kz = k - min_coords.z;
-
-          const auto center = min
-            + Math::Vec3z(i, j, k).cast<Float32>() * full_voxel_size
-            + half_voxel_size;
-
-          const auto index =
-            i * voxel_count.y * voxel_count.z + j * voxel_count.z + k;
-
-          // Check plane distance first to avoid testing the planes, as those
-          // tests have an associated decode cost.
-          const auto plane = Math::Plane{normal, center - a};
-          const auto hit =
-            Math::abs(plane.distance()) < full_voxel_size * RASTERIZE_MAX_DISTANCE
-              && xy_mat->test(ix * count.y + jy)
-              && xz_mat->test(ix * count.z + kz)
-              && zy_mat->test(kz * count.y + jy);
-
-          // Note that the voxelization is threaded in terms of triangles per
-          // task, overlapping triangles or shared-edge triangles can trample
-          // each other when building the volume, use atomic fetch_or here.
-          matrix[index].fetch_or(hit);
+  _triangles_per_task = Algorithm::max(_triangles_per_task,
+    (n_triangles + MAX_BINNING_TASKS - 1) / MAX_BINNING_TASKS);
+
+  const auto n_tasks =
+    Algorithm::max((n_triangles + _triangles_per_task - 1) / _triangles_per_task, 1_z);
+
+  const auto bin = [&](Size _task, auto&& _function) {
+    const auto begin = _task * _triangles_per_task;
+    const auto end = Algorithm::min(begin + _triangles_per_task, n_triangles);
+    for (Size triangle = begin; triangle < end; triangle++) {
+      Sint32 lo[3], hi[3];
+      range(triangle, BRICK_SHIFT, lo, hi);
+      for (Sint32 i = lo[0]; i <= hi[0]; i++) {
+        for (Sint32 j = lo[1]; j <= hi[1]; j++) {
+          for (Sint32 k = lo[2]; k <= hi[2]; k++) {
+            _function(brick_index(i, j, k), triangle);
+          }
         }
       }
     }
-    return true;
   };
 
-  // Schedule |n_tasks| tasks on |_scheduler|.
-  Concurrency::WaitGroup group{n_tasks};
-  Concurrency::Atomic<Size> success = 0;
-  for (Size task = 0; task < n_tasks; task++) {
-    auto voxelize_triangles = [&, task](Sint32) {
-      for (Size triangle = 0; triangle < _triangles_per_task; triangle++) {
-        if (RX_HINT_UNLIKELY(!kernel(task * _triangles_per_task + triangle))) {
-          group.signal();
-          return;
-        }
-      }
-      success++;
-      group.signal();
-    };
+  // The triangles of every brick are counted by each task, then written in
+  // the order of the tasks so the order does not depend on the scheduler.
+  Vector<Uint32> offsets{_allocator};
+  if (!offsets.resize(n_tasks * n_bricks, 0)) {
+    return nullopt;
+  }
+
+  run_tasks(_scheduler, n_tasks, [&](Size _task) {
+    const auto counts = offsets.data() + _task * n_bricks;
+    bin(_task, [&](Size _brick, Size) { counts[_brick]++; });
+  });
+
+  // The first reference of every brick and the bricks with any.
+  Vector<Uint32> first{_allocator};
+  Vector<Uint32> binned{_allocator};
+  if (!first.resize(n_bricks + 1)) {
+    return nullopt;
+  }
 
-    if (RX_HINT_UNLIKELY(!_scheduler.add(voxelize_triangles))) {
+  Uint32 n_references = 0;
+  for (Size brick = 0; brick < n_bricks; brick++) {
+    first[brick] = n_references;
+    for (Size task = 0; task < n_tasks; task++) {
+      const auto count = offsets[task * n_bricks + brick];
+      offsets[task * n_bricks + brick] = n_references;
+      n_references += count;
+    }
+    if (n_references != first[brick] && !binned.push_back(Uint32(brick))) {
       return nullopt;
     }
   }
+  first[n_bricks] = n_references;
 
-  // Handle remainder triangles here.
-  for (Size triangle = n_tasks * _triangles_per_task; triangle < n_triangles; triangle++) {
-    kernel(triangle);
+  Vector<Uint32> references{_allocator};
+  if (!references.resize(n_references)) {
+    return nullopt;
   }
 
-  // Wait for all the tasks to complete.
-  group.wait();
+  run_tasks(_scheduler, n_tasks, [&](Size _task) {
+    const auto next = offsets.data() + _task * n_bricks;
+    bin(_task, [&](Size _brick, Size _triangle) {
+      references[next[_brick]++] = Uint32(_triangle);
+    });
+  });
+
+  // Every brick with triangles is voxelized on its own, tasks taking the next
+  // brick until there are none left.
+  const auto n_binned = binned.size();
+  Vector<Brick> bricks{_allocator};
+  if (!bricks.resize(n_binned)) {
+    return nullopt;
+  }
+
+  Concurrency::Atomic<Size> next_brick = 0;
+  const auto n_voxelize_tasks =
+    Algorithm::min(_scheduler.total_threads(), n_binned);
+  run_tasks(_scheduler, n_voxelize_tasks, [&](Size) {
+    Overlap overlap;
+    for (Size slot = next_brick++; slot < n_binned; slot = next_brick++) {
+      const auto index = binned[slot];
+      auto& brick = bricks[slot];
+      Memory::zero(brick.words);
+
+      const Sint32 origin[3] = {
+        Sint32(index / (brick_count.y * brick_count.z)) << BRICK_SHIFT,
+        Sint32(index / brick_count.z % brick_count.y) << BRICK_SHIFT,
+        Sint32(index % brick_count.z) << BRICK_SHIFT
+      };
+
+      for (Uint32 i = first[index]; i < first[index + 1]; i++) {
+        const auto triangle = references[i];
+
+        Sint32 lo[3], hi[3];
+        range(triangle, 0, lo, hi);
+
+        // Triangles in the bounds of a single voxel are in it, which is most
+        // of the triangles of dense meshes.
+        if (lo[0] == hi[0] && lo[1] == hi[1] && lo[2] == hi[2]) {
+          brick.words[brick_word(lo[0], lo[1], lo[2])] |=
+            1_u64 << brick_bit(lo[0], lo[1], lo[2]);
+          continue;
+        }
+
+        // Clip the voxels of the triangle to the brick.
+        for (Size axis = 0; axis < 3; axis++) {
+          lo[axis] = Algorithm::max(lo[axis], origin[axis]);
+          hi[axis] = Algorithm::min(hi[axis], origin[axis] + Sint32(BRICK_SIZE) - 1);
+        }
+
+        setup_overlap(vertex(triangle, 0), vertex(triangle, 1),
+          vertex(triangle, 2), overlap);
+        voxelize_brick(overlap, lo, hi, count[2], brick.words);
+      }
+    }
+  });
+
+  // Bricks without any solid voxel are not kept.
+  Vector<Uint32> brick_map{_allocator};
+  if (!brick_map.resize(n_bricks, -1_u32)) {
+    return nullopt;
+  }
+
+  Size n_solid = 0;
+  for (Size slot = 0; slot < n_binned; slot++) {
+    const auto& brick = bricks[slot];
+    bool solid = false;
+    for (Size i = 0; i < BRICK_WORDS; i++) {
+      solid |= brick.words[i] != 0;
+    }
+    if (solid) {
+      brick_map[binned[slot]] = Uint32(n_solid);
+      bricks[n_solid++] = brick;
+    }
+  }
+
+  if (!bricks.resize(n_solid)) {
+    return nullopt;
+  }
 
-  // When not all of them were successful, we ran out of memory.
-  if (RX_HINT_UNLIKELY(success != n_tasks)) {
+  // Copy the words of the bricks into the dense words, then the words into
+  // the levels above.
+  Level levels[LEVELS];
+  Vector<Uint64> words{_allocator};
+  if (!words.resize(layout(voxel_count, levels), 0)) {
     return nullopt;
   }
 
-  // Here we just disown the contents into a Vector<Uint8> since we no longer
-  // require it to be atomic.
+  for (Size x = 0; x < brick_count.x; x++) {
+    for (Size y = 0; y < brick_count.y; y++) {
+      for (Size z = 0; z < brick_count.z; z++) {
+        const auto slot = brick_map[brick_index(x, y, z)];
+        if (slot == -1_u32) {
+          continue;
+        }
+        const auto& brick = bricks[slot];
+        for (Size i = 0; i < BRICK_WORDS; i++) {
+          if (brick.words[i]) {
+            // The words of a brick are ordered like the bits of a word.
+            const auto wx = (x << 2) | (i >> 4);
+            const auto wy = (y << 2) | ((i >> 2) & 3);
+            const auto wz = (z << 2) | (i & 3);
+            words[word_index(levels[0], wx, wy, wz)] = brick.words[i];
+          }
+        }
+      }
+    }
+  }
+
+  for (Size level = 1; level < LEVELS; level++) {
+    const auto& below = levels[level - 1];
+    for (Size i = 0; i < below.count.x; i++) {
+      for (Size j = 0; j < below.count.y; j++) {
+        for (Size k = 0; k < below.count.z; k++) {
+          if (words[word_index(below, i, j, k)]) {
+            words[word_index(levels[level], i >> 2, j >> 2, k >> 2)] |=
+              1_u64 << bit_index(i, j, k);
+          }
+        }
+      }
+    }
+  }
+
   return Voxel {
     bounds,
     voxel_count,
     full_voxel_size,
     half_voxel_size,
-    { matrix.disown() }
+    Utility::move(words),
+    Utility::move(brick_map),
+    Utility::move(bricks)
   };
 }
 
-// Implementation of DDA ray cast as outlined in
-//  https://www.researchgate.net/publication/2611491_A_Fast_Voxel_Traversal_Algorithm_for_Ray_Tracing
-//
-// TODO(dweiler): Improve coherency of casted rays as solid / non-solid branch is dominating factor.
-Optional<Float32> Voxel::ray_cast(const Math::Ray& _ray) const {
-  const auto step = _ray.direction()
-    .map([](Float32 _value) { return _value > 0.0f ? 1.0f : -1.0f; })
-    .cast<Sint32>();
+Voxel::Voxel(const Math::AABB& _bounds, const Math::Vec3z& _voxel_count,
+  Float32 _full_voxel_size, Float32 _half_voxel_size, Vector<Uint64>&& words_,
+  Vector<Uint32>&& brick_map_, Vector<Brick>&& bricks_)
+  : m_bounds{_bounds}
+  , m_voxel_count{_voxel_count}
+  , m_full_voxel_size{_full_voxel_size}
+  , m_half_voxel_size{_half_voxel_size}
+  , m_words{Utility::move(words_)}
+  , m_brick_map{Utility::move(brick_map_)}
+  , m_bricks{Utility::move(bricks_)}
+{
+  layout(m_voxel_count, m_levels);
+}
+
+Size Voxel::layout(const Math::Vec3z& _voxel_count, Level (&levels_)[LEVELS]) {
+  auto count = _voxel_count;
+  Size offset = 0;
+  for (Size i = 0; i < LEVELS; i++) {
+    count = count.map([](Size _value) { return (_value + 3) / 4; });
+    levels_[i] = {count, offset};
+    offset += count.area();
+  }
+  return offset;
+}
 
-  const auto count = m_voxel_count - 1_z;
+Sint32 Voxel::empty_cell(Sint32 _x, Sint32 _y, Sint32 _z) const {
+  // A word of a level which is zero is an empty cell of the next level.
+  const auto words = m_words.data();
+  for (Size i = 1; i < LEVELS; i++) {
+    const auto shift = 2 * (i + 1);
+    if (words[word_index(m_levels[i], _x >> shift, _y >> shift, _z >> shift)]) {
+      return 2 * i;
+    }
+  }
+  return 2 * LEVELS;
+}
 
-  Math::Vec3z voxel;
-  if (m_bounds.is_point_inside(_ray.point())) {
-    voxel = ((_ray.point() - m_bounds.min()) / m_full_voxel_size).cast<Size>();
+// Time to boundaries on axes rays do not move along.
+static constexpr const auto NEVER = 3.0e38f;
+
+// The state of a ray marching through the voxels.
+struct Traversal {
+  Sint32 voxel[3];
+  Float32 time[3];  // Time to the next boundary on every axis.
+  Float32 delta[3]; // Time to cross a voxel on every axis.
+  Float32 rate[3];  // Voxels crossed on every axis per unit of time.
+  Sint32 step[3];   // Direction of the ray on every axis, either 1 or -1.
+};
+
+// Finds the voxel |_ray| starts in, or enters the voxels at.
+static bool enter(const Math::AABB& _bounds, const Math::Vec3z& _count,
+  Float32 _voxel_size, const Math::Ray& _ray, Traversal& traversal_)
+{
+  Math::Vec3f point;
+  if (_bounds.is_point_inside(_ray.point())) {
+    point = _ray.point();
+  } else if (auto intersect = _bounds.ray_intersect(_ray)) {
+    point = *intersect;
   } else {
-    if (auto point = m_bounds.ray_intersect(_ray)) {
-      const auto indices = ((*point - m_bounds.min()) / m_full_voxel_size).cast<Size>();
-      // Clamp the indices so they do not go out of bounds.
-      voxel.x = Algorithm::min(indices.x, count.x);
-      voxel.y = Algorithm::min(indices.y, count.y);
-      voxel.z = Algorithm::min(indices.z, count.z);
+    return false;
+  }
+
+  const auto voxel = ((point - _bounds.min()) / _voxel_size).cast<Size>();
+  for (Size i = 0; i < 3; i++) {
+    // Clamp the indices so they do not go out of bounds.
+    const auto index = Algorithm::min(voxel[i], _count[i] - 1);
+    const auto direction = _ray.direction()[i];
+    const auto positive = direction > 0.0f;
+    traversal_.voxel[i] = Sint32(index);
+    traversal_.step[i] = positive ? 1 : -1;
+    if (direction != 0.0f) {
+      const auto boundary = _bounds.min()[i] + _voxel_size * Float32(index + positive);
+      traversal_.time[i] = (boundary - _ray.point()[i]) / direction;
+      traversal_.delta[i] = Math::abs(_voxel_size / direction);
+      traversal_.rate[i] = Math::abs(direction / _voxel_size);
     } else {
-      return nullopt;
+      traversal_.time[i] = NEVER;
+      traversal_.delta[i] = NEVER;
+      traversal_.rate[i] = 0.0f;
+    }
+  }
+
+  return true;
+}
+
+// Moves |traversal_| out of the empty cell of 1 << |_shift| voxels it's in,
+// stepping every axis over the voxels the ray crosses in the cell. Returns
+// false when it leaves the voxels, which may be inside of a cell as cells are
+// not clipped.
+static bool advance(Traversal& traversal_, Sint32 _shift, const Sint32 (&_count)[3]) {
+  auto& voxel = traversal_.voxel;
+  auto& time = traversal_.time;
+  const auto& delta = traversal_.delta;
+  const auto& step = traversal_.step;
+
+  // The voxels left in the cell on every axis and when the ray leaves it.
+  const Sint32 size = 1 << _shift;
+  Sint32 steps[3];
+  Float32 exits[3];
+  for (Size i = 0; i < 3; i++) {
+    const auto lo = voxel[i] & ~(size - 1);
+    steps[i] = step[i] > 0 ? lo + size - 1 - voxel[i] : voxel[i] - lo;
+    exits[i] = time[i] + delta[i] * Float32(steps[i]);
+  }
+
+  const Size axis = exits[0] < exits[1]
+    ? (exits[0] < exits[2] ? 0 : 2)
+    : (exits[1] < exits[2] ? 1 : 2);
+
+  const auto exit = exits[axis];
+
+  bool inside = true;
+  for (Size i = 0; i < 3; i++) {
+    Sint32 crossed;
+    if (i == axis) {
+      crossed = steps[i] + 1;
+      time[i] = exits[i] + delta[i];
+    } else {
+      crossed = time[i] < exit
+        ? Algorithm::min(Sint32((exit - time[i]) * traversal_.rate[i]) + 1, steps[i])
+        : 0;
+      time[i] += delta[i] * Float32(crossed);
     }
+    voxel[i] += step[i] * crossed;
+    inside &= Uint32(voxel[i]) < Uint32(_count[i]);
+  }
+
+  return inside;
+}
+
+// Implementation of DDA ray cast as outlined in
+//  https://www.researchgate.net/publication/2611491_A_Fast_Voxel_Traversal_Algorithm_for_Ray_Tracing
+//
+// Empty cells of the levels above the voxels are skipped in one step.
+Optional<Float32> Voxel::ray_cast(const Math::Ray& _ray) const {
+  Traversal traversal;
+  if (!enter(m_bounds, m_voxel_count, m_full_voxel_size, _ray, traversal)) {
+    return nullopt;
   }
 
-  const auto center = voxel_origin(voxel);
-  const auto next_boundaries = center + step.cast<Float32>() * m_half_voxel_size;
-  const auto delta = (m_full_voxel_size / _ray.direction())
-    .map([](Float32 _value) { return Math::abs(_value); });
+  const Sint32 count[3] = {
+    Sint32(m_voxel_count.x),
+    Sint32(m_voxel_count.y),
+    Sint32(m_voxel_count.z)
+  };
+
+  const auto& voxel = traversal.voxel;
+  const auto& level = m_levels[0];
+  const auto words = m_words.data();
+
+  // The word of the voxels the traversal is in, only loaded again when the
+  // traversal leaves them.
+  const auto load = [&] {
+    return words[word_index(level, voxel[0] >> 2, voxel[1] >> 2, voxel[2] >> 2)];
+  };
 
   // March through the voxel scene.
   auto in_air = false;
-  auto max = (next_boundaries - _ray.point()) / _ray.direction();
+  auto shift = 0;
+  auto word = load();
   for (;;) {
-    if (max.x < max.y) {
-      if (max.x < max.z) {
-        if ((voxel.x += step.x) > count.x) {
-          return nullopt;
-        }
-        max.x += delta.x;
-      } else {
-        if ((voxel.z += step.z) > count.z) {
-          return nullopt;
-        }
-        max.z += delta.z;
+    if (shift == 0) {
+      auto& time = traversal.time;
+      const Size axis = time[0] < time[1]
+        ? (time[0] < time[2] ? 0 : 2)
+        : (time[1] < time[2] ? 1 : 2);
+      const auto step = traversal.step[axis];
+      const auto index = traversal.voxel[axis] += step;
+      if (Uint32(index) >= Uint32(count[axis])) {
+        return nullopt;
       }
+      // Entered the next word of voxels when the step wraps the low bits.
+      if (((index - (step >> 1)) & 3) == 0) {
+        word = load();
+      }
+      time[axis] += traversal.delta[axis];
     } else {
-      if (max.y < max.z) {
-        if ((voxel.y += step.y) > count.y) {
-          return nullopt;
-        }
-        max.y += delta.y;
-      } else {
-        if ((voxel.z += step.z) > count.z) {
-          return nullopt;
-        }
-        max.z += delta.z;
+      if (!advance(traversal, shift, count)) {
+        return nullopt;
       }
+      word = load();
     }
 
-    const auto index =
-      voxel.x * m_voxel_count.y * m_voxel_count.z + voxel.y * m_voxel_count.z + voxel.z;
-
-    if (!m_voxels[index] && !in_air) {
+    if (word & (1_u64 << bit_index(voxel[0], voxel[1], voxel[2]))) {
+      if (in_air) {
+        // Distance to origin of voxel, not a corner point.
+        return Math::length(_ray.point() - voxel_origin({Size(voxel[0]), Size(voxel[1]), Size(voxel[2])}));
+      }
+      shift = 0;
+    } else {
       in_air = true;
+      shift = word ? 0 : empty_cell(voxel[0], voxel[1], voxel[2]);
+    }
+  }
+}
+
+void Voxel::ray_cast(const Math::Ray* _rays, Size _count, Optional<Float32>* results_) const {
+#if defined(__SSE2__)
+  if (_count >= PACKET_SIZE) {
+    ray_cast_packets(_rays, _count, results_);
+    return;
+  }
+#endif
+  for (Size i = 0; i < _count; i++) {
+    results_[i] = ray_cast(_rays[i]);
+  }
+}
+
+#if defined(__SSE2__)
+static inline __m128i select(__m128i _mask, __m128i _a, __m128i _b) {
+  return _mm_or_si128(_mm_and_si128(_mask, _a), _mm_andnot_si128(_mask, _b));
+}
+
+static inline __m128 select(__m128 _mask, __m128 _a, __m128 _b) {
+  return _mm_or_ps(_mm_and_ps(_mask, _a), _mm_andnot_ps(_mask, _b));
+}
+
+// Masks of the axis with the smallest of |_values| in every lane, breaking
+// ties the same way as the scalar traversal.
+static inline void minimum(const __m128 (&_values)[3], __m128 (&axes_)[3]) {
+  const auto x_lt_y = _mm_cmplt_ps(_values[0], _values[1]);
+  const auto x_lt_z = _mm_cmplt_ps(_values[0], _values[2]);
+  const auto y_lt_z = _mm_cmplt_ps(_values[1], _values[2]);
+  axes_[0] = _mm_and_ps(x_lt_y, x_lt_z);
+  axes_[1] = _mm_andnot_ps(x_lt_y, y_lt_z);
+  axes_[2] = _mm_andnot_ps(_mm_or_ps(axes_[0], axes_[1]), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+}
+
+// Every lane of the packet runs its own traversal, doing the same arithmetic
+// as |advance| four at a time. Only the lookups of the voxels are per lane.
+// When the ray of a lane finishes the lane is refilled with the next ray, so
+// lanes are not left idle waiting on the longest ray of the packet.
+void Voxel::ray_cast_packets(const Math::Ray* _rays, Size _count, Optional<Float32>* results_) const {
+  alignas(16) Sint32 voxel[3][PACKET_SIZE];
+  alignas(16) Float32 time[3][PACKET_SIZE];
+  alignas(16) Float32 delta[3][PACKET_SIZE];
+  alignas(16) Float32 rate[3][PACKET_SIZE];
+  alignas(16) Sint32 positive[3][PACKET_SIZE];
+  alignas(16) Sint32 sizes[PACKET_SIZE];
+  Size rays[PACKET_SIZE];
+
+  const auto words = m_words.data();
+  const auto& level = m_levels[0];
+
+  // Fills |_lane| with the next ray which enters the voxels.
+  Size next = 0;
+  Uint32 active = 0;
+  Uint32 in_air = 0;
+  const auto fill = [&](Size _lane) {
+    for (; next < _count; next++) {
+      Traversal traversal;
+      if (!enter(m_bounds, m_voxel_count, m_full_voxel_size, _rays[next], traversal)) {
+        results_[next] = nullopt;
+        continue;
+      }
+      for (Size i = 0; i < 3; i++) {
+        voxel[i][_lane] = traversal.voxel[i];
+        time[i][_lane] = traversal.time[i];
+        delta[i][_lane] = traversal.delta[i];
+        rate[i][_lane] = traversal.rate[i];
+        positive[i][_lane] = traversal.step[i] > 0 ? -1 : 0;
+      }
+      sizes[_lane] = 1;
+      rays[_lane] = next++;
+      active |= 1 << _lane;
+      in_air &= ~(1 << _lane);
+      return;
+    }
+
+    // No rays left, the lane is still stepped, harmlessly.
+    for (Size i = 0; i < 3; i++) {
+      voxel[i][_lane] = 0;
+      time[i][_lane] = 1.0f;
+      delta[i][_lane] = 1.0f;
+      rate[i][_lane] = 1.0f;
+      positive[i][_lane] = -1;
+    }
+    sizes[_lane] = 1;
+    active &= ~(1 << _lane);
+  };
+
+  for (Size lane = 0; lane < PACKET_SIZE; lane++) {
+    fill(lane);
+  }
+
+  __m128i v[3], s[3], pos[3], last[3];
+  __m128 t[3], d[3], r[3];
+  const auto load = [&] {
+    for (Size i = 0; i < 3; i++) {
+      v[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(voxel[i]));
+      pos[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(positive[i]));
+      s[i] = _mm_sub_epi32(_mm_and_si128(pos[i], _mm_set1_epi32(2)), _mm_set1_epi32(1));
+      t[i] = _mm_load_ps(time[i]);
+      d[i] = _mm_load_ps(delta[i]);
+      r[i] = _mm_load_ps(rate[i]);
+    }
+  };
+
+  const auto store = [&] {
+    for (Size i = 0; i < 3; i++) {
+      _mm_store_si128(reinterpret_cast<__m128i*>(voxel[i]), v[i]);
+      _mm_store_ps(time[i], t[i]);
+    }
+  };
+
+  for (Size i = 0; i < 3; i++) {
+    last[i] = _mm_set1_epi32(Sint32(m_voxel_count[i]) - 1);
+  }
+
+  load();
+
+  const auto zero = _mm_setzero_si128();
+  const auto one = _mm_set1_epi32(1);
+
+  auto skipping = false;
+  while (active) {
+    __m128i out = zero;
+    if (!skipping) {
+      // Every lane steps a single voxel, the ordinary DDA step.
+      __m128 axes[3];
+      minimum(t, axes);
+      for (Size i = 0; i < 3; i++) {
+        const auto axis = _mm_castps_si128(axes[i]);
+        v[i] = _mm_add_epi32(v[i], _mm_and_si128(axis, s[i]));
+        t[i] = _mm_add_ps(t[i], _mm_and_ps(axes[i], d[i]));
+        out = _mm_or_si128(out, _mm_cmplt_epi32(v[i], zero));
+        out = _mm_or_si128(out, _mm_cmpgt_epi32(v[i], last[i]));
+      }
+    } else {
+      const auto size = _mm_load_si128(reinterpret_cast<const __m128i*>(sizes));
+      const auto mask = _mm_sub_epi32(size, one);
+
+      __m128i steps[3];
+      __m128 exits[3];
+      for (Size i = 0; i < 3; i++) {
+        const auto lo = _mm_andnot_si128(mask, v[i]);
+        steps[i] = select(pos[i],
+          _mm_sub_epi32(_mm_add_epi32(lo, mask), v[i]),
+          _mm_sub_epi32(v[i], lo));
+        exits[i] = _mm_add_ps(t[i], _mm_mul_ps(d[i], _mm_cvtepi32_ps(steps[i])));
+      }
+
+      __m128 axes[3];
+      minimum(exits, axes);
+
+      const auto exit = select(axes[0], exits[0], select(axes[1], exits[1], exits[2]));
+
+      for (Size i = 0; i < 3; i++) {
+        const auto axis = _mm_castps_si128(axes[i]);
+        const auto before = _mm_castps_si128(_mm_cmplt_ps(t[i], exit));
+
+        auto crossed = _mm_add_epi32(_mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(exit, t[i]), r[i])), one);
+        crossed = select(_mm_cmpgt_epi32(crossed, steps[i]), steps[i], crossed);
+        crossed = _mm_and_si128(before, crossed);
+        crossed = select(axis, _mm_add_epi32(steps[i], one), crossed);
+
+        t[i] = select(axes[i], _mm_add_ps(exits[i], d[i]),
+          _mm_add_ps(t[i], _mm_mul_ps(d[i], _mm_cvtepi32_ps(crossed))));
+
+        v[i] = select(pos[i], _mm_add_epi32(v[i], crossed), _mm_sub_epi32(v[i], crossed));
+
+        out = _mm_or_si128(out, _mm_cmplt_epi32(v[i], zero));
+        out = _mm_or_si128(out, _mm_cmpgt_epi32(v[i], last[i]));
+      }
+    }
+
+    // Lanes which left the voxels look up the first voxel instead, as their
+    // results are discarded.
+    for (Size i = 0; i < 3; i++) {
+      _mm_store_si128(reinterpret_cast<__m128i*>(voxel[i]), _mm_andnot_si128(out, v[i]));
+    }
+
+    Uint32 solid = 0;
+    Uint32 empty = 0;
+    for (Size lane = 0; lane < PACKET_SIZE; lane++) {
+      const auto x = voxel[0][lane];
+      const auto y = voxel[1][lane];
+      const auto z = voxel[2][lane];
+      const auto word = words[word_index(level, x >> 2, y >> 2, z >> 2)];
+      solid |= Uint32((word >> bit_index(x, y, z)) & 1) << lane;
+      empty |= Uint32(word == 0) << lane;
+    }
+
+    const auto left = Uint32(_mm_movemask_ps(_mm_castsi128_ps(out))) & active;
+    const auto hit = solid & in_air & active & ~left;
+    in_air |= ~solid;
+
+    // Lanes in empty words of voxels skip the largest empty cell around them.
+    const auto empties = empty & active & ~left;
+    skipping = empties != 0;
+    if (skipping) {
+      _mm_store_si128(reinterpret_cast<__m128i*>(sizes), one);
+    }
+    for (auto lanes = empties; lanes; lanes &= lanes - 1) {
+      const auto lane = bit_search_lsb(lanes);
+      sizes[lane] = 1 << empty_cell(voxel[0][lane], voxel[1][lane], voxel[2][lane]);
     }
 
-    if (m_voxels[index] && in_air) {
-      // Distance to origin of voxel, not a corner point.
-      return Math::length(_ray.point() - voxel_origin(voxel));
+    if (const auto done = left | hit) {
+      for (auto lanes = left; lanes; lanes &= lanes - 1) {
+        results_[rays[bit_search_lsb(lanes)]] = nullopt;
+      }
+      for (auto lanes = hit; lanes; lanes &= lanes - 1) {
+        const auto lane = bit_search_lsb(lanes);
+        const Math::Vec3z voxel_hit{Size(voxel[0][lane]), Size(voxel[1][lane]), Size(voxel[2][lane])};
+        results_[rays[lane]] = Math::length(_rays[rays[lane]].point() - voxel_origin(voxel_hit));
+      }
+      store();
+      active &= ~done;
+      for (auto lanes = done; lanes; lanes &= lanes - 1) {
+        fill(bit_search_lsb(lanes));
+      }
+      load();
     }
   }
 }
+#endif
 
-} // namespace Rx::Model
\ No newline at end of file
+} // namespace Rx::Model
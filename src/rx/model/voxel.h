@@ -13,7 +13,24 @@ namespace Rx::Math {
 
 namespace Rx::Model {
 
+// Voxels are packed one bit each into words of 4x4x4 voxels. Above those are
+// coarser levels with a bit for every word of the level below which is not
+// empty, so rays can skip over empty space 4, 16 or 64 voxels at a time.
+//
+// The voxels are made in bricks of 16x16x16 voxels, the words of a word of
+// the level above, which are kept sparsely in addition to the dense words.
 struct Voxel {
+  // The number of rays traced together by |ray_cast| on arrays of rays.
+  static inline constexpr const Size PACKET_SIZE = 4;
+
+  static inline constexpr const Size BRICK_SHIFT = 4;
+  static inline constexpr const Size BRICK_SIZE = 1 << BRICK_SHIFT;
+
+  // The words of a brick are ordered like the bits of a word.
+  struct Brick {
+    Uint64 words[64];
+  };
+
   static Optional<Voxel> create(
     Concurrency::Scheduler& _schedler,
     Memory::Allocator& _allocator,
@@ -23,20 +40,59 @@ struct Voxel {
     Size _max_voxels,
     Size _triangles_per_task);
 
+  // Casts |_ray| until it leaves the voxels it starts in and hits another,
+  // returning the distance to the center of that voxel.
   Optional<Float32> ray_cast(const Math::Ray& _ray) const;
 
+  // Casts the |_count| rays of |_rays| like the above, writing the result of
+  // each to |results_|. Rays are traced in packets of |PACKET_SIZE| with SIMD
+  // when available.
+  void ray_cast(const Math::Ray* _rays, Size _count, Optional<Float32>* results_) const;
+
+  bool is_solid(const Math::Vec3z& _voxel) const;
+
   const Math::Vec3f voxel_origin(const Math::Vec3z& _voxel) const;
 
+  // The brick at |_brick|, in bricks, or nullptr when none of it is solid.
+  const Brick* find_brick(const Math::Vec3z& _brick) const;
+
+  // The bricks with any solid voxel.
+  const Vector<Brick>& bricks() const;
+
   Voxel(Voxel&& voxel_);
   Voxel(const Math::AABB& _bounds, const Math::Vec3z& _voxel_count,
-    Float32 _full_voxel_size, Float32 _half_voxel_size, Vector<Uint8>&& voxels_);
+    Float32 _full_voxel_size, Float32 _half_voxel_size, Vector<Uint64>&& words_,
+    Vector<Uint32>&& brick_map_, Vector<Brick>&& bricks_);
 
 private:
+  static inline constexpr const Size LEVELS = 3;
+
+  struct Level {
+    Math::Vec3z count;
+    Size offset;
+  };
+
+  // Lays out the words of every level for |_voxel_count| voxels, returning
+  // the number of words.
+  static Size layout(const Math::Vec3z& _voxel_count, Level (&levels_)[LEVELS]);
+
+  static Size word_index(const Level& _level, Size _x, Size _y, Size _z);
+  static Size bit_index(Size _x, Size _y, Size _z);
+
+  // Returns the log2 of the size of the largest empty cell around the empty
+  // word of voxels with the voxel at |_x, _y, _z|.
+  Sint32 empty_cell(Sint32 _x, Sint32 _y, Sint32 _z) const;
+
+  void ray_cast_packets(const Math::Ray* _rays, Size _count, Optional<Float32>* results_) const;
+
   Math::AABB m_bounds;
   Math::Vec3z m_voxel_count;
   Float32 m_full_voxel_size;
   Float32 m_half_voxel_size;
-  Vector<Uint8> m_voxels;
+  Level m_levels[LEVELS];
+  Vector<Uint64> m_words;
+  Vector<Uint32> m_brick_map; // Index in |m_bricks| of every brick, or -1.
+  Vector<Brick> m_bricks;
 };
 
 inline Voxel::Voxel(Voxel&& voxel_)
@@ -44,24 +100,44 @@ inline Voxel::Voxel(Voxel&& voxel_)
   , m_voxel_count{Utility::exchange(voxel_.m_voxel_count, Math::Vec3z{})}
   , m_full_voxel_size{Utility::exchange(voxel_.m_full_voxel_size, 0.0f)}
   , m_half_voxel_size{Utility::exchange(voxel_.m_half_voxel_size, 0.0f)}
-  , m_voxels{Utility::move(voxel_.m_voxels)}
-{
-}
-
-inline Voxel::Voxel(const Math::AABB& _bounds, const Math::Vec3z& _voxel_count,
-  Float32 _full_voxel_size, Float32 _half_voxel_size, Vector<Uint8>&& voxels_)
-  : m_bounds{_bounds}
-  , m_voxel_count{_voxel_count}
-  , m_full_voxel_size{_full_voxel_size}
-  , m_half_voxel_size{_half_voxel_size}
-  , m_voxels{Utility::move(voxels_)}
+  , m_words{Utility::move(voxel_.m_words)}
+  , m_brick_map{Utility::move(voxel_.m_brick_map)}
+  , m_bricks{Utility::move(voxel_.m_bricks)}
 {
+  for (Size i = 0; i < LEVELS; i++) {
+    m_levels[i] = voxel_.m_levels[i];
+  }
 }
 
 inline const Math::Vec3f Voxel::voxel_origin(const Math::Vec3z& _voxel) const {
   return m_bounds.min() + (m_full_voxel_size * _voxel.cast<Float32>()) + m_half_voxel_size;
 }
 
+inline const Voxel::Brick* Voxel::find_brick(const Math::Vec3z& _brick) const {
+  const auto count = m_voxel_count.map([](Size _value) {
+    return (_value + BRICK_SIZE - 1) >> BRICK_SHIFT;
+  });
+  const auto index = m_brick_map[(_brick.x * count.y + _brick.y) * count.z + _brick.z];
+  return index != -1_u32 ? &m_bricks[index] : nullptr;
+}
+
+inline const Vector<Voxel::Brick>& Voxel::bricks() const {
+  return m_bricks;
+}
+
+inline Size Voxel::word_index(const Level& _level, Size _x, Size _y, Size _z) {
+  return _level.offset + (_x * _level.count.y + _y) * _level.count.z + _z;
+}
+
+inline Size Voxel::bit_index(Size _x, Size _y, Size _z) {
+  return ((_x & 3) << 4) | ((_y & 3) << 2) | (_z & 3);
+}
+
+inline bool Voxel::is_solid(const Math::Vec3z& _voxel) const {
+  const auto word = m_words[word_index(m_levels[0], _voxel.x >> 2, _voxel.y >> 2, _voxel.z >> 2)];
+  return word & (1_u64 << bit_index(_voxel.x, _voxel.y, _voxel.z));
+}
+
 };
 
-#endif // RX_MODEL_VOXELIZE_H
\ No newline at end of file
+#endif // RX_MODEL_VOXELIZE_H
@@ -64,6 +64,11 @@ bool State::resize(Size _particles, Size _groups) {
     return true;
   }
 
+  // Groups are added to the tree as they're updated, which cannot fail.
+  if (!m_group_tree.reserve(_groups)) {
+    return false;
+  }
+
   Memory::Aggregate aggregate{m_allocator};
   bool result = true;
 
@@ -90,6 +95,7 @@ bool State::resize(Size _particles, Size _groups) {
   result &= aggregate.add<Uint16>(_particles);  // m_texture
   result &= aggregate.add<Uint32>(_particles);  // m_group_refs
   result &= aggregate.add<Group>(_groups);      // m_groups
+  result &= aggregate.add<Uint32>(_groups);     // m_group_proxies
   if (!result) {
     return false;
   }
@@ -157,6 +163,12 @@ bool State::resize(Size _particles, Size _groups) {
 
   m_group_data     = reinterpret_cast<Group*>(data + aggregate[18]);
 
+  m_group_proxies  = reinterpret_cast<Uint32*>(data + aggregate[19]);
+  for (Size i = 0; i < _groups; i++) {
+    m_group_proxies[i] = -1_u32;
+  }
+  m_group_tree.clear();
+
   m_group_count    = _groups;
   m_total_count    = _particles;
 
@@ -167,15 +179,73 @@ State::~State() {
   m_allocator.deallocate(m_data);
 }
 
-Size State::visible(Span<Uint32> indices_, const Math::Frustum& _frustum) const {
-  Size count = 0;
+void State::update_group_tree() {
   for (Size i = 0; i < m_group_count; i++) {
     const auto& group = m_group_data[i];
-    if (group.count && _frustum.is_aabb_inside(group.bounds)) {
+    auto& proxy = m_group_proxies[i];
+    if (group.count == 0) {
+      if (proxy != -1_u32) {
+        m_group_tree.remove(proxy);
+        proxy = -1_u32;
+      }
+    } else if (proxy == -1_u32) {
+      // Reserved for every group on resize.
+      const auto insert = m_group_tree.insert(group.bounds, Uint32(i));
+      RX_ASSERT(insert, "out of memory");
+      proxy = *insert;
+    } else {
+      m_group_tree.move(proxy, group.bounds);
+    }
+  }
+}
+
+// The number of groups found by the tree which are tested together.
+static constexpr const Size GROUPS_PER_BATCH = 64;
+
+Size State::visible(Span<Uint32> indices_, const Math::Frustum& _frustum) const {
+  // The groups which may be visible are collected from the tree with their
+  // bounds laid out for the frustum to test a batch of them at once.
+  Uint32 groups[GROUPS_PER_BATCH];
+  Float32 origins[3][GROUPS_PER_BATCH];
+  Float32 scales[3][GROUPS_PER_BATCH];
+  Size n_groups = 0;
+
+  Size count = 0;
+  auto flush = [&] {
+    Uint32 inside[GROUPS_PER_BATCH];
+    const auto n_inside = _frustum.cull(
+      Math::Frustum::Boxes{{origins[0], origins[1], origins[2]},
+                           {scales[0], scales[1], scales[2]}},
+      n_groups, inside);
+    for (Size i = 0; i < n_inside; i++) {
+      const auto& group = m_group_data[groups[inside[i]]];
       Memory::copy(indices_.data() + count, group.indices, group.count);
       count += group.count;
     }
-  }
+    n_groups = 0;
+  };
+
+  m_group_tree.query(_frustum, [&](Uint32 _group) {
+    const auto& group = m_group_data[_group];
+    if (!group.count) {
+      return;
+    }
+
+    const auto origin = group.bounds.origin();
+    const auto scale = group.bounds.scale();
+    for (Size i = 0; i < 3; i++) {
+      origins[i][n_groups] = origin[i];
+      scales[i][n_groups] = scale[i];
+    }
+
+    groups[n_groups++] = _group;
+    if (n_groups == GROUPS_PER_BATCH) {
+      flush();
+    }
+  });
+
+  flush();
+
   return count;
 }
 
@@ -4,6 +4,7 @@
 #include "rx/core/uninitialized.h"
 
 #include "rx/math/aabb.h"
+#include "rx/math/aabb_tree.h"
 #include "rx/math/vec4.h"
 
 namespace Rx::Math { struct Frustum; }
@@ -52,6 +53,10 @@ protected:
 
   void swap(Uint32 _lhs, Uint32 _rhs);
 
+  // Moves the groups in |m_group_tree| to their bounds, called after the
+  // bounds change. Empty groups are removed from it.
+  void update_group_tree();
+
   Memory::Allocator& m_allocator;
 
   // TODO(dweiler): Use Optional?
@@ -91,6 +96,10 @@ protected:
   // The group array as referenced by index in |m_group_refs|.
   Group* m_group_data;
   Size m_group_count;
+
+  // The proxy of every group in |m_group_tree|, -1 for empty groups.
+  Uint32* m_group_proxies;
+  Math::AABBTree m_group_tree;
 };
 
 inline State::State(Memory::Allocator& _allocator)
@@ -118,6 +127,8 @@ inline State::State(Memory::Allocator& _allocator)
   , m_group_refs{nullptr}
   , m_group_data{nullptr}
   , m_group_count{0}
+  , m_group_proxies{nullptr}
+  , m_group_tree{_allocator}
 {
 }
 
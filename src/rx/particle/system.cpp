@@ -116,6 +116,8 @@ void System::update(Float32 _delta_time) {
     group.indices[group.count++] = i;
   }
 
+  update_group_tree();
+
   // Unique id for each update.
   m_id++;
 }
@@ -140,4 +142,42 @@ Optional<Size> System::add_emitter(Uint32 _group, const Program& _program, Float
   return nullopt;
 }
 
+bool System::replace_program(const Program::Hash& _hash, const Program& _program) {
+  if (!m_programs.find(_hash)) {
+    return false;
+  }
+
+  // Assembled the same, nothing to do.
+  if (_hash == _program.hash) {
+    return true;
+  }
+
+  // Emitters refer to programs in |m_programs| which may move around as it's
+  // changed, so they're found again by hash afterwards.
+  Vector<Program::Hash> hashes{m_allocator};
+  const bool recorded = m_emitters.each_fwd([&](const Emitter& _emitter) {
+    const auto& hash = _emitter.m_program->hash;
+    return hashes.push_back(hash == _hash ? _program.hash : hash);
+  });
+  if (!recorded) {
+    return false;
+  }
+
+  if (!m_programs.find(_program.hash)) {
+    auto copy = Utility::copy(_program);
+    if (!copy || !m_programs.insert(_program.hash, Utility::move(*copy))) {
+      return false;
+    }
+  }
+
+  m_programs.erase(_hash);
+
+  const auto n_emitters = m_emitters.size();
+  for (Size i = 0; i < n_emitters; i++) {
+    m_emitters[i].m_program = m_programs.find(hashes[i]);
+  }
+
+  return true;
+}
+
 } // namespace Rx::Particle
\ No newline at end of file
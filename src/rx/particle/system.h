@@ -23,6 +23,12 @@ struct System
   void update(Float32 _delta_time);
 
   [[nodiscard]] Optional<Size> add_emitter(Uint32 _group, const Program& _program, Float32 _rate);
+
+  // Replace the program with hash |_hash| by |_program|, like when the source
+  // of it changed. The emitters using it run |_program| from then on.
+  //
+  // Returns false when no emitter was added with that program.
+  [[nodiscard]] bool replace_program(const Program::Hash& _hash, const Program& _program);
   [[nodiscard]] bool add_texture(const StringView& _file_name);
 
   Emitter& emitter(Size _index);
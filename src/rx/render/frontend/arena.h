@@ -44,6 +44,10 @@ struct Arena {
     bool record_elements_edit(Size _offset, Size _size);
     bool record_instances_edit(Size _offset, Size _size);
 
+    // The vertices written before, to be edited in place. Edits must be
+    // recorded with |record_vertices_edit|.
+    Span<Byte> edit_vertices();
+
     Size base_vertex() const;
     Size base_element() const;
     Size base_instance() const;
@@ -241,6 +245,14 @@ RX_HINT_FORCE_INLINE Span<const Byte> Arena::Block::vertices() const {
   return {m_arena->m_buffer->vertices().data() + range.offset, Size(range.size)};
 }
 
+RX_HINT_FORCE_INLINE Span<Byte> Arena::Block::edit_vertices() {
+  // Mapping the size the buffer already is doesn't move or resize it.
+  const auto& range = range_for(Buffer::Sink::VERTICES);
+  const auto buffer = m_arena->m_buffer;
+  const auto data = buffer->map_vertices(buffer->vertices().size());
+  return {data + range.offset, Size(range.size)};
+}
+
 RX_HINT_FORCE_INLINE Span<const Byte> Arena::Block::elements() const {
   const auto& range = range_for(Buffer::Sink::ELEMENTS);
   return {m_arena->m_buffer->elements().data() + range.offset, Size(range.size)};
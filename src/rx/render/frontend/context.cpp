@@ -99,6 +99,7 @@ Context::Context(Memory::Allocator& _allocator, Backend::Context* _backend, cons
   , m_cached_texturesCM{allocator()}
   , m_techniques{allocator()}
   , m_modules{allocator()}
+  , m_technique_files{allocator()}
   // , m_routines{allocator()}
   , m_arenas{allocator()}
   , m_draw_calls{0, 0}
@@ -107,6 +108,8 @@ Context::Context(Memory::Allocator& _allocator, Backend::Context* _backend, cons
   , m_blit_calls{0, 0}
   , m_vertices{0, 0}
   , m_triangles{0, 0}
+  , m_triangles_saved{0, 0}
+  , m_skinning_saved{0, 0}
   , m_lines{0, 0}
   , m_points{0, 0}
   , m_commands_recorded{0, 0}
@@ -152,6 +155,9 @@ Context::Context(Memory::Allocator& _allocator, Backend::Context* _backend, cons
       if (item_.is_file() && item_.name().ends_with(".json5")) {
         Technique new_technique{this};
         if (auto path = item_.full_name(); new_technique.load(*path) && new_technique.compile(m_modules)) {
+          if (auto name = Utility::copy(new_technique.name())) {
+            m_technique_files.insert(Utility::move(*path), Utility::move(*name));
+          }
           m_techniques.insert(new_technique.name(), Utility::move(new_technique));
         }
       }
@@ -188,6 +194,13 @@ Context::Context(Memory::Allocator& _allocator, Backend::Context* _backend, cons
   m_swapchain_target->attach_texture(m_swapchain_texture, 0);
   m_swapchain_target->m_flags |= Target::SWAPCHAIN;
   initialize_target(RX_RENDER_TAG("swapchain"), m_swapchain_target);
+
+  // Reload techniques and modules as they're edited.
+  auto on_change = Filesystem::Watcher::instance().on_change(
+    [this](const StringView& _file_name) { on_file_change(_file_name); });
+  if (on_change) {
+    m_on_file_change = Utility::move(*on_change);
+  }
 }
 
 Context::~Context() {
@@ -1026,6 +1039,8 @@ bool Context::process() {
   swap(m_points);
   swap(m_lines);
   swap(m_triangles);
+  swap(m_triangles_saved);
+  swap(m_skinning_saved);
   swap(m_commands_recorded);
   swap(m_footprint);
 
@@ -1162,6 +1177,112 @@ Technique* Context::find_technique_by_name(const char* _name) {
   return m_techniques.find(_name);
 }
 
+void Context::on_file_change(const StringView& _file_name) {
+  if (!_file_name.ends_with(".json5")) {
+    return;
+  }
+
+  // Only files directly in the directories, like when loading them.
+  const auto in_directory = [&](const char* _path) {
+    const auto length = strlen(_path);
+    return _file_name.size() > length + 1
+      && _file_name.begins_with(_path)
+      && _file_name[length] == '/'
+      && !StringView{_file_name.data() + length + 1}.contains('/');
+  };
+
+  if (in_directory(MODULES_PATH)) {
+    reload_module(_file_name);
+  } else if (in_directory(TECHNIQUES_PATH)) {
+    reload_technique(_file_name);
+  }
+}
+
+bool Context::reload_module(const StringView& _file_name) {
+  Time::StopWatch time;
+  time.start();
+
+  Module new_module{allocator()};
+  if (!new_module.load(_file_name)) {
+    logger->error("failed to reload module '%s', keeping the old one",
+      _file_name);
+    return false;
+  }
+
+  auto name = Utility::copy(new_module.name());
+  if (!name) {
+    return false;
+  }
+
+  // Nothing refers to a module outside of |m_modules| so it can be replaced.
+  if (auto find = m_modules.find(*name)) {
+    *find = Utility::move(new_module);
+  } else if (!m_modules.insert(*name, Utility::move(new_module))) {
+    return false;
+  }
+
+  // Then only the techniques using the module need to be reloaded, all of the
+  // others remain as they were.
+  Vector<String> dependents{allocator()};
+  m_technique_files.each_pair([&](const String& _file, const String& _technique) {
+    const auto technique = m_techniques.find(_technique);
+    if (!technique || !technique->uses_module(m_modules, *name)) {
+      return true;
+    }
+    auto file = Utility::copy(_file);
+    return file && dependents.push_back(Utility::move(*file));
+  });
+
+  Size reloaded = 0;
+  dependents.each_fwd([&](const String& _file) {
+    if (reload_technique(_file)) {
+      reloaded++;
+    }
+  });
+
+  time.stop();
+  logger->info("reloaded module '%s' and %zu of %zu techniques using it in %s",
+    *name, reloaded, dependents.size(), time.elapsed());
+
+  return reloaded == dependents.size();
+}
+
+bool Context::reload_technique(const StringView& _file_name) {
+  Technique new_technique{this};
+  if (!new_technique.load(_file_name) || !new_technique.compile(m_modules)) {
+    logger->error("failed to reload technique '%s', keeping the old one",
+      _file_name);
+    return false;
+  }
+
+  // Techniques are referred to by pointer. They're replaced in place, since
+  // inserting into |m_techniques| can move them.
+  auto technique = m_techniques.find(new_technique.name());
+  if (!technique) {
+    logger->warning("technique '%s' in '%s' is new, it will be loaded on restart",
+      new_technique.name(), _file_name);
+    return false;
+  }
+
+  auto file_name = _file_name.to_string(allocator());
+  auto name = Utility::copy(new_technique.name());
+  if (!file_name || !name) {
+    return false;
+  }
+
+  *technique = Utility::move(new_technique);
+
+  if (auto find = m_technique_files.find(*file_name)) {
+    *find = Utility::move(*name);
+  } else if (!m_technique_files.insert(Utility::move(*file_name), Utility::move(*name))) {
+    return false;
+  }
+
+  logger->info("reloaded technique '%s'", technique->name());
+
+  return true;
+}
+
 Arena* Context::arena(const Buffer::Format& _format) {
   // Check if an arena for this buffer |_format| already exists.
   Concurrency::ScopeLock lock{m_mutex};
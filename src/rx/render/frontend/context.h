@@ -9,6 +9,8 @@
 #include "rx/core/concurrency/mutex.h"
 #include "rx/core/concurrency/atomic.h"
 
+#include "rx/core/filesystem/watcher.h"
+
 #include "rx/render/frontend/command.h"
 #include "rx/render/frontend/resource.h"
 #include "rx/render/frontend/arena.h"
@@ -224,12 +226,22 @@ struct Context {
 
   Statistics stats(Resource::Type _type) const;
 
+  // Records triangles not drawn because a simplified level of detail was
+  // drawn instead.
+  void record_triangles_saved(Size _count);
+
+  // Records vertices drawn without being skinned in the vertex shader because
+  // they were skinned once before drawing.
+  void record_skinning_saved(Size _count);
+
   Size draw_calls() const;
   Size instanced_draw_calls() const;
   Size clear_calls() const;
   Size blit_calls() const;
   Size vertices() const;
   Size triangles() const;
+  Size triangles_saved() const;
+  Size skinning_saved() const;
   Size lines() const;
   Size points() const;
   Size commands() const;
@@ -259,6 +271,12 @@ private:
   template<typename T>
   void remove_from_cache(Map<String, T*>& cache_, T* _object);
 
+  // Reload the technique or module in |_file_name| when it changed. Techniques
+  // using a reloaded module are reloaded too.
+  void on_file_change(const StringView& _file_name);
+  bool reload_module(const StringView& _file_name);
+  bool reload_technique(const StringView& _file_name);
+
   mutable Concurrency::Mutex m_mutex;
 
   Memory::Allocator& m_allocator               RX_HINT_GUARDED_BY(m_mutex);
@@ -310,6 +328,7 @@ private:
 
   Map<String, Technique> m_techniques          RX_HINT_GUARDED_BY(m_mutex);
   Map<String, Module> m_modules                RX_HINT_GUARDED_BY(m_mutex);
+  Map<String, String> m_technique_files        RX_HINT_GUARDED_BY(m_mutex);
   // Map<String, Routine> m_routines              RX_HINT_GUARDED_BY(m_mutex);
 
   Map<Buffer::Format, Arena> m_arenas          RX_HINT_GUARDED_BY(m_mutex);
@@ -320,6 +339,8 @@ private:
   Concurrency::Atomic<Size> m_blit_calls[2];
   Concurrency::Atomic<Size> m_vertices[2];
   Concurrency::Atomic<Size> m_triangles[2];
+  Concurrency::Atomic<Size> m_triangles_saved[2];
+  Concurrency::Atomic<Size> m_skinning_saved[2];
   Concurrency::Atomic<Size> m_lines[2];
   Concurrency::Atomic<Size> m_points[2];
   Concurrency::Atomic<Size> m_commands_recorded[2];
@@ -331,6 +352,8 @@ private:
 
   DeviceInfo m_device_info;
   FrameTimer m_timer;
+
+  Filesystem::Watcher::ChangeEvent::Handle m_on_file_change;
 };
 
 inline constexpr Context::DeviceInfo::DeviceInfo(Memory::Allocator& _allocator)
@@ -379,6 +402,22 @@ inline Size Context::triangles() const {
   return m_triangles[1].load();
 }
 
+inline Size Context::triangles_saved() const {
+  return m_triangles_saved[1].load();
+}
+
+inline void Context::record_triangles_saved(Size _count) {
+  m_triangles_saved[0] += _count;
+}
+
+inline Size Context::skinning_saved() const {
+  return m_skinning_saved[1].load();
+}
+
+inline void Context::record_skinning_saved(Size _count) {
+  m_skinning_saved[0] += _count;
+}
+
 inline Size Context::lines() const {
   return m_lines[1].load();
 }
@@ -155,7 +155,7 @@ bool Material::load(const Rx::Material::Loader& _loader) {
       const bool mipmaps = _texture.mipmap_mode() != Rx::Material::Texture::MipmapMode::NONE;
       Rx::Texture::Chain chain{m_frontend->allocator()};
       if (!chain.generate(bitmap.data.data(), bitmap.format,
-        bitmap.format, bitmap.dimensions, false, mipmaps))
+        bitmap.format, bitmap.dimensions, bitmap.has_mipchain, mipmaps))
       {
         return false;
       }
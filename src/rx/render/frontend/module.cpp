@@ -1,5 +1,5 @@
-#include "rx/core/filesystem/unbuffered_file.h"
-#include "rx/core/serialize/json.h"
+#include "rx/core/filesystem/vfs.h"
+#include "rx/core/serialize/json_reader.h"
 
 #include "rx/render/frontend/module.h"
 
@@ -35,86 +35,124 @@ Module& Module::operator=(Module&& module_) {
 }
 
 bool Module::load(Stream::Context& _stream) {
-  if (auto data = _stream.read_text(allocator())) {
-    if (auto disown = data->disown()) {
-      if (auto json = Serialize::JSON::parse(allocator(), String{*disown})) {
-        return parse(*json);
-      }
-    }
+  if (auto reader = Serialize::JSONReader::create(allocator(), _stream)) {
+    return parse(*reader);
   }
   return false;
 }
 
 bool Module::load(const StringView& _file_name) {
-  if (auto file = Filesystem::UnbufferedFile::open(allocator(), _file_name, "r")) {
+  if (auto file = Filesystem::open_file(allocator(), _file_name)) {
     return load(*file);
   }
   return false;
 }
 
-bool Module::parse(const Serialize::JSON& _description) {
+bool Module::parse(Serialize::JSONReader& reader_) {
+  using Token = Serialize::JSONReader::Token;
+
   auto& allocator = *m_allocator;
 
-  if (!_description) {
-    const auto json_error{_description.error()};
-    if (json_error) {
+  // Reports the error of the reader, there is none when out of memory.
+  const auto error = [&]() -> bool {
+    if (const auto json_error = reader_.error()) {
       return m_report.error("%s", *json_error);
-    } else {
-      return m_report.error("empty description");
     }
+    return false;
+  };
+
+  // Reads the value of the key just read, which must be a |_token|.
+  const auto expect = [&](Token _token, const char* _message) -> bool {
+    const auto token = reader_.next();
+    if (token == Token::ERROR) {
+      return error();
+    }
+    return token == _token || m_report.error("%s", _message);
+  };
+
+  switch (reader_.next()) {
+  case Token::BEGIN_OBJECT:
+    break;
+  case Token::ERROR:
+    return error();
+  case Token::END:
+    return m_report.error("empty description");
+  default:
+    return m_report.error("expected Object");
   }
 
-  const auto& name = _description["name"];
-  const auto& source = _description["source"];
+  bool has_name = false;
+  bool has_source = false;
 
-  if (!name) {
-    return m_report.error("missing 'name'");
-  }
+  for (auto token = reader_.next(); token != Token::END_OBJECT; token = reader_.next()) {
+    if (token != Token::KEY) {
+      return error();
+    }
 
-  if (!name.is_string()) {
-    return m_report.error("expected String for 'name'");
-  }
+    const auto key = reader_.as_string();
+    if (key == "name") {
+      if (!expect(Token::STRING, "expected String for 'name'")) {
+        return false;
+      }
 
-  auto name_string = name.as_string(allocator);
-  if (!name_string) {
-    return false;
-  }
+      auto name_string = reader_.as_string().to_string(allocator);
+      if (!name_string) {
+        return false;
+      }
 
-  m_name = Utility::move(*name_string);
+      m_name = Utility::move(*name_string);
 
-  if (!m_report.rename(m_name)) {
-    return false;
-  }
+      if (!m_report.rename(m_name)) {
+        return false;
+      }
 
-  if (!source) {
-    return m_report.error("missing 'source'");
-  }
+      has_name = true;
+    } else if (key == "source") {
+      if (!expect(Token::STRING, "expected String for 'source'")) {
+        return false;
+      }
 
-  if (!source.is_string()) {
-    return m_report.error("expected String for 'source'");
-  }
+      auto source_string = reader_.as_string().to_string(allocator);
+      if (!source_string) {
+        return false;
+      }
 
-  auto source_string = source.as_string(allocator);
-  if (!source_string) {
-    return false;
-  }
+      // Trim any leading and trailing whitespace characters from the contents too.
+      m_source = Utility::move(*source_string); //.strip("\t\r\n ");
+      has_source = true;
+    } else if (key == "imports") {
+      if (!expect(Token::BEGIN_ARRAY, "expected Array[String] for 'imports'")) {
+        return false;
+      }
 
-  // Trim any leading and trailing whitespace characters from the contents too.
-  m_source = Utility::move(*source_string); //.strip("\t\r\n ");
+      for (auto element = reader_.next(); element != Token::END_ARRAY; element = reader_.next()) {
+        if (element == Token::ERROR) {
+          return error();
+        }
 
-  const auto& imports = _description["imports"];
-  if (!imports) {
-    return true;
+        if (element != Token::STRING) {
+          return m_report.error("expected Array[String] for 'imports'");
+        }
+
+        auto dependency = reader_.as_string().to_string(allocator);
+        if (!dependency || !m_dependencies.push_back(Utility::move(*dependency))) {
+          return false;
+        }
+      }
+    } else if (!reader_.skip()) {
+      return error();
+    }
+  }
+
+  if (!has_name) {
+    return m_report.error("missing 'name'");
   }
 
-  if (!imports.is_array_of(Serialize::JSON::Type::STRING)) {
-    return m_report.error("expected Array[String] for 'imports'");
+  if (!has_source) {
+    return m_report.error("missing 'source'");
   }
 
-  return imports.each([&](const Serialize::JSON& _import) {
-    auto dependency = _import.as_string(allocator);
-    return dependency && m_dependencies.push_back(Utility::move(*dependency));
-  });
+  return true;
 }
 
 bool resolve_module_dependencies(
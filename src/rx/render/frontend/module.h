@@ -6,7 +6,7 @@
 
 #include "rx/core/algorithm/topological_sort.h"
 
-namespace Rx::Serialize { struct JSON; }
+namespace Rx::Serialize { struct JSONReader; }
 namespace Rx::Stream { struct Context; }
 
 namespace Rx::Render::Frontend {
@@ -22,7 +22,8 @@ struct Module {
   [[nodiscard]] bool load(Stream::Context& _stream);
   [[nodiscard]] bool load(const StringView& _file_name);
 
-  [[nodiscard]] bool parse(const Serialize::JSON& _description);
+  // Reads the description token by token, the source is not copied twice.
+  [[nodiscard]] bool parse(Serialize::JSONReader& reader_);
 
   const String& source() const &;
   const String& name() const &;
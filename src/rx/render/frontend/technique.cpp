@@ -6,7 +6,7 @@
 
 #include "rx/core/serialize/json.h"
 #include "rx/core/optional.h"
-#include "rx/core/filesystem/unbuffered_file.h"
+#include "rx/core/filesystem/vfs.h"
 #include "rx/core/algorithm/topological_sort.h"
 
 RX_LOG("render/technique", logger);
@@ -254,11 +254,48 @@ Technique& Technique::operator=(Technique&& technique_) {
   // Update |m_configuration| references to this Technique instance.
   m_configurations.each_fwd([this](Configuration& configuration_) {
     configuration_.m_technique = this;
+    // Update |m_programs| references to this Technique instance.
+    configuration_.m_programs.each_fwd([this](Configuration::LazyProgram& program_) {
+      program_.m_technique = this;
+    });
   });
 
   return *this;
 }
 
+static bool module_uses_module(const Map<String, Module>& _modules,
+  const StringView& _module, const StringView& _name, Set<String>& visited_)
+{
+  if (StringView{_module} == _name) {
+    return true;
+  }
+
+  // Visit each module once, there may be cycles.
+  if (visited_.find(_module)) {
+    return false;
+  }
+
+  const auto module = _modules.find(_module);
+  if (!module || !visited_.insert(module->name())) {
+    return false;
+  }
+
+  return !module->dependencies().each_fwd([&](const String& _dependency) {
+    return !module_uses_module(_modules, _dependency, _name, visited_);
+  });
+}
+
+bool Technique::uses_module(const Map<String, Module>& _modules,
+  const StringView& _name) const
+{
+  Set<String> visited{m_frontend->allocator()};
+  return !m_shader_definitions.each_fwd([&](const ShaderDefinition& _definition) {
+    return _definition.dependencies.each_fwd([&](const ShaderDefinition::Dependency& _dependency) {
+      return !module_uses_module(_modules, _dependency.name, _name, visited);
+    });
+  });
+}
+
 bool Technique::evaluate_when(const Map<String, bool>& _values, const String& _when) const {
   const auto result = binexp_evaluate(_when.data(), _values);
   if (result < 0) {
@@ -853,7 +890,7 @@ bool Technique::Configuration::LazyProgram::compile() {
 // [Technique]
 bool Technique::load(const StringView& _file_name) {
   auto& allocator = m_frontend->allocator();
-  if (auto file = Filesystem::UnbufferedFile::open(allocator, _file_name, "r")) {
+  if (auto file = Filesystem::open_file(allocator, _file_name)) {
     return load(*file);
   }
   return false;
@@ -125,6 +125,10 @@ public:
 
   const String& name() const;
 
+  // Check if any shader uses the module |_name|, directly or through the
+  // modules it uses.
+  bool uses_module(const Map<String, Module>& _modules, const StringView& _name) const;
+
 private:
   struct ShaderDefinition {
     ShaderDefinition(Memory::Allocator& _allocator)
@@ -269,90 +269,89 @@ void Immediate3D::render(Frontend::Target* _target, const Math::Mat4x4f& _view,
     storage += calculate_storage(_command);
   });
 
-  // The commands generated did not produce any primitives to render.
-  if (storage.elements == 0) {
-    return;
-  }
-
-  // Allocate storage.
-  m_vertices  = (Vertex*)m_buffers[m_wr_index]->map_vertices(storage.vertices * sizeof(Vertex));
-  m_elements  = (Uint32*)m_buffers[m_wr_index]->map_elements(storage.elements * sizeof(Uint32));
-  m_instances = (Instance*)m_buffers[m_wr_index]->map_instances(storage.instances * sizeof(Instance));
-
-  // Generate geometry for a future frame.
-  m_queue.m_commands.each_fwd([this](const Queue::Command& _command) {
-    switch (_command.kind) {
-    case Queue::Command::Type::POINT:
-      generate_point(
-        _command.as_point.position,
-        _command.as_point.size,
-        _command.color,
-        _command.flags);
-      break;
-    case Queue::Command::Type::LINE:
-      generate_line(
-        _command.as_line.point_a,
-        _command.as_line.point_b,
-        _command.as_line.color_a,
-        _command.as_line.color_b,
-        _command.flags);
-      break;
-    case Queue::Command::Type::SOLID_SPHERE:
-      generate_solid_sphere(
-        _command.as_solid_sphere.slices_and_stacks,
-        _command.as_solid_sphere.transform,
-        _command.color,
-        _command.flags);
-      break;
-    case Queue::Command::Type::WIRE_TRIANGLE:
-      generate_wire_triangle(
-        _command.as_wire_triangle.point_a,
-        _command.as_wire_triangle.point_b,
-        _command.as_wire_triangle.point_c,
-        _command.as_wire_triangle.color_a,
-        _command.as_wire_triangle.color_b,
-        _command.as_wire_triangle.color_c,
-        _command.flags);
-      break;
-    case Queue::Command::Type::WIRE_SPHERE:
-      generate_wire_sphere(
-        _command.as_solid_sphere.slices_and_stacks,
-        _command.as_solid_sphere.transform,
-        _command.color,
-        _command.flags);
-      break;
-    case Queue::Command::Type::WIRE_BOX:
-      generate_wire_box(
-        _command.as_wire_box.aabb,
-        _command.color,
-        _command.flags);
-      break;
-    case Queue::Command::Type::SOLID_BOX:
-      generate_solid_box(
-        _command.as_solid_box.transform,
-        _command.color,
-        _command.flags);
-      break;
-    default:
-      break;
-    }
-  });
+  // Commands which produce no primitives still swap in an empty frame so the
+  // last frame is drawn and the queue is cleared.
+  if (storage.elements != 0) {
+    // Allocate storage.
+    m_vertices  = (Vertex*)m_buffers[m_wr_index]->map_vertices(storage.vertices * sizeof(Vertex));
+    m_elements  = (Uint32*)m_buffers[m_wr_index]->map_elements(storage.elements * sizeof(Uint32));
+    m_instances = (Instance*)m_buffers[m_wr_index]->map_instances(storage.instances * sizeof(Instance));
+
+    // Generate geometry for a future frame.
+    m_queue.m_commands.each_fwd([this](const Queue::Command& _command) {
+      switch (_command.kind) {
+      case Queue::Command::Type::POINT:
+        generate_point(
+          _command.as_point.position,
+          _command.as_point.size,
+          _command.color,
+          _command.flags);
+        break;
+      case Queue::Command::Type::LINE:
+        generate_line(
+          _command.as_line.point_a,
+          _command.as_line.point_b,
+          _command.as_line.color_a,
+          _command.as_line.color_b,
+          _command.flags);
+        break;
+      case Queue::Command::Type::SOLID_SPHERE:
+        generate_solid_sphere(
+          _command.as_solid_sphere.slices_and_stacks,
+          _command.as_solid_sphere.transform,
+          _command.color,
+          _command.flags);
+        break;
+      case Queue::Command::Type::WIRE_TRIANGLE:
+        generate_wire_triangle(
+          _command.as_wire_triangle.point_a,
+          _command.as_wire_triangle.point_b,
+          _command.as_wire_triangle.point_c,
+          _command.as_wire_triangle.color_a,
+          _command.as_wire_triangle.color_b,
+          _command.as_wire_triangle.color_c,
+          _command.flags);
+        break;
+      case Queue::Command::Type::WIRE_SPHERE:
+        generate_wire_sphere(
+          _command.as_solid_sphere.slices_and_stacks,
+          _command.as_solid_sphere.transform,
+          _command.color,
+          _command.flags);
+        break;
+      case Queue::Command::Type::WIRE_BOX:
+        generate_wire_box(
+          _command.as_wire_box.aabb,
+          _command.color,
+          _command.flags);
+        break;
+      case Queue::Command::Type::SOLID_BOX:
+        generate_solid_box(
+          _command.as_solid_box.transform,
+          _command.color,
+          _command.flags);
+        break;
+      default:
+        break;
+      }
+    });
 
-  // Record the edit.
-  m_buffers[m_wr_index]->record_vertices_edit(0, storage.vertices * sizeof(Vertex));
-  m_buffers[m_wr_index]->record_elements_edit(0, storage.elements * sizeof(Uint32));
-  m_buffers[m_wr_index]->record_instances_edit(0, storage.instances * sizeof(Instance));
-  m_frontend->update_buffer(RX_RENDER_TAG("immediate3D"), m_buffers[m_wr_index]);
-
-  // Clear staging buffers
-  m_vertices = nullptr;
-  m_elements = nullptr;
-  m_instances = nullptr;
-
-  // Reset indices
-  m_vertex_index = 0;
-  m_element_index = 0;
-  m_instance_index = 0;
+    // Record the edit.
+    m_buffers[m_wr_index]->record_vertices_edit(0, storage.vertices * sizeof(Vertex));
+    m_buffers[m_wr_index]->record_elements_edit(0, storage.elements * sizeof(Uint32));
+    m_buffers[m_wr_index]->record_instances_edit(0, storage.instances * sizeof(Instance));
+    m_frontend->update_buffer(RX_RENDER_TAG("immediate3D"), m_buffers[m_wr_index]);
+
+    // Clear staging buffers
+    m_vertices = nullptr;
+    m_elements = nullptr;
+    m_instances = nullptr;
+
+    // Reset indices
+    m_vertex_index = 0;
+    m_element_index = 0;
+    m_instance_index = 0;
+  }
 
   // Write buffer will be processed some time in the future
   m_render_batches[m_wr_index] = Utility::move(m_batches);
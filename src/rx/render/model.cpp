@@ -10,20 +10,69 @@
 #include "rx/render/frontend/buffer.h"
 #include "rx/render/frontend/arena.h"
 
+#include "rx/model/skinning.h"
+#include "rx/model/blend_tree.h"
+
 #include "rx/math/frustum.h"
 
 #include "rx/core/profiler.h"
+#include "rx/core/concurrency/scheduler.h"
+#include "rx/core/concurrency/wait_group.h"
+#include "rx/core/log.h"
+#include "rx/core/algorithm/min.h"
+#include "rx/core/memory/copy.h"
+#include "rx/core/filesystem/vfs.h"
+#include "rx/core/serialize/json.h"
+
+#include "rx/console/variable.h"
 
 namespace Rx::Render {
 
+RX_LOG("render/model", logger);
+
+RX_CONSOLE_FVAR(
+  lod_error,
+  "render.model.lod_error",
+  "largest error of simplified levels of detail in pixels (0 disables)",
+  0.0f,
+  64.0f,
+  1.0f);
+
+RX_CONSOLE_FVAR(
+  lod_hysteresis,
+  "render.model.lod_hysteresis",
+  "fraction of lod_error levels of detail need to change by to switch",
+  0.0f,
+  0.9f,
+  0.25f);
+
+RX_CONSOLE_BVAR(
+  pre_skin,
+  "render.model.pre_skin",
+  "skin animated models once a frame on the CPU instead of in every pass",
+  false);
+
+// The number of vertices skinned by a task.
+static constexpr const Size VERTICES_PER_TASK = 4096;
+
+// The number of meshes culled together.
+static constexpr const Size MESHES_PER_BATCH = 64;
+
 Model::Model(Frontend::Context* _frontend, Frontend::Technique* _technique)
   : m_frontend{_frontend}
   , m_technique{_technique}
+  , m_file_name{_frontend->allocator()}
   , m_arena{nullptr}
+  , m_skinned_arena{nullptr}
+  , m_skinned{false}
   , m_materials{_frontend->allocator()}
+  , m_material_files{_frontend->allocator()}
   , m_opaque_meshes{_frontend->allocator()}
   , m_transparent_meshes{_frontend->allocator()}
+  , m_blend_tree{nullptr}
   , m_clips{_frontend->allocator()}
+  , m_occlusion_baker{_frontend->allocator()}
+  , m_occlusion{_frontend->allocator()}
 {
 }
 
@@ -38,15 +87,23 @@ Optional<Model> Model::create(Frontend::Context* _frontend) {
 Model::Model(Model&& model_)
   : m_frontend{Utility::exchange(model_.m_frontend, nullptr)}
   , m_technique{Utility::exchange(model_.m_technique, nullptr)}
+  , m_file_name{Utility::move(model_.m_file_name)}
   , m_arena{Utility::exchange(model_.m_arena, nullptr)}
   , m_block{Utility::move(model_.m_block)}
+  , m_skinned_arena{Utility::exchange(model_.m_skinned_arena, nullptr)}
+  , m_skinned_block{Utility::move(model_.m_skinned_block)}
+  , m_skinned{Utility::exchange(model_.m_skinned, false)}
   , m_materials{Utility::move(model_.m_materials)}
+  , m_material_files{Utility::move(model_.m_material_files)}
   , m_opaque_meshes{Utility::move(model_.m_opaque_meshes)}
   , m_transparent_meshes{Utility::move(model_.m_transparent_meshes)}
   , m_skeleton{Utility::move(model_.m_skeleton)}
   , m_animation{Utility::move(model_.m_animation)}
+  , m_blend_tree{Utility::exchange(model_.m_blend_tree, nullptr)}
   , m_clips{Utility::move(model_.m_clips)}
   , m_aabb{Utility::move(model_.m_aabb)}
+  , m_occlusion_baker{Utility::move(model_.m_occlusion_baker)}
+  , m_occlusion{Utility::move(model_.m_occlusion)}
 {
 }
 
@@ -57,15 +114,23 @@ Model& Model::operator=(Model&& model_) {
 
   m_frontend = Utility::exchange(model_.m_frontend, nullptr);
   m_technique = Utility::exchange(model_.m_technique, nullptr);
+  m_file_name = Utility::move(model_.m_file_name);
   m_arena = Utility::exchange(model_.m_arena, nullptr);
   m_block = Utility::move(model_.m_block);
+  m_skinned_arena = Utility::exchange(model_.m_skinned_arena, nullptr);
+  m_skinned_block = Utility::move(model_.m_skinned_block);
+  m_skinned = Utility::exchange(model_.m_skinned, false);
   m_materials = Utility::move(model_.m_materials);
+  m_material_files = Utility::move(model_.m_material_files);
   m_opaque_meshes = Utility::move(model_.m_opaque_meshes);
   m_transparent_meshes = Utility::move(model_.m_transparent_meshes);
   m_skeleton = Utility::move(model_.m_skeleton);
   m_animation = Utility::move(model_.m_animation);
+  m_blend_tree = Utility::exchange(model_.m_blend_tree, nullptr);
   m_clips = Utility::move(model_.m_clips);
   m_aabb = Utility::move(model_.m_aabb);
+  m_occlusion_baker = Utility::move(model_.m_occlusion_baker);
+  m_occlusion = Utility::move(model_.m_occlusion);
 
   return *this;
 }
@@ -73,6 +138,23 @@ Model& Model::operator=(Model&& model_) {
 Model::~Model() {
 }
 
+// The arena of static vertices, which animated vertices are also skinned into.
+static Frontend::Arena* static_arena(Frontend::Context* _frontend) {
+  using Vertex = Rx::Model::Loader::Vertex;
+
+  Frontend::Buffer::Format format{_frontend->allocator()};
+  format.record_element_type(Frontend::Buffer::ElementType::U32);
+  format.record_vertex_stride(sizeof(Vertex));
+  format.record_vertex_attribute({Frontend::Buffer::Attribute::Type::F32x3, offsetof(Vertex, position)});
+  format.record_vertex_attribute({Frontend::Buffer::Attribute::Type::F32,   offsetof(Vertex, occlusion)});
+  format.record_vertex_attribute({Frontend::Buffer::Attribute::Type::F32x3, offsetof(Vertex, normal)});
+  format.record_vertex_attribute({Frontend::Buffer::Attribute::Type::F32x4, offsetof(Vertex, tangent)});
+  format.record_vertex_attribute({Frontend::Buffer::Attribute::Type::F32x2, offsetof(Vertex, coordinate)});
+  format.finalize();
+
+  return _frontend->arena(format);
+}
+
 bool Model::upload(const Rx::Model::Loader& _loader) {
   if (auto clips = Utility::copy(_loader.clips())) {
     m_clips = Utility::move(*clips);
@@ -90,6 +172,11 @@ bool Model::upload(const Rx::Model::Loader& _loader) {
 
   m_last_transform = nullopt;
 
+  // Skinned again from the new vertices when needed.
+  m_skinned_arena = nullptr;
+  m_skinned_block = Frontend::Arena::Block{};
+  m_skinned = false;
+
   // Clear incase being called multiple times for model changes.
   m_opaque_meshes.clear();
   m_transparent_meshes.clear();
@@ -120,17 +207,7 @@ bool Model::upload(const Rx::Model::Loader& _loader) {
   } else {
     using Vertex = Rx::Model::Loader::Vertex;
 
-    Frontend::Buffer::Format format{m_frontend->allocator()};
-    format.record_element_type(Frontend::Buffer::ElementType::U32);
-    format.record_vertex_stride(sizeof(Vertex));
-    format.record_vertex_attribute({Frontend::Buffer::Attribute::Type::F32x3, offsetof(Vertex, position)});
-    format.record_vertex_attribute({Frontend::Buffer::Attribute::Type::F32,   offsetof(Vertex, occlusion)});
-    format.record_vertex_attribute({Frontend::Buffer::Attribute::Type::F32x3, offsetof(Vertex, normal)});
-    format.record_vertex_attribute({Frontend::Buffer::Attribute::Type::F32x4, offsetof(Vertex, tangent)});
-    format.record_vertex_attribute({Frontend::Buffer::Attribute::Type::F32x2, offsetof(Vertex, coordinate)});
-    format.finalize();
-
-    m_arena = m_frontend->arena(format);
+    m_arena = static_arena(m_frontend);
     m_block = m_arena;
 
     const auto &vertices = _loader.vertices();
@@ -147,6 +224,7 @@ bool Model::upload(const Rx::Model::Loader& _loader) {
   m_frontend->update_buffer(RX_RENDER_TAG("Model"), m_arena->buffer());
 
   m_materials.clear();
+  m_material_files.clear();
 
   // Map all the loaded material::loader's to render::frontend::material's while
   // using indices to refer to them rather than strings.
@@ -154,9 +232,12 @@ bool Model::upload(const Rx::Model::Loader& _loader) {
   const bool material_load_result =
     _loader.materials().each_pair([this, &material_indices](const String& _name, const Material::Loader& _material) {
       Frontend::Material material{m_frontend};
-      if (material.load(_material)) {
+      MaterialFiles files{m_frontend->allocator()};
+      if (material.load(_material) && files.record(_material)) {
         const Size material_index{m_materials.size()};
-        return material_indices.insert(_name, material_index) && m_materials.push_back(Utility::move(material));
+        return material_indices.insert(_name, material_index)
+          && m_materials.push_back(Utility::move(material))
+          && m_material_files.push_back(Utility::move(files));
       }
       return false;
     });
@@ -169,16 +250,22 @@ bool Model::upload(const Rx::Model::Loader& _loader) {
   return _loader.meshes().each_fwd([this, &material_indices](const Rx::Model::Mesh& _mesh) {
     if (auto* find = material_indices.find(_mesh.material)) {
       auto bounds = Utility::copy(_mesh.bounds);
-      if (!bounds) {
+      auto lods = Utility::copy(_mesh.lods);
+      if (!bounds || !lods) {
         // Out of memory.
         return false;
       }
+      // A blend tree mixes frames of any clip.
+      Math::AABB any_frame;
+      bounds->each_fwd([&](const Vector<Math::AABB>& _frames) {
+        _frames.each_fwd([&](const Math::AABB& _frame) { any_frame.expand(_frame); });
+      });
       if (m_materials[*find].has_alpha()) {
         return m_transparent_meshes.emplace_back(_mesh.offset, _mesh.count,
-          *find, Utility::move(*bounds));
+          *find, Utility::move(*bounds), any_frame, Utility::move(*lods), 0_z);
       } else {
         return m_opaque_meshes.emplace_back(_mesh.offset, _mesh.count,
-          *find, Utility::move(*bounds));
+          *find, Utility::move(*bounds), any_frame, Utility::move(*lods), 0_z);
       }
     }
     return false;
@@ -191,6 +278,30 @@ void Model::animate(Size _index, [[maybe_unused]] bool _loop) {
   } else {
     m_animation = nullopt;
   }
+
+  m_blend_tree = nullptr;
+
+  // Skinned vertices are of the last animation until the next update.
+  m_skinned = false;
+}
+
+void Model::animate(const Rx::Model::BlendTree* _blend_tree) {
+  RX_ASSERT(!_blend_tree || (m_skeleton && _blend_tree->skeleton() == &*m_skeleton),
+    "blend tree of another skeleton");
+
+  m_animation = nullopt;
+  m_blend_tree = _blend_tree;
+
+  // Skinned vertices are of the last animation until the next update.
+  m_skinned = false;
+}
+
+const Vector<Math::Mat3x4f>& Model::lb_frames() const & {
+  return m_blend_tree ? m_blend_tree->lb_frames() : m_animation->lb_frames();
+}
+
+const Vector<Math::DualQuatf>& Model::dq_frames() const & {
+  return m_blend_tree ? m_blend_tree->dq_frames() : m_animation->dq_frames();
 }
 
 void Model::update(Float32 _delta_time) {
@@ -198,6 +309,160 @@ void Model::update(Float32 _delta_time) {
     m_animation->update(_delta_time, true);
   }
 
+  update_occlusion();
+  skin(nullptr, {this, 1});
+  update_bounds();
+}
+
+void Model::update(Concurrency::Scheduler& _scheduler, Span<Model> models_,
+  Float32 _delta_time)
+{
+  const auto n_models = models_.size();
+  if (n_models == 0) {
+    return;
+  }
+
+  Vector<Rx::Model::Animation*> animations{models_[0].m_frontend->allocator()};
+  if (!animations.reserve(n_models)) {
+    for (Size i = 0; i < n_models; i++) {
+      models_[i].update(_delta_time);
+    }
+    return;
+  }
+
+  for (Size i = 0; i < n_models; i++) {
+    if (auto& animation = models_[i].m_animation) {
+      (void)animations.push_back(&*animation);
+    }
+  }
+
+  Rx::Model::Animation::update(_scheduler,
+    {animations.data(), animations.size()}, _delta_time, true);
+
+  for (Size i = 0; i < n_models; i++) {
+    models_[i].update_occlusion();
+  }
+
+  skin(&_scheduler, models_);
+
+  for (Size i = 0; i < n_models; i++) {
+    models_[i].update_bounds();
+  }
+}
+
+bool Model::prepare_skinning() {
+  if (m_skinned_arena) {
+    return true;
+  }
+
+  using AnimatedVertex = Rx::Model::Loader::AnimatedVertex;
+  using Vertex = Rx::Model::Loader::Vertex;
+
+  auto arena = static_arena(m_frontend);
+  Frontend::Arena::Block block{arena};
+
+  // The elements are the same, only the vertices are skinned every frame.
+  const auto n_vertices = m_block.vertices().size() / sizeof(AnimatedVertex);
+  const auto elements = m_block.elements();
+  if (!block.map_vertices(n_vertices * sizeof(Vertex))
+    || !block.write_elements(elements.data(), elements.size()))
+  {
+    return false;
+  }
+  block.record_elements_edit(0, elements.size());
+
+  m_skinned_arena = arena;
+  m_skinned_block = Utility::move(block);
+
+  return true;
+}
+
+void Model::skin(Concurrency::Scheduler* _scheduler, Span<Model> models_) {
+  using AnimatedVertex = Rx::Model::Loader::AnimatedVertex;
+  using Vertex = Rx::Model::Loader::Vertex;
+
+  RX_PROFILE_CPU("model::skin");
+
+  const auto models = models_.data();
+  const auto n_models = models_.size();
+
+  const bool enabled = pre_skin->get();
+  for (Size i = 0; i < n_models; i++) {
+    auto& model = models[i];
+    model.m_skinned = enabled && model.is_animated() && model.prepare_skinning();
+    if (!enabled && model.m_skinned_arena) {
+      model.m_skinned_arena = nullptr;
+      model.m_skinned_block = Frontend::Arena::Block{};
+    }
+  }
+
+  // Calls |_function(vertices, count, frames, skinned)| for every group of at
+  // most VERTICES_PER_TASK vertices of the models skinned.
+  const auto each_group = [&](auto&& _function) {
+    for (Size i = 0; i < n_models; i++) {
+      auto& model = models[i];
+      if (!model.m_skinned) {
+        continue;
+      }
+
+      const auto vertices =
+        model.m_block.vertices().cast<const AnimatedVertex>();
+      const auto skinned = reinterpret_cast<Vertex*>(
+        model.m_skinned_block.edit_vertices().data());
+      const auto frames = model.dq_frames().data();
+
+      const auto n_vertices = vertices.size();
+      for (Size offset = 0; offset < n_vertices; offset += VERTICES_PER_TASK) {
+        _function(vertices.data() + offset,
+          Algorithm::min(n_vertices - offset, VERTICES_PER_TASK), frames,
+          skinned + offset);
+      }
+    }
+  };
+
+  Size n_groups = 0;
+  each_group([&](const AnimatedVertex*, Size, const Math::DualQuatf*, Vertex*) {
+    n_groups++;
+  });
+
+  if (n_groups == 0) {
+    return;
+  }
+
+  // Not worth a task.
+  if (!_scheduler || n_groups == 1) {
+    each_group(Rx::Model::skin);
+  } else {
+    Concurrency::WaitGroup group{n_groups};
+    each_group([&](const AnimatedVertex* _vertices, Size _count,
+      const Math::DualQuatf* _frames, Vertex* skinned_)
+    {
+      const bool added = _scheduler->add([&, _vertices, _count, _frames, skinned_](Sint32) {
+        Rx::Model::skin(_vertices, _count, _frames, skinned_);
+        group.signal();
+      });
+
+      if (!added) {
+        Rx::Model::skin(_vertices, _count, _frames, skinned_);
+        group.signal();
+      }
+    });
+
+    group.wait();
+  }
+
+  for (Size i = 0; i < n_models; i++) {
+    auto& model = models[i];
+    if (model.m_skinned) {
+      model.m_skinned_block.record_vertices_edit(0,
+        model.m_skinned_block.vertices().size());
+      model.m_frontend->update_buffer(RX_RENDER_TAG("Model"),
+        model.m_skinned_arena->buffer());
+    }
+  }
+}
+
+void Model::update_bounds() {
   Math::AABB aabb;
   auto expand = [&, this](const Mesh& _mesh) {
     aabb.expand(mesh_bounds(_mesh));
@@ -209,8 +474,43 @@ void Model::update(Float32 _delta_time) {
   m_aabb = aabb;
 }
 
+// Occlusion is at the same place in both kinds of vertices.
+static_assert(offsetof(Rx::Model::Loader::Vertex, occlusion)
+  == offsetof(Rx::Model::Loader::AnimatedVertex, occlusion));
+
+void Model::update_occlusion() {
+  if (!m_occlusion_baker) {
+    return;
+  }
+
+  // Checked before polling so the last pass is not missed.
+  const bool done = m_occlusion_baker->is_done();
+
+  if (m_occlusion_baker->poll(m_occlusion)) {
+    const auto vertices = m_block.edit_vertices();
+    const auto stride = m_arena->buffer()->format().vertex_stride();
+    const auto n_vertices = Algorithm::min(m_occlusion.size(), vertices.size() / stride);
+    const auto offset = offsetof(Rx::Model::Loader::Vertex, occlusion);
+    for (Size i = 0; i < n_vertices; i++) {
+      Memory::copy(reinterpret_cast<Float32*>(vertices.data() + i * stride + offset),
+        m_occlusion.data() + i);
+    }
+
+    m_block.record_vertices_edit(0, vertices.size());
+    m_frontend->update_buffer(RX_RENDER_TAG("Model"), m_arena->buffer());
+  }
+
+  if (done) {
+    logger->verbose("baked occlusion in %zu passes", m_occlusion_baker->passes());
+    m_occlusion_baker = nullptr;
+    m_occlusion.clear();
+  }
+}
+
 Math::AABB Model::mesh_bounds(const Mesh& _mesh) const {
-  if (m_animation) {
+  if (m_blend_tree) {
+    return _mesh.any_frame;
+  } else if (m_animation) {
     // Interpolate between the two frames.
     const auto& interpolant = m_animation->interpolant();
     const auto& bounds = _mesh.bounds[m_animation->clip()->index];
@@ -225,6 +525,43 @@ Math::AABB Model::mesh_bounds(const Mesh& _mesh) const {
   }
 }
 
+void Model::select_lod(Mesh& mesh_, const Math::AABB& _bounds,
+  const Math::Mat4x4f& _view, Float32 _scale) const
+{
+  const auto threshold = lod_error->get();
+  const auto distance = Math::length(Math::transform_point(_bounds.origin(), _view));
+
+  // Errors are relative to the size of the mesh, which is measured here by
+  // the longest axis of the bounds. Meshes the camera is inside of are always
+  // drawn in full.
+  if (threshold <= 0.0f || distance <= Math::length(_bounds.scale())) {
+    mesh_.lod = 0;
+    return;
+  }
+
+  const auto size = _bounds.scale().max_element() * 2.0f * _scale / distance;
+  const auto error = [&](Size _lod) {
+    return _lod ? mesh_.lods[_lod - 1].error * size : 0.0f;
+  };
+
+  // Levels only change when the error is far enough past the threshold to
+  // not switch back and forth every frame.
+  const auto n_lods = mesh_.lods.size();
+  const auto hysteresis = lod_hysteresis->get();
+  auto lod = Algorithm::min(mesh_.lod, n_lods);
+  if (error(lod) > threshold * (1.0f + hysteresis)) {
+    while (lod > 0 && error(lod) > threshold * (1.0f + hysteresis)) {
+      lod--;
+    }
+  } else {
+    while (lod < n_lods && error(lod + 1) < threshold * (1.0f - hysteresis)) {
+      lod++;
+    }
+  }
+
+  mesh_.lod = lod;
+}
+
 void Model::render(Frontend::Target* _target, const Math::Mat4x4f& _model,
                    const Math::Mat4x4f& _view, const Math::Mat4x4f& _projection,
                    Uint32 _flags, Immediate3D* _immediate)
@@ -273,9 +610,20 @@ void Model::render(Frontend::Target* _target, const Math::Mat4x4f& _model,
   // Viewport(0, 0, w, h)
   state.viewport.record_dimensions(_target->dimensions());
 
-  auto draw = [&](const Mesh& _mesh, bool _transparent) {
-    if (!frustum.is_aabb_inside(mesh_bounds(_mesh).transform(_model))) {
-      return false;
+  // Converts sizes in view space at a distance of one to pixels.
+  const auto lod_scale =
+    _projection.y.y * Float32(_target->dimensions().h) * 0.5f;
+
+  auto draw = [&](Mesh& _mesh, const Math::AABB& _bounds, bool _transparent) {
+    select_lod(_mesh, _bounds, _view, lod_scale);
+
+    Size offset = _mesh.offset;
+    Size count = _mesh.count;
+    if (_mesh.lod) {
+      const auto& lod = _mesh.lods[_mesh.lod - 1];
+      offset = lod.offset;
+      count = lod.count;
+      m_frontend->record_triangles_saved((_mesh.count - count) / 3);
     }
 
     RX_PROFILE_CPU("batch");
@@ -292,8 +640,9 @@ void Model::render(Frontend::Target* _target, const Math::Mat4x4f& _model,
     if (material.occlusion())  flags |= 1 << 5;
     if (material.emissive())   flags |= 1 << 6;
 
+    // Skinned vertices are drawn as static ones.
     Size configuration = 0;
-    if (m_animation) {
+    if (is_animated() && !m_skinned) {
       configuration = 2;
       // TODO(DQS)
     }
@@ -328,11 +677,11 @@ void Model::render(Frontend::Target* _target, const Math::Mat4x4f& _model,
     if (const auto& image = material.emissive())  uniforms[14].record_sampler(draw_images.add(image.texture, image.sampler));
 
     // For animation
-    if (m_animation) {
+    if (is_animated() && !m_skinned) {
       // LBS ...
-      uniforms[15].record_lb_bones(m_animation->lb_frames(), m_skeleton->joints().size());
+      uniforms[15].record_lb_bones(lb_frames(), m_skeleton->joints().size());
       // DQS ...
-      uniforms[16].record_dq_bones(m_animation->dq_frames(), m_skeleton->joints().size());
+      uniforms[16].record_dq_bones(dq_frames(), m_skeleton->joints().size());
     }
 
     // Record all the draw buffers.
@@ -348,39 +697,69 @@ void Model::render(Frontend::Target* _target, const Math::Mat4x4f& _model,
     // Only blend when transparent.
     state.blend.record_enable(_transparent);
 
+    const auto& arena = m_skinned ? m_skinned_arena : m_arena;
+    const auto& block = m_skinned ? m_skinned_block : m_block;
+
     m_frontend->draw(
       RX_RENDER_TAG("model mesh"),
       state,
       _target,
       draw_buffers,
-      m_arena->buffer(),
+      arena->buffer(),
       program,
-      _mesh.count,
-      m_block.base_element() + _mesh.offset,
+      count,
+      block.base_element() + offset,
       0,
-      m_block.base_vertex(),
-      m_block.base_instance(),
+      block.base_vertex(),
+      block.base_instance(),
       Render::Frontend::PrimitiveType::TRIANGLES,
       draw_images);
 
     if (_flags & BOUNDS) {
       _immediate->frame_queue().record_wire_box(
         {1.0f, 0.0f, 0.0f, 1.0f},
-        mesh_bounds(_mesh).transform(_model),
+        _bounds,
         Immediate3D::DEPTH_TEST | Immediate3D::DEPTH_WRITE);
     }
-
-    return true;
   };
 
+  // The bounds of a batch of meshes are laid out for the frustum to test
+  // them together.
   bool visible = false;
-  m_opaque_meshes.each_fwd([&](const Mesh& _mesh) {
-    visible |= draw(_mesh, false);
-  });
+  auto draw_visible = [&](Vector<Mesh>& meshes_, bool _transparent) {
+    const auto n_meshes = meshes_.size();
+    for (Size offset = 0; offset < n_meshes; offset += MESHES_PER_BATCH) {
+      const auto count = Algorithm::min(n_meshes - offset, MESHES_PER_BATCH);
+
+      Math::AABB bounds[MESHES_PER_BATCH];
+      Float32 origins[3][MESHES_PER_BATCH];
+      Float32 scales[3][MESHES_PER_BATCH];
+      for (Size i = 0; i < count; i++) {
+        bounds[i] = mesh_bounds(meshes_[offset + i]).transform(_model);
+        const auto origin = bounds[i].origin();
+        const auto scale = bounds[i].scale();
+        for (Size j = 0; j < 3; j++) {
+          origins[j][i] = origin[j];
+          scales[j][i] = scale[j];
+        }
+      }
 
-  m_transparent_meshes.each_fwd([&](const Mesh& _mesh) {
-    visible |= draw(_mesh, true);
-  });
+      Uint32 indices[MESHES_PER_BATCH];
+      const auto n_visible = frustum.cull(
+        Math::Frustum::Boxes{{origins[0], origins[1], origins[2]},
+                             {scales[0], scales[1], scales[2]}},
+        count, indices);
+
+      for (Size i = 0; i < n_visible; i++) {
+        draw(meshes_[offset + indices[i]], bounds[indices[i]], _transparent);
+      }
+
+      visible |= n_visible != 0;
+    }
+  };
+
+  draw_visible(m_opaque_meshes, false);
+  draw_visible(m_transparent_meshes, true);
 
   m_last_transform = _model * view_projection;
 
@@ -388,6 +767,12 @@ void Model::render(Frontend::Target* _target, const Math::Mat4x4f& _model,
     return;
   }
 
+  // Every vertex of the pre-skinned block is one not skinned by this draw.
+  if (m_skinned) {
+    m_frontend->record_skinning_saved(
+      m_skinned_block.vertices().size() / sizeof(Rx::Model::Loader::Vertex));
+  }
+
   if (_flags & BOUNDS) {
     _immediate->frame_queue().record_wire_box(
       {0.0f, 0.0f, 1.0f, 1.0f},
@@ -407,7 +792,7 @@ void Model::render(Frontend::Target* _target, const Math::Mat4x4f& _model,
 void Model::render_normals(const Math::Mat4x4f& _world, Render::Immediate3D* _immediate) {
   const auto scale = m_aabb.transform(_world).scale() * 0.25f;
 
-  if (m_animation) {
+  if (is_animated() && !m_skinned) {
     const auto& vertices = m_block.vertices().cast<const Rx::Model::Loader::AnimatedVertex>();
     const auto n_vertices = vertices.size();
 
@@ -420,7 +805,7 @@ void Model::render_normals(const Math::Mat4x4f& _world, Render::Immediate3D* _im
       const Math::Vec3f color = vertex.normal * 0.5f + 0.5f;
 
       // CPU skeletal animation of the lines.
-      const auto& frames = m_animation->lb_frames();
+      const auto& frames = lb_frames();
 
       Math::Mat3x4f transform;
       transform  = frames[vertex.blend_indices.x] * vertex.blend_weights.x;
@@ -446,7 +831,8 @@ void Model::render_normals(const Math::Mat4x4f& _world, Render::Immediate3D* _im
               Immediate3D::DEPTH_TEST | Immediate3D::DEPTH_WRITE);
     };
   } else {
-    const auto& vertices = m_block.vertices().cast<const Rx::Model::Loader::Vertex>();
+    const auto& block = m_skinned ? m_skinned_block : m_block;
+    const auto& vertices = block.vertices().cast<const Rx::Model::Loader::Vertex>();
     const auto n_vertices = vertices.size();
 
     for (Size i = 0; i < n_vertices; i++) {
@@ -478,8 +864,7 @@ void Model::render_skeleton(const Math::Mat4x4f& _world, Render::Immediate3D* _i
   // Render all the joints.
   for (Size i = 0; i < n_joints; i++) {
     const auto& frame =
-      m_animation
-        ? m_animation->lb_frames()[i] * joints[i].frame : joints[i].frame;
+      is_animated() ? lb_frames()[i] * joints[i].frame : joints[i].frame;
 
     const Math::Mat4x4f& joint{{frame.x.x, frame.y.x, frame.z.x, 0.0f},
                                {frame.x.y, frame.y.y, frame.z.y, 0.0f},
@@ -498,7 +883,7 @@ void Model::render_skeleton(const Math::Mat4x4f& _world, Render::Immediate3D* _i
   // Render the skeleton.
   for (Size i = 0; i < n_joints; i++) {
     const auto& frame =
-      m_animation ? m_animation->lb_frames()[i] * joints[i].frame : joints[i].frame;
+      is_animated() ? lb_frames()[i] * joints[i].frame : joints[i].frame;
 
     const auto parent = joints[i].parent;
 
@@ -508,7 +893,7 @@ void Model::render_skeleton(const Math::Mat4x4f& _world, Render::Immediate3D* _i
 
     const auto& parent_joint = joints[parent].frame;
     const auto& parent_frame =
-      m_animation ? m_animation->lb_frames()[parent] * parent_joint : parent_joint;
+      is_animated() ? lb_frames()[parent] * parent_joint : parent_joint;
 
     const Math::Vec3f parent_position = {
       parent_frame.x.w,
@@ -531,14 +916,161 @@ void Model::render_skeleton(const Math::Mat4x4f& _world, Render::Immediate3D* _i
   }
 }
 
+bool Model::MaterialFiles::record(const Rx::Material::Loader& _material) {
+  auto name_copy = Utility::copy(_material.name());
+  auto file_copy = Utility::copy(_material.file());
+  if (!name_copy || !file_copy) {
+    return false;
+  }
+
+  name = Utility::move(*name_copy);
+  file = Utility::move(*file_copy);
+  textures.clear();
+
+  return _material.textures().each_fwd([this](const Rx::Material::Texture& _texture) {
+    if (_texture.file().is_empty()) {
+      return true;
+    }
+    auto texture = Utility::copy(_texture.file());
+    return texture && textures.push_back(Utility::move(*texture));
+  });
+}
+
+bool Model::MaterialFiles::uses(const StringView& _file_name) const {
+  if (!file.is_empty() && StringView{file} == _file_name) {
+    return true;
+  }
+
+  return !textures.each_fwd([&](const String& _texture) {
+    return StringView{_texture} != _file_name;
+  });
+}
+
+bool Model::reload_material(const MaterialFiles& _files,
+  Optional<Serialize::JSON>& definition_, Rx::Material::Loader& loader_) const
+{
+  if (!_files.file.is_empty()) {
+    return loader_.load(_files.file);
+  }
+
+  if (m_file_name.is_empty()) {
+    return false;
+  }
+
+  if (!definition_) {
+    auto& allocator = m_frontend->allocator();
+    auto file = Filesystem::open_file(allocator, m_file_name);
+    if (!file) {
+      return false;
+    }
+    auto contents = file->read_text(allocator);
+    if (!contents) {
+      return false;
+    }
+    auto disown = contents->disown();
+    if (!disown) {
+      return false;
+    }
+    definition_ = Serialize::JSON::parse(allocator, String{*disown});
+    if (!definition_ || !*definition_) {
+      return false;
+    }
+  }
+
+  // The material with the same name in the definition, when it's defined
+  // there rather than in a file of its own.
+  Optional<Serialize::JSON> found;
+  (*definition_)["materials"].each([&](const Serialize::JSON& _material) {
+    if (!_material.is_object()) {
+      return true;
+    }
+    const auto name = _material["name"].as_string(m_frontend->allocator());
+    if (name && *name == _files.name) {
+      found = _material;
+      return false;
+    }
+    return true;
+  });
+
+  return found && loader_.parse(*found);
+}
+
+bool Model::reload(const StringView& _file_name) {
+  bool reloaded = false;
+
+  // An edit to the definition of the model changes the materials in it.
+  const bool definition_changed =
+    !m_file_name.is_empty() && StringView{m_file_name} == _file_name;
+  Optional<Serialize::JSON> definition;
+
+  const auto n_materials = m_material_files.size();
+  for (Size i = 0; i < n_materials; i++) {
+    auto& files = m_material_files[i];
+    const bool inline_changed = definition_changed && files.file.is_empty();
+    if (!inline_changed && !files.uses(_file_name)) {
+      continue;
+    }
+
+    // Only replace the material when everything loaded, a mistake in the
+    // edited file leaves the model as it was.
+    Rx::Material::Loader loader{m_frontend->allocator()};
+    Frontend::Material material{m_frontend};
+    if (!reload_material(files, definition, loader) || !material.load(loader)) {
+      logger->error("failed to reload material '%s'", files.name);
+      continue;
+    }
+
+    const bool had_alpha = m_materials[i].has_alpha();
+    m_materials[i] = Utility::move(material);
+    if (!files.record(loader)) {
+      return reloaded;
+    }
+
+    // Meshes are drawn in different passes when a material starts or stops
+    // being transparent.
+    if (had_alpha != m_materials[i].has_alpha()) {
+      auto& from = had_alpha ? m_transparent_meshes : m_opaque_meshes;
+      auto& to = had_alpha ? m_opaque_meshes : m_transparent_meshes;
+      for (Size j = 0; j < from.size(); ) {
+        if (from[j].material != i) {
+          j++;
+        } else if (to.push_back(Utility::move(from[j]))) {
+          from.erase(j, j + 1);
+        } else {
+          return reloaded;
+        }
+      }
+    }
+
+    logger->info("reloaded material '%s'", files.name);
+    reloaded = true;
+  }
+
+  return reloaded;
+}
+
 bool Model::load(Concurrency::Scheduler& _scheduler, Stream::Context& _stream) {
   Rx::Model::Loader loader{m_frontend->allocator()};
-  return loader.load(_scheduler, _stream) && upload(loader);
+  if (!loader.load(_scheduler, _stream) || !upload(loader)) {
+    return false;
+  }
+  m_file_name.clear();
+  m_occlusion_baker = Utility::move(loader.occlusion_baker());
+  return true;
 }
 
 bool Model::load(Concurrency::Scheduler& _scheduler, const StringView& _file_name) {
   Rx::Model::Loader loader{m_frontend->allocator()};
-  return loader.load(_scheduler, _file_name) && upload(loader);
+  if (!loader.load(_scheduler, _file_name) || !upload(loader)) {
+    return false;
+  }
+  auto file_name = _file_name.to_string(m_frontend->allocator());
+  if (!file_name) {
+    return false;
+  }
+  m_file_name = Utility::move(*file_name);
+  m_occlusion_baker = Utility::move(loader.occlusion_baker());
+  return true;
 }
 
 } // namespace Rx::Render
@@ -12,6 +12,9 @@
 
 #include "rx/core/uninitialized.h"
 
+namespace Rx::Serialize { struct JSON; }
+namespace Rx::Model { struct BlendTree; }
+
 namespace Rx::Render {
 
 namespace Frontend {
@@ -41,8 +44,19 @@ struct Model {
 
   void animate(Size _index, bool _loop);
 
+  // Takes the frames of the joints from |_blend_tree| in place of an animation,
+  // as it was last evaluated. The tree must be of skeleton() and is updated and
+  // evaluated by the caller before the model is updated. It must outlive the
+  // model or the next call to either of these.
+  void animate(const Rx::Model::BlendTree* _blend_tree);
+
   void update(Float32 _delta_time);
 
+  // Updates every model of |models_| like the above, with their animations
+  // updated together over |_scheduler|.
+  static void update(Concurrency::Scheduler& _scheduler, Span<Model> models_,
+    Float32 _delta_time);
+
   void render(Frontend::Target* _target, const Math::Mat4x4f& _model,
               const Math::Mat4x4f& _view, const Math::Mat4x4f& _projection,
               Uint32 _flags, Render::Immediate3D* _immediate = nullptr);
@@ -50,8 +64,19 @@ struct Model {
   [[nodiscard]] bool load(Concurrency::Scheduler& _scheduler, Stream::Context& _stream);
   [[nodiscard]] bool load(Concurrency::Scheduler& _scheduler, const StringView& _file_name);
 
+  // Reload the materials loaded from |_file_name| or using a texture in it.
+  // Materials defined in the model itself are rebuilt from its definition,
+  // also when that is |_file_name|. Returns true when any material was
+  // reloaded.
+  bool reload(const StringView& _file_name);
+
   const Optional<Rx::Model::Skeleton>& skeleton() const &;
   const Optional<Rx::Model::Animation>& animation() const &;
+  const Rx::Model::BlendTree* blend_tree() const;
+  const Vector<Rx::Model::Clip>& clips() const &;
+
+  // The bounds of the model at the current frame of the animation.
+  const Math::AABB& bounds() const &;
 
 private:
   Model(Frontend::Context* _frontend, Frontend::Technique* _technique);
@@ -61,28 +86,84 @@ private:
     Size count;
     Size material;
     Vector<Vector<Math::AABB>> bounds;
+    Math::AABB any_frame; // The bounds of every frame of every clip.
+    Vector<Rx::Model::Mesh::Lod> lods;
+    Size lod; // The level drawn last, 0 for the mesh itself.
+  };
+
+  // The files a material was loaded from. Materials defined in the model
+  // itself have no |file| and are found in the definition by |name|.
+  struct MaterialFiles {
+    MaterialFiles(Memory::Allocator& _allocator);
+    [[nodiscard]] bool record(const Rx::Material::Loader& _material);
+    bool uses(const StringView& _file_name) const;
+    String name;
+    String file;
+    Vector<String> textures;
   };
 
+  // Allocates the block animated vertices are skinned into.
+  [[nodiscard]] bool prepare_skinning();
+
+  // Skins the vertices of every animated model of |models_| into their
+  // skinned blocks when pre-skinning is enabled, over |_scheduler| if given.
+  static void skin(Concurrency::Scheduler* _scheduler, Span<Model> models_);
+
   void render_normals(const Math::Mat4x4f& _world, Render::Immediate3D* _immediate);
   void render_skeleton(const Math::Mat4x4f& _world, Render::Immediate3D* _immediate);
 
   [[nodiscard]] bool upload(const Rx::Model::Loader& _loader);
 
+  // Loads the material of |_files| again into |loader_|, from the definition
+  // of the model in |definition_| when defined there, which is read once.
+  bool reload_material(const MaterialFiles& _files,
+    Optional<Serialize::JSON>& definition_, Rx::Material::Loader& loader_) const;
+
+  // The frames of the joints, from the blend tree or the animation, when
+  // either is playing.
+  bool is_animated() const;
+  const Vector<Math::Mat3x4f>& lb_frames() const &;
+  const Vector<Math::DualQuatf>& dq_frames() const &;
+
+  // Writes the occlusion of the last pass of a progressive bake, if any, into
+  // the vertices.
+  void update_occlusion();
+
+  // Finds the bounds of the model at the current frame of the animation.
+  void update_bounds();
+
   // Obtains the bounds for a given mesh |_mesh| even if currently animated.
   Math::AABB mesh_bounds(const Mesh& _mesh) const;
 
+  // Selects the level of detail of |mesh_| for the size of |_bounds| in view
+  // space, where |_scale| converts from view space to pixels.
+  void select_lod(Mesh& mesh_, const Math::AABB& _bounds,
+    const Math::Mat4x4f& _view, Float32 _scale) const;
+
   Frontend::Context* m_frontend;
   Frontend::Technique* m_technique;
+  String m_file_name; // The definition loaded, empty for streams.
   Frontend::Arena* m_arena;
   Frontend::Arena::Block m_block;
+
+  // The vertices of the current frame of the animation, skinned once for every
+  // pass to draw as static vertices. Only when |m_skinned|.
+  Frontend::Arena* m_skinned_arena;
+  Frontend::Arena::Block m_skinned_block;
+  bool m_skinned;
+
   Vector<Frontend::Material> m_materials;
+  Vector<MaterialFiles> m_material_files;
   Vector<Mesh> m_opaque_meshes;
   Vector<Mesh> m_transparent_meshes;
   Optional<Rx::Model::Skeleton> m_skeleton;
   Optional<Rx::Model::Animation> m_animation;
+  const Rx::Model::BlendTree* m_blend_tree;
   Vector<Rx::Model::Clip> m_clips;
   Math::AABB m_aabb;
   Optional<Math::Mat4x4f> m_last_transform;
+  Ptr<Rx::Model::AoBaker> m_occlusion_baker;
+  Vector<Float32> m_occlusion;
 };
 
 inline Model::Model()
@@ -90,6 +171,13 @@ inline Model::Model()
 {
 }
 
+inline Model::MaterialFiles::MaterialFiles(Memory::Allocator& _allocator)
+  : name{_allocator}
+  , file{_allocator}
+  , textures{_allocator}
+{
+}
+
 inline const Optional<Rx::Model::Skeleton>& Model::skeleton() const & {
   return m_skeleton;
 }
@@ -98,6 +186,22 @@ inline const Optional<Rx::Model::Animation>& Model::animation() const & {
   return m_animation;
 }
 
+inline const Rx::Model::BlendTree* Model::blend_tree() const {
+  return m_blend_tree;
+}
+
+inline const Vector<Rx::Model::Clip>& Model::clips() const & {
+  return m_clips;
+}
+
+inline bool Model::is_animated() const {
+  return m_blend_tree || m_animation;
+}
+
+inline const Math::AABB& Model::bounds() const & {
+  return m_aabb;
+}
+
 } // namespace Rx::Render
 
 #endif // RX_RENDER_MODEL_H
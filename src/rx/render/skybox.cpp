@@ -7,7 +7,7 @@
 
 #include "rx/math/vec3.h"
 
-#include "rx/core/filesystem/unbuffered_file.h"
+#include "rx/core/filesystem/vfs.h"
 #include "rx/core/serialize/json.h"
 #include "rx/core/profiler.h"
 #include "rx/core/concurrency/thread_pool.h"
@@ -133,7 +133,7 @@ bool Skybox::load_async(Concurrency::Scheduler& _scheduler,
 
 bool Skybox::load(const StringView& _file_name, const Math::Vec2z& _max_face_dimensions) {
   auto& allocator = m_frontend->allocator();
-  if (auto file = Filesystem::UnbufferedFile::open(allocator, _file_name, "r")) {
+  if (auto file = Filesystem::open_file(allocator, _file_name)) {
     return load(*file, _max_face_dimensions);
   }
   return false;
@@ -10,13 +10,33 @@
 
 namespace Rx::Texture {
 
+Size Chain::count_pixels(const Math::Vec2z& _dimensions, bool _mipchain) {
+  if (!_mipchain) {
+    return _dimensions.area();
+  }
+
+  const auto levels = Math::log2(Uint64(_dimensions.max_element())) + 1;
+
+  Math::Vec2z dimensions{_dimensions};
+  Size pixels = 0;
+  for (Size i = 0; i < levels; i++) {
+    pixels += dimensions.area();
+    dimensions = dimensions.map([](Size _dim) {
+      return Algorithm::max(_dim / 2, 1_z);
+    });
+  }
+
+  return pixels;
+}
+
 bool Chain::generate(LinearBuffer&& data_, PixelFormat _has_format,
   PixelFormat _want_format, const Math::Vec2z& _dimensions, bool _has_mipchain,
   bool _want_mipchain)
 {
+  const auto pixels = count_pixels(_dimensions, _has_mipchain);
   if (_has_format == _want_format) {
     m_data = Utility::move(data_);
-  } else if (auto data = convert(allocator(), data_.data(), _dimensions.area(), _has_format, _want_format)) {
+  } else if (auto data = convert(allocator(), data_.data(), pixels, _has_format, _want_format)) {
     m_data = Utility::move(*data);
   } else {
     return false;
@@ -35,13 +55,15 @@ bool Chain::generate(const Byte* _data, PixelFormat _has_format,
   m_pixel_format = _want_format;
   m_dimensions = _dimensions;
 
-  if (!m_data.resize(_dimensions.area() * bpp())) {
+  // Every level is copied when there's a mipchain.
+  const auto pixels = count_pixels(_dimensions, _has_mipchain);
+  if (!m_data.resize(pixels * bpp())) {
     return false;
   }
 
   if (_has_format == _want_format) {
     Memory::copy(m_data.data(), _data, m_data.size());
-  } else if (auto data = convert(allocator(), _data, _dimensions.area(), _has_format, _want_format)) {
+  } else if (auto data = convert(allocator(), _data, pixels, _has_format, _want_format)) {
     m_data = Utility::move(*data);
   } else {
     return false;
@@ -36,6 +36,9 @@ struct Chain {
 
   [[nodiscard]] bool resize(const Math::Vec2z& _dimensions);
 
+  // Number of pixels in a chain of |_dimensions|, with or without a mipchain.
+  static Size count_pixels(const Math::Vec2z& _dimensions, bool _mipchain);
+
   LinearBuffer&& data();
   const LinearBuffer& data() const;
 
@@ -2,7 +2,7 @@
 #include "rx/texture/scale.h"
 #include "rx/texture/convert.h"
 
-#include "rx/core/filesystem/unbuffered_file.h"
+#include "rx/core/filesystem/vfs.h"
 #include "rx/core/log.h"
 
 #if defined(RX_PLATFORM_EMSCRIPTEN)
@@ -72,8 +72,8 @@ bool Loader::load(Stream::Context& _stream, PixelFormat _want_format,
   }
   free(decoded_image);
 #else
-  // Use STBI.
-  auto data = _stream.read_binary(allocator());
+  // Use STBI. Decode directly out of the stream when it can be viewed.
+  auto data = _stream.view_binary(allocator());
   if (!data) {
     return false;
   }
@@ -168,7 +168,7 @@ bool Loader::load(Stream::Context& _stream, PixelFormat _want_format,
 bool Loader::load(const StringView& _file_name, PixelFormat _want_format,
   const Math::Vec2z& _max_dimensions)
 {
-  if (auto file = Filesystem::UnbufferedFile::open(allocator(), _file_name, "r")) {
+  if (auto file = Filesystem::open_file(allocator(), _file_name, Filesystem::FileKind::MAPPED)) {
     return load(*file, _want_format, _max_dimensions);
   }
   return false;
@@ -0,0 +1,152 @@
+#include <stdio.h> // printf, fprintf
+#include <stdlib.h> // strtoul
+#include <string.h> // strcmp
+
+#include "rx/core/filesystem/directory.h"
+#include "rx/core/filesystem/pack.h"
+#include "rx/core/filesystem/unbuffered_file.h"
+
+#include "rx/core/concurrency/thread_pool.h"
+#include "rx/core/global.h"
+
+// Packs files and directories into a Filesystem::Pack.
+//
+// Usage: packer [-0] [-a alignment] [-j threads] <pack> <path>...
+//
+// Each path is added under the name it's given, directories recursively, so
+// "packer base.rxp base" gives names like "base/fonts/Consolas-Regular.ttf".
+// Point the "filesystem.pack" console variable at the pack to have the engine
+// load files out of it.
+
+using namespace Rx;
+
+struct Options {
+  bool compress = true;
+  Uint32 alignment = Filesystem::PackWriter::ALIGNMENT;
+  Size threads = 4;
+};
+
+static bool add_file(Filesystem::PackWriter& writer_, const StringView& _file_name,
+  const Options& _options, Uint64& bytes_)
+{
+  auto& allocator = Memory::SystemAllocator::instance();
+  auto file = Filesystem::MappedFile::open(allocator, _file_name);
+  if (!file) {
+    return false;
+  }
+
+  const auto data = file->data();
+  if (!writer_.add(_file_name, data, _options.compress)) {
+    fprintf(stderr, "failed to add '%s'\n", _file_name.data());
+    return false;
+  }
+
+  bytes_ += data.size();
+  return true;
+}
+
+static bool add_directory(Filesystem::PackWriter& writer_, Filesystem::Directory& directory_,
+  const Options& _options, Uint64& bytes_)
+{
+  return directory_.each([&](Filesystem::Directory::Item&& item_) {
+    const auto name = item_.full_name();
+    if (!name) {
+      return false;
+    }
+
+    if (item_.is_directory()) {
+      auto directory = item_.as_directory();
+      return directory && add_directory(writer_, *directory, _options, bytes_);
+    }
+
+    return add_file(writer_, *name, _options, bytes_);
+  });
+}
+
+static int usage(const char* _program) {
+  fprintf(stderr, "usage: %s [-0] [-a alignment] [-j threads] <pack> <path>...\n", _program);
+  fprintf(stderr, "  -0  store files without compression\n");
+  fprintf(stderr, "  -a  alignment of files in the pack (default %u)\n", Filesystem::PackWriter::ALIGNMENT);
+  fprintf(stderr, "  -j  threads to compress with, 0 compresses on this one (default 4)\n");
+  return 1;
+}
+
+static int pack(int _argc, char** _argv) {
+  auto& allocator = Memory::SystemAllocator::instance();
+
+  Options options;
+
+  int arg = 1;
+  for (; arg < _argc && _argv[arg][0] == '-'; arg++) {
+    if (!strcmp(_argv[arg], "-0")) {
+      options.compress = false;
+    } else if (!strcmp(_argv[arg], "-a") && arg + 1 < _argc) {
+      options.alignment = static_cast<Uint32>(strtoul(_argv[++arg], nullptr, 10));
+    } else if (!strcmp(_argv[arg], "-j") && arg + 1 < _argc) {
+      options.threads = strtoul(_argv[++arg], nullptr, 10);
+    } else {
+      return usage(_argv[0]);
+    }
+  }
+
+  if (_argc - arg < 2) {
+    return usage(_argv[0]);
+  }
+
+  Optional<Concurrency::ThreadPool> thread_pool;
+  if (options.threads) {
+    thread_pool = Concurrency::ThreadPool::create(allocator, options.threads, 1024);
+    if (!thread_pool) {
+      return 1;
+    }
+  }
+
+  const char* pack_name = _argv[arg++];
+  auto file = Filesystem::UnbufferedFile::open(allocator, pack_name, "w");
+  if (!file) {
+    fprintf(stderr, "failed to create '%s'\n", pack_name);
+    return 1;
+  }
+
+  auto writer = Filesystem::PackWriter::create(allocator, *file,
+    thread_pool ? &*thread_pool : nullptr, options.alignment);
+  if (!writer) {
+    fprintf(stderr, "bad alignment %u\n", options.alignment);
+    return 1;
+  }
+
+  Uint64 bytes = 0;
+  for (; arg < _argc; arg++) {
+    if (auto directory = Filesystem::Directory::open(allocator, _argv[arg])) {
+      if (!add_directory(*writer, *directory, options, bytes)) {
+        return 1;
+      }
+    } else if (!add_file(*writer, _argv[arg], options, bytes)) {
+      fprintf(stderr, "failed to open '%s'\n", _argv[arg]);
+      return 1;
+    }
+  }
+
+  if (!writer->finish()) {
+    fprintf(stderr, "failed to write '%s'\n", pack_name);
+    return 1;
+  }
+
+  printf("%s: %llu bytes packed into %llu\n", pack_name,
+    static_cast<unsigned long long>(bytes),
+    static_cast<unsigned long long>(writer->size()));
+
+  return 0;
+}
+
+int main(int _argc, char** _argv) {
+  if (!Globals::link()) {
+    return 1;
+  }
+
+  Globals::init();
+  const int result = pack(_argc, _argv);
+  Globals::fini();
+
+  return result;
+}